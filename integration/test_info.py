@@ -57,7 +57,14 @@ class TestVSSBasic(ValkeySearchTestCaseBase):
         ]
 
         string_fields = [
-            "search_background_indexing_status"
+            "search_background_indexing_status",
+            "search_distance_kernel_l2_float32",
+            "search_distance_kernel_ip_float32",
+            "search_distance_kernel_l2_float16",
+            "search_distance_kernel_ip_float16",
+            "search_distance_kernel_l2_bfloat16",
+            "search_distance_kernel_ip_bfloat16",
+            "search_distance_kernel_hamming_binary"
         ]
 
         bytes_fields = [
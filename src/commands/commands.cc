@@ -117,7 +117,9 @@ absl::Status QueryCommand::Execute(ValkeyModuleCtx *ctx,
       }
       parameters->SendReply(ctx, search_result);
       ValkeySearch::Instance().ScheduleSearchResultCleanup(
-          [neighbors = std::move(search_result.neighbors)]() mutable {
+          [neighbors = std::move(search_result.neighbors),
+           batch_results =
+               std::move(search_result.batch_results)]() mutable {
             // neighbors destructor runs automatically when lambda completes
           });
       return absl::OkStatus();
@@ -9,8 +9,10 @@
 
 #include <cctype>
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 
@@ -27,6 +29,7 @@
 #include "src/indexes/numeric.h"
 #include "src/indexes/tag.h"
 #include "src/indexes/text.h"
+#include "src/indexes/vector_base.h"
 #include "src/query/predicate.h"
 #include "src/valkey_search_options.h"
 #include "vmsdk/src/status/status_macros.h"
@@ -157,6 +160,13 @@ std::string PrintPredicateTree(const query::Predicate* predicate, int indent) {
           indent_str + "NUMERIC(" + std::string(numeric->GetAlias()) + ")\n";
       break;
     }
+    case query::PredicateType::kVectorRange: {
+      const auto* vector_range =
+          static_cast<const query::VectorRangePredicate*>(predicate);
+      result += indent_str + "VECTOR_RANGE(" +
+                std::string(vector_range->GetAlias()) + ")\n";
+      break;
+    }
     case query::PredicateType::kTag: {
       const auto* tag = static_cast<const query::TagPredicate*>(predicate);
       result += indent_str + "TAG(" + std::string(tag->GetAlias()) + ")\n";
@@ -206,9 +216,11 @@ std::string PrintPredicateTree(const query::Predicate* predicate, int indent) {
 
 FilterParser::FilterParser(const IndexSchema& index_schema,
                            absl::string_view expression,
-                           const TextParsingOptions& options)
+                           const TextParsingOptions& options,
+                           QueryParams* params)
     : index_schema_(index_schema),
       expression_(absl::StripAsciiWhitespace(expression)),
+      params_(params),
       options_(options),
       query_operations_{QueryOperations::kNone} {}
 
@@ -260,7 +272,8 @@ absl::StatusOr<std::string> FilterParser::ParseFieldName() {
   return field_name;
 }
 
-absl::StatusOr<double> FilterParser::ParseNumber() {
+absl::StatusOr<double> FilterParser::ParseNumber(
+    std::optional<int64_t>* integer) {
   SkipWhitespace();
   if (MatchInsensitive("-inf")) {
     return kNegativeInf;
@@ -269,12 +282,19 @@ absl::StatusOr<double> FilterParser::ParseNumber() {
   }
   std::string number_str;
   double value;
-  int multiplier = Match('-', false) ? -1 : 1;
+  bool negative = Match('-', false);
+  int multiplier = negative ? -1 : 1;
   while (!IsEnd() && (std::isdigit(Peek()) || Peek() == '.')) {
     number_str += expression_[pos_++];
   }
   if (absl::AsciiStrToLower(number_str) != "nan" &&
       absl::SimpleAtod(number_str, &value)) {
+    int64_t integer_value;
+    if (integer != nullptr &&
+        absl::SimpleAtoi(negative ? absl::StrCat("-", number_str) : number_str,
+                         &integer_value)) {
+      *integer = integer_value;
+    }
     return value * multiplier;
   }
   return absl::InvalidArgumentError(
@@ -295,7 +315,8 @@ FilterParser::ParseNumericPredicate(const std::string& attribute_alias) {
   if (Match('(')) {
     is_inclusive_start = false;
   }
-  VMSDK_ASSIGN_OR_RETURN(auto start, ParseNumber());
+  std::optional<int64_t> integer_start;
+  VMSDK_ASSIGN_OR_RETURN(auto start, ParseNumber(&integer_start));
   if (!Match(' ', false) && !Match(',')) {
     return absl::InvalidArgumentError(
         absl::StrCat("Expected space or `|` between start and end values of a "
@@ -306,14 +327,19 @@ FilterParser::ParseNumericPredicate(const std::string& attribute_alias) {
   if (Match('(')) {
     is_inclusive_end = false;
   }
-  VMSDK_ASSIGN_OR_RETURN(auto end, ParseNumber());
+  std::optional<int64_t> integer_end;
+  VMSDK_ASSIGN_OR_RETURN(auto end, ParseNumber(&integer_end));
   if (!Match(']')) {
     return absl::InvalidArgumentError(absl::StrCat("Expected ']' got '",
                                                    expression_.substr(pos_, 1),
                                                    "'. Position: ", pos_));
   }
-  if (start > end ||
-      (start == end && !(is_inclusive_start && is_inclusive_end))) {
+  // Integers beyond 2^53 may be rounded to the same double, so they are
+  // compared as parsed.
+  bool exact = integer_start.has_value() && integer_end.has_value();
+  bool above = exact ? *integer_start > *integer_end : start > end;
+  bool equal = exact ? *integer_start == *integer_end : start == end;
+  if (above || (equal && !(is_inclusive_start && is_inclusive_end))) {
     return absl::InvalidArgumentError(
         absl::StrCat("Start and end values of a "
                      "numeric field indicate an empty range. Position: ",
@@ -324,7 +350,70 @@ FilterParser::ParseNumericPredicate(const std::string& attribute_alias) {
   query_operations_ |= QueryOperations::kContainsNumeric;
   return std::make_unique<query::NumericPredicate>(
       numeric_index, attribute_alias, identifier, start, is_inclusive_start,
-      end, is_inclusive_end);
+      end, is_inclusive_end, integer_start, integer_end);
+}
+
+absl::StatusOr<std::unique_ptr<query::VectorRangePredicate>>
+FilterParser::ParseVectorRangePredicate(const std::string& attribute_alias) {
+  auto index = index_schema_.GetIndex(attribute_alias);
+  if (!index.ok() ||
+      (index.value()->GetIndexerType() != indexes::IndexerType::kHNSW &&
+       index.value()->GetIndexerType() != indexes::IndexerType::kFlat)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("`", attribute_alias,
+                     "` is not indexed as an HNSW or FLAT vector field"));
+  }
+  auto identifier = index_schema_.GetIdentifier(attribute_alias).value();
+  filter_identifiers_.insert(identifier);
+  if (!Match(' ', false)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Expected space after VECTOR_RANGE. Position: ", pos_));
+  }
+  VMSDK_ASSIGN_OR_RETURN(auto radius, ParseNumber());
+  if (radius < 0 || radius == kPositiveInf) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("VECTOR_RANGE radius must be a non negative number. "
+                     "Position: ",
+                     pos_));
+  }
+  SkipWhitespace();
+  if (!Match('$', false)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Expected the query vector as a `$` parameter. Position: ",
+                     pos_));
+  }
+  size_t param_start = pos_;
+  while (!IsEnd() && Peek() != ']' && !std::isspace(Peek())) {
+    ++pos_;
+  }
+  auto param_name = expression_.substr(param_start, pos_ - param_start);
+  auto param_not_found = absl::NotFoundError(
+      absl::StrCat("Parameter ", param_name, " not found."));
+  if (!params_) {
+    return param_not_found;
+  }
+  auto param = params_->find(param_name);
+  if (param == params_->end()) {
+    return param_not_found;
+  }
+  param->second.first++;
+  if (!Match(']')) {
+    return absl::InvalidArgumentError(absl::StrCat("Expected ']' got '",
+                                                   expression_.substr(pos_, 1),
+                                                   "'. Position: ", pos_));
+  }
+  auto vector_index = dynamic_cast<indexes::VectorBase*>(index.value().get());
+  auto query = param->second.second;
+  if (query.size() != static_cast<size_t>(vector_index->GetVectorDataSize())) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "VECTOR_RANGE query vector blob size (", query.size(),
+        ") does not match index's expected size (",
+        vector_index->GetVectorDataSize(), ")."));
+  }
+  query_operations_ |= QueryOperations::kContainsVectorRange;
+  return std::make_unique<query::VectorRangePredicate>(
+      vector_index, attribute_alias, identifier, radius,
+      vector_index->NormalizeQuery(query));
 }
 
 absl::StatusOr<absl::string_view> FilterParser::ParseTagString() {
@@ -968,7 +1057,14 @@ absl::StatusOr<FilterParser::ParseResult> FilterParser::ParseExpression(
         field_name = parsed_field;
         if (Match('[')) {
           node_count_++;
-          VMSDK_ASSIGN_OR_RETURN(predicate, ParseNumericPredicate(*field_name));
+          SkipWhitespace();
+          if (MatchInsensitive("VECTOR_RANGE")) {
+            VMSDK_ASSIGN_OR_RETURN(predicate,
+                                   ParseVectorRangePredicate(*field_name));
+          } else {
+            VMSDK_ASSIGN_OR_RETURN(predicate,
+                                   ParseNumericPredicate(*field_name));
+          }
           non_text = true;
         } else if (Match('{')) {
           node_count_++;
@@ -8,9 +8,13 @@
 #ifndef VALKEYSEARCH_SRC_COMMANDS_FILTER_PARSER_H_
 #define VALKEYSEARCH_SRC_COMMANDS_FILTER_PARSER_H_
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <utility>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
@@ -39,6 +43,7 @@ enum class QueryOperations : uint64_t {
   kContainsNegate = 1 << 4,
   kContainsText = 1 << 5,
   kContainsExactPhrase = 1 << 6,
+  kContainsVectorRange = 1 << 7,
 };
 
 inline QueryOperations operator|(QueryOperations a, QueryOperations b) {
@@ -54,6 +59,10 @@ inline bool operator&(QueryOperations a, QueryOperations b) {
   return static_cast<uint64_t>(a) & static_cast<uint64_t>(b);
 }
 
+// Query parameters by name, each with the number of times it was used.
+using QueryParams =
+    absl::flat_hash_map<absl::string_view, std::pair<int, absl::string_view>>;
+
 struct FilterParseResults {
   std::unique_ptr<query::Predicate> root_predicate;
   absl::flat_hash_set<std::string> filter_identifiers;
@@ -61,8 +70,11 @@ struct FilterParseResults {
 };
 class FilterParser {
  public:
+  // `params` resolves the `$` parameters of the expression, such as the query
+  // vector of a VECTOR_RANGE clause.
   FilterParser(const IndexSchema& index_schema, absl::string_view expression,
-               const TextParsingOptions& options);
+               const TextParsingOptions& options,
+               QueryParams* params = nullptr);
 
   absl::StatusOr<FilterParseResults> Parse();
 
@@ -75,6 +87,7 @@ class FilterParser {
   const TextParsingOptions& options_;
   const IndexSchema& index_schema_;
   absl::string_view expression_;
+  QueryParams* params_;
   size_t pos_{0};
   size_t node_count_{0};
   absl::flat_hash_set<std::string> filter_identifiers_;
@@ -113,6 +126,8 @@ class FilterParser {
   absl::StatusOr<ParseResult> ParseExpression(uint32_t level);
   absl::StatusOr<std::unique_ptr<query::NumericPredicate>>
   ParseNumericPredicate(const std::string& attribute_alias);
+  absl::StatusOr<std::unique_ptr<query::VectorRangePredicate>>
+  ParseVectorRangePredicate(const std::string& attribute_alias);
   absl::StatusOr<std::unique_ptr<query::TagPredicate>> ParseTagPredicate(
       const std::string& attribute_alias);
   absl::StatusOr<std::unique_ptr<query::TextPredicate>> ParseTextPredicate(
@@ -126,7 +141,8 @@ class FilterParser {
   bool MatchInsensitive(const std::string& expected);
   absl::StatusOr<std::string> ParseFieldName();
 
-  absl::StatusOr<double> ParseNumber();
+  // Also sets `integer`, if given, when the number is an int64 literal.
+  absl::StatusOr<double> ParseNumber(std::optional<int64_t>* integer = nullptr);
 
   absl::StatusOr<absl::string_view> ParseTagString();
 
@@ -109,6 +109,10 @@ absl::Status AggregateParameters::ParseCommand(vmsdk::ArgsIterator &itr) {
                                                         // 10 from search
 
   VMSDK_RETURN_IF_ERROR(PostParseQueryString(*this));
+  if (IsBatchedQuery()) {
+    return absl::InvalidArgumentError(
+        "Batched KNN queries are not supported by FT.AGGREGATE");
+  }
   VMSDK_RETURN_IF_ERROR(VerifyQueryString(*this));
   VMSDK_RETURN_IF_ERROR(ManipulateReturnsClause(*this));
 
@@ -27,6 +27,7 @@
 #include "src/index_schema.pb.h"
 #include "src/indexes/index_base.h"
 #include "src/indexes/vector_base.h"
+#include "third_party/hnswlib/space_binary.h"
 #include "vmsdk/src/command_parser.h"
 #include "vmsdk/src/module_config.h"
 #include "vmsdk/src/status/status_macros.h"
@@ -42,6 +43,14 @@ constexpr absl::string_view kBlockSizeParam{"BLOCK_SIZE"};
 constexpr absl::string_view kMParam{"M"};
 constexpr absl::string_view kEfConstructionParam{"EF_CONSTRUCTION"};
 constexpr absl::string_view kEfRuntimeParam{"EF_RUNTIME"};
+constexpr absl::string_view kQuantizeParam{"QUANTIZE"};
+constexpr absl::string_view kShardsParam{"SHARDS"};
+constexpr absl::string_view kGraphDimensionsParam{"GRAPH_DIM"};
+constexpr absl::string_view kNlistParam{"NLIST"};
+constexpr absl::string_view kNprobeParam{"NPROBE"};
+constexpr absl::string_view kPqMParam{"PQ_M"};
+constexpr absl::string_view kPqRerankParam{"PQ_RERANK"};
+constexpr absl::string_view kPqNbitsParam{"PQ_NBITS"};
 constexpr absl::string_view kDimensionsParam{"DIM"};
 constexpr absl::string_view kDistanceMetricParam{"DISTANCE_METRIC"};
 constexpr absl::string_view kDataTypeParam{"TYPE"};
@@ -286,6 +295,15 @@ vmsdk::KeyValueParser<HNSWParameters> CreateHNSWParser() {
                         GENERATE_VALUE_PARSER(HNSWParameters, ef_construction));
   parser.AddParamParser(kEfRuntimeParam,
                         GENERATE_VALUE_PARSER(HNSWParameters, ef_runtime));
+  parser.AddParamParser(
+      kQuantizeParam,
+      GENERATE_ENUM_PARSER(HNSWParameters, quantization,
+                           *indexes::kVectorQuantizationByStr));
+  parser.AddParamParser(kShardsParam,
+                        GENERATE_VALUE_PARSER(HNSWParameters, shards));
+  parser.AddParamParser(
+      kGraphDimensionsParam,
+      GENERATE_VALUE_PARSER(HNSWParameters, graph_dimensions));
   return parser;
 }
 vmsdk::KeyValueParser<FlatParameters> CreateFlatParamParser() {
@@ -304,6 +322,30 @@ vmsdk::KeyValueParser<FlatParameters> CreateFlatParamParser() {
                         GENERATE_VALUE_PARSER(FlatParameters, block_size));
   return parser;
 }
+vmsdk::KeyValueParser<IVFParameters> CreateIVFParamParser() {
+  vmsdk::KeyValueParser<IVFParameters> parser;
+  parser.AddParamParser(kDimensionsParam,
+                        GENERATE_VALUE_PARSER(IVFParameters, dimensions));
+  parser.AddParamParser(kDataTypeParam,
+                        GENERATE_ENUM_PARSER(IVFParameters, vector_data_type,
+                                             *indexes::kVectorDataTypeByStr));
+  parser.AddParamParser(kDistanceMetricParam,
+                        GENERATE_ENUM_PARSER(IVFParameters, distance_metric,
+                                             *indexes::kDistanceMetricByStr));
+  parser.AddParamParser(kInitialCapParam,
+                        GENERATE_VALUE_PARSER(IVFParameters, initial_cap));
+  parser.AddParamParser(kNlistParam,
+                        GENERATE_VALUE_PARSER(IVFParameters, nlist));
+  parser.AddParamParser(kNprobeParam,
+                        GENERATE_VALUE_PARSER(IVFParameters, nprobe));
+  parser.AddParamParser(kPqMParam,
+                        GENERATE_VALUE_PARSER(IVFParameters, pq_m));
+  parser.AddParamParser(kPqRerankParam,
+                        GENERATE_VALUE_PARSER(IVFParameters, pq_rerank));
+  parser.AddParamParser(kPqNbitsParam,
+                        GENERATE_VALUE_PARSER(IVFParameters, pq_nbits));
+  return parser;
+}
 absl::Status ParseVector(vmsdk::ArgsIterator &itr,
                          data_model::Index &index_proto) {
   absl::string_view algo_str;
@@ -327,6 +369,12 @@ absl::Status ParseVector(vmsdk::ArgsIterator &itr,
     VMSDK_RETURN_IF_ERROR(parser.Parse(parameters, vector_itr));
     VMSDK_RETURN_IF_ERROR(parameters.Verify());
     index_proto.set_allocated_vector_index(parameters.ToProto().release());
+  } else if (algo == data_model::VectorIndex::kIvfAlgorithm) {
+    static auto parser = CreateIVFParamParser();
+    IVFParameters parameters;
+    VMSDK_RETURN_IF_ERROR(parser.Parse(parameters, vector_itr));
+    VMSDK_RETURN_IF_ERROR(parameters.Verify());
+    index_proto.set_allocated_vector_index(parameters.ToProto().release());
   } else {
     static auto parser = CreateFlatParamParser();
     FlatParameters parameters;
@@ -545,7 +593,8 @@ absl::StatusOr<data_model::Attribute *> ParseAttributeArgs(
       break;
   }
 
-  // Check for SORTABLE option and ignore it
+  // Accept and ignore SORTABLE: FT.SEARCH SORTBY walks the Numeric index,
+  // which already keeps its keys in value order.
   if (itr.DistanceEnd() > 0) {
     auto next_arg = itr.Get();
     if (next_arg.ok()) {
@@ -733,6 +782,18 @@ absl::Status FTCreateVectorParameters::Verify() const {
   if (distance_metric == default_values.distance_metric) {
     return absl::InvalidArgumentError("Missing DISTANCE_METRIC parameter.");
   }
+  const bool is_binary =
+      vector_data_type == data_model::VECTOR_DATA_TYPE_BINARY;
+  if (is_binary !=
+      (distance_metric == data_model::DISTANCE_METRIC_HAMMING)) {
+    return absl::InvalidArgumentError(
+        "The HAMMING distance metric is only supported with, and required "
+        "by, the BINARY vector type.");
+  }
+  if (is_binary && dimensions.value() % hnswlib::kBitsPerBit8 != 0) {
+    return absl::InvalidArgumentError(
+        "The dimensions of a BINARY vector must be a multiple of 8.");
+  }
   return absl::OkStatus();
 }
 std::unique_ptr<data_model::VectorIndex> HNSWParameters::ToProto() const {
@@ -741,6 +802,9 @@ std::unique_ptr<data_model::VectorIndex> HNSWParameters::ToProto() const {
   hnsw_algorithm_proto->set_m(m);
   hnsw_algorithm_proto->set_ef_construction(ef_construction);
   hnsw_algorithm_proto->set_ef_runtime(ef_runtime);
+  hnsw_algorithm_proto->set_quantization(quantization);
+  hnsw_algorithm_proto->set_shards(shards);
+  hnsw_algorithm_proto->set_graph_dimensions(graph_dimensions);
   vector_index_proto->set_allocated_hnsw_algorithm(
       hnsw_algorithm_proto.release());
   return vector_index_proto;
@@ -765,6 +829,30 @@ absl::Status HNSWParameters::Verify() const {
       << kEfRuntimeParam
       << " must be a positive integer greater than 0 and cannot exceed "
       << max_ef_runtime_value << ".";
+  if (quantization != data_model::VECTOR_QUANTIZATION_NONE &&
+      vector_data_type == data_model::VECTOR_DATA_TYPE_BINARY) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(kQuantizeParam, " is not supported for BINARY vectors."));
+  }
+  VMSDK_RETURN_IF_ERROR(vmsdk::VerifyRange(shards, 1, kMaxShards))
+      << kShardsParam
+      << " must be a positive integer greater than 0 and cannot exceed "
+      << kMaxShards << ".";
+  if (graph_dimensions != 0) {
+    if (vector_data_type == data_model::VECTOR_DATA_TYPE_BINARY) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          kGraphDimensionsParam, " is not supported for BINARY vectors."));
+    }
+    if (quantization != data_model::VECTOR_QUANTIZATION_NONE) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          kGraphDimensionsParam, " cannot be combined with ", kQuantizeParam,
+          "."));
+    }
+    VMSDK_RETURN_IF_ERROR(
+        vmsdk::VerifyRange(graph_dimensions, 1, dimensions.value()))
+        << kGraphDimensionsParam << " cannot exceed " << kDimensionsParam
+        << ".";
+  }
   return absl::OkStatus();
 }
 std::unique_ptr<data_model::VectorIndex> FlatParameters::ToProto() const {
@@ -775,6 +863,45 @@ std::unique_ptr<data_model::VectorIndex> FlatParameters::ToProto() const {
       flat_algorithm_proto.release());
   return vector_index_proto;
 }
+absl::Status IVFParameters::Verify() const {
+  VMSDK_RETURN_IF_ERROR(FTCreateVectorParameters::Verify());
+  if (vector_data_type == data_model::VECTOR_DATA_TYPE_BINARY) {
+    return absl::InvalidArgumentError(
+        "The IVF algorithm does not support BINARY vectors.");
+  }
+  VMSDK_RETURN_IF_ERROR(vmsdk::VerifyRange(nlist, 1, kMaxNlist))
+      << kNlistParam
+      << " must be a positive integer greater than 0 and cannot exceed "
+      << kMaxNlist << ".";
+  VMSDK_RETURN_IF_ERROR(vmsdk::VerifyRange(nprobe, 1, nlist))
+      << kNprobeParam
+      << " must be a positive integer greater than 0 and cannot exceed "
+      << kNlistParam << ".";
+  if (pq_m > 0 && dimensions.value() % pq_m != 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        kPqMParam, " must divide the vector dimensions (", dimensions.value(),
+        ")."));
+  }
+  VMSDK_RETURN_IF_ERROR(vmsdk::VerifyRange(pq_rerank, 0, kMaxPqRerank))
+      << kPqRerankParam << " cannot exceed " << kMaxPqRerank << ".";
+  if (pq_nbits != 4 && pq_nbits != 8) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(kPqNbitsParam, " must be 4 or 8."));
+  }
+  return absl::OkStatus();
+}
+std::unique_ptr<data_model::VectorIndex> IVFParameters::ToProto() const {
+  auto vector_index_proto = FTCreateVectorParameters::ToProto();
+  auto ivf_algorithm_proto = std::make_unique<data_model::IVFAlgorithm>();
+  ivf_algorithm_proto->set_nlist(nlist);
+  ivf_algorithm_proto->set_nprobe(nprobe);
+  ivf_algorithm_proto->set_pq_m(pq_m);
+  ivf_algorithm_proto->set_pq_rerank(pq_rerank);
+  ivf_algorithm_proto->set_pq_nbits(pq_nbits);
+  vector_index_proto->set_allocated_ivf_algorithm(
+      ivf_algorithm_proto.release());
+  return vector_index_proto;
+}
 
 namespace options {
 
@@ -74,6 +74,14 @@ constexpr int kDefaultBlockSize{1024};
 constexpr int kDefaultM{16};
 constexpr int kDefaultEFConstruction{200};
 constexpr int kDefaultEFRuntime{10};
+constexpr uint32_t kDefaultShards{1};
+constexpr uint32_t kMaxShards{64};
+constexpr uint32_t kDefaultNlist{128};
+constexpr uint32_t kDefaultNprobe{8};
+constexpr uint32_t kMaxNlist{65536};
+constexpr uint32_t kDefaultPqRerank{4};
+constexpr uint32_t kMaxPqRerank{64};
+constexpr uint32_t kDefaultPqNbits{8};
 
 namespace options {
 
@@ -113,6 +121,17 @@ struct HNSWParameters : public FTCreateVectorParameters {
   int m{kDefaultM};
   int ef_construction{kDefaultEFConstruction};
   size_t ef_runtime{kDefaultEFRuntime};
+  // Builds and traverses the graph over scalar-quantized vectors, re-ranking
+  // the candidates with the full precision vectors.
+  data_model::VectorQuantization quantization{
+      data_model::VECTOR_QUANTIZATION_NONE};
+  // Number of independent graphs the vectors are partitioned across. Queries
+  // search all of them in parallel and merge the results.
+  uint32_t shards{kDefaultShards};
+  // Builds and traverses the graph over the leading dimensions of the
+  // vectors, e.g. of Matryoshka embeddings, re-ranking the candidates with
+  // the full vectors. Zero uses all the dimensions.
+  uint32_t graph_dimensions{0};
   absl::Status Verify() const;
   std::unique_ptr<data_model::VectorIndex> ToProto() const;
 };
@@ -124,6 +143,23 @@ struct FlatParameters : public FTCreateVectorParameters {
   std::unique_ptr<data_model::VectorIndex> ToProto() const;
 };
 
+struct IVFParameters : public FTCreateVectorParameters {
+  // Number of k-means centroids, i.e. posting lists, the vectors are
+  // partitioned into.
+  uint32_t nlist{kDefaultNlist};
+  // Default number of posting lists scanned per query.
+  uint32_t nprobe{kDefaultNprobe};
+  // Number of product quantization sub-quantizers, 0 disables product
+  // quantization.
+  uint32_t pq_m{0};
+  // Candidates re-ranked with exact distances per requested neighbor.
+  uint32_t pq_rerank{kDefaultPqRerank};
+  // Bits per product quantization code, 4 or 8.
+  uint32_t pq_nbits{kDefaultPqNbits};
+  absl::Status Verify() const;
+  std::unique_ptr<data_model::VectorIndex> ToProto() const;
+};
+
 absl::StatusOr<data_model::IndexSchema> ParseFTCreateArgs(
     ValkeyModuleCtx* ctx, ValkeyModuleString** argv, int argc);
 }  // namespace valkey_search
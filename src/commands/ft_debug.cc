@@ -266,6 +266,8 @@ absl::Status HelpCmd(ValkeyModuleCtx *ctx, vmsdk::ArgsIterator &itr) {
       {"FT._DEBUG PAUSEPOINT [ SET | RESET | TEST | LIST] <pausepoint>",
        "control pause points"},
       {"FT._DEBUG TEXTINFO <index> ...", "show info about schema-level text"},
+      {"FT._DEBUG HNSW_REORDER <index> [<attribute>]",
+       "reorder HNSW graphs so that neighbors are stored close together"},
       {"FT._DEBUG STRINGPOOLSTATS", "Show InternStringPool Stats"},
       {"FT_DEBUG SHOW_METADATA",
        "list internal metadata manager table namespace"},
@@ -315,6 +317,8 @@ absl::Status FTDebugCmd(ValkeyModuleCtx *ctx, ValkeyModuleString **argv,
     return StringPoolStats(ctx, itr);
   } else if (keyword == "TEXTINFO") {
     return IndexSchema::TextInfoCmd(ctx, itr);
+  } else if (keyword == "HNSW_REORDER") {
+    return IndexSchema::HNSWReorderCmd(ctx, itr);
   } else if (keyword == "SHOW_METADATA") {
     return valkey_search::coordinator::MetadataManager::Instance().ShowMetadata(
         ctx, itr);
@@ -155,55 +155,71 @@ void SerializeNonVectorNeighbors(ValkeyModuleCtx *ctx,
   }
 }
 
-}  // namespace
-// The reply structure is an array which consists of:
-// 1. The amount of response elements
-// 2. Per response entry:
-//   1. The cache entry Hash key
-//   2. An array with the following entries:
-//      1. Key value: [$score_as] score_value
-//      2. Distance value
-//      3. Attribute name
-//      4. The vector value
-// SendReply respects the Limit, see https://valkey.io/commands/ft.search/
-void SearchCommand::SendReply(ValkeyModuleCtx *ctx,
-                              query::SearchResult &search_result) {
-  // Increment success counter.
-  ++Metrics::GetStats().query_successful_requests_cnt;
+// Replies with the results of a single query, see SearchCommand::SendReply.
+void SendQueryReply(ValkeyModuleCtx *ctx, query::SearchResult &search_result,
+                    const query::SearchParameters &parameters) {
   auto &neighbors = search_result.neighbors;
   // Check if no results should be returned based on query parameters.
-  if (query::ShouldReturnNoResults(*this)) {
+  if (query::ShouldReturnNoResults(parameters)) {
     ValkeyModule_ReplyWithArray(ctx, 1);
     ValkeyModule_ReplyWithLongLong(ctx, search_result.total_count);
     return;
   }
-  if (no_content) {
-    SendReplyNoContent(ctx, search_result, *this);
+  if (parameters.no_content) {
+    SendReplyNoContent(ctx, search_result, parameters);
     return;
   }
   size_t original_size = neighbors.size();
+  const auto &index_schema = parameters.index_schema;
   // Support non-vector queries
-  if (IsNonVectorQuery()) {
+  if (parameters.IsNonVectorQuery()) {
     query::ProcessNonVectorNeighborsForReply(
-        ctx, index_schema->GetAttributeDataType(), neighbors, *this);
+        ctx, index_schema->GetAttributeDataType(), neighbors, parameters);
     // Adjust total count based on neighbors removed during processing
     // due to filtering or missing attributes.
     search_result.total_count -= (original_size - neighbors.size());
-    SerializeNonVectorNeighbors(ctx, search_result, *this);
+    SerializeNonVectorNeighbors(ctx, search_result, parameters);
     return;
   }
-  auto identifier = index_schema->GetIdentifier(attribute_alias);
+  auto identifier = index_schema->GetIdentifier(parameters.attribute_alias);
   if (!identifier.ok()) {
     ++Metrics::GetStats().query_failed_requests_cnt;
     ValkeyModule_ReplyWithError(ctx, identifier.status().message().data());
     return;
   }
   query::ProcessNeighborsForReply(ctx, index_schema->GetAttributeDataType(),
-                                  neighbors, *this, identifier.value());
+                                  neighbors, parameters, identifier.value());
   // Adjust total count based on neighbors removed during processing
   // due to filtering or missing attributes.
   search_result.total_count -= (original_size - neighbors.size());
-  SerializeNeighbors(ctx, search_result, *this);
+  SerializeNeighbors(ctx, search_result, parameters);
+}
+
+}  // namespace
+// The reply structure is an array which consists of:
+// 1. The amount of response elements
+// 2. Per response entry:
+//   1. The cache entry Hash key
+//   2. An array with the following entries:
+//      1. Key value: [$score_as] score_value
+//      2. Distance value
+//      3. Attribute name
+//      4. The vector value
+// A batched KNN query replies with an array holding one such reply per query
+// vector, in query order.
+// SendReply respects the Limit, see https://valkey.io/commands/ft.search/
+void SearchCommand::SendReply(ValkeyModuleCtx *ctx,
+                              query::SearchResult &search_result) {
+  // Increment success counter.
+  ++Metrics::GetStats().query_successful_requests_cnt;
+  if (IsBatchedQuery()) {
+    ValkeyModule_ReplyWithArray(ctx, search_result.batch_results.size());
+    for (auto &query_result : search_result.batch_results) {
+      SendQueryReply(ctx, query_result, *this);
+    }
+    return;
+  }
+  SendQueryReply(ctx, search_result, *this);
 }
 
 absl::Status FTSearchCmd(ValkeyModuleCtx *ctx, ValkeyModuleString **argv,
@@ -41,6 +41,10 @@ namespace valkey_search {
 constexpr absl::string_view kMaxKnnConfig{"max-vector-knn"};
 constexpr int kDefaultKnnLimit{10000};
 constexpr int kMaxKnn{100000};
+// Maximum number of query vectors in a batched KNN query.
+constexpr size_t kMaxKnnBatchSize{1024};
+// Maximum multiple of k of the candidates re-ranked by a KNN query.
+constexpr int kMaxOversample{100};
 
 /// Register the "--max-knn" flag. Controls the max KNN parameter for vector
 /// search.
@@ -64,6 +68,9 @@ namespace {
 constexpr absl::string_view kParamsParam{"PARAMS"};
 constexpr absl::string_view kDialectParam{"DIALECT"};
 constexpr absl::string_view kLimitParam{"LIMIT"};
+constexpr absl::string_view kSortByParam{"SORTBY"};
+constexpr absl::string_view kAscParam{"ASC"};
+constexpr absl::string_view kDescParam{"DESC"};
 constexpr absl::string_view kNoContentParam{"NOCONTENT"};
 constexpr absl::string_view kReturnParam{"RETURN"};
 constexpr absl::string_view kTimeoutParam{"TIMEOUT"};
@@ -135,6 +142,18 @@ absl::Status ParseKnnInner(query::SearchParameters &parameters,
         return absl::InvalidArgumentError("EF_RUNTIME argument is missing");
       }
       parameters.parse_vars.ef_string = params[i++];
+    } else if (absl::EqualsIgnoreCase(params[i], "NPROBE")) {
+      i++;
+      if (i == params.size()) {
+        return absl::InvalidArgumentError("NPROBE argument is missing");
+      }
+      parameters.parse_vars.nprobe_string = params[i++];
+    } else if (absl::EqualsIgnoreCase(params[i], "OVERSAMPLE")) {
+      i++;
+      if (i == params.size()) {
+        return absl::InvalidArgumentError("OVERSAMPLE argument is missing");
+      }
+      parameters.parse_vars.oversample_string = params[i++];
     } else if (absl::EqualsIgnoreCase(params[i], kAsParam)) {
       i++;
       if (i == params.size()) {
@@ -184,7 +203,8 @@ absl::StatusOr<FilterParseResults> ParsePreFilter(
   TextParsingOptions options{.verbatim = search_params.verbatim,
                              .inorder = search_params.inorder,
                              .slop = search_params.slop};
-  FilterParser parser(index_schema, pre_filter, options);
+  FilterParser parser(index_schema, pre_filter, options,
+                      &search_params.parse_vars.params);
   return parser.Parse();
 }
 
@@ -219,6 +239,34 @@ ConstructLimitParser() {
       });
 }
 
+std::unique_ptr<vmsdk::ParamParser<query::SearchParameters>>
+ConstructSortByParser() {
+  return std::make_unique<vmsdk::ParamParser<query::SearchParameters>>(
+      [](query::SearchParameters &parameters,
+         vmsdk::ArgsIterator &itr) -> absl::Status {
+        VMSDK_ASSIGN_OR_RETURN(auto field, itr.PopNext());
+        query::SortByParameter sortby{
+            std::string(vmsdk::ToStringView(field))};
+        if (itr.PopIfNextIgnoreCase(kDescParam)) {
+          sortby.ascending = false;
+        } else {
+          itr.PopIfNextIgnoreCase(kAscParam);
+        }
+        // The keys are walked in value order, which only the Numeric index
+        // keeps.
+        VMSDK_ASSIGN_OR_RETURN(
+            auto index,
+            parameters.index_schema->GetIndex(sortby.attribute_alias));
+        if (index->GetIndexerType() != indexes::IndexerType::kNumeric) {
+          return absl::InvalidArgumentError(
+              absl::StrCat("Index field `", sortby.attribute_alias,
+                           "` is not a Numeric index"));
+        }
+        parameters.sortby = std::move(sortby);
+        return absl::OkStatus();
+      });
+}
+
 std::unique_ptr<vmsdk::ParamParser<query::SearchParameters>>
 ConstructParamsParser() {
   return std::make_unique<vmsdk::ParamParser<query::SearchParameters>>(
@@ -309,6 +357,7 @@ vmsdk::KeyValueParser<query::SearchParameters> CreateSearchParser() {
       kTimeoutParam,
       GENERATE_VALUE_PARSER(query::SearchParameters, timeout_ms));
   parser.AddParamParser(kLimitParam, ConstructLimitParser());
+  parser.AddParamParser(kSortByParam, ConstructSortByParser());
   parser.AddParamParser(
       kNoContentParam,
       GENERATE_FLAG_PARSER(query::SearchParameters, no_content));
@@ -383,7 +432,8 @@ absl::Status PreParseQueryString(query::SearchParameters &parameters) {
     VMSDK_ASSIGN_OR_RETURN(auto index, parameters.index_schema->GetIndex(
                                            parameters.attribute_alias));
     if (index->GetIndexerType() != indexes::IndexerType::kHNSW &&
-        index->GetIndexerType() != indexes::IndexerType::kFlat) {
+        index->GetIndexerType() != indexes::IndexerType::kFlat &&
+        index->GetIndexerType() != indexes::IndexerType::kIVF) {
       return absl::InvalidArgumentError(
           absl::StrCat("Index field `", parameters.attribute_alias,
                        "` is not a Vector index "));
@@ -407,9 +457,27 @@ absl::Status PostParseVectorParameters(query::SearchParameters &parameters) {
       SubstituteParam(parameters, parameters.parse_vars.k_string));
   VMSDK_ASSIGN_OR_RETURN(parameters.k, vmsdk::To<unsigned>(k_string));
 
-  VMSDK_ASSIGN_OR_RETURN(
-      parameters.query,
-      SubstituteParam(parameters, parameters.parse_vars.query_vector_string));
+  // A comma separated list of parameters, e.g. `$BLOB1,$BLOB2`, is a batched
+  // KNN query with one result section per query vector.
+  auto query_vector_string = parameters.parse_vars.query_vector_string;
+  if (absl::StartsWith(query_vector_string, "$") &&
+      absl::StrContains(query_vector_string, ',')) {
+    for (absl::string_view query_param :
+         absl::StrSplit(query_vector_string, ',')) {
+      if (!absl::StartsWith(query_param, "$")) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Batched query vectors must be parameters, got `",
+                         query_param, "`"));
+      }
+      VMSDK_ASSIGN_OR_RETURN(auto query,
+                             SubstituteParam(parameters, query_param));
+      parameters.batch_queries.emplace_back(query);
+    }
+    parameters.query = parameters.batch_queries.front();
+  } else {
+    VMSDK_ASSIGN_OR_RETURN(parameters.query,
+                           SubstituteParam(parameters, query_vector_string));
+  }
 
   if (!parameters.parse_vars.ef_string.empty()) {
     VMSDK_ASSIGN_OR_RETURN(
@@ -418,6 +486,22 @@ absl::Status PostParseVectorParameters(query::SearchParameters &parameters) {
     VMSDK_ASSIGN_OR_RETURN(parameters.ef, vmsdk::To<unsigned>(ef_string));
   }
 
+  if (!parameters.parse_vars.nprobe_string.empty()) {
+    VMSDK_ASSIGN_OR_RETURN(
+        auto nprobe_string,
+        SubstituteParam(parameters, parameters.parse_vars.nprobe_string));
+    VMSDK_ASSIGN_OR_RETURN(parameters.nprobe,
+                           vmsdk::To<unsigned>(nprobe_string));
+  }
+
+  if (!parameters.parse_vars.oversample_string.empty()) {
+    VMSDK_ASSIGN_OR_RETURN(
+        auto oversample_string,
+        SubstituteParam(parameters, parameters.parse_vars.oversample_string));
+    VMSDK_ASSIGN_OR_RETURN(parameters.oversample,
+                           vmsdk::To<unsigned>(oversample_string));
+  }
+
   if (!parameters.parse_vars.score_as_string.empty()) {
     VMSDK_ASSIGN_OR_RETURN(
         parameters.parse_vars.score_as_string,
@@ -440,6 +524,20 @@ absl::Status VerifyQueryString(query::SearchParameters &parameters) {
     if (parameters.query.empty()) {
       return absl::InvalidArgumentError("Invalid Query Syntax");
     }
+    if (parameters.batch_queries.size() > kMaxKnnBatchSize) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("A batched KNN query cannot exceed ", kMaxKnnBatchSize,
+                       " query vectors."));
+    }
+    for (const auto &query : parameters.batch_queries) {
+      if (query.empty()) {
+        return absl::InvalidArgumentError("Invalid Query Syntax");
+      }
+    }
+    if (parameters.IsBatchedQuery() && parameters.sortby.has_value()) {
+      return absl::InvalidArgumentError(
+          "SORTBY is not supported with a batched KNN query.");
+    }
     if (parameters.ef.has_value()) {
       auto max_ef_runtime_value = options::GetMaxEfRuntime().GetValue();
       VMSDK_RETURN_IF_ERROR(
@@ -449,6 +547,18 @@ absl::Status VerifyQueryString(query::SearchParameters &parameters) {
              "exceed "
           << max_ef_runtime_value << ".";
     }
+    if (parameters.nprobe.has_value()) {
+      VMSDK_RETURN_IF_ERROR(
+          vmsdk::VerifyRange(parameters.nprobe.value(), 1, std::nullopt))
+          << "`NPROBE` must be a positive integer greater than 0.";
+    }
+    if (parameters.oversample.has_value()) {
+      VMSDK_RETURN_IF_ERROR(vmsdk::VerifyRange(parameters.oversample.value(),
+                                               1, kMaxOversample))
+          << "`OVERSAMPLE` must be a positive integer greater than 0 and "
+             "cannot exceed "
+          << kMaxOversample << ".";
+    }
     auto max_knn_value = options::GetMaxKnn().GetValue();
     VMSDK_RETURN_IF_ERROR(vmsdk::VerifyRange(parameters.k, 1, max_knn_value))
         << "KNN parameter must be a positive integer greater than 0 and cannot "
@@ -36,10 +36,8 @@ struct SearchCommand : public QueryCommand {
   absl::Status ParseCommand(vmsdk::ArgsIterator &itr) override;
   void SendReply(ValkeyModuleCtx *ctx,
                  query::SearchResult &search_result) override;
-  // By default, FT.SEARCH does not require complete results and can optimized
-  // with LIMIT based trimming.
-  // TODO: When SORTBY or similar clauses are supported, implement the correct
-  // logic here to return true when those clauses are present.
+  // FT.SEARCH does not require complete results and can optimized with LIMIT
+  // based trimming, as SORTBY is applied by the search before the trimming.
   bool RequiresCompleteResults() const override { return false; }
 };
 
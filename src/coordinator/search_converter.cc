@@ -7,7 +7,9 @@
 
 #include "src/coordinator/search_converter.h"
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 
@@ -22,6 +24,7 @@
 #include "src/indexes/index_base.h"
 #include "src/indexes/numeric.h"
 #include "src/indexes/tag.h"
+#include "src/indexes/vector_base.h"
 #include "src/query/predicate.h"
 #include "src/query/search.h"
 #include "src/schema_manager.h"
@@ -75,12 +78,39 @@ absl::StatusOr<std::unique_ptr<query::Predicate>> GRPCPredicateToPredicate(
           index_schema->GetIdentifier(predicate.numeric().attribute_alias()));
       attribute_identifiers.insert(identifier);
       auto numeric_index = dynamic_cast<indexes::Numeric*>(index.get());
+      const auto& numeric = predicate.numeric();
       auto numeric_predicate = std::make_unique<query::NumericPredicate>(
-          numeric_index, predicate.numeric().attribute_alias(), identifier,
-          predicate.numeric().start(), predicate.numeric().is_inclusive_start(),
-          predicate.numeric().end(), predicate.numeric().is_inclusive_end());
+          numeric_index, numeric.attribute_alias(), identifier,
+          numeric.start(), numeric.is_inclusive_start(), numeric.end(),
+          numeric.is_inclusive_end(),
+          numeric.has_integer_start()
+              ? std::optional<int64_t>(numeric.integer_start())
+              : std::nullopt,
+          numeric.has_integer_end()
+              ? std::optional<int64_t>(numeric.integer_end())
+              : std::nullopt);
       return numeric_predicate;
     }
+    case Predicate::kVectorRange: {
+      VMSDK_ASSIGN_OR_RETURN(
+          auto index,
+          index_schema->GetIndex(predicate.vector_range().attribute_alias()));
+      if (index->GetIndexerType() != indexes::IndexerType::kHNSW &&
+          index->GetIndexerType() != indexes::IndexerType::kFlat) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("`", predicate.vector_range().attribute_alias(),
+                         "` is not indexed as an HNSW or FLAT vector field"));
+      }
+      VMSDK_ASSIGN_OR_RETURN(auto identifier,
+                             index_schema->GetIdentifier(
+                                 predicate.vector_range().attribute_alias()));
+      attribute_identifiers.insert(identifier);
+      // The query vector was normalized by the coordinator already.
+      return std::make_unique<query::VectorRangePredicate>(
+          dynamic_cast<indexes::VectorBase*>(index.get()),
+          predicate.vector_range().attribute_alias(), identifier,
+          predicate.vector_range().radius(), predicate.vector_range().query());
+    }
     case Predicate::kAnd: {
       std::vector<std::unique_ptr<query::Predicate>> children;
       children.reserve(predicate.and_().children_size());
@@ -205,11 +235,26 @@ GRPCSearchRequestToParameters(const SearchIndexPartitionRequest& request,
                                request.attribute_alias()));
   }
   parameters->query = request.query();
+  if (request.batch_queries_size() > 0) {
+    parameters->batch_queries.assign(request.batch_queries().begin(),
+                                     request.batch_queries().end());
+    parameters->query = parameters->batch_queries.front();
+  }
   parameters->dialect = request.dialect();
   parameters->k = request.k();
   parameters->ef = request.ef();
+  if (request.nprobe() > 0) {
+    parameters->nprobe = request.nprobe();
+  }
+  if (request.oversample() > 0) {
+    parameters->oversample = request.oversample();
+  }
   parameters->limit = query::LimitParameter{request.limit().first_index(),
                                             request.limit().number()};
+  if (request.has_sortby()) {
+    parameters->sortby = query::SortByParameter{
+        request.sortby().attribute_alias(), request.sortby().ascending()};
+  }
   parameters->no_content = request.no_content();
   parameters->enable_partial_results = request.enable_partial_results();
   parameters->enable_consistency = request.enable_consistency();
@@ -259,8 +304,30 @@ std::unique_ptr<Predicate> PredicateToGRPCPredicate(
           numeric_predicate->GetEnd());
       numeric_predicate_proto->mutable_numeric()->set_is_inclusive_end(
           numeric_predicate->IsEndInclusive());
+      if (auto integer_start = numeric_predicate->GetIntegerStart();
+          integer_start.has_value()) {
+        numeric_predicate_proto->mutable_numeric()->set_integer_start(
+            *integer_start);
+      }
+      if (auto integer_end = numeric_predicate->GetIntegerEnd();
+          integer_end.has_value()) {
+        numeric_predicate_proto->mutable_numeric()->set_integer_end(
+            *integer_end);
+      }
       return numeric_predicate_proto;
     }
+    case query::PredicateType::kVectorRange: {
+      auto vector_range_predicate =
+          dynamic_cast<const query::VectorRangePredicate*>(&predicate);
+      auto vector_range_predicate_proto = std::make_unique<Predicate>();
+      vector_range_predicate_proto->mutable_vector_range()->set_attribute_alias(
+          std::string(vector_range_predicate->GetAlias()));
+      vector_range_predicate_proto->mutable_vector_range()->set_radius(
+          vector_range_predicate->GetRadius());
+      vector_range_predicate_proto->mutable_vector_range()->set_query(
+          std::string(vector_range_predicate->GetQuery()));
+      return vector_range_predicate_proto;
+    }
     case query::PredicateType::kComposedAnd: {
       auto and_predicate_proto = std::make_unique<Predicate>();
       auto composed_and_predicate =
@@ -353,14 +420,31 @@ std::unique_ptr<SearchIndexPartitionRequest> ParametersToGRPCSearchRequest(
   request->set_db_num(parameters.db_num_);
   request->set_attribute_alias(parameters.attribute_alias);
   request->set_score_as(vmsdk::ToStringView(parameters.score_as.get()));
-  request->set_query(parameters.query);
+  if (parameters.IsBatchedQuery()) {
+    for (const auto& query : parameters.batch_queries) {
+      request->add_batch_queries(query);
+    }
+  } else {
+    request->set_query(parameters.query);
+  }
   request->set_dialect(parameters.dialect);
   request->set_k(parameters.k);
   if (parameters.ef.has_value()) {
     request->set_ef(parameters.ef.value());
   }
+  if (parameters.nprobe.has_value()) {
+    request->set_nprobe(parameters.nprobe.value());
+  }
+  if (parameters.oversample.has_value()) {
+    request->set_oversample(parameters.oversample.value());
+  }
   request->mutable_limit()->set_first_index(parameters.limit.first_index);
   request->mutable_limit()->set_number(parameters.limit.number);
+  if (parameters.sortby.has_value()) {
+    request->mutable_sortby()->set_attribute_alias(
+        parameters.sortby->attribute_alias);
+    request->mutable_sortby()->set_ascending(parameters.sortby->ascending);
+  }
   request->set_timeout_ms(parameters.timeout_ms);
   request->set_no_content(parameters.no_content);
   request->set_enable_partial_results(parameters.enable_partial_results);
@@ -101,6 +101,9 @@ void SerializeNeighbors(SearchIndexPartitionResponse* response,
     auto* neighbor_proto = response->add_neighbors();
     neighbor_proto->set_key(std::move(*neighbor.external_id));
     neighbor_proto->set_score(neighbor.distance);
+    if (neighbor.sort_value.has_value()) {
+      neighbor_proto->set_sort_value(neighbor.sort_value.value());
+    }
     if (neighbor.attribute_contents) {
       const auto& attribute_contents = neighbor.attribute_contents.value();
       for (const auto& [identifier, record] : attribute_contents) {
@@ -112,6 +115,33 @@ void SerializeNeighbors(SearchIndexPartitionResponse* response,
   }
 }
 
+void SerializeSearchResult(SearchIndexPartitionResponse* response,
+                           const query::SearchResult& result) {
+  for (const auto& query_result : result.batch_results) {
+    SerializeSearchResult(response->add_batch_responses(), query_result);
+  }
+  SerializeNeighbors(response, result.neighbors);
+  response->set_total_count(result.total_count);
+}
+
+// Fetches the contents of the neighbors on the main thread.
+void ProcessNeighborsForResponse(ValkeyModuleCtx* ctx,
+                                 std::vector<indexes::Neighbor>& neighbors,
+                                 const query::SearchParameters& parameters) {
+  const auto& attribute_data_type =
+      parameters.index_schema->GetAttributeDataType();
+  if (parameters.IsNonVectorQuery()) {
+    query::ProcessNonVectorNeighborsForReply(ctx, attribute_data_type,
+                                             neighbors, parameters);
+  } else {
+    auto vector_identifier =
+        parameters.index_schema->GetIdentifier(parameters.attribute_alias)
+            .value();
+    query::ProcessNeighborsForReply(ctx, attribute_data_type, neighbors,
+                                    parameters, vector_identifier);
+  }
+}
+
 grpc::Status Service::PerformSlotConsistencyCheck(
     uint64_t expected_slot_fingerprint) {
   // compare slot fingerprint
@@ -158,32 +188,20 @@ query::SearchResponseCallback Service::MakeSearchCallback(
       return;
     }
     if (parameters->no_content) {
-      SerializeNeighbors(response, result->neighbors);
-      response->set_total_count(result->total_count);
+      SerializeSearchResult(response, result.value());
       reactor->Finish(grpc::Status::OK);
       RecordSearchMetrics(false, std::move(latency_sample));
     } else {
       vmsdk::RunByMain([parameters = std::move(parameters), response, reactor,
                         latency_sample = std::move(latency_sample),
-                        neighbors = std::move(result->neighbors),
-                        total_count = result->total_count]() mutable {
-        const auto& attribute_data_type =
-            parameters->index_schema->GetAttributeDataType();
+                        result = std::move(result.value())]() mutable {
         auto ctx = vmsdk::MakeUniqueValkeyThreadSafeContext(nullptr);
-        if (parameters->IsNonVectorQuery()) {
-          query::ProcessNonVectorNeighborsForReply(
-              ctx.get(), attribute_data_type, neighbors, *parameters);
-        } else {
-          auto vector_identifier =
-              parameters->index_schema
-                  ->GetIdentifier(parameters->attribute_alias)
-                  .value();
-          query::ProcessNeighborsForReply(ctx.get(), attribute_data_type,
-                                          neighbors, *parameters,
-                                          vector_identifier);
+        ProcessNeighborsForResponse(ctx.get(), result.neighbors, *parameters);
+        for (auto& query_result : result.batch_results) {
+          ProcessNeighborsForResponse(ctx.get(), query_result.neighbors,
+                                      *parameters);
         }
-        SerializeNeighbors(response, neighbors);
-        response->set_total_count(total_count);
+        SerializeSearchResult(response, result);
         reactor->Finish(grpc::Status::OK);
         RecordSearchMetrics(false, std::move(latency_sample));
       });
@@ -42,15 +42,18 @@
 #include "src/indexes/vector_base.h"
 #include "src/indexes/vector_flat.h"
 #include "src/indexes/vector_hnsw.h"
+#include "src/indexes/vector_ivf.h"
 #include "src/keyspace_event_manager.h"
 #include "src/metrics.h"
 #include "src/rdb_serialization.h"
+#include "src/schema_manager.h"
 #include "src/utils/string_interning.h"
 #include "src/valkey_search.h"
 #include "src/valkey_search_options.h"
 #include "src/vector_externalizer.h"
 #include "version.h"
 #include "vmsdk/src/blocked_client.h"
+#include "vmsdk/src/command_parser.h"
 #include "vmsdk/src/debug.h"
 #include "vmsdk/src/info.h"
 #include "vmsdk/src/log.h"
@@ -67,6 +70,9 @@ namespace valkey_search {
 
 LogLevel GetLogSeverity(bool ok) { return ok ? DEBUG : WARNING; }
 
+// Records whose links a consolidation repairs per hold of the schema lock.
+static constexpr size_t kConsolidationStepRecords{1000};
+
 //
 // Controls and stats for V2 RDB file
 //
@@ -114,6 +120,30 @@ IndexSchema::BackfillJob::BackfillJob(ValkeyModuleCtx *ctx,
                          << ")";
 }
 
+// Creates a vector index of the given concrete type, loading its contents
+// from RDB when a supplemental content iterator is provided.
+// TODO: Create an empty index in case of an error loading the index contents
+// from RDB.
+template <typename VectorIndexT>
+absl::StatusOr<std::shared_ptr<indexes::IndexBase>> CreateVectorIndex(
+    ValkeyModuleCtx *ctx, IndexSchema *index_schema,
+    const data_model::Attribute &attribute,
+    std::optional<SupplementalContentChunkIter> iter) {
+  const auto &vector_index_proto = attribute.index().vector_index();
+  VMSDK_ASSIGN_OR_RETURN(
+      auto index,
+      (iter.has_value())
+          ? VectorIndexT::LoadFromRDB(
+                ctx, &index_schema->GetAttributeDataType(), vector_index_proto,
+                attribute.identifier(), std::move(*iter))
+          : VectorIndexT::Create(
+                vector_index_proto, attribute.identifier(),
+                index_schema->GetAttributeDataType().ToProto()));
+  index_schema->SubscribeToVectorExternalizer(attribute.identifier(),
+                                              index.get());
+  return index;
+}
+
 absl::StatusOr<std::shared_ptr<indexes::IndexBase>> IndexFactory(
     ValkeyModuleCtx *ctx, IndexSchema *index_schema,
     const data_model::Attribute &attribute,
@@ -138,21 +168,19 @@ absl::StatusOr<std::shared_ptr<indexes::IndexBase>> IndexFactory(
       switch (index.vector_index().algorithm_case()) {
         case data_model::VectorIndex::kHnswAlgorithm: {
           switch (index.vector_index().vector_data_type()) {
-            case data_model::VECTOR_DATA_TYPE_FLOAT32: {
-              VMSDK_ASSIGN_OR_RETURN(
-                  auto index,
-                  (iter.has_value())
-                      ? indexes::VectorHNSW<float>::LoadFromRDB(
-                            ctx, &index_schema->GetAttributeDataType(),
-                            index.vector_index(), attribute.identifier(),
-                            std::move(*iter))
-                      : indexes::VectorHNSW<float>::Create(
-                            index.vector_index(), attribute.identifier(),
-                            index_schema->GetAttributeDataType().ToProto()));
-              index_schema->SubscribeToVectorExternalizer(
-                  attribute.identifier(), index.get());
-              return index;
-            }
+            case data_model::VECTOR_DATA_TYPE_FLOAT32:
+              return CreateVectorIndex<indexes::VectorHNSW<float>>(
+                  ctx, index_schema, attribute, std::move(iter));
+            case data_model::VECTOR_DATA_TYPE_FLOAT16:
+              return CreateVectorIndex<indexes::VectorHNSW<hnswlib::float16>>(
+                  ctx, index_schema, attribute, std::move(iter));
+            case data_model::VECTOR_DATA_TYPE_BFLOAT16:
+              return CreateVectorIndex<
+                  indexes::VectorHNSW<hnswlib::bfloat16>>(
+                  ctx, index_schema, attribute, std::move(iter));
+            case data_model::VECTOR_DATA_TYPE_BINARY:
+              return CreateVectorIndex<indexes::VectorHNSW<hnswlib::bit8>>(
+                  ctx, index_schema, attribute, std::move(iter));
             default: {
               return absl::InvalidArgumentError(
                   "Unsupported vector data type.");
@@ -161,23 +189,36 @@ absl::StatusOr<std::shared_ptr<indexes::IndexBase>> IndexFactory(
         }
         case data_model::VectorIndex::kFlatAlgorithm: {
           switch (index.vector_index().vector_data_type()) {
-            case data_model::VECTOR_DATA_TYPE_FLOAT32: {
-              // TODO: Create an empty index in case of an error
-              // loading the index contents from RDB.
-              VMSDK_ASSIGN_OR_RETURN(
-                  auto index,
-                  (iter.has_value())
-                      ? indexes::VectorFlat<float>::LoadFromRDB(
-                            ctx, &index_schema->GetAttributeDataType(),
-                            index.vector_index(), attribute.identifier(),
-                            std::move(*iter))
-                      : indexes::VectorFlat<float>::Create(
-                            index.vector_index(), attribute.identifier(),
-                            index_schema->GetAttributeDataType().ToProto()));
-              index_schema->SubscribeToVectorExternalizer(
-                  attribute.identifier(), index.get());
-              return index;
+            case data_model::VECTOR_DATA_TYPE_FLOAT32:
+              return CreateVectorIndex<indexes::VectorFlat<float>>(
+                  ctx, index_schema, attribute, std::move(iter));
+            case data_model::VECTOR_DATA_TYPE_FLOAT16:
+              return CreateVectorIndex<indexes::VectorFlat<hnswlib::float16>>(
+                  ctx, index_schema, attribute, std::move(iter));
+            case data_model::VECTOR_DATA_TYPE_BFLOAT16:
+              return CreateVectorIndex<
+                  indexes::VectorFlat<hnswlib::bfloat16>>(
+                  ctx, index_schema, attribute, std::move(iter));
+            case data_model::VECTOR_DATA_TYPE_BINARY:
+              return CreateVectorIndex<indexes::VectorFlat<hnswlib::bit8>>(
+                  ctx, index_schema, attribute, std::move(iter));
+            default: {
+              return absl::InvalidArgumentError(
+                  "Unsupported vector data type.");
             }
+          }
+        }
+        case data_model::VectorIndex::kIvfAlgorithm: {
+          switch (index.vector_index().vector_data_type()) {
+            case data_model::VECTOR_DATA_TYPE_FLOAT32:
+              return CreateVectorIndex<indexes::VectorIVF<float>>(
+                  ctx, index_schema, attribute, std::move(iter));
+            case data_model::VECTOR_DATA_TYPE_FLOAT16:
+              return CreateVectorIndex<indexes::VectorIVF<hnswlib::float16>>(
+                  ctx, index_schema, attribute, std::move(iter));
+            case data_model::VECTOR_DATA_TYPE_BFLOAT16:
+              return CreateVectorIndex<indexes::VectorIVF<hnswlib::bfloat16>>(
+                  ctx, index_schema, attribute, std::move(iter));
             default: {
               return absl::InvalidArgumentError(
                   "Unsupported vector data type.");
@@ -623,6 +664,7 @@ void IndexSchema::ProcessAttributeMutation(
         case indexes::IndexerType::kVector:
         case indexes::IndexerType::kHNSW:
         case indexes::IndexerType::kFlat:
+        case indexes::IndexerType::kIVF:
           Metrics::GetStats().ingest_field_vector++;
           break;
         case indexes::IndexerType::kNumeric:
@@ -801,17 +843,181 @@ void IndexSchema::BackfillScanCallback(ValkeyModuleCtx *ctx,
                                        ValkeyModuleString *keyname,
                                        ValkeyModuleKey *key, void *privdata) {
   IndexSchema *index_schema = reinterpret_cast<IndexSchema *>(privdata);
-  index_schema->backfill_job_.Get()->scanned_key_count++;
+  auto &backfill_job = index_schema->backfill_job_.Get();
+  backfill_job->scanned_key_count++;
   auto key_prefixes = index_schema->GetKeyPrefixes();
   auto key_cstr = vmsdk::ToStringView(keyname);
   if (std::any_of(key_prefixes.begin(), key_prefixes.end(),
                   [&key_cstr](const auto &key_prefix) {
                     return key_cstr.starts_with(key_prefix);
                   })) {
+    backfill_job->matched_key_count++;
     index_schema->ProcessKeyspaceNotification(ctx, keyname, true);
   }
 }
 
+void IndexSchema::ScheduleConsolidation() {
+  const double min_tombstone_ratio =
+      options::GetHNSWConsolidationThreshold().GetValue() / 100.0;
+  if (min_tombstone_ratio == 0) {
+    return;
+  }
+  for (const auto &[name, attribute] : attributes_) {
+    auto index = attribute.GetIndex();
+    if (index->GetIndexerType() != indexes::IndexerType::kHNSW) {
+      continue;
+    }
+    auto vector_index = std::dynamic_pointer_cast<indexes::VectorBase>(index);
+    if (!vector_index->ClaimConsolidation(min_tombstone_ratio)) {
+      continue;
+    }
+    ValkeySearch::Instance().ScheduleUtilityTask(
+        [weak_index_schema = GetWeakPtr(), vector_index]() {
+          auto index_schema = weak_index_schema.lock();
+          if (!index_schema) {
+            return;
+          }
+          // The links are repaired in bounded steps, releasing the lock in
+          // between so that searches are not held up by a large index.
+          for (bool repaired = false; !repaired;) {
+            vmsdk::WriterMutexLock lock(&index_schema->time_sliced_mutex_);
+            auto status = vector_index->RepairDeletedLinks(
+                kConsolidationStepRecords);
+            if (!status.ok()) {
+              VMSDK_LOG(WARNING, nullptr)
+                  << "Failed to repair the deleted records of index "
+                  << index_schema->GetName() << ": "
+                  << status.status().message();
+              return;
+            }
+            repaired = *status;
+          }
+          // Searches may still hold pointers to the vectors being released.
+          vmsdk::WriterMutexLock lock(&index_schema->time_sliced_mutex_);
+          auto reclaimed_bytes = vector_index->ConsolidateDeletes();
+          if (!reclaimed_bytes.ok()) {
+            VMSDK_LOG(WARNING, nullptr)
+                << "Failed to consolidate the deleted records of index "
+                << index_schema->GetName() << ": "
+                << reclaimed_bytes.status().message();
+          }
+        });
+  }
+}
+
+void IndexSchema::ScheduleReorder() {
+  const double min_growth_ratio =
+      options::GetHNSWReorderGrowthThreshold().GetValue() / 100.0;
+  if (min_growth_ratio == 0 || IsBackfillInProgress()) {
+    return;
+  }
+  for (const auto &[name, attribute] : attributes_) {
+    auto index = attribute.GetIndex();
+    if (index->GetIndexerType() != indexes::IndexerType::kHNSW) {
+      continue;
+    }
+    auto vector_index = std::dynamic_pointer_cast<indexes::VectorBase>(index);
+    if (!vector_index->ClaimReorder(min_growth_ratio)) {
+      continue;
+    }
+    ValkeySearch::Instance().ScheduleUtilityTask(
+        [weak_index_schema = GetWeakPtr(), vector_index]() {
+          auto index_schema = weak_index_schema.lock();
+          if (!index_schema) {
+            return;
+          }
+          // The graph is copied without holding the lock. Only swapping the
+          // copy in waits for the searches, which keep the internal ids of
+          // the elements they visit.
+          auto status = vector_index->PrepareReorder();
+          if (status.ok()) {
+            vmsdk::WriterMutexLock lock(&index_schema->time_sliced_mutex_);
+            status = vector_index->ApplyReorder();
+          }
+          if (!status.ok()) {
+            VMSDK_LOG(WARNING, nullptr)
+                << "Failed to reorder the vectors of index "
+                << index_schema->GetName() << ": " << status.message();
+          }
+        });
+  }
+}
+
+void IndexSchema::ScheduleTraining() {
+  for (const auto &[name, attribute] : attributes_) {
+    auto index = attribute.GetIndex();
+    if (index->GetIndexerType() != indexes::IndexerType::kIVF) {
+      continue;
+    }
+    auto vector_index = std::dynamic_pointer_cast<indexes::VectorBase>(index);
+    if (!vector_index->ClaimTraining()) {
+      continue;
+    }
+    ValkeySearch::Instance().ScheduleUtilityTask(
+        [weak_index_schema = GetWeakPtr(), vector_index]() {
+          auto index_schema = weak_index_schema.lock();
+          if (!index_schema) {
+            return;
+          }
+          // The trained lists are swapped in under the index lock only, so
+          // that neither searches nor mutations wait for the training.
+          auto status = vector_index->Train();
+          if (!status.ok()) {
+            VMSDK_LOG(WARNING, nullptr)
+                << "Failed to train the vector index of index "
+                << index_schema->GetName() << ": " << status.message();
+          }
+        });
+  }
+}
+
+/*
+FT._DEBUG HNSW_REORDER <index_name> [<attribute>]
+
+Reorders the HNSW attributes of the index, or only the given one, right away.
+*/
+absl::Status IndexSchema::HNSWReorderCmd(ValkeyModuleCtx *ctx,
+                                         vmsdk::ArgsIterator &itr) {
+  std::string index_name;
+  VMSDK_RETURN_IF_ERROR(vmsdk::ParseParamValue(itr, index_name));
+  VMSDK_ASSIGN_OR_RETURN(auto index_schema,
+                         SchemaManager::Instance().GetIndexSchema(
+                             ValkeyModule_GetSelectedDb(ctx), index_name));
+  std::optional<std::string> attribute_alias;
+  if (itr.HasNext()) {
+    VMSDK_RETURN_IF_ERROR(
+        vmsdk::ParseParamValue(itr, attribute_alias.emplace()));
+  }
+  if (itr.HasNext()) {
+    return absl::InvalidArgumentError("Extra arguments found on command line");
+  }
+  vmsdk::WriterMutexLock lock(&index_schema->time_sliced_mutex_);
+  std::vector<std::shared_ptr<indexes::VectorBase>> vector_indexes;
+  if (attribute_alias) {
+    VMSDK_ASSIGN_OR_RETURN(auto index,
+                           index_schema->GetIndex(*attribute_alias));
+    if (index->GetIndexerType() != indexes::IndexerType::kHNSW) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Attribute `", *attribute_alias, "` is not an HNSW vector index"));
+    }
+    vector_indexes.push_back(
+        std::dynamic_pointer_cast<indexes::VectorBase>(index));
+  } else {
+    for (const auto &[name, attribute] : index_schema->attributes_) {
+      if (attribute.GetIndex()->GetIndexerType() ==
+          indexes::IndexerType::kHNSW) {
+        vector_indexes.push_back(std::dynamic_pointer_cast<indexes::VectorBase>(
+            attribute.GetIndex()));
+      }
+    }
+  }
+  for (const auto &vector_index : vector_indexes) {
+    VMSDK_RETURN_IF_ERROR(vector_index->ReorderForLocality());
+  }
+  ValkeyModule_ReplyWithSimpleString(ctx, "OK");
+  return absl::OkStatus();
+}
+
 CONTROLLED_BOOLEAN(StopBackfill, false);
 
 uint32_t IndexSchema::PerformBackfill(ValkeyModuleCtx *ctx,
@@ -860,9 +1066,55 @@ uint32_t IndexSchema::PerformBackfill(ValkeyModuleCtx *ctx,
       return res;
     }
   }
+  ReserveBackfillCapacity();
   return current_scan_count - start_scan_count;
 }
 
+void IndexSchema::ReserveBackfillCapacity() {
+  const auto &backfill_job = backfill_job_.Get();
+  if (backfill_job->matched_key_count == 0 ||
+      backfill_job->db_size <= backfill_job->scanned_key_count) {
+    return;
+  }
+  // Extrapolate the number of keys left to index from the share of the scanned
+  // keys matching the prefixes so far.
+  uint64_t expected_key_count =
+      (backfill_job->db_size - backfill_job->scanned_key_count) *
+          backfill_job->matched_key_count / backfill_job->scanned_key_count +
+      stats_.backfill_inqueue_tasks;
+  std::vector<std::shared_ptr<indexes::VectorBase>> vector_indexes;
+  for (const auto &[name, attribute] : attributes_) {
+    auto index = attribute.GetIndex();
+    if (index->GetIndexerType() == indexes::IndexerType::kHNSW) {
+      vector_indexes.push_back(
+          std::dynamic_pointer_cast<indexes::VectorBase>(index));
+    }
+  }
+  if (vector_indexes.empty()) {
+    return;
+  }
+  // Growing the graphs in one step, off the main thread, keeps the writer
+  // threads from stalling on a resize every hnsw-block-size records.
+  ValkeySearch::Instance().ScheduleUtilityTask(
+      [weak_index_schema = GetWeakPtr(),
+       vector_indexes = std::move(vector_indexes), expected_key_count]() {
+        auto index_schema = weak_index_schema.lock();
+        if (!index_schema) {
+          return;
+        }
+        // Searches read the graphs without the resize lock, which only keeps
+        // out the writers.
+        vmsdk::WriterMutexLock lock(&index_schema->time_sliced_mutex_);
+        for (const auto &vector_index : vector_indexes) {
+          auto status = vector_index->ReserveCapacity(expected_key_count);
+          if (!status.ok()) {
+            VMSDK_LOG(WARNING, nullptr)
+                << "Failed to reserve backfill capacity: " << status.message();
+          }
+        }
+      });
+}
+
 float IndexSchema::GetBackfillPercent() const {
   const auto &backfill_job = backfill_job_.Get();
   if (!IsBackfillInProgress() || (backfill_job->db_size == 0)) {
@@ -1032,7 +1284,8 @@ void IndexSchema::RespondWithInfo(ValkeyModuleCtx *ctx) const {
 bool IsVectorIndex(std::shared_ptr<indexes::IndexBase> index) {
   return index->GetIndexerType() == indexes::IndexerType::kVector ||
          index->GetIndexerType() == indexes::IndexerType::kHNSW ||
-         index->GetIndexerType() == indexes::IndexerType::kFlat;
+         index->GetIndexerType() == indexes::IndexerType::kFlat ||
+         index->GetIndexerType() == indexes::IndexerType::kIVF;
 }
 
 std::unique_ptr<data_model::IndexSchema> IndexSchema::ToProto() const {
@@ -1700,7 +1953,7 @@ void IndexSchema::VectorExternalizer(const InternedStringPtr &key,
     if (interned_vector) {
       VectorExternalizer::Instance().Externalize(
           key, attribute_identifier, attribute_data_type_->ToProto(),
-          interned_vector, magnitude);
+          interned_vector, magnitude, it->second->GetDataType());
     }
     return;
   }
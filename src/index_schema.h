@@ -148,6 +148,16 @@ class IndexSchema : public KeyspaceEventSubscription,
                               ValkeyModuleString *key) override;
 
   uint32_t PerformBackfill(ValkeyModuleCtx *ctx, uint32_t batch_size);
+  // Schedules a background consolidation on the utility pool for every HNSW
+  // attribute whose share of deleted elements crossed the configured threshold.
+  void ScheduleConsolidation();
+  // Schedules a background reordering on the utility pool for every HNSW
+  // attribute which grew by the configured threshold since it was reordered.
+  // Nothing is scheduled while a backfill is still adding records.
+  void ScheduleReorder();
+  // Schedules the training on the utility pool of every IVF attribute which
+  // holds enough vectors to be trained.
+  void ScheduleTraining();
 
   bool IsBackfillInProgress() const {
     auto &backfill_job = backfill_job_.Get();
@@ -210,6 +220,8 @@ class IndexSchema : public KeyspaceEventSubscription,
 
   static absl::Status TextInfoCmd(ValkeyModuleCtx *ctx,
                                   vmsdk::ArgsIterator &itr);
+  static absl::Status HNSWReorderCmd(ValkeyModuleCtx *ctx,
+                                     vmsdk::ArgsIterator &itr);
 
  protected:
   IndexSchema(ValkeyModuleCtx *ctx,
@@ -260,6 +272,7 @@ class IndexSchema : public KeyspaceEventSubscription,
     vmsdk::UniqueValkeyDetachedThreadSafeContext scan_ctx;
     vmsdk::UniqueValkeyScanCursor cursor;
     uint64_t scanned_key_count{0};
+    uint64_t matched_key_count{0};
     uint64_t db_size;
     vmsdk::StopWatch stopwatch;
     bool paused_by_oom{false};
@@ -300,6 +313,8 @@ class IndexSchema : public KeyspaceEventSubscription,
   static void BackfillScanCallback(ValkeyModuleCtx *ctx,
                                    ValkeyModuleString *keyname,
                                    ValkeyModuleKey *key, void *privdata);
+  // Pre-sizes the HNSW attributes for the keys the backfill is yet to index.
+  void ReserveBackfillCapacity();
   bool DeleteIfNotInValkeyDict(ValkeyModuleCtx *ctx, ValkeyModuleString *key,
                                const Attribute &attribute);
   vmsdk::BlockedClientCategory GetBlockedCategoryFromProto() const;
@@ -327,6 +342,7 @@ class IndexSchema : public KeyspaceEventSubscription,
   vmsdk::MainThreadAccessGuard<bool> schedule_multi_exec_processing_{false};
 
   FRIEND_TEST(IndexSchemaRDBTest, SaveAndLoad);
+  FRIEND_TEST(IndexSchemaBackfillTest, ReserveBackfillCapacityExcludesSearches);
   FRIEND_TEST(IndexSchemaRDBTest, ComprehensiveSkipLoadTest);
   FRIEND_TEST(IndexSchemaFriendTest, ConsistencyTest);
   FRIEND_TEST(IndexSchemaFriendTest, MutatedAttributes);
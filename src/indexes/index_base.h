@@ -25,7 +25,16 @@
 #include "vmsdk/src/valkey_module_api/valkey_module.h"
 
 namespace valkey_search::indexes {
-enum class IndexerType { kHNSW, kFlat, kNumeric, kTag, kVector, kNone, kText };
+enum class IndexerType {
+  kHNSW,
+  kFlat,
+  kNumeric,
+  kTag,
+  kVector,
+  kNone,
+  kText,
+  kIVF
+};
 
 enum class DeletionType {
   kRecord,      // The record was deleted from the index.
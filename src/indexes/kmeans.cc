@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#include "src/indexes/kmeans.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "third_party/hnswlib/hnswlib.h"
+
+namespace valkey_search::indexes {
+
+namespace {
+
+void Normalize(float* vector, size_t dimensions) {
+  float norm = 0.0f;
+  for (size_t i = 0; i < dimensions; ++i) {
+    norm += vector[i] * vector[i];
+  }
+  if (norm == 0.0f) {
+    return;
+  }
+  norm = std::sqrt(norm);
+  for (size_t i = 0; i < dimensions; ++i) {
+    vector[i] /= norm;
+  }
+}
+
+// k-means++ seeding: every next centroid is drawn with a probability
+// proportional to its distance from the closest centroid chosen so far.
+void SeedCentroids(const float* data, size_t count, size_t dimensions,
+                   size_t k, hnswlib::SpaceInterface<float>* space,
+                   std::mt19937_64& rng, std::vector<float>& centroids) {
+  auto dist_func = space->get_dist_func();
+  auto* dist_func_param = space->get_dist_func_param();
+  std::vector<double> min_distance(count,
+                                   std::numeric_limits<double>::max());
+  size_t chosen = std::uniform_int_distribution<size_t>(0, count - 1)(rng);
+  for (size_t c = 0; c < k; ++c) {
+    std::memcpy(&centroids[c * dimensions], &data[chosen * dimensions],
+                dimensions * sizeof(float));
+    if (c + 1 == k) {
+      break;
+    }
+    double total = 0;
+    for (size_t i = 0; i < count; ++i) {
+      // Inner product distances may be negative.
+      double distance = std::max(
+          0.0f, dist_func(&data[i * dimensions], &centroids[c * dimensions],
+                          dist_func_param));
+      min_distance[i] = std::min(min_distance[i], distance);
+      total += min_distance[i];
+    }
+    if (total <= 0) {
+      chosen = std::uniform_int_distribution<size_t>(0, count - 1)(rng);
+      continue;
+    }
+    double target = std::uniform_real_distribution<double>(0, total)(rng);
+    chosen = count - 1;
+    for (size_t i = 0; i < count; ++i) {
+      target -= min_distance[i];
+      if (target <= 0) {
+        chosen = i;
+        break;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+std::vector<float> TrainKMeans(const float* data, size_t count,
+                               size_t dimensions, size_t k,
+                               hnswlib::SpaceInterface<float>* space,
+                               const KMeansOptions& options) {
+  CHECK_GT(k, 0u);
+  CHECK_LE(k, count);
+  std::mt19937_64 rng(options.seed);
+  std::vector<float> centroids(k * dimensions);
+  SeedCentroids(data, count, dimensions, k, space, rng, centroids);
+  if (options.spherical) {
+    for (size_t c = 0; c < k; ++c) {
+      Normalize(&centroids[c * dimensions], dimensions);
+    }
+  }
+
+  std::vector<uint32_t> assignment(count);
+  std::vector<size_t> sizes(k);
+  std::vector<double> sums(k * dimensions);
+  for (int iteration = 0; iteration < options.iterations; ++iteration) {
+    for (size_t i = 0; i < count; ++i) {
+      assignment[i] =
+          NearestCentroid(&data[i * dimensions], centroids, dimensions, space);
+    }
+    std::fill(sizes.begin(), sizes.end(), 0);
+    std::fill(sums.begin(), sums.end(), 0.0);
+    for (size_t i = 0; i < count; ++i) {
+      const float* vector = &data[i * dimensions];
+      double* sum = &sums[assignment[i] * dimensions];
+      for (size_t d = 0; d < dimensions; ++d) {
+        sum[d] += vector[d];
+      }
+      ++sizes[assignment[i]];
+    }
+    for (size_t c = 0; c < k; ++c) {
+      float* centroid = &centroids[c * dimensions];
+      if (sizes[c] == 0) {
+        // Re-seed an empty cluster with a random member of the largest one,
+        // which is the cluster that benefits most from being split.
+        size_t largest = std::distance(
+            sizes.begin(), std::max_element(sizes.begin(), sizes.end()));
+        size_t pick =
+            std::uniform_int_distribution<size_t>(0, sizes[largest] - 1)(rng);
+        for (size_t i = 0; i < count; ++i) {
+          if (assignment[i] == largest && pick-- == 0) {
+            std::memcpy(centroid, &data[i * dimensions],
+                        dimensions * sizeof(float));
+            assignment[i] = c;
+            --sizes[largest];
+            sizes[c] = 1;
+            break;
+          }
+        }
+      } else {
+        for (size_t d = 0; d < dimensions; ++d) {
+          centroid[d] = sums[c * dimensions + d] / sizes[c];
+        }
+      }
+      if (options.spherical) {
+        Normalize(centroid, dimensions);
+      }
+    }
+  }
+  return centroids;
+}
+
+uint32_t NearestCentroid(const float* vector,
+                         const std::vector<float>& centroids,
+                         size_t dimensions,
+                         hnswlib::SpaceInterface<float>* space) {
+  auto dist_func = space->get_dist_func();
+  auto* dist_func_param = space->get_dist_func_param();
+  const size_t k = centroids.size() / dimensions;
+  uint32_t nearest = 0;
+  float nearest_distance = std::numeric_limits<float>::max();
+  for (size_t c = 0; c < k; ++c) {
+    float distance =
+        dist_func(vector, &centroids[c * dimensions], dist_func_param);
+    if (distance < nearest_distance) {
+      nearest_distance = distance;
+      nearest = c;
+    }
+  }
+  return nearest;
+}
+
+std::vector<uint32_t> NearestCentroids(const float* vector,
+                                       const std::vector<float>& centroids,
+                                       size_t dimensions, size_t n,
+                                       hnswlib::SpaceInterface<float>* space) {
+  auto dist_func = space->get_dist_func();
+  auto* dist_func_param = space->get_dist_func_param();
+  const size_t k = centroids.size() / dimensions;
+  n = std::min(n, k);
+  // Max-heap of the n closest centroids seen so far.
+  std::priority_queue<std::pair<float, uint32_t>> closest;
+  for (size_t c = 0; c < k; ++c) {
+    float distance =
+        dist_func(vector, &centroids[c * dimensions], dist_func_param);
+    if (closest.size() < n) {
+      closest.emplace(distance, c);
+    } else if (distance < closest.top().first) {
+      closest.pop();
+      closest.emplace(distance, c);
+    }
+  }
+  std::vector<uint32_t> result(closest.size());
+  for (size_t i = result.size(); i > 0; --i) {
+    result[i - 1] = closest.top().second;
+    closest.pop();
+  }
+  return result;
+}
+
+}  // namespace valkey_search::indexes
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#ifndef VALKEYSEARCH_SRC_INDEXES_KMEANS_H_
+#define VALKEYSEARCH_SRC_INDEXES_KMEANS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "third_party/hnswlib/hnswlib.h"
+
+namespace valkey_search::indexes {
+
+struct KMeansOptions {
+  // Number of Lloyd iterations run after the k-means++ seeding.
+  int iterations{10};
+  // Normalizes the centroids after every update. Used with inner product
+  // spaces, where the centroid direction is what matters.
+  bool spherical{false};
+  // Seed of the generator used for seeding and re-seeding empty clusters, so
+  // that training the same data always yields the same centroids.
+  uint64_t seed{1};
+};
+
+// Clusters `count` row-major float vectors of `dimensions` elements into `k`
+// clusters, assigning vectors with the distance function of `space`. Returns
+// the `k` row-major centroids. Requires 0 < k <= count.
+std::vector<float> TrainKMeans(const float* data, size_t count,
+                               size_t dimensions, size_t k,
+                               hnswlib::SpaceInterface<float>* space,
+                               const KMeansOptions& options = {});
+
+// Returns the position of the centroid closest to the vector.
+uint32_t NearestCentroid(const float* vector,
+                         const std::vector<float>& centroids,
+                         size_t dimensions,
+                         hnswlib::SpaceInterface<float>* space);
+
+// Returns the positions of the (at most) `n` centroids closest to the vector,
+// closest first.
+std::vector<uint32_t> NearestCentroids(const float* vector,
+                                       const std::vector<float>& centroids,
+                                       size_t dimensions, size_t n,
+                                       hnswlib::SpaceInterface<float>* space);
+
+}  // namespace valkey_search::indexes
+
+#endif  // VALKEYSEARCH_SRC_INDEXES_KMEANS_H_
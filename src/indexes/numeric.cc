@@ -8,13 +8,16 @@
 #include "src/indexes/numeric.h"
 
 #include <cstddef>
+#include <cmath>
 #include <cstdint>
 #include <limits>
 #include <memory>
 #include <optional>
 #include <string>
 
+#include "absl/base/casts.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -29,12 +32,62 @@
 
 namespace valkey_search::indexes {
 namespace {
-std::optional<double> ParseNumber(absl::string_view data) {
+// 2^63, the first double above the int64 range.
+constexpr double kInt64Limit = 9223372036854775808.0;
+
+bool IsInt64(double value) {
+  return std::trunc(value) == value && value >= -kInt64Limit &&
+         value < kInt64Limit;
+}
+
+struct ParsedNumber {
   double value;
-  if (absl::AsciiStrToLower(data) == "nan" || !absl::SimpleAtod(data, &value)) {
+  // Set if the value is an int64, with all its digits.
+  std::optional<int64_t> integer;
+};
+
+std::optional<ParsedNumber> ParseNumber(absl::string_view data) {
+  ParsedNumber number;
+  int64_t integer;
+  if (absl::SimpleAtoi(data, &integer)) {
+    number.value = static_cast<double>(integer);
+    number.integer = integer;
+    return number;
+  }
+  if (absl::AsciiStrToLower(data) == "nan" ||
+      !absl::SimpleAtod(data, &number.value)) {
     return std::nullopt;
   }
-  return value;
+  // Integral doubles, e.g. "1e3" or "2.0", are integers too.
+  if (IsInt64(number.value)) {
+    number.integer = static_cast<int64_t>(number.value);
+  }
+  return number;
+}
+
+// Returns whether the integer is a double too, which then keys it exactly.
+bool IsExactDouble(int64_t integer) {
+  auto value = static_cast<double>(integer);
+  return value < kInt64Limit && static_cast<int64_t>(value) == integer;
+}
+
+// Maps the doubles to int64 keys in the same order. The bits of the
+// non-negative doubles already order like them, those of the negative ones
+// order in reverse and have their magnitude bits flipped.
+int64_t EncodeDouble(double value) {
+  // Makes -0.0 the same key as 0.0.
+  value += 0.0;
+  auto bits = absl::bit_cast<int64_t>(value);
+  return bits < 0 ? bits ^ std::numeric_limits<int64_t>::max() : bits;
+}
+
+double DecodeDouble(int64_t key) {
+  return absl::bit_cast<double>(
+      key < 0 ? key ^ std::numeric_limits<int64_t>::max() : key);
+}
+
+int64_t ToKey(const ParsedNumber& number, bool integer_mode) {
+  return integer_mode ? *number.integer : EncodeDouble(number.value);
 }
 }  // namespace
 
@@ -51,13 +104,20 @@ absl::StatusOr<bool> Numeric::AddRecord(const InternedStringPtr& key,
     untracked_keys_.insert(key);
     return false;
   }
-  auto [_, succ] = tracked_keys_.insert({key, *value});
-  if (!succ) {
+  if (tracked_keys_.contains(key)) {
     return absl::AlreadyExistsError(
         absl::StrCat("Key `", key->Str(), "` already exists"));
   }
+  if (integer_mode_ && !value->integer.has_value()) {
+    SwitchToDoubleMode();
+  }
+  auto index_key = ToKey(*value, integer_mode_);
+  TrackRoundedInteger(key, value->integer);
+  non_integer_count_ += IsNonIntegerKey(key, index_key);
+  tracked_keys_.insert({key, index_key});
   untracked_keys_.erase(key);
-  index_->Add(key, *value);
+  index_->Add(key, index_key);
+  MaybeSwitchToIntegerMode();
   return true;
 }
 
@@ -76,8 +136,17 @@ absl::StatusOr<bool> Numeric::ModifyRecord(const InternedStringPtr& key,
         absl::StrCat("Key `", key->Str(), "` not found"));
   }
 
-  index_->Modify(it->first, it->second, *value);
-  it->second = *value;
+  if (integer_mode_ && !value->integer.has_value()) {
+    SwitchToDoubleMode();
+  }
+  non_integer_count_ -= IsNonIntegerKey(key, it->second);
+  rounded_integers_.erase(key);
+  auto index_key = ToKey(*value, integer_mode_);
+  TrackRoundedInteger(key, value->integer);
+  non_integer_count_ += IsNonIntegerKey(key, index_key);
+  index_->Modify(it->first, it->second, index_key);
+  it->second = index_key;
+  MaybeSwitchToIntegerMode();
   return true;
 }
 
@@ -96,8 +165,11 @@ absl::StatusOr<bool> Numeric::RemoveRecord(const InternedStringPtr& key,
     return false;
   }
 
+  non_integer_count_ -= IsNonIntegerKey(key, it->second);
+  rounded_integers_.erase(key);
   index_->Remove(it->first, it->second);
   tracked_keys_.erase(it);
+  MaybeSwitchToIntegerMode();
   return true;
 }
 
@@ -118,63 +190,198 @@ std::unique_ptr<data_model::Index> Numeric::ToProto() const {
   return index_proto;
 }
 
-const double* Numeric::GetValue(const InternedStringPtr& key) const {
+void Numeric::SwitchToDoubleMode() {
+  integer_mode_ = false;
+  updates_since_switch_ = 0;
+  non_integer_count_ = 0;
+  index_ = std::make_unique<BTreeNumericIndex>();
+  for (auto& [key, index_key] : tracked_keys_) {
+    TrackRoundedInteger(key, index_key);
+    index_key = EncodeDouble(static_cast<double>(index_key));
+    index_->Add(key, index_key);
+  }
+}
+
+void Numeric::MaybeSwitchToIntegerMode() {
+  // Rebuilding the tree takes a pass over the tracked keys, which the updates
+  // since the last switch pay for. A value going back and forth between an
+  // integer and not then does not rebuild the tree on every update.
+  ++updates_since_switch_;
+  if (integer_mode_ || non_integer_count_ > 0 ||
+      updates_since_switch_ < tracked_keys_.size()) {
+    return;
+  }
+  integer_mode_ = true;
+  updates_since_switch_ = 0;
+  index_ = std::make_unique<BTreeNumericIndex>();
+  for (auto& [key, index_key] : tracked_keys_) {
+    auto rounded = rounded_integers_.find(key);
+    index_key = rounded != rounded_integers_.end()
+                    ? rounded->second
+                    : static_cast<int64_t>(DecodeDouble(index_key));
+    index_->Add(key, index_key);
+  }
+  rounded_integers_.clear();
+}
+
+void Numeric::TrackRoundedInteger(const InternedStringPtr& key,
+                                  std::optional<int64_t> integer) {
+  if (!integer_mode_ && integer.has_value() && !IsExactDouble(*integer)) {
+    rounded_integers_[key] = *integer;
+  }
+}
+
+bool Numeric::IsNonIntegerKey(const InternedStringPtr& key,
+                              int64_t index_key) const {
+  // Integers next to the int64 limits round to 2^63, which is not an int64.
+  return !integer_mode_ && !IsInt64(DecodeDouble(index_key)) &&
+         !rounded_integers_.contains(key);
+}
+
+bool Numeric::IsIntegerMode() const {
+  absl::MutexLock lock(&index_mutex_);
+  return integer_mode_;
+}
+
+double Numeric::FromKey(int64_t key) const {
+  return integer_mode_ ? static_cast<double>(key) : DecodeDouble(key);
+}
+
+std::optional<double> Numeric::GetValue(const InternedStringPtr& key) const {
   // Note that the Numeric index is not mutated while the time sliced mutex is
   // in a read mode and therefor it is safe to skip lock acquiring.
   if (auto it = tracked_keys_.find(key); it != tracked_keys_.end()) {
-    return &it->second;
+    return FromKey(it->second);
+  }
+  return std::nullopt;
+}
+
+std::optional<std::string> Numeric::GetValueString(
+    const InternedStringPtr& key) const {
+  auto it = tracked_keys_.find(key);
+  if (it == tracked_keys_.end()) {
+    return std::nullopt;
+  }
+  if (integer_mode_) {
+    return absl::StrCat(it->second);
+  }
+  if (auto rounded = rounded_integers_.find(key);
+      rounded != rounded_integers_.end()) {
+    return absl::StrCat(rounded->second);
+  }
+  return absl::StrCat(DecodeDouble(it->second));
+}
+
+std::optional<Numeric::KeyRange> Numeric::GetKeyRange(
+    const query::NumericPredicate& predicate) const {
+  KeyRange range;
+  if (integer_mode_) {
+    auto integer_range = predicate.GetIntegerRange();
+    if (!integer_range.has_value()) {
+      return std::nullopt;
+    }
+    range = {integer_range->start, integer_range->end};
+  } else {
+    // The keys of consecutive doubles are consecutive.
+    range.start = EncodeDouble(predicate.GetStart()) +
+                  (predicate.IsStartInclusive() ? 0 : 1);
+    range.end =
+        EncodeDouble(predicate.GetEnd()) - (predicate.IsEndInclusive() ? 0 : 1);
+  }
+  if (range.start > range.end) {
+    return std::nullopt;
+  }
+  return range;
+}
+
+bool Numeric::IsInRange(const InternedStringPtr& key,
+                        const query::NumericPredicate& predicate) const {
+  auto it = tracked_keys_.find(key);
+  if (it == tracked_keys_.end()) {
+    return false;
+  }
+  auto range = GetKeyRange(predicate);
+  return range.has_value() && it->second >= range->start &&
+         it->second <= range->end;
+}
+
+void Numeric::ForEachInValueOrder(
+    bool ascending,
+    absl::FunctionRef<bool(const InternedStringPtr&, double)> fn) const {
+  // Like GetValue, relies on the time sliced mutex rather than the index mutex.
+  const auto& btree = index_->GetBtree();
+  auto visit = [this, &fn](const BTreeNumericIndex::ConstIterator& it) {
+    for (const auto& key : it.values()) {
+      if (!fn(key, FromKey(it.key()))) {
+        return false;
+      }
+    }
+    return true;
+  };
+  if (ascending) {
+    for (auto it = btree.begin(); it != btree.end(); ++it) {
+      if (!visit(it)) {
+        return;
+      }
+    }
+  } else {
+    for (auto it = btree.Last(); it != btree.end(); --it) {
+      if (!visit(it)) {
+        return;
+      }
+    }
   }
-  return nullptr;
 }
 
 std::unique_ptr<Numeric::EntriesFetcher> Numeric::Search(
     const query::NumericPredicate& predicate, bool negate) const {
   EntriesRange entries_range;
   const auto& btree = index_->GetBtree();
+  auto range = GetKeyRange(predicate);
   if (negate) {
-    auto size =
-        index_->GetCount(std::numeric_limits<double>::lowest(),
-                         predicate.GetStart(), true,
-                         !predicate.IsStartInclusive()) +
-        index_->GetCount(predicate.GetEnd(), std::numeric_limits<double>::max(),
-                         !predicate.IsEndInclusive(), true);
+    if (!range.has_value()) {
+      entries_range.first = btree.begin();
+      entries_range.second = btree.end();
+      return std::make_unique<Numeric::EntriesFetcher>(
+          entries_range, btree.Size() + untracked_keys_.size(), std::nullopt,
+          &untracked_keys_);
+    }
+    auto size = index_->GetCount(std::numeric_limits<int64_t>::min(),
+                                 range->start, true, false) +
+                index_->GetCount(range->end,
+                                 std::numeric_limits<int64_t>::max(), false,
+                                 true);
     entries_range.first = btree.begin();
-    entries_range.second = predicate.IsStartInclusive()
-                               ? btree.lower_bound(predicate.GetStart())
-                               : btree.upper_bound(predicate.GetStart());
+    entries_range.second = btree.LowerBound(range->start);
     EntriesRange additional_entries_range;
-    additional_entries_range.first =
-        predicate.IsEndInclusive() ? btree.upper_bound(predicate.GetEnd())
-                                   : btree.lower_bound(predicate.GetEnd());
-    ;
+    additional_entries_range.first = btree.UpperBound(range->end);
     additional_entries_range.second = btree.end();
     return std::make_unique<Numeric::EntriesFetcher>(
         entries_range, size + untracked_keys_.size(), additional_entries_range,
         &untracked_keys_);
   }
 
-  entries_range.first = predicate.IsStartInclusive()
-                            ? btree.lower_bound(predicate.GetStart())
-                            : btree.upper_bound(predicate.GetStart());
-  entries_range.second = predicate.IsEndInclusive()
-                             ? btree.upper_bound(predicate.GetEnd())
-                             : btree.lower_bound(predicate.GetEnd());
-  size_t size = index_->GetCount(predicate.GetStart(), predicate.GetEnd(),
-                                 predicate.IsStartInclusive(),
-                                 predicate.IsEndInclusive());
+  if (!range.has_value()) {
+    entries_range.first = btree.end();
+    entries_range.second = btree.end();
+    return std::make_unique<Numeric::EntriesFetcher>(entries_range, 0);
+  }
+  entries_range.first = btree.LowerBound(range->start);
+  entries_range.second = btree.UpperBound(range->end);
+  size_t size = index_->GetCount(range->start, range->end, true, true);
   return std::make_unique<Numeric::EntriesFetcher>(entries_range, size);
 }
 
 bool Numeric::EntriesFetcherIterator::NextKeys(
     const Numeric::EntriesRange& range, BTreeNumericIndex::ConstIterator& iter,
-    std::optional<InternedStringSet::const_iterator>& keys_iter) {
+    std::optional<BTreeNumericIndex::Postings::const_iterator>& keys_iter) {
   while (iter != range.second) {
     if (!keys_iter.has_value()) {
-      keys_iter = iter->second.begin();
+      keys_iter = iter.values().begin();
     } else {
       ++keys_iter.value();
     }
-    if (keys_iter.value() != iter->second.end()) {
+    if (keys_iter.value() != iter.values().end()) {
       return true;
     }
     ++iter;
@@ -226,13 +433,13 @@ void Numeric::EntriesFetcherIterator::Next() {
 
 const InternedStringPtr& Numeric::EntriesFetcherIterator::operator*() const {
   if (entries_iter_ != entries_range_.second) {
-    DCHECK(entry_keys_iter_ != entries_iter_->second.end());
+    DCHECK(entry_keys_iter_ != entries_iter_.values().end());
     return *entry_keys_iter_.value();
   }
   if (additional_entries_range_.has_value() &&
       additional_entries_iter_ != additional_entries_range_.value().second) {
     DCHECK(additional_entry_keys_iter_ !=
-           additional_entries_iter_->second.end());
+           additional_entries_iter_.values().end());
     return *additional_entry_keys_iter_.value();
   }
   DCHECK(untracked_keys_ && untracked_keys_iter_.has_value() &&
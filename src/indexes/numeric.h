@@ -12,12 +12,12 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <string>
 #include <utility>
 
 #include "absl/base/thread_annotations.h"
-#include "absl/container/btree_map.h"
-#include "absl/container/flat_hash_set.h"
 #include "absl/functional/any_invocable.h"
+#include "absl/functional/function_ref.h"
 #include "absl/hash/hash.h"
 #include "absl/log/check.h"
 #include "absl/status/status.h"
@@ -27,7 +27,7 @@
 #include "src/indexes/index_base.h"
 #include "src/query/predicate.h"
 #include "src/rdb_serialization.h"
-#include "src/utils/segment_tree.h"
+#include "src/utils/counted_btree.h"
 #include "src/utils/string_interning.h"
 #include "vmsdk/src/valkey_module_api/valkey_module.h"
 
@@ -37,48 +37,39 @@ template <typename T, typename Hasher = absl::Hash<T>,
           typename Equalizer = std::equal_to<T>>
 class BTreeNumeric {
  public:
-  using SetType = absl::flat_hash_set<T, Hasher, Equalizer>;
-  using ConstIterator =
-      typename absl::btree_map<double, SetType>::const_iterator;
+  using BTree = utils::CountedBTree<int64_t, T, Hasher, Equalizer>;
+  using ConstIterator = typename BTree::ConstIterator;
+  using Postings = typename BTree::Postings;
 
-  void Add(const T& value, double key) {
-    btree_[key].insert(value);
-    segment_tree_.Add(key);
-  }
+  void Add(const T& value, int64_t key) { btree_.Add(key, value); }
 
-  void Modify(const T& value, double old_key, double new_key) {
+  void Modify(const T& value, int64_t old_key, int64_t new_key) {
     Remove(value, old_key);
     Add(value, new_key);
   }
 
-  void Remove(const T& value, double key) {
-    btree_[key].erase(value);
-    if (btree_[key].empty()) {
-      btree_.erase(key);
-    }
-    segment_tree_.Remove(key);
-  }
-  const absl::btree_map<double, SetType>& GetBtree() const { return btree_; }
+  void Remove(const T& value, int64_t key) { btree_.Remove(key, value); }
+  const BTree& GetBtree() const { return btree_; }
 
-  size_t GetCount(double start, double end, bool start_inclusive,
-                  bool end_inclusive) {
-    return segment_tree_.Count(start, end, start_inclusive, end_inclusive);
+  size_t GetCount(int64_t start, int64_t end, bool start_inclusive,
+                  bool end_inclusive) const {
+    return btree_.Count(start, end, start_inclusive, end_inclusive);
   }
 
  private:
-  // Right now we have both BTree and Segment Tree. The BTree is used to
-  // maintain the keys and the values. The segment tree is used to maintain the
-  // count of the keys in the range.
-  //
-  // Note on overhead: SegmentTree is roughly 80 bytes per entry (40 B per node,
-  // 2x nodes per entries with a balanced tree).
-  //
-  // TODO: Consider using a single data structure to maintain both
-  // the keys and the count.
-  absl::btree_map<double, SetType> btree_;
-  utils::SegmentTree segment_tree_;
+  // The keys of each value, whose inner nodes also count the keys of their
+  // subtrees for the range sizes.
+  BTree btree_;
 };
 
+// The keys of a Numeric index are int64. While every value of the index is
+// an integer, the keys are the values themselves, so that integers beyond the
+// 53 bit mantissa of a double, e.g. nanosecond timestamps or ids, are stored
+// and compared exactly. A value that is not an int64 switches the index to
+// keys that encode the bits of the double values in their order, and it
+// switches back once no such value is left, with the integers it rounded
+// restored exactly. The tree stores the int64 keys of a leaf as 32 bit offsets
+// when they are close enough, as those of timestamps and counters are.
 class Numeric : public IndexBase {
  public:
   explicit Numeric(const data_model::NumericIndex& numeric_index_proto);
@@ -114,7 +105,22 @@ class Numeric : public IndexBase {
 
   std::unique_ptr<data_model::Index> ToProto() const override;
 
-  const double* GetValue(const InternedStringPtr& key) const
+  std::optional<double> GetValue(const InternedStringPtr& key) const
+      ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  // Returns the value of `key` as a string, with all the digits of integers.
+  std::optional<std::string> GetValueString(const InternedStringPtr& key) const
+      ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  // Returns whether the value of `key` is in the range of `predicate`. Unlike
+  // NumericPredicate::Evaluate, compares the keys of the index, which are
+  // exact for integers.
+  bool IsInRange(const InternedStringPtr& key,
+                 const query::NumericPredicate& predicate) const
+      ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  // Calls `fn` with the tracked keys and their values in ascending, or
+  // descending, value order until it returns false.
+  void ForEachInValueOrder(
+      bool ascending,
+      absl::FunctionRef<bool(const InternedStringPtr&, double)> fn) const
       ABSL_NO_THREAD_SAFETY_ANALYSIS;
   using BTreeNumericIndex = BTreeNumeric<InternedStringPtr>;
   using EntriesRange = std::pair<BTreeNumericIndex::ConstIterator,
@@ -133,13 +139,14 @@ class Numeric : public IndexBase {
     static bool NextKeys(
         const Numeric::EntriesRange& range,
         BTreeNumericIndex::ConstIterator& iter,
-        std::optional<InternedStringSet::const_iterator>& keys_iter);
+        std::optional<BTreeNumericIndex::Postings::const_iterator>& keys_iter);
     const EntriesRange& entries_range_;
     BTreeNumericIndex::ConstIterator entries_iter_;
-    std::optional<InternedStringSet::const_iterator> entry_keys_iter_;
+    std::optional<BTreeNumericIndex::Postings::const_iterator>
+        entry_keys_iter_;
     const std::optional<EntriesRange>& additional_entries_range_;
     BTreeNumericIndex::ConstIterator additional_entries_iter_;
-    std::optional<InternedStringSet::const_iterator>
+    std::optional<BTreeNumericIndex::Postings::const_iterator>
         additional_entry_keys_iter_;
     const InternedStringSet* untracked_keys_;
     std::optional<InternedStringSet::const_iterator> untracked_keys_iter_;
@@ -169,9 +176,41 @@ class Numeric : public IndexBase {
       const query::NumericPredicate& predicate,
       bool negate) const ABSL_NO_THREAD_SAFETY_ANALYSIS;
 
+  bool IsIntegerMode() const ABSL_LOCKS_EXCLUDED(index_mutex_);
+
  private:
+  struct KeyRange {
+    int64_t start;
+    int64_t end;
+  };
+  // Returns the inclusive range of the keys of the values in the range of
+  // `predicate`, or nullopt if no key is in it.
+  std::optional<KeyRange> GetKeyRange(
+      const query::NumericPredicate& predicate) const
+      ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  double FromKey(int64_t key) const ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  // Re-keys the index by the bits of the double values.
+  void SwitchToDoubleMode() ABSL_EXCLUSIVE_LOCKS_REQUIRED(index_mutex_);
+  // Counts an update, and re-keys the index by the integer values if they
+  // all are integers again.
+  void MaybeSwitchToIntegerMode() ABSL_EXCLUSIVE_LOCKS_REQUIRED(index_mutex_);
+  // Keeps `integer` in rounded_integers_ if its double key rounds it.
+  void TrackRoundedInteger(const InternedStringPtr& key,
+                           std::optional<int64_t> integer)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(index_mutex_);
+  bool IsNonIntegerKey(const InternedStringPtr& key, int64_t index_key) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(index_mutex_);
+
   mutable absl::Mutex index_mutex_;
-  InternedStringHashMap<double> tracked_keys_ ABSL_GUARDED_BY(index_mutex_);
+  bool integer_mode_ ABSL_GUARDED_BY(index_mutex_){true};
+  // The number of tracked values that are not int64, in double mode.
+  size_t non_integer_count_ ABSL_GUARDED_BY(index_mutex_){0};
+  size_t updates_since_switch_ ABSL_GUARDED_BY(index_mutex_){0};
+  InternedStringHashMap<int64_t> tracked_keys_ ABSL_GUARDED_BY(index_mutex_);
+  // The integer values whose double keys are not exact, in double mode, e.g.
+  // those beyond 2^53.
+  InternedStringHashMap<int64_t> rounded_integers_
+      ABSL_GUARDED_BY(index_mutex_);
   // untracked keys is needed to support negate filtering
   InternedStringSet untracked_keys_ ABSL_GUARDED_BY(index_mutex_);
   std::unique_ptr<BTreeNumericIndex> index_ ABSL_GUARDED_BY(index_mutex_);
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#include "src/indexes/pq_fast_scan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace valkey_search::indexes {
+
+namespace {
+
+constexpr size_t kTableEntries{16};
+constexpr size_t kHalfBlock{kFastScanBlockSize / 2};
+
+size_t PadM(size_t m) { return (m + 1) & ~size_t{1}; }
+
+// Sums the table entries of the codes of the block into `sums`.
+void ScanBlockSums(const uint8_t* table, const uint8_t* block,
+                   size_t padded_m, uint16_t* sums) {
+#if defined(__AVX2__)
+  const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+  const __m256i low_bytes = _mm256_set1_epi16(0x00ff);
+  __m256i low_even = _mm256_setzero_si256();
+  __m256i low_odd = _mm256_setzero_si256();
+  __m256i high_even = _mm256_setzero_si256();
+  __m256i high_odd = _mm256_setzero_si256();
+  for (size_t s = 0; s < padded_m; s += 2) {
+    // Two sub-quantizers at a time, one per 128 bit lane.
+    const __m256i lut = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(table + s * kTableEntries));
+    const __m256i codes = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(block + s * kHalfBlock));
+    const __m256i low = _mm256_shuffle_epi8(
+        lut, _mm256_and_si256(codes, low_nibbles));
+    const __m256i high = _mm256_shuffle_epi8(
+        lut, _mm256_and_si256(_mm256_srli_epi16(codes, 4), low_nibbles));
+    // Widen the byte distances to 16 bits, the even and odd vectors apart.
+    low_even = _mm256_add_epi16(low_even, _mm256_and_si256(low, low_bytes));
+    low_odd = _mm256_add_epi16(low_odd, _mm256_srli_epi16(low, 8));
+    high_even = _mm256_add_epi16(high_even, _mm256_and_si256(high, low_bytes));
+    high_odd = _mm256_add_epi16(high_odd, _mm256_srli_epi16(high, 8));
+  }
+  auto fold = [](__m256i sums) {
+    return _mm_add_epi16(_mm256_castsi256_si128(sums),
+                         _mm256_extracti128_si256(sums, 1));
+  };
+  const __m128i low_even_sums = fold(low_even);
+  const __m128i low_odd_sums = fold(low_odd);
+  const __m128i high_even_sums = fold(high_even);
+  const __m128i high_odd_sums = fold(high_odd);
+  auto *out = reinterpret_cast<__m128i*>(sums);
+  _mm_storeu_si128(out, _mm_unpacklo_epi16(low_even_sums, low_odd_sums));
+  _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(low_even_sums, low_odd_sums));
+  _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(high_even_sums, high_odd_sums));
+  _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(high_even_sums, high_odd_sums));
+#elif defined(__ARM_NEON)
+  const uint8x16_t low_nibbles = vdupq_n_u8(0x0f);
+  uint16x8_t acc[4] = {vdupq_n_u16(0), vdupq_n_u16(0), vdupq_n_u16(0),
+                       vdupq_n_u16(0)};
+  for (size_t s = 0; s < padded_m; ++s) {
+    const uint8x16_t lut = vld1q_u8(table + s * kTableEntries);
+    const uint8x16_t codes = vld1q_u8(block + s * kHalfBlock);
+    const uint8x16_t low = vqtbl1q_u8(lut, vandq_u8(codes, low_nibbles));
+    const uint8x16_t high = vqtbl1q_u8(lut, vshrq_n_u8(codes, 4));
+    acc[0] = vaddw_u8(acc[0], vget_low_u8(low));
+    acc[1] = vaddw_high_u8(acc[1], low);
+    acc[2] = vaddw_u8(acc[2], vget_low_u8(high));
+    acc[3] = vaddw_high_u8(acc[3], high);
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    vst1q_u16(sums + i * 8, acc[i]);
+  }
+#else
+  std::fill(sums, sums + kFastScanBlockSize, 0);
+  for (size_t s = 0; s < padded_m; ++s) {
+    const uint8_t* lut = table + s * kTableEntries;
+    const uint8_t* codes = block + s * kHalfBlock;
+    for (size_t j = 0; j < kHalfBlock; ++j) {
+      sums[j] += lut[codes[j] & 0x0f];
+      sums[j + kHalfBlock] += lut[codes[j] >> 4];
+    }
+  }
+#endif
+}
+
+}  // namespace
+
+size_t GetFastScanBlockBytes(size_t m) { return PadM(m) * kHalfBlock; }
+
+void PackFastScanCode(const uint8_t* code, size_t m, size_t position,
+                      uint8_t* block) {
+  const size_t byte = position % kHalfBlock;
+  const int shift = position < kHalfBlock ? 0 : 4;
+  for (size_t s = 0; s < m; ++s) {
+    uint8_t& packed = block[s * kHalfBlock + byte];
+    packed = (packed & ~(0x0f << shift)) | ((code[s] & 0x0f) << shift);
+  }
+}
+
+void UnpackFastScanCode(const uint8_t* block, size_t m, size_t position,
+                        uint8_t* code) {
+  const size_t byte = position % kHalfBlock;
+  const int shift = position < kHalfBlock ? 0 : 4;
+  for (size_t s = 0; s < m; ++s) {
+    code[s] = (block[s * kHalfBlock + byte] >> shift) & 0x0f;
+  }
+}
+
+FastScanTable::FastScanTable(const float* table, size_t m)
+    : padded_m_(PadM(m)), table_(padded_m_ * kTableEntries, 0) {
+  std::vector<float> minimums(m);
+  float max_range = 0.0f;
+  float total_range = 0.0f;
+  for (size_t s = 0; s < m; ++s) {
+    const float* entries = table + s * kTableEntries;
+    auto [min, max] = std::minmax_element(entries, entries + kTableEntries);
+    minimums[s] = *min;
+    bias_ += *min;
+    max_range = std::max(max_range, *max - *min);
+    total_range += *max - *min;
+  }
+  if (max_range > 0.0f) {
+    // Each entry is rounded to a byte, and their sum, which adds at most half
+    // a unit per sub-quantizer, must fit 16 bits.
+    scale_ = std::min(
+        std::numeric_limits<uint8_t>::max() / max_range,
+        (std::numeric_limits<uint16_t>::max() - static_cast<float>(m)) /
+            total_range);
+  }
+  for (size_t s = 0; s < m; ++s) {
+    for (size_t c = 0; c < kTableEntries; ++c) {
+      table_[s * kTableEntries + c] = static_cast<uint8_t>(std::lround(
+          (table[s * kTableEntries + c] - minimums[s]) * scale_));
+    }
+  }
+  // Rounding is off by at most half a unit per entry. The float sums of the
+  // exact distances are off by a few more ulps, covered by the extra unit.
+  max_error_ = (0.5f * m + 1.0f) / scale_;
+}
+
+void FastScanTable::ScanBlock(const uint8_t* block, float* distances) const {
+  uint16_t sums[kFastScanBlockSize];
+  ScanBlockSums(table_.data(), block, padded_m_, sums);
+  for (size_t i = 0; i < kFastScanBlockSize; ++i) {
+    distances[i] = bias_ + sums[i] / scale_;
+  }
+}
+
+}  // namespace valkey_search::indexes
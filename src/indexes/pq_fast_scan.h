@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#ifndef VALKEYSEARCH_SRC_INDEXES_PQ_FAST_SCAN_H_
+#define VALKEYSEARCH_SRC_INDEXES_PQ_FAST_SCAN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace valkey_search::indexes {
+
+// Fast scan of 4 bit product quantization codes. The lookup table of a 4 bit
+// sub-quantizer holds 16 entries, so once quantized to bytes it fits a 128 bit
+// register and a single byte shuffle (pshufb on x86, tbl on ARM) looks up the
+// distances of 16 codes at once. The codes of kFastScanBlockSize vectors are
+// stored interleaved in blocks for that: for every sub-quantizer, byte j of
+// the block holds the code of vector j in its low nibble and the code of
+// vector j + 16 in its high nibble.
+inline constexpr size_t kFastScanBlockSize{32};
+
+// Size of a block of codes of `m` sub-quantizers. The sub-quantizers are
+// padded to an even count, so that the AVX2 kernel handles two at a time.
+size_t GetFastScanBlockBytes(size_t m);
+// Writes the code of the vector at `position` of the block. `code` holds one
+// 4 bit value per byte, as written by ProductQuantizer::Encode.
+void PackFastScanCode(const uint8_t* code, size_t m, size_t position,
+                      uint8_t* block);
+// Reads back the code of the vector at `position` of the block.
+void UnpackFastScanCode(const uint8_t* block, size_t m, size_t position,
+                        uint8_t* code);
+
+// Lookup table of a query quantized to bytes. Every sub-quantizer table is
+// shifted by its minimum and all of them are scaled by the same factor, small
+// enough for the sums of `m` entries to fit 16 bits. A block distance then
+// differs from the sum of the float table entries by at most GetMaxError().
+class FastScanTable {
+ public:
+  // `table` holds 16 floats per sub-quantizer, as computed by the 4 bit
+  // ProductQuantizer.
+  FastScanTable(const float* table, size_t m);
+
+  // Writes the approximate distances of the kFastScanBlockSize codes of the
+  // block to `distances`.
+  void ScanBlock(const uint8_t* block, float* distances) const;
+  float GetMaxError() const { return max_error_; }
+
+ private:
+  size_t padded_m_;
+  std::vector<uint8_t> table_;
+  float scale_{1.0f};
+  float bias_{0.0f};
+  float max_error_{0.0f};
+};
+
+}  // namespace valkey_search::indexes
+
+#endif  // VALKEYSEARCH_SRC_INDEXES_PQ_FAST_SCAN_H_
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#include "src/indexes/product_quantizer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "src/indexes/kmeans.h"
+#include "third_party/hnswlib/hnswlib.h"
+#include "third_party/hnswlib/space_l2.h"
+
+namespace valkey_search::indexes {
+
+namespace {
+
+float L2Sqr(const float* a, const float* b, size_t dimensions) {
+  float distance = 0.0f;
+  for (size_t d = 0; d < dimensions; ++d) {
+    float diff = a[d] - b[d];
+    distance += diff * diff;
+  }
+  return distance;
+}
+
+float InnerProduct(const float* a, const float* b, size_t dimensions) {
+  float product = 0.0f;
+  for (size_t d = 0; d < dimensions; ++d) {
+    product += a[d] * b[d];
+  }
+  return product;
+}
+
+}  // namespace
+
+ProductQuantizer::ProductQuantizer(size_t dimensions, size_t m, uint32_t nbits)
+    : dimensions_(dimensions),
+      m_(m),
+      nbits_(nbits),
+      codebook_size_(size_t{1} << nbits),
+      sub_dimensions_(dimensions / m) {
+  CHECK_GT(m, 0u);
+  CHECK_EQ(dimensions % m, 0u);
+  CHECK(nbits == 4 || nbits == 8);
+}
+
+void ProductQuantizer::Train(const float* data, size_t count, uint64_t seed) {
+  CHECK_GE(count, codebook_size_);
+  hnswlib::L2Space space(sub_dimensions_);
+  std::vector<float> sub_vectors(count * sub_dimensions_);
+  codebooks_.resize(m_ * codebook_size_ * sub_dimensions_);
+  for (size_t s = 0; s < m_; ++s) {
+    for (size_t i = 0; i < count; ++i) {
+      std::memcpy(&sub_vectors[i * sub_dimensions_],
+                  &data[i * dimensions_ + s * sub_dimensions_],
+                  sub_dimensions_ * sizeof(float));
+    }
+    auto centroids = TrainKMeans(sub_vectors.data(), count, sub_dimensions_,
+                                 codebook_size_, &space, {.seed = seed + s});
+    std::memcpy(&codebooks_[s * codebook_size_ * sub_dimensions_],
+                centroids.data(), centroids.size() * sizeof(float));
+  }
+}
+
+void ProductQuantizer::Encode(const float* vector, uint8_t* code) const {
+  for (size_t s = 0; s < m_; ++s) {
+    const float* sub_vector = &vector[s * sub_dimensions_];
+    const float* codebook = &codebooks_[s * codebook_size_ * sub_dimensions_];
+    float nearest_distance = std::numeric_limits<float>::max();
+    for (size_t c = 0; c < codebook_size_; ++c) {
+      float distance =
+          L2Sqr(sub_vector, &codebook[c * sub_dimensions_], sub_dimensions_);
+      if (distance < nearest_distance) {
+        nearest_distance = distance;
+        code[s] = c;
+      }
+    }
+  }
+}
+
+void ProductQuantizer::ComputeL2Table(const float* query, float* table) const {
+  for (size_t s = 0; s < m_; ++s) {
+    const float* sub_query = &query[s * sub_dimensions_];
+    const float* codebook = &codebooks_[s * codebook_size_ * sub_dimensions_];
+    for (size_t c = 0; c < codebook_size_; ++c) {
+      table[s * codebook_size_ + c] =
+          L2Sqr(sub_query, &codebook[c * sub_dimensions_], sub_dimensions_);
+    }
+  }
+}
+
+void ProductQuantizer::ComputeNegativeIPTable(const float* query,
+                                              float* table) const {
+  for (size_t s = 0; s < m_; ++s) {
+    const float* sub_query = &query[s * sub_dimensions_];
+    const float* codebook = &codebooks_[s * codebook_size_ * sub_dimensions_];
+    for (size_t c = 0; c < codebook_size_; ++c) {
+      table[s * codebook_size_ + c] = -InnerProduct(
+          sub_query, &codebook[c * sub_dimensions_], sub_dimensions_);
+    }
+  }
+}
+
+absl::string_view ProductQuantizer::GetSerializedCodebooks() const {
+  return absl::string_view(reinterpret_cast<const char*>(codebooks_.data()),
+                           codebooks_.size() * sizeof(float));
+}
+
+absl::Status ProductQuantizer::LoadCodebooks(absl::string_view serialized) {
+  const size_t expected =
+      m_ * codebook_size_ * sub_dimensions_ * sizeof(float);
+  if (serialized.size() != expected) {
+    return absl::InternalError(
+        absl::StrCat("Product quantizer codebooks size mismatch, expected: ",
+                     expected, ", got: ", serialized.size()));
+  }
+  codebooks_.resize(m_ * codebook_size_ * sub_dimensions_);
+  std::memcpy(codebooks_.data(), serialized.data(), serialized.size());
+  return absl::OkStatus();
+}
+
+}  // namespace valkey_search::indexes
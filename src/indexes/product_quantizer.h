@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#ifndef VALKEYSEARCH_SRC_INDEXES_PRODUCT_QUANTIZER_H_
+#define VALKEYSEARCH_SRC_INDEXES_PRODUCT_QUANTIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace valkey_search::indexes {
+
+// Product quantizer: a vector is split into `m` equally sized sub-vectors and
+// every sub-vector is encoded as the position of its closest centroid in a
+// per-subspace codebook of 2^`nbits` centroids. Codes hold one byte per
+// subspace, also with 4 bit codebooks, whose codes the posting lists pack for
+// the fast scan, see pq_fast_scan.h. Distances between a query and encoded
+// vectors are computed with asymmetric distance computation: a per-query
+// lookup table holds the distance between every query sub-vector and every
+// centroid of its subspace, and the distance to a code is the sum of `m` table
+// lookups.
+class ProductQuantizer {
+ public:
+  static constexpr uint32_t kDefaultBits{8};
+
+  // Requires `m` to divide `dimensions` and `nbits` to be 4 or 8.
+  ProductQuantizer(size_t dimensions, size_t m, uint32_t nbits = kDefaultBits);
+
+  size_t GetM() const { return m_; }
+  uint32_t GetBits() const { return nbits_; }
+  size_t GetCodebookSize() const { return codebook_size_; }
+  size_t GetCodeSize() const { return m_; }
+  size_t GetTableSize() const { return m_ * codebook_size_; }
+  bool IsTrained() const { return !codebooks_.empty(); }
+
+  // Trains the codebooks with k-means on `count` row-major float vectors.
+  // Requires count >= GetCodebookSize().
+  void Train(const float* data, size_t count, uint64_t seed);
+  // Writes the GetCodeSize() bytes code of the vector.
+  void Encode(const float* vector, uint8_t* code) const;
+  // Fills `table` (GetTableSize() floats) with the squared L2 distances
+  // between the query sub-vectors and the codebook centroids.
+  void ComputeL2Table(const float* query, float* table) const;
+  // Fills `table` (GetTableSize() floats) with the negated inner products of
+  // the query sub-vectors and the codebook centroids.
+  void ComputeNegativeIPTable(const float* query, float* table) const;
+  // Sums the table entries selected by the code.
+  float Distance(const float* table, const uint8_t* code) const {
+    float distance = 0.0f;
+    for (size_t s = 0; s < m_; ++s) {
+      distance += table[s * codebook_size_ + code[s]];
+    }
+    return distance;
+  }
+
+  // The codebooks are serialized as a single raw float array.
+  absl::string_view GetSerializedCodebooks() const;
+  absl::Status LoadCodebooks(absl::string_view serialized);
+
+ private:
+  size_t dimensions_;
+  size_t m_;
+  uint32_t nbits_;
+  size_t codebook_size_;
+  size_t sub_dimensions_;
+  // Row-major [m][codebook_size][sub_dimensions] centroids, empty until
+  // trained.
+  std::vector<float> codebooks_;
+};
+
+}  // namespace valkey_search::indexes
+
+#endif  // VALKEYSEARCH_SRC_INDEXES_PRODUCT_QUANTIZER_H_
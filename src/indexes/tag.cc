@@ -9,12 +9,14 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/ascii.h"
@@ -24,6 +26,7 @@
 #include "absl/synchronization/mutex.h"
 #include "src/indexes/index_base.h"
 #include "src/query/predicate.h"
+#include "src/utils/compressed_bitmap.h"
 #include "src/utils/patricia_tree.h"
 #include "src/utils/string_interning.h"
 #include "vmsdk/src/valkey_module_api/valkey_module.h"
@@ -54,20 +57,39 @@ absl::StatusOr<bool> Tag::AddRecord(const InternedStringPtr& key,
     untracked_keys_.insert(key);
     return false;
   }
-  auto [_, succ] = tracked_tags_by_keys_.insert(
-      {key, TagInfo{.raw_tag_string = std::move(interned_data),
-                    .tags = parsed_tags}});
-  if (!succ) {
+  if (tracked_tags_by_keys_.contains(key)) {
     return absl::AlreadyExistsError(
         absl::StrCat("Key `", key->Str(), "` already exists"));
   }
+  auto doc_id = AllocateDocId(key);
+  tracked_tags_by_keys_.insert(
+      {key, TagInfo{.raw_tag_string = std::move(interned_data),
+                    .tags = parsed_tags,
+                    .doc_id = doc_id}});
   untracked_keys_.erase(key);
   for (const auto& tag : parsed_tags) {
-    tree_.AddKeyValue(tag, key);
+    tree_.AddKeyValue(tag, doc_id);
   }
   return true;
 }
 
+uint32_t Tag::AllocateDocId(const InternedStringPtr& key) {
+  if (!free_doc_ids_.empty()) {
+    auto doc_id = free_doc_ids_.back();
+    free_doc_ids_.pop_back();
+    keys_by_doc_id_[doc_id] = key;
+    return doc_id;
+  }
+  CHECK_LT(keys_by_doc_id_.size(), std::numeric_limits<uint32_t>::max());
+  keys_by_doc_id_.push_back(key);
+  return keys_by_doc_id_.size() - 1;
+}
+
+void Tag::FreeDocId(uint32_t doc_id) {
+  keys_by_doc_id_[doc_id] = InternedStringPtr();
+  free_doc_ids_.push_back(doc_id);
+}
+
 std::string Tag::UnescapeTag(absl::string_view tag) {
   std::string result;
   result.reserve(tag.size());
@@ -164,14 +186,14 @@ absl::StatusOr<bool> Tag::ModifyRecord(const InternedStringPtr& key,
   // insert new tags that are not present in the old tags.
   for (const auto& tag : new_parsed_tags) {
     if (!tag_info.tags.contains(tag)) {
-      tree_.AddKeyValue(tag, key);
+      tree_.AddKeyValue(tag, tag_info.doc_id);
     }
   }
 
   // remove old tags that are not present in the new tags.
   for (const auto& tag : tag_info.tags) {
     if (!new_parsed_tags.contains(tag)) {
-      tree_.Remove(tag, key);
+      tree_.Remove(tag, tag_info.doc_id);
     }
   }
 
@@ -196,8 +218,9 @@ absl::StatusOr<bool> Tag::RemoveRecord(const InternedStringPtr& key,
   }
   auto& tag_info = it->second;
   for (const auto& tag : tag_info.tags) {
-    tree_.Remove(tag, key);
+    tree_.Remove(tag, tag_info.doc_id);
   }
+  FreeDocId(tag_info.doc_id);
   tracked_tags_by_keys_.erase(it);
   return true;
 }
@@ -250,47 +273,52 @@ const absl::flat_hash_set<absl::string_view>* Tag::GetValue(
 }
 
 Tag::EntriesFetcherIterator::EntriesFetcherIterator(
-    const PatriciaTreeIndex& tree,
-    absl::flat_hash_set<PatriciaNodeIndex*>& entries,
+    const std::vector<InternedStringPtr>& keys_by_doc_id,
+    const utils::CompressedBitmap* doc_ids,
     const InternedStringSet& untracked_keys, bool negate)
-    : tree_iter_(tree.RootIterator()),
-      entries_(entries),
+    : keys_by_doc_id_(keys_by_doc_id),
+      doc_ids_(doc_ids),
       untracked_keys_(untracked_keys),
       negate_(negate) {}
 
 bool Tag::EntriesFetcherIterator::Done() const {
   if (negate_) {
-    return tree_iter_.Done() &&
-           (untracked_keys_.empty() ||
-            (untracked_keys_iter_.has_value() &&
-             untracked_keys_iter_.value() == untracked_keys_.end()));
+    return untracked_keys_iter_.has_value() &&
+           untracked_keys_iter_.value() == untracked_keys_.end();
   }
-  return entries_.empty() && next_node_ == nullptr;
+  return doc_ids_ == nullptr || (doc_ids_iter_.has_value() &&
+                                 doc_ids_iter_.value() == doc_ids_->end());
 }
 
 void Tag::EntriesFetcherIterator::NextNegate() {
-  if (next_node_) {
-    ++next_iter_;
-    if (next_iter_ != next_node_->value.value().end()) {
-      return;
-    }
-    tree_iter_.Next();
+  if (doc_id_ == keys_by_doc_id_.size()) {
+    ++untracked_keys_iter_.value();
+    return;
   }
-  while (!tree_iter_.Done()) {
-    next_node_ = tree_iter_.Value();
-    if (next_node_ && !entries_.contains(next_node_) &&
-        next_node_->value.has_value() && !next_node_->value.value().empty()) {
-      next_iter_ = next_node_->value.value().begin();
-      return;
+  // Walks the documents along with the matching ones, both in order.
+  size_t doc_id = doc_id_.has_value() ? doc_id_.value() + 1 : 0;
+  if (doc_ids_ != nullptr && !doc_ids_iter_.has_value()) {
+    doc_ids_iter_ = doc_ids_->begin();
+  }
+  for (; doc_id < keys_by_doc_id_.size(); ++doc_id) {
+    if (!keys_by_doc_id_[doc_id]) {
+      continue;
     }
-    tree_iter_.Next();
+    if (doc_ids_ != nullptr) {
+      auto& doc_ids_iter = doc_ids_iter_.value();
+      while (doc_ids_iter != doc_ids_->end() && *doc_ids_iter < doc_id) {
+        ++doc_ids_iter;
+      }
+      if (doc_ids_iter != doc_ids_->end() && *doc_ids_iter == doc_id) {
+        continue;
+      }
+    }
+    break;
   }
-  next_node_ = nullptr;
-  if (!untracked_keys_iter_.has_value()) {
+  doc_id_ = doc_id;
+  if (doc_id == keys_by_doc_id_.size()) {
     untracked_keys_iter_ = untracked_keys_.begin();
-    return;
   }
-  ++untracked_keys_iter_.value();
 }
 
 void Tag::EntriesFetcherIterator::Next() {
@@ -298,73 +326,74 @@ void Tag::EntriesFetcherIterator::Next() {
     NextNegate();
     return;
   }
-  if (next_node_) {
-    ++next_iter_;
-    if (next_iter_ != next_node_->value.value().end()) {
-      return;
-    }
+  if (doc_ids_ == nullptr) {
+    return;
   }
-  while (!entries_.empty()) {
-    auto itr = entries_.begin();
-    next_node_ = *itr;
-    entries_.erase(itr);
-    if (next_node_->value.has_value() && !next_node_->value.value().empty()) {
-      next_iter_ = next_node_->value.value().begin();
-      return;
-    }
+  if (doc_ids_iter_.has_value()) {
+    ++doc_ids_iter_.value();
+  } else {
+    doc_ids_iter_ = doc_ids_->begin();
   }
-  next_node_ = nullptr;
 }
 
 const InternedStringPtr& Tag::EntriesFetcherIterator::operator*() const {
-  if (negate_ && tree_iter_.Done()) {
+  if (negate_) {
+    if (doc_id_.value() < keys_by_doc_id_.size()) {
+      return keys_by_doc_id_[doc_id_.value()];
+    }
     return *untracked_keys_iter_.value();
   }
-  return *next_iter_;
+  return keys_by_doc_id_[*doc_ids_iter_.value()];
 }
 
 // TODO: b/357027854 - Support Suffix/Infix Search
 std::unique_ptr<Tag::EntriesFetcher> Tag::Search(
     const query::TagPredicate& predicate, bool negate) const {
   absl::flat_hash_set<PatriciaNodeIndex*> entries;
-  size_t size = 0;
-
+  auto add_entry = [&entries](PatriciaNodeIndex* node) {
+    if (node != nullptr && node->value.has_value() &&
+        !node->value.value().empty()) {
+      entries.insert(node);
+    }
+  };
   for (const auto& tag : predicate.GetTags()) {
     if (tag.back() == '*') {
       auto prefix_tag = tag.substr(0, tag.length() - 1);
       for (auto it = tree_.PrefixMatcher(prefix_tag); !it.Done(); it.Next()) {
-        PatriciaNodeIndex* node = it.Value();
-        if (node != nullptr) {
-          auto res = entries.insert(node);
-          if (res.second && node->value.has_value()) {
-            size += node->value.value().size();
-          }
-        }
+        add_entry(it.Value());
       }
     } else {
       // exact search
-      PatriciaNodeIndex* node = tree_.ExactMatcher(tag);
-      if (node != nullptr) {
-        auto res = entries.insert(node);
-        if (res.second && node->value.has_value()) {
-          size += node->value.value().size();
-        }
-      }
+      add_entry(tree_.ExactMatcher(tag));
     }
   }
-  if (negate) {
-    size = tracked_tags_by_keys_.size() > size
-               ? tracked_tags_by_keys_.size() - size
-               : tracked_tags_by_keys_.size();
-    size += untracked_keys_.size();
+  auto fetched_size = [&](size_t matched) {
+    if (!negate) {
+      return matched;
+    }
+    return tracked_tags_by_keys_.size() - matched + untracked_keys_.size();
+  };
+  if (entries.size() > 1) {
+    // A key with several of the tags is fetched once.
+    utils::CompressedBitmap doc_ids;
+    for (auto* node : entries) {
+      doc_ids.UnionWith(node->value.value());
+    }
+    auto size = fetched_size(doc_ids.size());
+    return std::make_unique<Tag::EntriesFetcher>(
+        keys_by_doc_id_, std::move(doc_ids), size, negate, untracked_keys_);
   }
-  return std::make_unique<Tag::EntriesFetcher>(tree_, entries, size, negate,
-                                               untracked_keys_);
+  const utils::CompressedBitmap* doc_ids =
+      entries.empty() ? nullptr : &(*entries.begin())->value.value();
+  return std::make_unique<Tag::EntriesFetcher>(
+      keys_by_doc_id_, doc_ids,
+      fetched_size(doc_ids == nullptr ? 0 : doc_ids->size()), negate,
+      untracked_keys_);
 }
 
 std::unique_ptr<EntriesFetcherIteratorBase> Tag::EntriesFetcher::Begin() {
-  auto itr = std::make_unique<EntriesFetcherIterator>(tree_, entries_,
-                                                      untracked_keys_, negate_);
+  auto itr = std::make_unique<EntriesFetcherIterator>(
+      keys_by_doc_id_, doc_ids_, untracked_keys_, negate_);
   itr->Next();
   return itr;
 }
@@ -9,13 +9,17 @@
 #define VALKEYSEARCH_SRC_INDEXES_TAG_H_
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/functional/any_invocable.h"
+#include "absl/hash/hash.h"
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -24,6 +28,7 @@
 #include "src/indexes/index_base.h"
 #include "src/query/predicate.h"
 #include "src/rdb_serialization.h"
+#include "src/utils/compressed_bitmap.h"
 #include "src/utils/patricia_tree.h"
 #include "src/utils/string_interning.h"
 #include "vmsdk/src/valkey_module_api/valkey_module.h"
@@ -70,13 +75,16 @@ class Tag : public IndexBase {
   const absl::flat_hash_set<absl::string_view>* GetValue(
       const InternedStringPtr& key,
       bool& case_sensitive) const ABSL_NO_THREAD_SAFETY_ANALYSIS;
-  using PatriciaTreeIndex = PatriciaTree<InternedStringPtr>;
-  using PatriciaNodeIndex = PatriciaNode<InternedStringPtr>;
+  // The values of a tag are the document numbers of its keys.
+  using PatriciaTreeIndex =
+      PatriciaTree<uint32_t, absl::Hash<uint32_t>, std::equal_to<uint32_t>,
+                   utils::CompressedBitmap>;
+  using PatriciaNodeIndex = PatriciaTreeIndex::PatriciaNodeType;
 
   class EntriesFetcherIterator : public EntriesFetcherIteratorBase {
    public:
-    EntriesFetcherIterator(const PatriciaTreeIndex& tree,
-                           absl::flat_hash_set<PatriciaNodeIndex*>& entries,
+    EntriesFetcherIterator(const std::vector<InternedStringPtr>& keys_by_doc_id,
+                           const utils::CompressedBitmap* doc_ids,
                            const InternedStringSet& untracked_keys,
                            bool negate);
     bool Done() const override;
@@ -84,33 +92,48 @@ class Tag : public IndexBase {
     const InternedStringPtr& operator*() const override;
 
    private:
-    PatriciaTreeIndex::PrefixSubTreeIterator tree_iter_;
-    absl::flat_hash_set<PatriciaNodeIndex*>& entries_;
-    PatriciaNodeIndex* next_node_{nullptr};
-    InternedStringSet::const_iterator next_iter_;
+    void NextNegate();
+    const std::vector<InternedStringPtr>& keys_by_doc_id_;
+    const utils::CompressedBitmap* doc_ids_;
+    std::optional<utils::CompressedBitmap::const_iterator> doc_ids_iter_;
+    // When negated, the current document.
+    std::optional<size_t> doc_id_;
     const InternedStringSet& untracked_keys_;
     bool negate_;
     std::optional<InternedStringSet::const_iterator> untracked_keys_iter_;
-    void NextNegate();
   };
 
+  // Fetches the keys of `doc_ids`, or, if `negate`, those of the other
+  // documents and the untracked keys. `doc_ids` may be null when no tag
+  // matches.
   class EntriesFetcher : public EntriesFetcherBase {
    public:
-    EntriesFetcher(const PatriciaTreeIndex& tree,
-                   absl::flat_hash_set<PatriciaNodeIndex*> entries, size_t size,
+    EntriesFetcher(const std::vector<InternedStringPtr>& keys_by_doc_id,
+                   const utils::CompressedBitmap* doc_ids, size_t size,
                    bool negate, const InternedStringSet& untracked_keys)
-        : tree_(tree),
+        : keys_by_doc_id_(keys_by_doc_id),
+          doc_ids_(doc_ids),
           size_(size),
-          entries_(entries),
           negate_(negate),
-          untracked_keys_(untracked_keys){};
+          untracked_keys_(untracked_keys) {}
+    // Takes the union of the documents of several tags.
+    EntriesFetcher(const std::vector<InternedStringPtr>& keys_by_doc_id,
+                   utils::CompressedBitmap doc_ids, size_t size, bool negate,
+                   const InternedStringSet& untracked_keys)
+        : keys_by_doc_id_(keys_by_doc_id),
+          owned_doc_ids_(std::move(doc_ids)),
+          doc_ids_(&owned_doc_ids_.value()),
+          size_(size),
+          negate_(negate),
+          untracked_keys_(untracked_keys) {}
     size_t Size() const override;
     std::unique_ptr<EntriesFetcherIteratorBase> Begin() override;
 
    private:
-    const PatriciaTreeIndex& tree_;
+    const std::vector<InternedStringPtr>& keys_by_doc_id_;
+    std::optional<utils::CompressedBitmap> owned_doc_ids_;
+    const utils::CompressedBitmap* doc_ids_;
     size_t size_{0};
-    absl::flat_hash_set<PatriciaNodeIndex*> entries_;
     bool negate_;
     const InternedStringSet& untracked_keys_;
   };
@@ -128,16 +151,25 @@ class Tag : public IndexBase {
   static std::string UnescapeTag(absl::string_view tag);
 
  private:
+  uint32_t AllocateDocId(const InternedStringPtr& key)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(index_mutex_);
+  void FreeDocId(uint32_t doc_id) ABSL_EXCLUSIVE_LOCKS_REQUIRED(index_mutex_);
+
   mutable absl::Mutex index_mutex_;
   struct TagInfo {
     InternedStringPtr raw_tag_string;
     absl::flat_hash_set<absl::string_view> tags;
+    uint32_t doc_id;
   };
   // Map of tracked keys to their tags.
   InternedStringHashMap<TagInfo> tracked_tags_by_keys_
       ABSL_GUARDED_BY(index_mutex_);
   // untracked and tracked_ keys are mutually exclusive.
   InternedStringSet untracked_keys_ ABSL_GUARDED_BY(index_mutex_);
+  // The tracked keys by their document numbers, which are dense as the numbers
+  // of removed keys are reused. The keys of free numbers are null.
+  std::vector<InternedStringPtr> keys_by_doc_id_ ABSL_GUARDED_BY(index_mutex_);
+  std::vector<uint32_t> free_doc_ids_ ABSL_GUARDED_BY(index_mutex_);
   const char separator_;
   const bool case_sensitive_;
   PatriciaTreeIndex tree_ ABSL_GUARDED_BY(index_mutex_);
@@ -16,6 +16,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <deque>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <queue>
@@ -29,6 +30,7 @@
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
@@ -43,10 +45,13 @@
 #include "src/indexes/text.h"
 #include "src/query/predicate.h"
 #include "src/rdb_serialization.h"
+#include "src/utils/cancel.h"
 #include "src/utils/string_interning.h"
 #include "src/valkey_search_options.h"
 #include "src/vector_externalizer.h"
 #include "third_party/hnswlib/hnswlib.h"
+#include "third_party/hnswlib/space_binary.h"
+#include "third_party/hnswlib/space_half.h"
 #include "third_party/hnswlib/space_ip.h"
 #include "third_party/hnswlib/space_l2.h"
 #include "vmsdk/src/log.h"
@@ -57,29 +62,113 @@
 
 namespace valkey_search {
 constexpr float kDefaultMagnitude = -1.0f;
+// While keys with several vectors are indexed, searches for k keys start
+// with this many times k vectors.
+constexpr uint64_t kMultiVectorSearchFactor = 4;
 
 namespace {
 
 template <typename T>
-std::unique_ptr<hnswlib::SpaceInterface<T>> CreateSpace(
+std::unique_ptr<hnswlib::SpaceInterface<float>> CreateSpace(
     int dimensions, valkey_search::data_model::DistanceMetric distance_metric) {
+  const bool inner_product =
+      distance_metric ==
+          valkey_search::data_model::DistanceMetric::DISTANCE_METRIC_COSINE ||
+      distance_metric ==
+          valkey_search::data_model::DistanceMetric::DISTANCE_METRIC_IP;
   if constexpr (std::is_same_v<T, float>) {
-    if (distance_metric ==
-            valkey_search::data_model::DistanceMetric::DISTANCE_METRIC_COSINE ||
-        distance_metric ==
-            valkey_search::data_model::DistanceMetric::DISTANCE_METRIC_IP) {
+    if (inner_product) {
       return std::make_unique<hnswlib::InnerProductSpace>(dimensions);
-    } else {
-      return std::make_unique<hnswlib::L2Space>(dimensions);
     }
+    return std::make_unique<hnswlib::L2Space>(dimensions);
+  } else if constexpr (std::is_same_v<T, hnswlib::float16>) {
+    if (inner_product) {
+      return std::make_unique<hnswlib::InnerProductSpaceF16>(dimensions);
+    }
+    return std::make_unique<hnswlib::L2SpaceF16>(dimensions);
+  } else if constexpr (std::is_same_v<T, hnswlib::bfloat16>) {
+    if (inner_product) {
+      return std::make_unique<hnswlib::InnerProductSpaceBF16>(dimensions);
+    }
+    return std::make_unique<hnswlib::L2SpaceBF16>(dimensions);
+  } else if constexpr (std::is_same_v<T, hnswlib::bit8>) {
+    return std::make_unique<hnswlib::HammingSpace>(dimensions);
   }
   DCHECK(false) << "no matching spacer";
   return std::make_unique<hnswlib::L2Space>(dimensions);
 }
 
+template <typename T>
+bool AppendParsedElements(const std::vector<std::string> &float_strings,
+                          std::string &binary_string) {
+  binary_string.reserve(float_strings.size() * sizeof(T));
+  for (const auto &float_str : float_strings) {
+    float value;
+    if (!absl::SimpleAtof(float_str, &value)) {
+      return false;
+    }
+    T element = hnswlib::FromFloat<T>(value);
+    binary_string += std::string((char *)&element, sizeof(T));
+  }
+  return true;
+}
+
+// Binary vectors are given as one 0 or 1 element per dimension, the first
+// dimension ending up in the most significant bit of the first byte.
+bool AppendParsedBits(const std::vector<std::string> &bit_strings,
+                      std::string &binary_string) {
+  if (bit_strings.size() % hnswlib::kBitsPerBit8 != 0) {
+    return false;
+  }
+  binary_string.reserve(bit_strings.size() / hnswlib::kBitsPerBit8);
+  uint8_t byte = 0;
+  for (size_t i = 0; i < bit_strings.size(); ++i) {
+    int bit;
+    if (!absl::SimpleAtoi(bit_strings[i], &bit) || (bit != 0 && bit != 1)) {
+      return false;
+    }
+    byte = (byte << 1) | bit;
+    if ((i + 1) % hnswlib::kBitsPerBit8 == 0) {
+      binary_string.push_back(static_cast<char>(byte));
+      byte = 0;
+    }
+  }
+  return true;
+}
+
 }  // namespace
 
 namespace indexes {
+namespace {
+
+// Iterates the keys a vector range predicate was resolved to.
+class KeysEntriesFetcher : public EntriesFetcherBase {
+ public:
+  explicit KeysEntriesFetcher(std::vector<InternedStringPtr> keys)
+      : keys_(std::move(keys)) {}
+  size_t Size() const override { return keys_.size(); }
+  std::unique_ptr<EntriesFetcherIteratorBase> Begin() override {
+    return std::make_unique<Iterator>(keys_);
+  }
+
+ private:
+  class Iterator : public EntriesFetcherIteratorBase {
+   public:
+    explicit Iterator(const std::vector<InternedStringPtr> &keys)
+        : keys_(keys) {}
+    bool Done() const override { return pos_ >= keys_.size(); }
+    void Next() override { ++pos_; }
+    const InternedStringPtr &operator*() const override { return keys_[pos_]; }
+
+   private:
+    const std::vector<InternedStringPtr> &keys_;
+    size_t pos_{0};
+  };
+  std::vector<InternedStringPtr> keys_;
+};
+
+}  // namespace
+
 bool PrefilterEvaluator::Evaluate(const query::Predicate &predicate,
                                   const InternedStringPtr &key) {
   key_ = &key;
@@ -98,8 +187,16 @@ query::EvaluationResult PrefilterEvaluator::EvaluateTags(
 query::EvaluationResult PrefilterEvaluator::EvaluateNumeric(
     const query::NumericPredicate &predicate) {
   CHECK(key_);
-  auto value = predicate.GetIndex()->GetValue(*key_);
-  return predicate.Evaluate(value);
+  return query::EvaluationResult(
+      predicate.GetIndex()->IsInRange(*key_, predicate));
+}
+
+query::EvaluationResult PrefilterEvaluator::EvaluateVectorRange(
+    const query::VectorRangePredicate &predicate) {
+  CHECK(key_);
+  auto distance = predicate.GetIndex()->ComputeDistance(predicate.GetQuery(),
+                                                        *key_);
+  return predicate.Evaluate(distance.ok() ? &distance.value() : nullptr);
 }
 
 query::EvaluationResult PrefilterEvaluator::EvaluateText(
@@ -111,39 +208,71 @@ query::EvaluationResult PrefilterEvaluator::EvaluateText(
   return predicate.Evaluate(*text_index_, *key_, require_positions);
 }
 
+size_t GetVectorByteSize(data_model::VectorDataType data_type,
+                         int dimensions) {
+  switch (data_type) {
+    case data_model::VECTOR_DATA_TYPE_FLOAT32:
+      return sizeof(float) * dimensions;
+    case data_model::VECTOR_DATA_TYPE_FLOAT16:
+      return sizeof(hnswlib::float16) * dimensions;
+    case data_model::VECTOR_DATA_TYPE_BFLOAT16:
+      return sizeof(hnswlib::bfloat16) * dimensions;
+    case data_model::VECTOR_DATA_TYPE_BINARY:
+      return dimensions / hnswlib::kBitsPerBit8;
+    default:
+      return 0;
+  }
+}
+
+// The magnitude is accumulated in float precision for all element types.
 template <typename T>
-T CopyAndNormalizeEmbedding(T *dst, T *src, size_t size) {
-  T magnitude = 0.0f;
+float CopyAndNormalizeEmbedding(T *dst, const T *src, size_t size) {
+  float magnitude = 0.0f;
   for (size_t i = 0; i < size; i++) {
-    magnitude += src[i] * src[i];
+    float value = hnswlib::ToFloat(src[i]);
+    magnitude += value * value;
   }
   magnitude = std::sqrt(magnitude);
-  T norm = (magnitude == 0.0f) ? 1.0f : (1.0f / magnitude);
+  float norm = (magnitude == 0.0f) ? 1.0f : (1.0f / magnitude);
   for (size_t i = 0; i < size; i++) {
-    dst[i] = norm * src[i];
+    dst[i] = hnswlib::FromFloat<T>(norm * hnswlib::ToFloat(src[i]));
   }
   return magnitude;
 }
 
-std::vector<char> NormalizeEmbedding(absl::string_view record, size_t type_size,
+template <typename T>
+std::vector<char> NormalizeEmbedding(absl::string_view record,
                                      float *magnitude) {
   std::vector<char> ret(record.size());
-  if (type_size == sizeof(float)) {
-    float result = CopyAndNormalizeEmbedding(
-        (float *)&ret[0], (float *)record.data(), ret.size() / sizeof(float));
-    if (magnitude) {
-      *magnitude = result;
-    }
-    return ret;
+  float result = CopyAndNormalizeEmbedding(
+      (T *)&ret[0], (const T *)record.data(), ret.size() / sizeof(T));
+  if (magnitude) {
+    *magnitude = result;
+  }
+  return ret;
+}
+
+std::vector<char> NormalizeEmbedding(absl::string_view record,
+                                     data_model::VectorDataType data_type,
+                                     float *magnitude) {
+  switch (data_type) {
+    case data_model::VECTOR_DATA_TYPE_FLOAT32:
+      return NormalizeEmbedding<float>(record, magnitude);
+    case data_model::VECTOR_DATA_TYPE_FLOAT16:
+      return NormalizeEmbedding<hnswlib::float16>(record, magnitude);
+    case data_model::VECTOR_DATA_TYPE_BFLOAT16:
+      return NormalizeEmbedding<hnswlib::bfloat16>(record, magnitude);
+    default:
+      CHECK(false) << "unsupported vector data type";
   }
-  CHECK(false) << "unsupported type size";
 }
 
 template <typename T>
-void VectorBase::Init(int dimensions,
-                      valkey_search::data_model::DistanceMetric distance_metric,
-                      std::unique_ptr<hnswlib::SpaceInterface<T>> &space) {
+void VectorBase::Init(
+    int dimensions, valkey_search::data_model::DistanceMetric distance_metric,
+    std::unique_ptr<hnswlib::SpaceInterface<float>> &space) {
   space = CreateSpace<T>(dimensions, distance_metric);
+  distance_space_ = space.get();
   distance_metric_ = distance_metric;
   if (distance_metric ==
       valkey_search::data_model::DistanceMetric::DISTANCE_METRIC_COSINE) {
@@ -159,7 +288,7 @@ InternedStringPtr VectorBase::InternVector(absl::string_view record,
   if (normalize_) {
     magnitude = kDefaultMagnitude;
     auto norm_record =
-        NormalizeEmbedding(record, GetDataTypeSize(), &magnitude.value());
+        NormalizeEmbedding(record, data_type_, &magnitude.value());
     return StringInternStore::Intern(
         absl::string_view((const char *)norm_record.data(), norm_record.size()),
         vector_allocator_.get());
@@ -167,18 +296,54 @@ InternedStringPtr VectorBase::InternVector(absl::string_view record,
   return StringInternStore::Intern(record, vector_allocator_.get());
 }
 
+size_t VectorBase::GetRecordVectorCount(absl::string_view record) const {
+  if (IsValidSizeVector(record)) {
+    return 1;
+  }
+  const size_t vector_size = GetVectorDataSize();
+  if (attribute_data_type_ !=
+          data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_JSON ||
+      record.empty() || vector_size == 0 || record.size() % vector_size != 0) {
+    return 0;
+  }
+  return record.size() / vector_size;
+}
+
 absl::StatusOr<bool> VectorBase::AddRecord(const InternedStringPtr &key,
                                            absl::string_view record) {
-  std::optional<float> magnitude;
-  auto interned_vector = InternVector(record, magnitude);
-  if (!interned_vector) {
+  const size_t vector_count = GetRecordVectorCount(record);
+  if (vector_count == 0) {
     return false;
   }
+  const size_t vector_size = GetVectorDataSize();
+  // Only the magnitude of the first vector is kept. The index does not return
+  // the contents of keys with several vectors.
+  std::optional<float> magnitude;
+  std::optional<float> other_magnitude;
+  std::vector<InternedStringPtr> interned_vectors;
+  interned_vectors.reserve(vector_count);
+  for (size_t i = 0; i < vector_count; ++i) {
+    interned_vectors.push_back(
+        InternVector(record.substr(i * vector_size, vector_size),
+                     i == 0 ? magnitude : other_magnitude));
+  }
   VMSDK_ASSIGN_OR_RETURN(
       auto internal_id,
-      TrackKey(key, magnitude.value_or(kDefaultMagnitude), interned_vector));
-  absl::Status add_result = AddRecordImpl(internal_id, interned_vector->Str());
+      TrackKey(key, magnitude.value_or(kDefaultMagnitude), interned_vectors));
+  absl::Status add_result;
+  size_t added_count = 0;
+  for (const auto &interned_vector : interned_vectors) {
+    add_result = AddRecordImpl(internal_id + added_count,
+                               interned_vector->Str());
+    if (!add_result.ok()) {
+      break;
+    }
+    ++added_count;
+  }
   if (!add_result.ok()) {
+    for (size_t i = 0; i < added_count; ++i) {
+      [[maybe_unused]] auto remove_result = RemoveRecordImpl(internal_id + i);
+    }
     auto untrack_result = UnTrackKey(key);
     if (!untrack_result.ok()) {
       VMSDK_LOG_EVERY_N_SEC(WARNING, nullptr, 1)
@@ -192,21 +357,20 @@ absl::StatusOr<bool> VectorBase::AddRecord(const InternedStringPtr &key,
 }
 
 absl::StatusOr<uint64_t> VectorBase::GetInternalId(
-    const InternedStringPtr &key) const {
+    const InternedStringPtr &key, uint32_t *vector_count) const {
   absl::ReaderMutexLock lock(&key_to_metadata_mutex_);
-  auto it = tracked_metadata_by_key_.find(key);
-  if (it == tracked_metadata_by_key_.end()) {
-    return absl::InvalidArgumentError("Record was not found");
-  }
-  return it->second.internal_id;
+  return GetInternalIdDuringSearch(key, vector_count);
 }
 
 absl::StatusOr<uint64_t> VectorBase::GetInternalIdDuringSearch(
-    const InternedStringPtr &key) const {
+    const InternedStringPtr &key, uint32_t *vector_count) const {
   auto it = tracked_metadata_by_key_.find(key);
   if (it == tracked_metadata_by_key_.end()) {
     return absl::InvalidArgumentError("Record was not found");
   }
+  if (vector_count) {
+    *vector_count = it->second.vector_count;
+  }
   return it->second.internal_id;
 }
 
@@ -223,14 +387,24 @@ absl::StatusOr<bool> VectorBase::ModifyRecord(const InternedStringPtr &key,
                                               absl::string_view record) {
   // VectorExternalizer tracks added entries. We need to untrack mutations which
   // are processed as modified records.
+  const size_t vector_count = GetRecordVectorCount(record);
   std::optional<float> magnitude;
-  auto interned_vector = InternVector(record, magnitude);
-  if (!interned_vector) {
+  auto interned_vector =
+      vector_count == 1 ? InternVector(record, magnitude) : InternedStringPtr();
+  if (vector_count == 0) {
     [[maybe_unused]] auto res =
         RemoveRecord(key, indexes::DeletionType::kRecord);
     return false;
   }
-  VMSDK_ASSIGN_OR_RETURN(auto internal_id, GetInternalId(key));
+  uint32_t tracked_vector_count;
+  VMSDK_ASSIGN_OR_RETURN(auto internal_id,
+                         GetInternalId(key, &tracked_vector_count));
+  if (vector_count != 1 || tracked_vector_count != 1) {
+    // Keys with several vectors are replaced as a whole.
+    VMSDK_RETURN_IF_ERROR(
+        RemoveRecord(key, indexes::DeletionType::kRecord).status());
+    return AddRecord(key, record);
+  }
   VMSDK_ASSIGN_OR_RETURN(
       bool res, UpdateMetadata(key, magnitude.value_or(kDefaultMagnitude),
                                interned_vector));
@@ -251,9 +425,51 @@ absl::StatusOr<bool> VectorBase::ModifyRecord(const InternedStringPtr &key,
   return true;
 }
 
+uint64_t VectorBase::GetSearchCount(uint64_t count) const {
+  if (multi_vector_key_count_ == 0) {
+    return count;
+  }
+  if (count > std::numeric_limits<uint64_t>::max() / kMultiVectorSearchFactor) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  return count * kMultiVectorSearchFactor;
+}
+
+std::optional<uint64_t> VectorBase::WidenSearchCount(uint64_t count,
+                                                     uint64_t search_count,
+                                                     size_t found,
+                                                     size_t key_count) const {
+  // Finding fewer vectors than asked for means there are no more to find.
+  if (key_count >= count || found < search_count ||
+      search_count > std::numeric_limits<uint64_t>::max() / 2) {
+    return std::nullopt;
+  }
+  return search_count * 2;
+}
+
+absl::StatusOr<std::vector<Neighbor>> VectorBase::SearchKeys(
+    uint64_t count,
+    absl::FunctionRef<absl::StatusOr<
+        std::priority_queue<std::pair<float, hnswlib::labeltype>>>(uint64_t)>
+        search) {
+  uint64_t search_count = GetSearchCount(count);
+  while (true) {
+    VMSDK_ASSIGN_OR_RETURN(auto search_result, search(search_count));
+    const size_t found = search_result.size();
+    VMSDK_ASSIGN_OR_RETURN(auto reply, CreateReply(search_result, count));
+    auto wider_search_count =
+        WidenSearchCount(count, search_count, found, reply.size());
+    if (!wider_search_count) {
+      return reply;
+    }
+    search_count = *wider_search_count;
+  }
+}
+
 template <typename T>
 absl::StatusOr<std::vector<Neighbor>> VectorBase::CreateReply(
-    std::priority_queue<std::pair<T, hnswlib::labeltype>> &knn_res) {
+    std::priority_queue<std::pair<T, hnswlib::labeltype>> &knn_res,
+    uint64_t count) {
   std::vector<Neighbor> ret;
   ret.reserve(knn_res.size());
   while (!knn_res.empty()) {
@@ -269,6 +485,20 @@ absl::StatusOr<std::vector<Neighbor>> VectorBase::CreateReply(
   }
   // Reverse to obtain asc order of closest neighbors first.
   std::reverse(ret.begin(), ret.end());
+  if (multi_vector_key_count_ > 0) {
+    absl::flat_hash_set<const char *> seen_keys;
+    ret.erase(std::remove_if(ret.begin(), ret.end(),
+                             [&seen_keys](const Neighbor &neighbor) {
+                               return !seen_keys
+                                           .insert(neighbor.external_id->Str()
+                                                       .data())
+                                           .second;
+                             }),
+              ret.end());
+  }
+  if (ret.size() > count) {
+    ret.erase(ret.begin() + count, ret.end());
+  }
   return ret;
 }
 
@@ -278,14 +508,24 @@ absl::StatusOr<std::vector<char>> VectorBase::GetValue(
   if (it == tracked_metadata_by_key_.end()) {
     return absl::NotFoundError("Record was not found");
   }
+  if (it->second.vector_count > 1) {
+    return absl::UnimplementedError(
+        "The vectors of keys with several vectors are not returned from the "
+        "index");
+  }
   std::vector<char> result;
   char *value = GetValueImpl(it->second.internal_id);
+  if (value == nullptr) {
+    return absl::UnimplementedError(
+        "The vectors of indexes keeping only their codes are not returned from "
+        "the index");
+  }
   if (normalize_) {
     if (it->second.magnitude < 0) {
       return absl::InternalError("Magnitude is not initialized");
     }
     result = DenormalizeVector(absl::string_view(value, GetVectorDataSize()),
-                               GetDataTypeSize(), it->second.magnitude);
+                               data_type_, it->second.magnitude);
   } else {
     result.assign(value, value + GetVectorDataSize());
   }
@@ -295,15 +535,18 @@ absl::StatusOr<std::vector<char>> VectorBase::GetValue(
 absl::StatusOr<bool> VectorBase::RemoveRecord(
     const InternedStringPtr &key,
     [[maybe_unused]] indexes::DeletionType deletion_type) {
-  VMSDK_ASSIGN_OR_RETURN(auto res, UnTrackKey(key));
-  if (!res.has_value()) {
+  VMSDK_ASSIGN_OR_RETURN(auto metadata, UnTrackKey(key));
+  if (!metadata.has_value()) {
     return false;
   }
-  VMSDK_RETURN_IF_ERROR(RemoveRecordImpl(res.value()));
+  for (uint32_t i = 0; i < metadata->vector_count; ++i) {
+    VMSDK_RETURN_IF_ERROR(RemoveRecordImpl(metadata->internal_id + i));
+  }
   return true;
 }
 
-absl::StatusOr<std::optional<uint64_t>> VectorBase::UnTrackKey(
+absl::StatusOr<std::optional<VectorBase::TrackedKeyMetadata>>
+VectorBase::UnTrackKey(
     const InternedStringPtr &key) {
   if (key->Str().empty()) {
     return std::nullopt;
@@ -313,17 +556,23 @@ absl::StatusOr<std::optional<uint64_t>> VectorBase::UnTrackKey(
   if (it == tracked_metadata_by_key_.end()) {
     return std::nullopt;
   }
-  auto id = it->second.internal_id;
-  UnTrackVector(id);
+  auto metadata = it->second;
   tracked_metadata_by_key_.erase(it);
-  auto key_by_internal_id_it = key_by_internal_id_.find(id);
-  if (key_by_internal_id_it == key_by_internal_id_.end()) {
-    return absl::InvalidArgumentError(
-        "Error while untracking key - key was not found in key_by_internal_id_ "
-        "but in internal_by_key_");
+  if (metadata.vector_count > 1) {
+    --multi_vector_key_count_;
+  }
+  for (uint32_t i = 0; i < metadata.vector_count; ++i) {
+    auto id = metadata.internal_id + i;
+    UnTrackVector(id);
+    auto key_by_internal_id_it = key_by_internal_id_.find(id);
+    if (key_by_internal_id_it == key_by_internal_id_.end()) {
+      return absl::InvalidArgumentError(
+          "Error while untracking key - key was not found in "
+          "key_by_internal_id_ but in internal_by_key_");
+    }
+    key_by_internal_id_.erase(key_by_internal_id_it);
   }
-  key_by_internal_id_.erase(key_by_internal_id_it);
-  return id;
+  return metadata;
 }
 
 char *VectorBase::TrackVector(uint64_t internal_id, char *vector, size_t len) {
@@ -333,23 +582,33 @@ char *VectorBase::TrackVector(uint64_t internal_id, char *vector, size_t len) {
   return (char *)interned_vector->Str().data();
 }
 
-absl::StatusOr<uint64_t> VectorBase::TrackKey(const InternedStringPtr &key,
-                                              float magnitude,
-                                              const InternedStringPtr &vector) {
+absl::StatusOr<uint64_t> VectorBase::TrackKey(
+    const InternedStringPtr &key, float magnitude,
+    const std::vector<InternedStringPtr> &vectors) {
   if (key->Str().empty()) {
     return absl::InvalidArgumentError("key can't be empty");
   }
+  const uint32_t vector_count = vectors.size();
   absl::WriterMutexLock lock(&key_to_metadata_mutex_);
-  auto id = inc_id_++;
+  auto id = inc_id_;
+  inc_id_ += vector_count;
   auto [_, succ] = tracked_metadata_by_key_.insert(
-      {key, {.internal_id = id, .magnitude = magnitude}});
+      {key,
+       {.internal_id = id,
+        .magnitude = magnitude,
+        .vector_count = vector_count}});
 
   if (!succ) {
     return absl::InvalidArgumentError(
         absl::StrCat("Embedding id already exists: ", key->Str()));
   }
-  TrackVector(id, vector);
-  key_by_internal_id_.insert({id, key});
+  for (uint32_t i = 0; i < vector_count; ++i) {
+    TrackVector(id + i, vectors[i]);
+    key_by_internal_id_.insert({id + i, key});
+  }
+  if (vector_count > 1) {
+    ++multi_vector_key_count_;
+  }
   return id;
 }
 // Return an error if the key is empty or not being tracked.
@@ -408,6 +667,9 @@ absl::Status VectorBase::SaveTrackedKeys(
     metadata_pb.set_key(key->Str());
     metadata_pb.set_internal_id(metadata.internal_id);
     metadata_pb.set_magnitude(metadata.magnitude);
+    if (metadata.vector_count > 1) {
+      metadata_pb.set_vector_count(metadata.vector_count);
+    }
     auto metadata_pb_str = metadata_pb.SerializeAsString();
     VMSDK_RETURN_IF_ERROR(
         chunked_out.SaveChunk(metadata_pb_str.data(), metadata_pb_str.size()))
@@ -438,7 +700,7 @@ void VectorBase::ExternalizeVector(ValkeyModuleCtx *ctx,
   if (interned_vector) {
     VectorExternalizer::Instance().Externalize(
         interned_key, attribute_identifier, attribute_data_type->ToProto(),
-        interned_vector, magnitude);
+        interned_vector, magnitude, data_type_);
   }
 }
 
@@ -454,14 +716,24 @@ absl::Status VectorBase::LoadTrackedKeys(
       return absl::InvalidArgumentError("Error parsing metadata from proto");
     }
     auto interned_key = StringInternStore::Intern(tracked_key_metadata.key());
+    // Keys saved before multi-vector records have no vector count.
+    const uint32_t vector_count =
+        std::max<uint32_t>(tracked_key_metadata.vector_count(), 1);
     tracked_metadata_by_key_.insert(
         {interned_key,
          {.internal_id = tracked_key_metadata.internal_id(),
-          .magnitude = tracked_key_metadata.magnitude()}});
-    key_by_internal_id_.insert(
-        {tracked_key_metadata.internal_id(), interned_key});
-    inc_id_ = std::max(
-        inc_id_, static_cast<uint64_t>(tracked_key_metadata.internal_id()));
+          .magnitude = tracked_key_metadata.magnitude(),
+          .vector_count = vector_count}});
+    for (uint32_t i = 0; i < vector_count; ++i) {
+      key_by_internal_id_.insert(
+          {tracked_key_metadata.internal_id() + i, interned_key});
+    }
+    if (vector_count > 1) {
+      ++multi_vector_key_count_;
+    }
+    inc_id_ = std::max(inc_id_, static_cast<uint64_t>(
+                                    tracked_key_metadata.internal_id() +
+                                    vector_count - 1));
     ExternalizeVector(ctx, attribute_data_type, tracked_key_metadata.key(),
                       attribute_identifier_);
   }
@@ -485,8 +757,119 @@ std::unique_ptr<data_model::Index> VectorBase::ToProto() const {
 absl::StatusOr<std::pair<float, hnswlib::labeltype>>
 VectorBase::ComputeDistanceFromRecord(const InternedStringPtr &key,
                                       absl::string_view query) const {
-  VMSDK_ASSIGN_OR_RETURN(auto internal_id, GetInternalIdDuringSearch(key));
-  return ComputeDistanceFromRecordImpl(internal_id, query);
+  uint32_t vector_count;
+  VMSDK_ASSIGN_OR_RETURN(auto internal_id,
+                         GetInternalIdDuringSearch(key, &vector_count));
+  return ComputeMinDistance(internal_id, vector_count, query);
+}
+
+absl::StatusOr<std::pair<float, hnswlib::labeltype>>
+VectorBase::ComputeMinDistance(uint64_t internal_id, uint32_t vector_count,
+                               absl::string_view query) const {
+  VMSDK_ASSIGN_OR_RETURN(auto closest,
+                         ComputeDistanceFromRecordImpl(internal_id, query));
+  for (uint32_t i = 1; i < vector_count; ++i) {
+    VMSDK_ASSIGN_OR_RETURN(
+        auto result, ComputeDistanceFromRecordImpl(internal_id + i, query));
+    if (result.first < closest.first) {
+      closest = result;
+    }
+  }
+  return closest;
+}
+
+std::string VectorBase::NormalizeQuery(absl::string_view query) const {
+  if (!normalize_ || !IsValidSizeVector(query)) {
+    return std::string(query);
+  }
+  auto norm_query = NormalizeEmbedding(query, data_type_);
+  return std::string(norm_query.data(), norm_query.size());
+}
+
+std::unique_ptr<EntriesFetcherBase> VectorBase::Search(
+    const query::VectorRangePredicate &predicate, bool negate,
+    cancel::Token &cancellation_token) {
+  std::vector<InternedStringPtr> keys;
+  if (negate) {
+    // The keys beyond the radius are most of the index, an exact scan is as
+    // cheap as anything else here.
+    for (const auto &[key, metadata] : tracked_metadata_by_key_) {
+      auto distance = ComputeMinDistance(
+          metadata.internal_id, metadata.vector_count, predicate.GetQuery());
+      if (distance.ok() && distance->first > predicate.GetRadius()) {
+        keys.push_back(key);
+      }
+      if (cancellation_token->IsCancelled()) {
+        break;
+      }
+    }
+    return std::make_unique<KeysEntriesFetcher>(std::move(keys));
+  }
+  auto neighbors = SearchRange(predicate.GetQuery(), predicate.GetRadius(),
+                               cancellation_token);
+  if (!neighbors.ok()) {
+    VMSDK_LOG(WARNING, nullptr)
+        << "Vector range search on `" << predicate.GetAlias()
+        << "` failed: " << neighbors.status();
+  } else {
+    keys.reserve(neighbors->size());
+    for (auto &neighbor : *neighbors) {
+      keys.push_back(std::move(neighbor.external_id));
+    }
+  }
+  return std::make_unique<KeysEntriesFetcher>(std::move(keys));
+}
+
+absl::StatusOr<float> VectorBase::ComputeDistance(
+    absl::string_view query, const InternedStringPtr &key) const {
+  VMSDK_ASSIGN_OR_RETURN(auto result, ComputeDistanceFromRecord(key, query));
+  return result.first;
+}
+
+absl::StatusOr<float> VectorBase::ComputeDistance(
+    absl::string_view query, vmsdk::UniqueValkeyString record) const {
+  if (attribute_data_type_ ==
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_JSON) {
+    record = NormalizeStringRecord(std::move(record));
+  }
+  if (!record) {
+    return absl::InvalidArgumentError("Invalid vector record");
+  }
+  auto record_str = vmsdk::ToStringView(record.get());
+  const size_t vector_count = GetRecordVectorCount(record_str);
+  if (vector_count == 0 || !IsValidSizeVector(query)) {
+    return absl::InvalidArgumentError("Vector record size mismatch");
+  }
+  // Records with several vectors are as close as their closest vector.
+  const size_t vector_size = GetVectorDataSize();
+  float distance = std::numeric_limits<float>::max();
+  for (size_t i = 0; i < vector_count; ++i) {
+    auto vector =
+        NormalizeQuery(record_str.substr(i * vector_size, vector_size));
+    distance = std::min(distance, distance_space_->get_dist_func()(
+                                      query.data(), vector.data(),
+                                      distance_space_->get_dist_func_param()));
+  }
+  return distance;
+}
+
+std::priority_queue<std::pair<float, hnswlib::labeltype>> MergeSearchResults(
+    std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>>
+        &results,
+    uint64_t k) {
+  std::priority_queue<std::pair<float, hnswlib::labeltype>> merged;
+  for (auto &result : results) {
+    while (!result.empty()) {
+      if (merged.size() < k || result.top().first < merged.top().first) {
+        merged.push(result.top());
+        if (merged.size() > k) {
+          merged.pop();
+        }
+      }
+      result.pop();
+    }
+  }
+  return merged;
 }
 
 bool VectorBase::AddPrefilteredKey(
@@ -514,28 +897,66 @@ bool VectorBase::AddPrefilteredKey(
 
 vmsdk::UniqueValkeyString VectorBase::NormalizeStringRecord(
     vmsdk::UniqueValkeyString record) const {
-  CHECK_EQ(GetDataTypeSize(), sizeof(float));
   auto record_str = vmsdk::ToStringView(record.get());
   if (absl::ConsumePrefix(&record_str, "[")) {
     absl::ConsumeSuffix(&record_str, "]");
   }
-  std::vector<std::string> float_strings =
-      absl::StrSplit(record_str, ',', absl::SkipWhitespace());
+  // A JSON path matching several arrays yields "1,2],[3,4", once the outer
+  // brackets are removed. The arrays are concatenated into one record.
+  std::vector<absl::string_view> arrays = absl::StrSplit(record_str, ']');
+  const size_t vector_size = GetVectorDataSize();
   std::string binary_string;
-  binary_string.reserve(float_strings.size() * sizeof(float));
-  for (const auto &float_str : float_strings) {
-    float value;
-    if (!absl::SimpleAtof(float_str, &value)) {
+  for (size_t i = 0; i < arrays.size(); ++i) {
+    auto array = arrays[i];
+    if (i > 0) {
+      array = absl::StripLeadingAsciiWhitespace(array);
+      if (!absl::ConsumePrefix(&array, ",")) {
+        return nullptr;
+      }
+      array = absl::StripLeadingAsciiWhitespace(array);
+      if (!absl::ConsumePrefix(&array, "[")) {
+        return nullptr;
+      }
+    }
+    std::vector<std::string> float_strings =
+        absl::StrSplit(array, ',', absl::SkipWhitespace());
+    const size_t previous_size = binary_string.size();
+    bool parsed = false;
+    switch (data_type_) {
+      case data_model::VECTOR_DATA_TYPE_FLOAT32:
+        parsed = AppendParsedElements<float>(float_strings, binary_string);
+        break;
+      case data_model::VECTOR_DATA_TYPE_FLOAT16:
+        parsed = AppendParsedElements<hnswlib::float16>(float_strings,
+                                                        binary_string);
+        break;
+      case data_model::VECTOR_DATA_TYPE_BFLOAT16:
+        parsed = AppendParsedElements<hnswlib::bfloat16>(float_strings,
+                                                         binary_string);
+        break;
+      case data_model::VECTOR_DATA_TYPE_BINARY:
+        parsed = AppendParsedBits(float_strings, binary_string);
+        break;
+      default:
+        CHECK(false) << "unsupported vector data type";
+    }
+    if (!parsed) {
+      return nullptr;
+    }
+    // An array holds a single vector. A record of one array of several
+    // vectors' size would otherwise be split into vectors by its length.
+    const size_t array_size = binary_string.size() - previous_size;
+    if (array_size != vector_size &&
+        (arrays.size() > 1 || array_size > vector_size)) {
       return nullptr;
     }
-    binary_string += std::string((char *)&value, sizeof(float));
   }
   return vmsdk::MakeUniqueValkeyString(binary_string);
 }
 
 size_t VectorBase::GetTrackedKeyCount() const {
   absl::ReaderMutexLock lock(&key_to_metadata_mutex_);
-  return key_by_internal_id_.size();
+  return tracked_metadata_by_key_.size();
 }
 
 size_t VectorBase::GetUnTrackedKeyCount() const { return 0; }
@@ -567,9 +988,19 @@ absl::Status VectorBase::ForEachUnTrackedKey(
 template void VectorBase::Init<float>(
     int dimensions, data_model::DistanceMetric distance_metric,
     std::unique_ptr<hnswlib::SpaceInterface<float>> &space);
+template void VectorBase::Init<hnswlib::float16>(
+    int dimensions, data_model::DistanceMetric distance_metric,
+    std::unique_ptr<hnswlib::SpaceInterface<float>> &space);
+template void VectorBase::Init<hnswlib::bfloat16>(
+    int dimensions, data_model::DistanceMetric distance_metric,
+    std::unique_ptr<hnswlib::SpaceInterface<float>> &space);
+template void VectorBase::Init<hnswlib::bit8>(
+    int dimensions, data_model::DistanceMetric distance_metric,
+    std::unique_ptr<hnswlib::SpaceInterface<float>> &space);
 
 template absl::StatusOr<std::vector<Neighbor>> VectorBase::CreateReply<float>(
-    std::priority_queue<std::pair<float, hnswlib::labeltype>> &knn_res);
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> &knn_res,
+    uint64_t count);
 }  // namespace indexes
 
 }  // namespace valkey_search
@@ -8,14 +8,17 @@
 #ifndef VALKEYSEARCH_SRC_INDEXES_VECTOR_BASE_H_
 #define VALKEYSEARCH_SRC_INDEXES_VECTOR_BASE_H_
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <deque>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <queue>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -24,6 +27,7 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/functional/any_invocable.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
@@ -34,21 +38,27 @@
 #include "src/query/predicate.h"
 #include "src/rdb_serialization.h"
 #include "src/utils/allocator.h"
+#include "src/utils/cancel.h"
 #include "src/utils/string_interning.h"
 #include "third_party/hnswlib/hnswlib.h"
 #include "third_party/hnswlib/iostream.h"
+#include "third_party/hnswlib/space_binary.h"
+#include "third_party/hnswlib/space_half.h"
 #include "vmsdk/src/managed_pointers.h"
 #include "vmsdk/src/valkey_module_api/valkey_module.h"
 
 namespace valkey_search::indexes {
 
-std::vector<char> NormalizeEmbedding(absl::string_view record, size_t type_size,
+std::vector<char> NormalizeEmbedding(absl::string_view record,
+                                     data_model::VectorDataType data_type,
                                      float* magnitude = nullptr);
 
 struct Neighbor {
   InternedStringPtr external_id;
   float distance;
   std::optional<RecordsMap> attribute_contents;
+  // The value of the SORTBY field of a query sorted by a Numeric field.
+  std::optional<double> sort_value;
   Neighbor(const InternedStringPtr& external_id, float distance)
       : external_id(external_id), distance(distance) {}
   Neighbor(const InternedStringPtr& external_id, float distance,
@@ -59,12 +69,14 @@ struct Neighbor {
   Neighbor(Neighbor&& other) noexcept
       : external_id(std::move(other.external_id)),
         distance(other.distance),
-        attribute_contents(std::move(other.attribute_contents)) {}
+        attribute_contents(std::move(other.attribute_contents)),
+        sort_value(other.sort_value) {}
   Neighbor& operator=(Neighbor&& other) noexcept {
     if (this != &other) {
       external_id = std::move(other.external_id);
       distance = other.distance;
       attribute_contents = std::move(other.attribute_contents);
+      sort_value = other.sort_value;
     }
     return *this;
   }
@@ -84,6 +96,7 @@ const absl::NoDestructor<absl::flat_hash_map<
     kVectorAlgoByStr({
         {"HNSW", data_model::VectorIndex::AlgorithmCase::kHnswAlgorithm},
         {"FLAT", data_model::VectorIndex::AlgorithmCase::kFlatAlgorithm},
+        {"IVF", data_model::VectorIndex::AlgorithmCase::kIvfAlgorithm},
     });
 
 const absl::NoDestructor<
@@ -91,11 +104,51 @@ const absl::NoDestructor<
     kDistanceMetricByStr(
         {{"L2", data_model::DistanceMetric::DISTANCE_METRIC_L2},
          {"IP", data_model::DistanceMetric::DISTANCE_METRIC_IP},
-         {"COSINE", data_model::DistanceMetric::DISTANCE_METRIC_COSINE}});
+         {"COSINE", data_model::DistanceMetric::DISTANCE_METRIC_COSINE},
+         {"HAMMING", data_model::DistanceMetric::DISTANCE_METRIC_HAMMING}});
 
 const absl::NoDestructor<
     absl::flat_hash_map<absl::string_view, data_model::VectorDataType>>
-    kVectorDataTypeByStr({{"FLOAT32", data_model::VECTOR_DATA_TYPE_FLOAT32}});
+    kVectorDataTypeByStr(
+        {{"FLOAT32", data_model::VECTOR_DATA_TYPE_FLOAT32},
+         {"FLOAT16", data_model::VECTOR_DATA_TYPE_FLOAT16},
+         {"BFLOAT16", data_model::VECTOR_DATA_TYPE_BFLOAT16},
+         {"BINARY", data_model::VECTOR_DATA_TYPE_BINARY}});
+
+const absl::NoDestructor<
+    absl::flat_hash_map<absl::string_view, data_model::VectorQuantization>>
+    kVectorQuantizationByStr(
+        {{"NONE", data_model::VECTOR_QUANTIZATION_NONE},
+         {"INT8", data_model::VECTOR_QUANTIZATION_INT8},
+         {"INT8_CODES_ONLY", data_model::VECTOR_QUANTIZATION_INT8_CODES_ONLY}});
+
+// Maps the element type a vector index stores to its vector data type.
+template <typename T>
+constexpr data_model::VectorDataType VectorDataTypeOf() {
+  if constexpr (std::is_same_v<T, float>) {
+    return data_model::VECTOR_DATA_TYPE_FLOAT32;
+  } else if constexpr (std::is_same_v<T, hnswlib::float16>) {
+    return data_model::VECTOR_DATA_TYPE_FLOAT16;
+  } else if constexpr (std::is_same_v<T, hnswlib::bfloat16>) {
+    return data_model::VECTOR_DATA_TYPE_BFLOAT16;
+  } else if constexpr (std::is_same_v<T, hnswlib::bit8>) {
+    return data_model::VECTOR_DATA_TYPE_BINARY;
+  } else {
+    static_assert(!sizeof(T), "Unsupported vector element type");
+  }
+}
+
+// Returns the size in bytes of a vector with the given number of dimensions,
+// or 0 if the data type is not supported. BINARY vectors pack eight
+// dimensions per byte.
+size_t GetVectorByteSize(data_model::VectorDataType data_type, int dimensions);
+
+// Merges the results of the sub-tasks of a split exact search into its `k`
+// best matches.
+std::priority_queue<std::pair<float, hnswlib::labeltype>> MergeSearchResults(
+    std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>>&
+        results,
+    uint64_t k);
 
 template <typename V>
 absl::string_view LookupKeyByValue(
@@ -123,7 +176,83 @@ class VectorBase : public IndexBase, public hnswlib::VectorTracker {
                                     absl::string_view record) override
       ABSL_LOCKS_EXCLUDED(key_to_metadata_mutex_);
   virtual size_t GetCapacity() const = 0;
+  // Claims the consolidation of the deleted records once they make up at least
+  // `min_tombstone_ratio` of the index. Returns false if the index does not
+  // keep deleted records around or a consolidation is already pending.
+  virtual bool ClaimConsolidation(double min_tombstone_ratio) { return false; }
+  // Repairs the index around the deleted records of up to `max_records` more
+  // records of a claimed consolidation, ahead of ConsolidateDeletes. Lets the
+  // bulk of the work run in bounded steps. Returns true once all the records
+  // were visited.
+  virtual absl::StatusOr<bool> RepairDeletedLinks(size_t max_records) {
+    return true;
+  }
+  // Repairs the index around the deleted records and releases them. Returns
+  // the number of bytes reclaimed.
+  virtual absl::StatusOr<size_t> ConsolidateDeletes() { return 0; }
+  // Claims the reordering of the index for locality once it grew by at least
+  // `min_growth_ratio` since it was last reordered. Returns false if the index
+  // has no such ordering or a reordering is already pending.
+  virtual bool ClaimReorder(double min_growth_ratio) { return false; }
+  // Renumbers the index elements so that neighbors are stored close together.
+  virtual absl::Status ReorderForLocality() { return absl::OkStatus(); }
+  // ReorderForLocality in two steps. PrepareReorder builds the renumbered
+  // index alongside searches and mutations, then ApplyReorder catches it up
+  // with the records mutated meanwhile and swaps it in.
+  virtual absl::Status PrepareReorder() { return absl::OkStatus(); }
+  virtual absl::Status ApplyReorder() { return absl::OkStatus(); }
+  // Claims the training of the index once it holds enough vectors to train
+  // on. Returns false if the index needs no training, is already trained or a
+  // training is already pending.
+  virtual bool ClaimTraining() { return false; }
+  // Trains the index on a snapshot of its vectors and swaps the result in.
+  virtual absl::Status Train() { return absl::OkStatus(); }
+  // Grows the index ahead of time so that `additional_records` more records
+  // can be added without resizing it.
+  virtual absl::Status ReserveCapacity(size_t additional_records) {
+    return absl::OkStatus();
+  }
+  // Work of a single inline filtered search, as estimated for the query
+  // planner.
+  struct InlineSearchEstimate {
+    // Number of stored vectors the query is compared with.
+    size_t distance_computations{0};
+    // Number of candidates the filter is evaluated for.
+    size_t filter_evaluations{0};
+    // Whether the filter is restrictive enough for the search to traverse the
+    // index around the rejected candidates.
+    bool filtered_traversal{false};
+  };
+  // Estimates the work of an inline filtered search for `k` neighbors, when a
+  // `selectivity` share of the indexed vectors passes the filter.
+  // `search_width` is the EF_RUNTIME or NPROBE of the query, if set.
+  virtual InlineSearchEstimate EstimateInlineSearch(
+      uint64_t k, double selectivity,
+      std::optional<size_t> search_width) const = 0;
   bool GetNormalize() const { return normalize_; }
+  // Returns the query vector normalized the same way as the indexed vectors.
+  std::string NormalizeQuery(absl::string_view query) const;
+  // Returns all the vectors within `radius` of the normalized query, closest
+  // first. Indexes that can't enumerate a radius return an error.
+  virtual absl::StatusOr<std::vector<Neighbor>> SearchRange(
+      absl::string_view query, float radius, cancel::Token& cancellation_token,
+      std::unique_ptr<hnswlib::BaseFilterFunctor> filter = nullptr) {
+    return absl::InvalidArgumentError(
+        "VECTOR_RANGE is only supported by HNSW and FLAT indexes");
+  }
+  // Resolves a range predicate to the keys within its radius, or to the keys
+  // beyond it if negated.
+  std::unique_ptr<EntriesFetcherBase> Search(
+      const query::VectorRangePredicate& predicate, bool negate,
+      cancel::Token& cancellation_token) ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  // Returns the distance between the normalized query and the indexed vector
+  // of the key.
+  absl::StatusOr<float> ComputeDistance(absl::string_view query,
+                                        const InternedStringPtr& key) const;
+  // Returns the distance between the normalized query and a record of the
+  // attribute as stored in the keyspace.
+  absl::StatusOr<float> ComputeDistance(absl::string_view query,
+                                        vmsdk::UniqueValkeyString record) const;
   std::unique_ptr<data_model::Index> ToProto() const override;
   absl::Status SaveIndex(RDBChunkOutputStream chunked_out) const override;
   absl::Status SaveTrackedKeys(RDBChunkOutputStream chunked_out) const
@@ -154,41 +283,76 @@ class VectorBase : public IndexBase, public hnswlib::VectorTracker {
       absl::flat_hash_set<const char*>& top_keys) const;
   vmsdk::UniqueValkeyString NormalizeStringRecord(
       vmsdk::UniqueValkeyString record) const override;
+  // Converts search results to neighbors, closest first. Keys with several
+  // vectors only keep their closest one, and at most `count` keys are kept.
   template <typename T>
   absl::StatusOr<std::vector<Neighbor>> CreateReply(
-      std::priority_queue<std::pair<T, hnswlib::labeltype>>& knn_res);
+      std::priority_queue<std::pair<T, hnswlib::labeltype>>& knn_res,
+      uint64_t count = std::numeric_limits<uint64_t>::max());
+  // Returns the number of vectors a search for the `count` nearest keys starts
+  // with. While keys with several vectors are indexed, a few of them may take
+  // up most of the nearest vectors, so it fetches more.
+  uint64_t GetSearchCount(uint64_t count) const;
+  // Returns the number of vectors to search again for, when a search for
+  // `search_count` vectors found `found` of them and `key_count` of the
+  // `count` nearest keys. Returns nullopt if a wider search finds no more.
+  std::optional<uint64_t> WidenSearchCount(uint64_t count,
+                                           uint64_t search_count, size_t found,
+                                           size_t key_count) const;
+  // Searches for the `count` nearest keys with `search`, which returns the
+  // given number of nearest vectors, widening it as needed.
+  absl::StatusOr<std::vector<Neighbor>> SearchKeys(
+      uint64_t count,
+      absl::FunctionRef<absl::StatusOr<
+          std::priority_queue<std::pair<float, hnswlib::labeltype>>>(uint64_t)>
+          search);
   absl::StatusOr<std::vector<char>> GetValue(const InternedStringPtr& key) const
       ABSL_NO_THREAD_SAFETY_ANALYSIS;
-  int GetVectorDataSize() const { return GetDataTypeSize() * dimensions_; }
+  int GetVectorDataSize() const {
+    return GetVectorByteSize(data_type_, dimensions_);
+  }
+  data_model::VectorDataType GetDataType() const { return data_type_; }
+  // Returns the internal id of the first vector of the key. The key's vectors
+  // have consecutive internal ids, `vector_count` of them.
+  absl::StatusOr<uint64_t> GetInternalIdDuringSearch(
+      const InternedStringPtr& key, uint32_t* vector_count = nullptr) const
+      ABSL_NO_THREAD_SAFETY_ANALYSIS;
   char* TrackVector(uint64_t internal_id, char* vector, size_t len) override;
   InternedStringPtr InternVector(absl::string_view record,
                                  std::optional<float>& magnitude);
 
  protected:
   VectorBase(IndexerType indexer_type, int dimensions,
+             data_model::VectorDataType data_type,
              data_model::AttributeDataType attribute_data_type,
              absl::string_view attribute_identifier)
       : IndexBase(indexer_type),
         dimensions_(dimensions),
         attribute_identifier_(attribute_identifier),
-        attribute_data_type_(attribute_data_type)
+        attribute_data_type_(attribute_data_type),
+        data_type_(data_type)
 #ifndef SAN_BUILD
         ,
         vector_allocator_(CREATE_UNIQUE_PTR(
-            FixedSizeAllocator, dimensions * sizeof(float) + 1, true))
+            FixedSizeAllocator,
+            GetVectorByteSize(data_type, dimensions) + 1, true))
 #endif  // !SAN_BUILD
   {
   }
 
-  bool IsValidSizeVector(absl::string_view record) {
-    const auto data_type_size = GetDataTypeSize();
-    int32_t dim = record.size() / GetDataTypeSize();
-    return dim == dimensions_ && (record.size() % data_type_size == 0);
+  bool IsValidSizeVector(absl::string_view record) const {
+    return record.size() == static_cast<size_t>(GetVectorDataSize());
   }
+  // Returns the number of vectors in a record, or 0 if it is not valid. JSON
+  // records hold several vectors when their path matches several arrays, e.g.
+  // `$.chunks[*].embedding`.
+  size_t GetRecordVectorCount(absl::string_view record) const;
   int RespondWithInfo(ValkeyModuleCtx* ctx) const override;
+  // T is the element type the vectors are stored as. Distances are always
+  // computed as float, regardless of the element type.
   template <typename T>
   void Init(int dimensions, data_model::DistanceMetric distance_metric,
-            std::unique_ptr<hnswlib::SpaceInterface<T>>& space);
+            std::unique_ptr<hnswlib::SpaceInterface<float>>& space);
   virtual absl::Status AddRecordImpl(uint64_t internal_id,
                                      absl::string_view record) = 0;
 
@@ -206,13 +370,17 @@ class VectorBase : public IndexBase, public hnswlib::VectorTracker {
                          const AttributeDataType* attribute_data_type,
                          absl::string_view key_cstr,
                          absl::string_view attribute_identifier);
+  // Returns null when the index does not keep the vector of the record.
   virtual char* GetValueImpl(uint64_t internal_id) const = 0;
 
   int dimensions_;
   std::string attribute_identifier_;
   bool normalize_{false};
   data_model::AttributeDataType attribute_data_type_;
+  data_model::VectorDataType data_type_;
   data_model::DistanceMetric distance_metric_;
+  // The full precision space the index was initialized with.
+  hnswlib::SpaceInterface<float>* distance_space_{nullptr};
   virtual absl::StatusOr<std::pair<float, hnswlib::labeltype>>
   ComputeDistanceFromRecordImpl(uint64_t internal_id,
                                 absl::string_view query) const = 0;
@@ -223,38 +391,48 @@ class VectorBase : public IndexBase, public hnswlib::VectorTracker {
   virtual void UnTrackVector(uint64_t internal_id) = 0;
 
  private:
-  absl::StatusOr<uint64_t> TrackKey(const InternedStringPtr& key,
-                                    float magnitude,
-                                    const InternedStringPtr& vector)
+  struct TrackedKeyMetadata {
+    uint64_t internal_id;
+    // If normalize_ is false, this will be -1.0f. Otherwise, it will be the
+    // magnitude of the vector. If the magnitude is not initialized, it will be
+    // -inf (this is an intermediate state during backfill when transitioning
+    // from the old RDB format that didn't include magnitudes).
+    float magnitude;
+    // Number of vectors of the key, with consecutive internal ids from
+    // internal_id.
+    uint32_t vector_count{1};
+  };
+
+  absl::StatusOr<uint64_t> TrackKey(
+      const InternedStringPtr& key, float magnitude,
+      const std::vector<InternedStringPtr>& vectors)
       ABSL_LOCKS_EXCLUDED(key_to_metadata_mutex_);
-  absl::StatusOr<std::optional<uint64_t>> UnTrackKey(
+  absl::StatusOr<std::optional<TrackedKeyMetadata>> UnTrackKey(
       const InternedStringPtr& key) ABSL_LOCKS_EXCLUDED(key_to_metadata_mutex_);
   absl::StatusOr<bool> UpdateMetadata(const InternedStringPtr& key,
                                       float magnitude,
                                       const InternedStringPtr& vector)
       ABSL_LOCKS_EXCLUDED(key_to_metadata_mutex_);
-  absl::StatusOr<uint64_t> GetInternalId(const InternedStringPtr& key) const
+  absl::StatusOr<uint64_t> GetInternalId(const InternedStringPtr& key,
+                                         uint32_t* vector_count = nullptr) const
       ABSL_LOCKS_EXCLUDED(key_to_metadata_mutex_);
-  absl::StatusOr<uint64_t> GetInternalIdDuringSearch(
-      const InternedStringPtr& key) const ABSL_NO_THREAD_SAFETY_ANALYSIS;
   absl::flat_hash_map<uint64_t, InternedStringPtr> key_by_internal_id_
       ABSL_GUARDED_BY(key_to_metadata_mutex_);
-  struct TrackedKeyMetadata {
-    uint64_t internal_id;
-    // If normalize_ is false, this will be -1.0f. Otherwise, it will be the
-    // magnitude of the vector. If the magnitude is not initialized, it will be
-    // -inf (this is an intermediate state during backfill when transitioning
-    // from the old RDB format that didn't include magnitudes).
-    float magnitude;
-  };
 
   InternedStringHashMap<TrackedKeyMetadata> tracked_metadata_by_key_
       ABSL_GUARDED_BY(key_to_metadata_mutex_);
   uint64_t inc_id_ ABSL_GUARDED_BY(key_to_metadata_mutex_){0};
   mutable absl::Mutex key_to_metadata_mutex_;
+  // Number of tracked keys with several vectors, whose searches must drop
+  // the other vectors of a key.
+  std::atomic<size_t> multi_vector_key_count_{0};
   absl::StatusOr<std::pair<float, hnswlib::labeltype>>
   ComputeDistanceFromRecord(const InternedStringPtr& key,
                             absl::string_view query) const;
+  // Returns the closest of the `vector_count` vectors from `internal_id`.
+  absl::StatusOr<std::pair<float, hnswlib::labeltype>> ComputeMinDistance(
+      uint64_t internal_id, uint32_t vector_count,
+      absl::string_view query) const;
   UniqueFixedSizeAllocatorPtr vector_allocator_{nullptr, nullptr};
 };
 
@@ -276,6 +454,8 @@ class PrefilterEvaluator : public query::Evaluator {
       const query::TagPredicate& predicate) override;
   query::EvaluationResult EvaluateNumeric(
       const query::NumericPredicate& predicate) override;
+  query::EvaluationResult EvaluateVectorRange(
+      const query::VectorRangePredicate& predicate) override;
   query::EvaluationResult EvaluateText(const query::TextPredicate& predicate,
                                        bool require_positions) override;
   const valkey_search::indexes::text::TextIndex* text_index_;
@@ -15,11 +15,13 @@
 #include <exception>
 #include <memory>
 #include <mutex>  // NOLINT(build/c++11)
+#include <optional>
 #include <queue>
 #include <string>
 #include <string_view>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/status/status.h"
@@ -35,8 +37,11 @@
 #include "src/rdb_serialization.h"
 #include "src/utils/cancel.h"
 #include "src/utils/string_interning.h"
+#include "src/valkey_search.h"
+#include "src/valkey_search_options.h"
 #include "vmsdk/src/log.h"
 #include "vmsdk/src/status/status_macros.h"
+#include "vmsdk/src/thread_pool.h"
 #include "vmsdk/src/valkey_module_api/valkey_module.h"
 
 // Note that the ordering matters here - we want to minimize the memory
@@ -60,9 +65,10 @@ absl::StatusOr<std::shared_ptr<VectorFlat<T>>> VectorFlat<T>::Create(
                           vector_index_proto.distance_metric(),
                           vector_index_proto.flat_algorithm().block_size(),
                           attribute_identifier, attribute_data_type));
-    index->Init(vector_index_proto.dimension_count(),
-                vector_index_proto.distance_metric(), index->space_);
-    index->algo_ = std::make_unique<hnswlib::BruteforceSearch<T>>(
+    index->template Init<T>(vector_index_proto.dimension_count(),
+                            vector_index_proto.distance_metric(),
+                            index->space_);
+    index->algo_ = std::make_unique<hnswlib::BruteforceSearch<float>>(
         index->space_.get(), vector_index_proto.initial_cap());
     return index;
   } catch (const std::exception &e) {
@@ -72,28 +78,17 @@ absl::StatusOr<std::shared_ptr<VectorFlat<T>>> VectorFlat<T>::Create(
   }
 }
 
-template <typename T>
-void VectorFlat<T>::TrackVector(uint64_t internal_id,
-                                const InternedStringPtr &vector) {
-  absl::MutexLock lock(&tracked_vectors_mutex_);
-  tracked_vectors_[internal_id] = vector;
-}
-
 template <typename T>
 bool VectorFlat<T>::IsVectorMatch(uint64_t internal_id,
                                   const InternedStringPtr &vector) {
-  absl::MutexLock lock(&tracked_vectors_mutex_);
-  auto it = tracked_vectors_.find(internal_id);
-  if (it == tracked_vectors_.end()) {
+  absl::ReaderMutexLock lock(&resize_mutex_);
+  // Removals of other records may move the stored vector.
+  std::unique_lock<std::mutex> index_lock(algo_->index_lock);
+  const char *stored = algo_->getPoint(internal_id);
+  if (stored == nullptr) {
     return false;
   }
-  return it->second->Str() == vector->Str();
-}
-
-template <typename T>
-void VectorFlat<T>::UnTrackVector(uint64_t internal_id) {
-  absl::MutexLock lock(&tracked_vectors_mutex_);
-  tracked_vectors_.erase(internal_id);
+  return absl::string_view(stored, algo_->vector_size_) == vector->Str();
 }
 
 template <typename T>
@@ -108,13 +103,14 @@ absl::StatusOr<std::shared_ptr<VectorFlat<T>>> VectorFlat<T>::LoadFromRDB(
         vector_index_proto.distance_metric(),
         vector_index_proto.flat_algorithm().block_size(), attribute_identifier,
         attribute_data_type->ToProto()));
-    index->Init(vector_index_proto.dimension_count(),
-                vector_index_proto.distance_metric(), index->space_);
-    index->algo_ =
-        std::make_unique<hnswlib::BruteforceSearch<T>>(index->space_.get());
+    index->template Init<T>(vector_index_proto.dimension_count(),
+                            vector_index_proto.distance_metric(),
+                            index->space_);
+    index->algo_ = std::make_unique<hnswlib::BruteforceSearch<float>>(
+        index->space_.get());
     RDBChunkInputStream input(std::move(iter));
     VMSDK_RETURN_IF_ERROR(
-        index->algo_->LoadIndex(input, index->space_.get(), index.get()));
+        index->algo_->LoadIndex(input, index->space_.get()));
     return index;
   } catch (const std::exception &e) {
     ++Metrics::GetStats().flat_create_exceptions_cnt;
@@ -128,8 +124,8 @@ VectorFlat<T>::VectorFlat(
     int dimensions, valkey_search::data_model::DistanceMetric distance_metric,
     uint32_t block_size, absl::string_view attribute_identifier,
     data_model::AttributeDataType attribute_data_type)
-    : VectorBase(IndexerType::kFlat, dimensions, attribute_data_type,
-                 attribute_identifier),
+    : VectorBase(IndexerType::kFlat, dimensions, VectorDataTypeOf<T>(),
+                 attribute_data_type, attribute_identifier),
       block_size_(block_size) {}
 
 template <typename T>
@@ -186,9 +182,8 @@ absl::Status VectorFlat<T>::ModifyRecordImpl(uint64_t internal_id,
         absl::StrCat("Couldn't find internal id: ", internal_id));
   }
 
-  memcpy((*algo_->data_)[found->second] + algo_->data_ptr_size_, &internal_id,
-         sizeof(hnswlib::labeltype));
-  *(char **)((*algo_->data_)[found->second]) = (char *)record.data();
+  memcpy(algo_->getVectorByIndex(found->second), record.data(),
+         algo_->vector_size_);
 
   return absl::OkStatus();
 }
@@ -226,36 +221,150 @@ absl::StatusOr<std::vector<Neighbor>> VectorFlat<T>::Search(
     return absl::InvalidArgumentError(absl::StrCat(
         "Error parsing vector similarity query: query vector blob size (",
         query.size(), ") does not match index's expected size (",
-        dimensions_ * GetDataTypeSize(), ")."));
+        GetVectorDataSize(), ")."));
   }
-  auto perform_search = [this, count, &filter,
-                         &cancellation_token](absl::string_view query)
-      -> absl::StatusOr<std::priority_queue<std::pair<T, hnswlib::labeltype>>> {
+  auto perform_search = [this, &filter, &cancellation_token](
+                            absl::string_view query, uint64_t search_count)
+      -> absl::StatusOr<
+          std::priority_queue<std::pair<float, hnswlib::labeltype>>> {
     absl::ReaderMutexLock lock(&resize_mutex_);
     try {
-      CancelCondition canceler(cancellation_token);
-      return algo_->searchKnn(
-          (T *)query.data(),
-          std::min(count, static_cast<uint64_t>(algo_->cur_element_count_)),
-          filter.get(), &canceler);
+      size_t element_count = algo_->cur_element_count_;
+      uint64_t k =
+          std::min(search_count, static_cast<uint64_t>(element_count));
+      size_t range_size = options::GetExactSearchRangeSize().GetValue();
+      if (range_size == 0 || element_count <= range_size) {
+        CancelCondition canceler(cancellation_token);
+        return algo_->searchKnn((T *)query.data(), k, filter.get(), &canceler);
+      }
+      // Large scans are split into ranges scanned on the reader threads. The
+      // sub-tasks run while this thread holds the lock and waits for them.
+      size_t num_ranges = (element_count + range_size - 1) / range_size;
+      std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>>
+          range_results(num_ranges);
+      vmsdk::RunInParallel(
+          ValkeySearch::Instance().GetReaderThreadPool(), num_ranges,
+          [&](size_t range) ABSL_NO_THREAD_SAFETY_ANALYSIS {
+            CancelCondition canceler(cancellation_token);
+            range_results[range] = algo_->searchKnnRange(
+                (T *)query.data(), k, range * range_size,
+                (range + 1) * range_size, filter.get(), &canceler);
+          });
+      return MergeSearchResults(range_results, k);
     } catch (const std::exception &e) {
       Metrics::GetStats().flat_search_exceptions_cnt.fetch_add(
           1, std::memory_order_relaxed);
       return absl::InternalError(e.what());
     }
   };
+  std::vector<char> norm_record;
   if (normalize_) {
-    auto norm_record = NormalizeEmbedding(query, GetDataTypeSize());
-    VMSDK_ASSIGN_OR_RETURN(
-        auto search_result,
-        perform_search(absl::string_view((const char *)norm_record.data(),
-                                         norm_record.size())));
-    return CreateReply(search_result);
+    norm_record = NormalizeEmbedding(query, data_type_);
+    query = absl::string_view(norm_record.data(), norm_record.size());
+  }
+  return SearchKeys(count, [&](uint64_t search_count) {
+    return perform_search(query, search_count);
+  });
+}
+
+template <typename T>
+VectorBase::InlineSearchEstimate VectorFlat<T>::EstimateInlineSearch(
+    uint64_t k, double selectivity, std::optional<size_t> search_width) const {
+  absl::ReaderMutexLock lock(&resize_mutex_);
+  // The scan scores every vector, and filters the ones closer than the k-th
+  // best match so far, which is every vector until k of them passed.
+  size_t element_count = algo_->cur_element_count_;
+  return {element_count, element_count};
+}
+
+template <typename T>
+absl::StatusOr<std::vector<Neighbor>> VectorFlat<T>::SearchRange(
+    absl::string_view query, float radius, cancel::Token &cancellation_token,
+    std::unique_ptr<hnswlib::BaseFilterFunctor> filter) {
+  if (!IsValidSizeVector(query)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Error parsing vector range query: query vector blob size (",
+        query.size(), ") does not match index's expected size (",
+        GetVectorDataSize(), ")."));
+  }
+  std::priority_queue<std::pair<float, hnswlib::labeltype>> search_result;
+  {
+    absl::ReaderMutexLock lock(&resize_mutex_);
+    try {
+      CancelCondition canceler(cancellation_token);
+      search_result = algo_->searchRange((T *)query.data(), radius,
+                                         filter.get(), &canceler);
+    } catch (const std::exception &e) {
+      Metrics::GetStats().flat_search_exceptions_cnt.fetch_add(
+          1, std::memory_order_relaxed);
+      return absl::InternalError(e.what());
+    }
   }
-  VMSDK_ASSIGN_OR_RETURN(auto search_result, perform_search(query));
   return CreateReply(search_result);
 }
 
+template <typename T>
+absl::StatusOr<std::vector<std::vector<Neighbor>>> VectorFlat<T>::SearchBatch(
+    const std::vector<absl::string_view> &queries, uint64_t count,
+    cancel::Token &cancellation_token,
+    std::unique_ptr<hnswlib::BaseFilterFunctor> filter) {
+  std::vector<std::vector<char>> norm_records;
+  norm_records.reserve(normalize_ ? queries.size() : 0);
+  std::vector<const void *> query_data;
+  query_data.reserve(queries.size());
+  for (const auto &query : queries) {
+    if (!IsValidSizeVector(query)) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Error parsing vector similarity query: query vector blob size (",
+          query.size(), ") does not match index's expected size (",
+          GetVectorDataSize(), ")."));
+    }
+    if (normalize_) {
+      norm_records.push_back(NormalizeEmbedding(query, data_type_));
+      query_data.push_back(norm_records.back().data());
+    } else {
+      query_data.push_back(query.data());
+    }
+  }
+  // The whole batch is searched again in the rare case that keys with
+  // several vectors leave a query short of `count` keys.
+  for (uint64_t search_count = GetSearchCount(count);;) {
+    std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>>
+        search_results;
+    {
+      absl::ReaderMutexLock lock(&resize_mutex_);
+      try {
+        CancelCondition canceler(cancellation_token);
+        search_results = algo_->searchKnnBatch(
+            query_data,
+            std::min(search_count,
+                     static_cast<uint64_t>(algo_->cur_element_count_)),
+            filter.get(), &canceler);
+      } catch (const std::exception &e) {
+        Metrics::GetStats().flat_search_exceptions_cnt.fetch_add(
+            1, std::memory_order_relaxed);
+        return absl::InternalError(e.what());
+      }
+    }
+    std::vector<std::vector<Neighbor>> replies;
+    replies.reserve(search_results.size());
+    std::optional<uint64_t> wider_search_count;
+    for (auto &search_result : search_results) {
+      const size_t found = search_result.size();
+      VMSDK_ASSIGN_OR_RETURN(auto reply, CreateReply(search_result, count));
+      if (!wider_search_count) {
+        wider_search_count =
+            WidenSearchCount(count, search_count, found, reply.size());
+      }
+      replies.push_back(std::move(reply));
+    }
+    if (!wider_search_count) {
+      return replies;
+    }
+    search_count = *wider_search_count;
+  }
+}
+
 template <typename T>
 absl::StatusOr<std::pair<float, hnswlib::labeltype>>
 VectorFlat<T>::ComputeDistanceFromRecordImpl(uint64_t internal_id,
@@ -268,7 +377,7 @@ VectorFlat<T>::ComputeDistanceFromRecordImpl(uint64_t internal_id,
   }
   return (std::pair<float, hnswlib::labeltype>){
       algo_->fstdistfunc_((T *)query.data(),
-                          *(char **)(*algo_->data_)[search->second],
+                          algo_->getVectorByIndex(search->second),
                           algo_->dist_func_param_),
       internal_id};
 }
@@ -276,14 +385,7 @@ VectorFlat<T>::ComputeDistanceFromRecordImpl(uint64_t internal_id,
 template <typename T>
 void VectorFlat<T>::ToProtoImpl(
     data_model::VectorIndex *vector_index_proto) const {
-  data_model::VectorDataType data_type;
-  if constexpr (std::is_same_v<T, float>) {
-    data_type = data_model::VectorDataType::VECTOR_DATA_TYPE_FLOAT32;
-  } else {
-    DCHECK(false) << "Unsupported type: " << typeid(T).name();
-    data_type = data_model::VectorDataType::VECTOR_DATA_TYPE_UNSPECIFIED;
-  }
-  vector_index_proto->set_vector_data_type(data_type);
+  vector_index_proto->set_vector_data_type(data_type_);
 
   auto flat_algorithm_proto = std::make_unique<data_model::FlatAlgorithm>();
   flat_algorithm_proto->set_block_size(block_size_);
@@ -300,15 +402,8 @@ int VectorFlat<T>::RespondWithInfoImpl(ValkeyModuleCtx *ctx) const {
                        data_model::VectorIndex::AlgorithmCase::kFlatAlgorithm)
           .data());
   ValkeyModule_ReplyWithSimpleString(ctx, "data_type");
-  if constexpr (std::is_same_v<T, float>) {
-    ValkeyModule_ReplyWithSimpleString(
-        ctx,
-        LookupKeyByValue(*kVectorDataTypeByStr,
-                         data_model::VectorDataType::VECTOR_DATA_TYPE_FLOAT32)
-            .data());
-  } else {
-    ValkeyModule_ReplyWithSimpleString(ctx, "UNKNOWN");
-  }
+  ValkeyModule_ReplyWithSimpleString(
+      ctx, LookupKeyByValue(*kVectorDataTypeByStr, data_type_).data());
   ValkeyModule_ReplyWithSimpleString(ctx, "dim");
   ValkeyModule_ReplyWithLongLong(ctx, dimensions_);
   ValkeyModule_ReplyWithSimpleString(ctx, "distance_metric");
@@ -329,5 +424,8 @@ absl::Status VectorFlat<T>::SaveIndexImpl(
 }
 
 template class VectorFlat<float>;
+template class VectorFlat<hnswlib::float16>;
+template class VectorFlat<hnswlib::bfloat16>;
+template class VectorFlat<hnswlib::bit8>;
 
 }  // namespace valkey_search::indexes
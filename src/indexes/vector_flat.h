@@ -13,9 +13,9 @@
 #include <deque>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
-#include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
@@ -61,6 +61,21 @@ class VectorFlat : public VectorBase {
       cancel::Token& cancellation_token,
       std::unique_ptr<hnswlib::BaseFilterFunctor> filter = nullptr)
       ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  // Answers a batch of queries with one blocked scan over the index, see
+  // hnswlib::BruteforceSearch::searchKnnBatch. Results are in query order.
+  absl::StatusOr<std::vector<std::vector<Neighbor>>> SearchBatch(
+      const std::vector<absl::string_view>& queries, uint64_t count,
+      cancel::Token& cancellation_token,
+      std::unique_ptr<hnswlib::BaseFilterFunctor> filter = nullptr)
+      ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  absl::StatusOr<std::vector<Neighbor>> SearchRange(
+      absl::string_view query, float radius, cancel::Token& cancellation_token,
+      std::unique_ptr<hnswlib::BaseFilterFunctor> filter = nullptr) override
+      ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  InlineSearchEstimate EstimateInlineSearch(
+      uint64_t k, double selectivity,
+      std::optional<size_t> search_width) const override
+      ABSL_LOCKS_EXCLUDED(resize_mutex_);
 
  protected:
   absl::Status ResizeIfFull() ABSL_LOCKS_EXCLUDED(resize_mutex_);
@@ -82,27 +97,24 @@ class VectorFlat : public VectorBase {
       ABSL_NO_THREAD_SAFETY_ANALYSIS {
     return algo_->getPoint(internal_id);
   }
+  // The vectors are only stored in the contiguous blocks of algo_, the
+  // interned copies are not kept around.
   void TrackVector(uint64_t internal_id,
-                   const InternedStringPtr& vector) override
-      ABSL_LOCKS_EXCLUDED(tracked_vectors_mutex_);
+                   const InternedStringPtr& vector) override {}
   bool IsVectorMatch(uint64_t internal_id,
                      const InternedStringPtr& vector) override
-      ABSL_LOCKS_EXCLUDED(tracked_vectors_mutex_);
-  void UnTrackVector(uint64_t internal_id) override
-      ABSL_LOCKS_EXCLUDED(tracked_vectors_mutex_);
+      ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  void UnTrackVector(uint64_t internal_id) override {}
 
  private:
   VectorFlat(int dimensions, data_model::DistanceMetric distance_metric,
              uint32_t block_size, absl::string_view attribute_identifier,
              data_model::AttributeDataType attribute_data_type);
-  std::unique_ptr<hnswlib::BruteforceSearch<T>> algo_
+  std::unique_ptr<hnswlib::BruteforceSearch<float>> algo_
       ABSL_GUARDED_BY(resize_mutex_);
-  std::unique_ptr<hnswlib::SpaceInterface<T>> space_;
+  std::unique_ptr<hnswlib::SpaceInterface<float>> space_;
   uint32_t block_size_;
   mutable absl::Mutex resize_mutex_;
-  mutable absl::Mutex tracked_vectors_mutex_;
-  absl::flat_hash_map<uint64_t, InternedStringPtr> tracked_vectors_
-      ABSL_GUARDED_BY(tracked_vectors_mutex_);
 };
 }  // namespace valkey_search::indexes
 
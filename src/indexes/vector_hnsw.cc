@@ -7,11 +7,13 @@
 
 #include "src/indexes/vector_hnsw.h"
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
-#include <deque>
 #include <exception>
+#include <limits>
 #include <memory>
 #include <mutex>  // NOLINT(build/c++11)
 #include <optional>
@@ -19,8 +21,11 @@
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -34,11 +39,13 @@
 #include "src/indexes/vector_base.h"
 #include "src/metrics.h"
 #include "src/rdb_serialization.h"
+#include "src/utils/cancel.h"
 #include "src/utils/string_interning.h"
 #include "src/valkey_search.h"
 #include "valkey_search_options.h"
 #include "vmsdk/src/log.h"
 #include "vmsdk/src/status/status_macros.h"
+#include "vmsdk/src/thread_pool.h"
 #include "vmsdk/src/utils.h"
 #include "vmsdk/src/valkey_module_api/valkey_module.h"
 
@@ -79,26 +86,74 @@ std::optional<hnswlib::tableint> GetInternalIdDuringSearch(
 
 namespace valkey_search::indexes {
 
+// Below this many neighbors passing the filter per element on average, the
+// filtered subgraph is poorly connected and a filtered search switches to the
+// filtered traversal of HierarchicalNSW::searchKnnFiltered.
+constexpr double kFilteredTraversalMinPassingNeighbors = 8;
+
+// Smaller graphs stay in the CPU caches whatever the order of their elements,
+// so they are not reordered automatically.
+constexpr size_t kMinReorderElements = 1000;
+// A reordering copies the graph this many elements per hold of the resize
+// lock, which a resize then waits for at most.
+constexpr size_t kReorderStepElements = 10000;
+// The elements mutated while copying are copied again in at most this many
+// rounds, until no more than kReorderCatchUpElements are left to copy while
+// swapping the copies in.
+constexpr size_t kMaxReorderCatchUpRounds = 4;
+constexpr size_t kReorderCatchUpElements = 1024;
+
+// The quantization ranges of an INT8 index are fit to its first vectors,
+// which bounds the re-encoding of the graph as they widen. Later vectors out
+// of the ranges are clamped.
+constexpr size_t kQuantizationSampleSize = 1000;
+
+// The level generator seed of the first graph, the default of hnswlib. The
+// other graphs of a sharded index use the following seeds.
+constexpr size_t kShardRandomSeed = 100;
+
+namespace {
+// Indexes created before sharding have no shard count.
+size_t NumShards(const data_model::HNSWAlgorithm &hnsw_proto) {
+  return std::max<size_t>(hnsw_proto.shards(), 1);
+}
+}  // namespace
+
 template <typename T>
 absl::StatusOr<std::shared_ptr<VectorHNSW<T>>> VectorHNSW<T>::Create(
     const data_model::VectorIndex &vector_index_proto,
     absl::string_view attribute_identifier,
     data_model::AttributeDataType attribute_data_type) {
+  if (std::is_same_v<T, hnswlib::bit8> &&
+      (vector_index_proto.hnsw_algorithm().quantization() !=
+           data_model::VECTOR_QUANTIZATION_NONE ||
+       vector_index_proto.hnsw_algorithm().graph_dimensions() != 0)) {
+    return absl::InvalidArgumentError("BINARY vectors cannot be quantized");
+  }
   try {
     auto index = std::shared_ptr<VectorHNSW<T>>(
         new VectorHNSW<T>(vector_index_proto.dimension_count(),
                           attribute_identifier, attribute_data_type));
-    index->Init(vector_index_proto.dimension_count(),
-                vector_index_proto.distance_metric(), index->space_);
+    index->template Init<T>(vector_index_proto.dimension_count(),
+                            vector_index_proto.distance_metric(),
+                            index->space_);
     const auto &hnsw_proto = vector_index_proto.hnsw_algorithm();
-    index->algo_ = std::make_unique<hnswlib::HierarchicalNSW<T>>(
-        index->space_.get(), vector_index_proto.initial_cap(), hnsw_proto.m(),
-        hnsw_proto.ef_construction());
-    index->algo_->setEf(hnsw_proto.ef_runtime());
-    // Notes:
-    // 1. Not allowing replace delete is aligned with RediSearch
-    // 2. Consider making allow_replace_deleted_ configurable
-    index->algo_->allow_replace_deleted_ = false;
+    size_t num_shards = NumShards(hnsw_proto);
+    // The initial capacity is split evenly across the graphs.
+    size_t shard_initial_cap =
+        (vector_index_proto.initial_cap() + num_shards - 1) / num_shards;
+    for (size_t i = 0; i < num_shards; ++i) {
+      auto shard = std::make_unique<hnswlib::HierarchicalNSW<float>>(
+          index->space_.get(), shard_initial_cap, hnsw_proto.m(),
+          hnsw_proto.ef_construction(), kShardRandomSeed + i);
+      shard->setEf(hnsw_proto.ef_runtime());
+      // Notes:
+      // 1. Not allowing replace delete is aligned with RediSearch
+      // 2. Consider making allow_replace_deleted_ configurable
+      shard->allow_replace_deleted_ = false;
+      index->shards_.push_back(std::move(shard));
+    }
+    index->InitQuantization(hnsw_proto);
     return index;
   } catch (const std::exception &e) {
     ++Metrics::GetStats().hnsw_create_exceptions_cnt;
@@ -111,7 +166,16 @@ template <typename T>
 void VectorHNSW<T>::TrackVector(uint64_t internal_id,
                                 const InternedStringPtr &vector) {
   absl::MutexLock lock(&tracked_vectors_mutex_);
-  tracked_vectors_.push_back(vector);
+  if (!track_vectors_) {
+    return;
+  }
+  auto [it, inserted] = tracked_vectors_.try_emplace(internal_id, vector);
+  if (!inserted) {
+    // The graph element keeps pointing at the previous vector until it is
+    // updated.
+    retired_vectors_.push_back(std::move(it->second));
+    it->second = vector;
+  }
 }
 
 template <typename T>
@@ -119,22 +183,38 @@ bool VectorHNSW<T>::IsVectorMatch(uint64_t internal_id,
                                   const InternedStringPtr &vector) {
   absl::ReaderMutexLock lock(&resize_mutex_);
   {
+    auto &shard = GetShard(internal_id);
     std::unique_lock<std::mutex> lock_label(
-        algo_->getLabelOpMutex(internal_id));
-    auto id = hnswlib_helpers::GetInternalId(algo_.get(), internal_id);
+        shard.getLabelOpMutex(internal_id));
+    auto id = hnswlib_helpers::GetInternalId(&shard, internal_id);
     if (!id.has_value()) {
       return false;
     }
-    char *data_ptrv = algo_->getDataByInternalId(*id);
-    size_t dim = *((size_t *)algo_->dist_func_param_);
-    absl::string_view record(data_ptrv, dim * sizeof(T));
+    if (!shard.keep_vectors_) {
+      // A vector encoding to the same code changes nothing in the graph.
+      std::string code(code_space_->get_data_size(), '\0');
+      quantizer_->encode(vector->Str().data(), code.data());
+      return code == absl::string_view(shard.getDataByInternalId(*id),
+                                       code.size());
+    }
+    char *data_ptrv = shard.getVectorByInternalId(*id);
+    absl::string_view record(data_ptrv, GetVectorDataSize());
     return vector->Str() == record;
   }
 }
-// UnTrackVector does not delete the vector in VectorHNSW, as vectors are never
-// physically removed from the graph—only marked as deleted.
+// UnTrackVector does not release the vector in VectorHNSW, as the graph element
+// is only marked as deleted. The vector is retired until ConsolidateDeletes
+// physically removes the element.
 template <typename T>
-void VectorHNSW<T>::UnTrackVector(uint64_t internal_id) {}
+void VectorHNSW<T>::UnTrackVector(uint64_t internal_id) {
+  absl::MutexLock lock(&tracked_vectors_mutex_);
+  auto it = tracked_vectors_.find(internal_id);
+  if (it == tracked_vectors_.end()) {
+    return;
+  }
+  retired_vectors_.push_back(std::move(it->second));
+  tracked_vectors_.erase(it);
+}
 
 template <typename T>
 absl::StatusOr<std::shared_ptr<VectorHNSW<T>>> VectorHNSW<T>::LoadFromRDB(
@@ -146,24 +226,57 @@ absl::StatusOr<std::shared_ptr<VectorHNSW<T>>> VectorHNSW<T>::LoadFromRDB(
     auto index = std::shared_ptr<VectorHNSW<T>>(new VectorHNSW<T>(
         vector_index_proto.dimension_count(), attribute_identifier,
         attribute_data_type->ToProto()));
-    index->Init(vector_index_proto.dimension_count(),
-                vector_index_proto.distance_metric(), index->space_);
+    index->template Init<T>(vector_index_proto.dimension_count(),
+                            vector_index_proto.distance_metric(),
+                            index->space_);
 
-    index->algo_ =
-        std::make_unique<hnswlib::HierarchicalNSW<T>>(index->space_.get());
+    const auto &hnsw_proto = vector_index_proto.hnsw_algorithm();
+    size_t num_shards = NumShards(hnsw_proto);
+    for (size_t i = 0; i < num_shards; ++i) {
+      index->shards_.push_back(
+          std::make_unique<hnswlib::HierarchicalNSW<float>>(
+              index->space_.get()));
+    }
+    index->InitQuantization(hnsw_proto);
+    RDBChunkInputStream input(std::move(iter));
+    if (index->IsQuantized()) {
+      VMSDK_ASSIGN_OR_RETURN(auto serialized_params, input.LoadChunk());
+      hnswlib::data_model::SQ8Params params;
+      if (!params.ParseFromString(*serialized_params) ||
+          !index->quantized_space_->restore(
+              {params.min().begin(), params.min().end()},
+              {params.max().begin(), params.max().end()},
+              params.fit_count())) {
+        return absl::InternalError("Could not load the quantization ranges");
+      }
+    }
     // initial_cap needs to be provided to retain the original initial_cap if
     // the index being loaded is empty.
+    size_t shard_initial_cap =
+        (vector_index_proto.initial_cap() + num_shards - 1) / num_shards;
 
-    RDBChunkInputStream input(std::move(iter));
-    VMSDK_RETURN_IF_ERROR(
-        index->algo_->LoadIndex(input, index->space_.get(),
-                                vector_index_proto.initial_cap(), index.get()));
-    // ef_runtime is not persisted in the index contents
-    index->algo_->setEf(vector_index_proto.hnsw_algorithm().ef_runtime());
-    // Notes:
-    // 1. Not allowing replace delete is aligned with RediSearch
-    // 2. Consider making allow_replace_deleted_ configurable
-    index->algo_->allow_replace_deleted_ = false;
+    // The graphs were saved one after the other into the same chunks.
+    for (auto &shard : index->shards_) {
+      VMSDK_RETURN_IF_ERROR(shard->LoadIndex(input, index->space_.get(),
+                                             shard_initial_cap, index.get()));
+      for (hnswlib::tableint i = 0; i < shard->cur_element_count_; ++i) {
+        if (shard->isMarkedDeleted(i)) {
+          index->UnTrackVector(shard->getExternalLabel(i));
+        }
+      }
+    }
+    if (index->IsQuantized() && index->quantized_space_->getFitCount() >=
+                                    kQuantizationSampleSize) {
+      index->FinishQuantizerFit();
+    }
+    for (auto &shard : index->shards_) {
+      // ef_runtime is not persisted in the index contents
+      shard->setEf(hnsw_proto.ef_runtime());
+      // Notes:
+      // 1. Not allowing replace delete is aligned with RediSearch
+      // 2. Consider making allow_replace_deleted_ configurable
+      shard->allow_replace_deleted_ = false;
+    }
     return index;
   } catch (const std::exception &e) {
     ++Metrics::GetStats().hnsw_create_exceptions_cnt;
@@ -176,24 +289,93 @@ template <typename T>
 VectorHNSW<T>::VectorHNSW(int dimensions,
                           absl::string_view attribute_identifier,
                           data_model::AttributeDataType attribute_data_type)
-    : VectorBase(IndexerType::kHNSW, dimensions, attribute_data_type,
-                 attribute_identifier) {}
+    : VectorBase(IndexerType::kHNSW, dimensions, VectorDataTypeOf<T>(),
+                 attribute_data_type, attribute_identifier) {}
+
+template <typename T>
+void VectorHNSW<T>::InitQuantization(
+    const data_model::HNSWAlgorithm &hnsw_proto) {
+  bool inner_product =
+      distance_metric_ != data_model::DistanceMetric::DISTANCE_METRIC_L2;
+  if (hnsw_proto.quantization() == data_model::VECTOR_QUANTIZATION_INT8 ||
+      hnsw_proto.quantization() ==
+          data_model::VECTOR_QUANTIZATION_INT8_CODES_ONLY) {
+    rerank_quantized_ =
+        hnsw_proto.quantization() == data_model::VECTOR_QUANTIZATION_INT8;
+    quantized_space_ =
+        std::make_unique<QuantizedSpace>(dimensions_, inner_product);
+    code_space_ = quantized_space_.get();
+    quantizer_ = quantized_space_.get();
+  } else if (hnsw_proto.graph_dimensions() != 0 &&
+             hnsw_proto.graph_dimensions() <
+                 static_cast<uint32_t>(dimensions_)) {
+    // COSINE compares the directions of the prefixes.
+    prefix_space_ = std::make_unique<PrefixSpace>(
+        hnsw_proto.graph_dimensions(), inner_product,
+        distance_metric_ == data_model::DistanceMetric::DISTANCE_METRIC_COSINE);
+    code_space_ = prefix_space_.get();
+    quantizer_ = prefix_space_.get();
+  } else {
+    return;
+  }
+  for (auto &shard : shards_) {
+    shard->setQuantizer(code_space_, quantizer_);
+  }
+}
+
+template <typename T>
+void VectorHNSW<T>::FitQuantizer(absl::string_view record) {
+  if (quantizer_fit_) {
+    return;
+  }
+  absl::WriterMutexLock lock(&resize_mutex_);
+  if (quantizer_fit_) {
+    return;
+  }
+  // At most kQuantizationSampleSize elements are re-encoded.
+  if (quantized_space_->fit(record.data())) {
+    for (auto &shard : shards_) {
+      shard->requantize();
+    }
+  }
+  if (quantized_space_->getFitCount() >= kQuantizationSampleSize) {
+    FinishQuantizerFit();
+  }
+}
+
+template <typename T>
+void VectorHNSW<T>::FinishQuantizerFit() {
+  quantizer_fit_ = true;
+  if (rerank_quantized_) {
+    return;
+  }
+  for (auto &shard : shards_) {
+    shard->dropVectors();
+  }
+  absl::MutexLock lock(&tracked_vectors_mutex_);
+  track_vectors_ = false;
+  tracked_vectors_.clear();
+  retired_vectors_.clear();
+}
 
 template <typename T>
 absl::Status VectorHNSW<T>::AddRecordImpl(uint64_t internal_id,
                                           absl::string_view record) {
+  if (IsQuantized()) {
+    FitQuantizer(record);
+  }
   do {
     try {
       absl::ReaderMutexLock lock(&resize_mutex_);
 
-      algo_->addPoint((T *)record.data(), internal_id);
+      GetShard(internal_id).addPoint((T *)record.data(), internal_id);
       return absl::OkStatus();
     } catch (const std::exception &e) {
       std::string error_msg = e.what();
       if (absl::StrContains(
               error_msg,
               "The number of elements exceeds the specified limit")) {
-        VMSDK_RETURN_IF_ERROR(ResizeIfFull());
+        VMSDK_RETURN_IF_ERROR(ResizeIfFull(GetShardIndex(internal_id)));
         continue;
       }
       ++Metrics::GetStats().hnsw_add_exceptions_cnt;
@@ -213,15 +395,8 @@ int VectorHNSW<T>::RespondWithInfoImpl(ValkeyModuleCtx *ctx) const {
           .data());
 
   ValkeyModule_ReplyWithSimpleString(ctx, "data_type");
-  if constexpr (std::is_same_v<T, float>) {
-    ValkeyModule_ReplyWithSimpleString(
-        ctx,
-        LookupKeyByValue(*kVectorDataTypeByStr,
-                         data_model::VectorDataType::VECTOR_DATA_TYPE_FLOAT32)
-            .data());
-  } else {
-    ValkeyModule_ReplyWithSimpleString(ctx, "UNKNOWN");
-  }
+  ValkeyModule_ReplyWithSimpleString(
+      ctx, LookupKeyByValue(*kVectorDataTypeByStr, data_type_).data());
   ValkeyModule_ReplyWithSimpleString(ctx, "dim");
   ValkeyModule_ReplyWithLongLong(ctx, dimensions_);
   ValkeyModule_ReplyWithSimpleString(ctx, "distance_metric");
@@ -235,38 +410,307 @@ int VectorHNSW<T>::RespondWithInfoImpl(ValkeyModuleCtx *ctx) const {
   ValkeyModule_ReplyWithLongLong(ctx, GetEfConstruction());
   ValkeyModule_ReplyWithSimpleString(ctx, "ef_runtime");
   ValkeyModule_ReplyWithLongLong(ctx, GetEfRuntime());
-  return 14;
+  ValkeyModule_ReplyWithSimpleString(ctx, "tombstone_ratio");
+  ValkeyModule_ReplyWithCString(ctx,
+                                std::to_string(GetTombstoneRatio()).c_str());
+  ValkeyModule_ReplyWithSimpleString(ctx, "reclaimed_bytes");
+  ValkeyModule_ReplyWithLongLong(ctx, reclaimed_bytes_);
+  int reply_count = 18;
+  if (IsQuantized()) {
+    ValkeyModule_ReplyWithSimpleString(ctx, "quantization");
+    auto quantization = rerank_quantized_
+                            ? data_model::VECTOR_QUANTIZATION_INT8
+                            : data_model::VECTOR_QUANTIZATION_INT8_CODES_ONLY;
+    ValkeyModule_ReplyWithSimpleString(
+        ctx, LookupKeyByValue(*kVectorQuantizationByStr, quantization).data());
+    reply_count += 2;
+  }
+  if (prefix_space_) {
+    ValkeyModule_ReplyWithSimpleString(ctx, "graph_dim");
+    ValkeyModule_ReplyWithLongLong(ctx, GetGraphDimensions());
+    reply_count += 2;
+  }
+  if (shards_.size() > 1) {
+    ValkeyModule_ReplyWithSimpleString(ctx, "shards");
+    ValkeyModule_ReplyWithLongLong(ctx, shards_.size());
+    reply_count += 2;
+  }
+  return reply_count;
+}
+
+template <typename T>
+double VectorHNSW<T>::GetTombstoneRatio() const {
+  // Both counters are atomics, reading them does not block behind a resize or
+  // a consolidation.
+  size_t element_count = 0;
+  size_t deleted_count = 0;
+  for (const auto &shard : shards_) {
+    element_count += shard->cur_element_count_;
+    deleted_count += shard->num_deleted_;
+  }
+  if (element_count == 0) {
+    return 0;
+  }
+  return static_cast<double>(deleted_count) / element_count;
+}
+
+template <typename T>
+bool VectorHNSW<T>::ClaimConsolidation(double min_tombstone_ratio) {
+  if (consolidation_pending_) {
+    return false;
+  }
+  double tombstone_ratio = GetTombstoneRatio();
+  if (tombstone_ratio == 0 || tombstone_ratio < min_tombstone_ratio) {
+    return false;
+  }
+  return !consolidation_pending_.exchange(true);
+}
+
+template <typename T>
+absl::StatusOr<bool> VectorHNSW<T>::RepairDeletedLinks(size_t max_records) {
+  absl::WriterMutexLock lock(&resize_mutex_);
+  try {
+    while (max_records > 0 && repair_shard_ < shards_.size()) {
+      auto &shard = shards_[repair_shard_];
+      const hnswlib::tableint element_count = shard->cur_element_count_;
+      const hnswlib::tableint end =
+          repair_element_ + std::min<size_t>(max_records,
+                                             element_count - repair_element_);
+      if (shard->getDeletedCount() > 0) {
+        shard->repairDeletedLinks(repair_element_, end);
+      }
+      max_records -= end - repair_element_;
+      repair_element_ = end;
+      if (repair_element_ == element_count) {
+        ++repair_shard_;
+        repair_element_ = 0;
+      }
+    }
+  } catch (const std::exception &e) {
+    repair_shard_ = 0;
+    repair_element_ = 0;
+    consolidation_pending_ = false;
+    ++Metrics::GetStats().hnsw_remove_exceptions_cnt;
+    return absl::InternalError(
+        absl::StrCat("Error while repairing deleted records: ", e.what()));
+  }
+  return repair_shard_ == shards_.size();
+}
+
+template <typename T>
+absl::StatusOr<size_t> VectorHNSW<T>::ConsolidateDeletes() {
+  absl::WriterMutexLock lock(&resize_mutex_);
+  vmsdk::StopWatch stop_watch;
+  size_t deleted_count = 0;
+  size_t reclaimed_bytes = 0;
+  // Only the elements added or relinked since their RepairDeletedLinks step
+  // are left to repair here.
+  repair_shard_ = 0;
+  repair_element_ = 0;
+  try {
+    for (auto &shard : shards_) {
+      deleted_count += shard->getDeletedCount();
+      reclaimed_bytes += shard->consolidateDeletes();
+    }
+  } catch (const std::exception &e) {
+    consolidation_pending_ = false;
+    ++Metrics::GetStats().hnsw_remove_exceptions_cnt;
+    return absl::InternalError(
+        absl::StrCat("Error while consolidating deleted records: ", e.what()));
+  }
+  // Release the retired vectors that no remaining element points at. Interned
+  // vectors shared with other keys only release their reference.
+  absl::flat_hash_set<const char *> referenced_vectors;
+  {
+    absl::MutexLock tracked_lock(&tracked_vectors_mutex_);
+    if (!retired_vectors_.empty()) {
+      for (const auto &shard : shards_) {
+        for (hnswlib::tableint i = 0; i < shard->cur_element_count_; ++i) {
+          referenced_vectors.insert(shard->getVectorByInternalId(i));
+        }
+      }
+      std::vector<InternedStringPtr> still_referenced;
+      for (auto &vector : retired_vectors_) {
+        if (referenced_vectors.contains(vector->Str().data())) {
+          still_referenced.push_back(std::move(vector));
+        } else {
+          reclaimed_bytes += GetVectorDataSize();
+        }
+      }
+      retired_vectors_ = std::move(still_referenced);
+    }
+  }
+  reclaimed_bytes_ += reclaimed_bytes;
+  consolidation_pending_ = false;
+  VMSDK_LOG(NOTICE, nullptr)
+      << "Consolidated HNSW index " << attribute_identifier_ << ", removed "
+      << deleted_count << " deleted elements, reclaimed " << reclaimed_bytes
+      << " bytes, took: " << absl::FormatDuration(stop_watch.Duration());
+  return reclaimed_bytes;
+}
+
+template <typename T>
+bool VectorHNSW<T>::ClaimReorder(double min_growth_ratio) {
+  // A reordering would move the elements under a consolidation in progress.
+  if (reorder_pending_ || consolidation_pending_) {
+    return false;
+  }
+  size_t element_count = 0;
+  for (const auto &shard : shards_) {
+    element_count += shard->cur_element_count_;
+  }
+  if (element_count < kMinReorderElements ||
+      element_count < reordered_element_count_ * (1 + min_growth_ratio)) {
+    return false;
+  }
+  return !reorder_pending_.exchange(true);
+}
+
+template <typename T>
+absl::Status VectorHNSW<T>::ReorderForLocality() {
+  VMSDK_RETURN_IF_ERROR(PrepareReorder());
+  return ApplyReorder();
+}
+
+template <typename T>
+absl::Status VectorHNSW<T>::PrepareReorder() {
+  try {
+    {
+      // The mutations are tracked from a point none is in flight.
+      absl::WriterMutexLock lock(&resize_mutex_);
+      reordered_copies_.clear();
+      for (auto &shard : shards_) {
+        reordered_copies_.push_back(shard->beginReorderedCopy());
+      }
+    }
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      for (bool built = false; !built;) {
+        absl::ReaderMutexLock lock(&resize_mutex_);
+        built = reordered_copies_[i] == nullptr ||
+                shards_[i]->buildReorderedCopy(*reordered_copies_[i],
+                                               kReorderStepElements);
+      }
+    }
+    for (size_t round = 0; round < kMaxReorderCatchUpRounds; ++round) {
+      absl::ReaderMutexLock lock(&resize_mutex_);
+      size_t copied = 0;
+      for (size_t i = 0; i < shards_.size(); ++i) {
+        if (reordered_copies_[i] != nullptr) {
+          copied += shards_[i]->catchUpReorderedCopy(*reordered_copies_[i]);
+        }
+      }
+      if (copied <= kReorderCatchUpElements) {
+        break;
+      }
+    }
+  } catch (const std::exception &e) {
+    CancelReorder();
+    return absl::InternalError(
+        absl::StrCat("Error while reordering the graph: ", e.what()));
+  }
+  return absl::OkStatus();
+}
+
+template <typename T>
+absl::Status VectorHNSW<T>::ApplyReorder() {
+  // Released once the lock is, along with the previous graphs they hold.
+  std::vector<std::unique_ptr<ReorderedCopy>> copies;
+  absl::WriterMutexLock lock(&resize_mutex_);
+  vmsdk::StopWatch stop_watch;
+  copies.swap(reordered_copies_);
+  bool swapped = true;
+  try {
+    for (size_t i = 0; i < copies.size(); ++i) {
+      if (copies[i] != nullptr && !shards_[i]->swapReorderedCopy(*copies[i])) {
+        swapped = false;
+      }
+    }
+  } catch (const std::exception &e) {
+    for (auto &shard : shards_) {
+      shard->cancelReorderedCopy();
+    }
+    reorder_pending_ = false;
+    return absl::InternalError(
+        absl::StrCat("Error while reordering the graph: ", e.what()));
+  }
+  reorder_pending_ = false;
+  if (!swapped) {
+    // Left for the next reordering to start over.
+    VMSDK_LOG(NOTICE, nullptr)
+        << "Dropped the reordering of HNSW index " << attribute_identifier_
+        << ", its elements were moved or re-encoded meanwhile";
+    return absl::OkStatus();
+  }
+  size_t element_count = 0;
+  for (const auto &shard : shards_) {
+    element_count += shard->cur_element_count_;
+  }
+  reordered_element_count_ = element_count;
+  VMSDK_LOG(NOTICE, nullptr)
+      << "Reordered HNSW index " << attribute_identifier_ << ", "
+      << element_count << " elements, swapping in took: "
+      << absl::FormatDuration(stop_watch.Duration());
+  return absl::OkStatus();
+}
+
+template <typename T>
+void VectorHNSW<T>::CancelReorder() {
+  absl::WriterMutexLock lock(&resize_mutex_);
+  for (auto &shard : shards_) {
+    shard->cancelReorderedCopy();
+  }
+  reordered_copies_.clear();
+  reorder_pending_ = false;
 }
 
 template <typename T>
 absl::Status VectorHNSW<T>::SaveIndexImpl(
     RDBChunkOutputStream chunked_out) const {
   absl::ReaderMutexLock lock(&resize_mutex_);
-  return algo_->SaveIndex(chunked_out);
+  if (IsQuantized()) {
+    hnswlib::data_model::SQ8Params params;
+    params.mutable_min()->Assign(quantized_space_->getRangeMin().begin(),
+                                 quantized_space_->getRangeMin().end());
+    params.mutable_max()->Assign(quantized_space_->getRangeMax().begin(),
+                                 quantized_space_->getRangeMax().end());
+    params.set_fit_count(quantized_space_->getFitCount());
+    std::string serialized_params;
+    if (!params.SerializeToString(&serialized_params)) {
+      return absl::InternalError("Could not serialize the quantization ranges");
+    }
+    VMSDK_RETURN_IF_ERROR(chunked_out.SaveChunk(serialized_params.data(),
+                                                serialized_params.size()));
+  }
+  for (const auto &shard : shards_) {
+    VMSDK_RETURN_IF_ERROR(shard->SaveIndex(chunked_out));
+  }
+  return absl::OkStatus();
 }
 
 template <typename T>
-absl::Status VectorHNSW<T>::ResizeIfFull() {
+absl::Status VectorHNSW<T>::ResizeIfFull(size_t shard) {
   {
     absl::ReaderMutexLock lock(&resize_mutex_);
-    if (algo_->getCurrentElementCount() < algo_->getMaxElements() ||
-        (algo_->allow_replace_deleted_ && algo_->getDeletedCount() > 0)) {
+    auto &algo = *shards_[shard];
+    if (algo.getCurrentElementCount() < algo.getMaxElements() ||
+        (algo.allow_replace_deleted_ && algo.getDeletedCount() > 0)) {
       return absl::OkStatus();
     }
   }
   try {
     absl::WriterMutexLock lock(&resize_mutex_);
-    if (algo_->getCurrentElementCount() == algo_->getMaxElements() &&
-        (!algo_->allow_replace_deleted_ || algo_->getDeletedCount() == 0)) {
+    auto &algo = *shards_[shard];
+    if (algo.getCurrentElementCount() == algo.getMaxElements() &&
+        (!algo.allow_replace_deleted_ || algo.getDeletedCount() == 0)) {
       vmsdk::StopWatch stop_watch;
-      auto max_elements = algo_->getMaxElements();
+      auto max_elements = algo.getMaxElements();
       // Notes
       // 1. Currently HNSWLib doesn't provide a way to shrink an index after
       // it was expanded.
       // 2. Once multithreaded is supported we'll have to make sure that no
       // thread is reading/writing during resize
       auto block_size = ValkeySearch::Instance().GetHNSWBlockSize();
-      algo_->resizeIndex(algo_->getMaxElements() + block_size);
+      algo.resizeIndex(algo.getMaxElements() + block_size);
       VMSDK_LOG(WARNING, nullptr)
           << "Resizing HNSW Index, current size: " << max_elements
           << ", expand by: " << block_size << ", resize time took: "
@@ -280,16 +724,119 @@ absl::Status VectorHNSW<T>::ResizeIfFull() {
   return absl::OkStatus();
 }
 
+template <typename T>
+VectorBase::InlineSearchEstimate VectorHNSW<T>::EstimateInlineSearch(
+    uint64_t k, double selectivity, std::optional<size_t> search_width) const {
+  absl::ReaderMutexLock lock(&resize_mutex_);
+  // Every graph is searched, and holds about an equal share of the vectors.
+  const auto &algo = *shards_[0];
+  size_t num_shards = shards_.size();
+  size_t element_count = 0;
+  for (const auto &shard : shards_) {
+    element_count += shard->getCurrentElementCount();
+  }
+  element_count = (element_count + num_shards - 1) / num_shards;
+  if (element_count == 0) {
+    return {};
+  }
+  // Tombstones are traversed but never returned, so they dilute the share of
+  // the graph that passes the filter.
+  selectivity *= 1.0 - GetTombstoneRatio();
+  selectivity = std::max(selectivity, 1.0 / element_count);
+  size_t ef = std::max<size_t>(search_width.value_or(algo.ef_), k);
+  double degree = algo.maxM0_;
+  // The upper layers are descended greedily, about one node per layer.
+  size_t upper_layers = static_cast<size_t>(
+      std::log(static_cast<double>(element_count)) * algo.mult_ *
+      algo.maxM_);
+  if (selectivity * degree < kFilteredTraversalMinPassingNeighbors) {
+    // Each of the about ef expansions of the filtered traversal filters the
+    // one and two hop neighborhood of the expanded node until maxM0 of them
+    // pass, and scores the ones that passed.
+    double filtered = std::min(degree / selectivity, degree + degree * degree);
+    double scored = std::min(degree, selectivity * (degree + degree * degree));
+    size_t base_layer_scored =
+        static_cast<size_t>(std::min<double>(element_count, ef * scored));
+    size_t base_layer_filtered =
+        static_cast<size_t>(std::min<double>(element_count, ef * filtered));
+    return {num_shards * (upper_layers + base_layer_scored),
+            num_shards * base_layer_filtered, true};
+  }
+  // The base layer search keeps expanding candidates until ef of them pass
+  // the filter, which takes about ef / selectivity expansions, and every
+  // expansion scores and filters the neighbors of the expanded node.
+  size_t base_layer = static_cast<size_t>(
+      std::min<double>(element_count, ef / selectivity * degree));
+  return {num_shards * (base_layer + upper_layers), num_shards * base_layer};
+}
+
+template <typename T>
+absl::Status VectorHNSW<T>::ReserveCapacity(size_t additional_records) {
+  // The records are spread evenly across the graphs.
+  size_t shard_additional_records =
+      (additional_records + GetShardCount() - 1) / GetShardCount();
+  auto is_reserved = [&]() ABSL_NO_THREAD_SAFETY_ANALYSIS {
+    for (const auto &shard : shards_) {
+      if (shard->getCurrentElementCount() + shard_additional_records >
+          shard->getMaxElements()) {
+        return false;
+      }
+    }
+    return true;
+  };
+  {
+    absl::ReaderMutexLock lock(&resize_mutex_);
+    if (is_reserved()) {
+      return absl::OkStatus();
+    }
+  }
+  try {
+    absl::WriterMutexLock lock(&resize_mutex_);
+    if (is_reserved()) {
+      return absl::OkStatus();
+    }
+    vmsdk::StopWatch stop_watch;
+    // Grow by whole blocks, as ResizeIfFull would have.
+    size_t block_size =
+        std::max<size_t>(ValkeySearch::Instance().GetHNSWBlockSize(), 1);
+    auto max_elements = GetCapacity();
+    for (auto &shard : shards_) {
+      auto shard_max_elements = shard->getMaxElements();
+      auto required =
+          shard->getCurrentElementCount() + shard_additional_records;
+      if (required <= shard_max_elements) {
+        continue;
+      }
+      shard->resizeIndex(shard_max_elements +
+                         (required - shard_max_elements + block_size - 1) /
+                             block_size * block_size);
+    }
+    VMSDK_LOG(NOTICE, nullptr)
+        << "Reserved HNSW Index capacity, current size: " << max_elements
+        << ", new size: " << GetCapacity() << ", resize time took: "
+        << absl::FormatDuration(stop_watch.Duration());
+  } catch (const std::exception &e) {
+    ++Metrics::GetStats().hnsw_add_exceptions_cnt;
+    return absl::InternalError(
+        absl::StrCat("Error while reserving capacity: ", e.what()));
+  }
+  return absl::OkStatus();
+}
+
 template <typename T>
 absl::Status VectorHNSW<T>::ModifyRecordImpl(uint64_t internal_id,
                                              absl::string_view record) {
+  if (IsQuantized()) {
+    FitQuantizer(record);
+  }
   try {
     absl::ReaderMutexLock lock(&resize_mutex_);
     // TODO - an alternative approach is to call HierarchicalNSW::updatePoint.
     // The concern with calling updatePoint is that it might have implications
     // on the search accuracy. Need to revisit this in the future.
-    algo_->markDelete(internal_id);
-    algo_->addPoint((T *)record.data(), internal_id);
+    auto &shard = GetShard(internal_id);
+    shard.markDelete(internal_id);
+    shard.addPoint((T *)record.data(), internal_id);
   } catch (const std::exception &e) {
     ++Metrics::GetStats().hnsw_modify_exceptions_cnt;
     return absl::InternalError(
@@ -302,7 +849,7 @@ template <typename T>
 absl::Status VectorHNSW<T>::RemoveRecordImpl(uint64_t internal_id) {
   try {
     absl::ReaderMutexLock lock(&resize_mutex_);
-    algo_->markDelete(internal_id);
+    GetShard(internal_id).markDelete(internal_id);
   } catch (const std::exception &e) {
     ++Metrics::GetStats().hnsw_remove_exceptions_cnt;
     return absl::InternalError(
@@ -326,61 +873,198 @@ template <typename T>
 absl::StatusOr<std::vector<Neighbor>> VectorHNSW<T>::Search(
     absl::string_view query, uint64_t count, cancel::Token &cancellation_token,
     std::unique_ptr<hnswlib::BaseFilterFunctor> filter,
-    std::optional<size_t> ef_runtime, bool enable_partial_results) {
+    std::optional<size_t> ef_runtime, bool enable_partial_results,
+    bool filtered_traversal, std::optional<size_t> oversample) {
   if (!IsValidSizeVector(query)) {
     return absl::InvalidArgumentError(absl::StrCat(
         "Error parsing vector similarity query: query vector blob size (",
         query.size(), ") does not match index's expected size (",
-        dimensions_ * GetDataTypeSize(), ")."));
+        GetVectorDataSize(), ")."));
   }
-  auto perform_search = [this, count, &filter, enable_partial_results,
-                         &ef_runtime,
-                         &cancellation_token](absl::string_view query)
+  // The filtered traversal only differs from the regular one when there is a
+  // filter to traverse around.
+  filtered_traversal = filtered_traversal && filter != nullptr;
+  auto perform_search = [this, &filter, enable_partial_results, &ef_runtime,
+                         filtered_traversal, &oversample, &cancellation_token](
+                            absl::string_view query, uint64_t search_count)
                             ABSL_NO_THREAD_SAFETY_ANALYSIS
-      -> absl::StatusOr<std::priority_queue<std::pair<T, hnswlib::labeltype>>> {
+      -> absl::StatusOr<
+          std::priority_queue<std::pair<float, hnswlib::labeltype>>> {
+    std::vector<char> code;
+    if (UsesCodes()) {
+      code.resize(code_space_->get_data_size());
+      quantizer_->encode(query.data(), code.data());
+    }
+    VMSDK_ASSIGN_OR_RETURN(
+        auto res,
+        SearchShards(
+            search_count,
+            [&](hnswlib::HierarchicalNSW<float> &algo)
+                -> std::priority_queue<std::pair<float, hnswlib::labeltype>> {
+              CancelCondition cancel_condition(cancellation_token);
+              if (UsesCodes() && !KeepsVectors()) {
+                // Only the codes are left to rank the elements by.
+                return filtered_traversal
+                           ? algo.searchKnnFiltered(code.data(), search_count,
+                                                    ef_runtime, filter.get(),
+                                                    &cancel_condition)
+                           : algo.searchKnn(code.data(), search_count,
+                                            ef_runtime, filter.get(),
+                                            &cancel_condition);
+              }
+              if (UsesCodes()) {
+                // Traverse the graph with the encoded query, keeping all ef
+                // candidates, or `oversample` times count if more, and
+                // re-rank them against the full precision vectors.
+                size_t candidate_count =
+                    std::max<size_t>(search_count * oversample.value_or(1),
+                                     ef_runtime.value_or(algo.ef_));
+                auto candidates =
+                    filtered_traversal
+                        ? algo.searchKnnFiltered(code.data(), candidate_count,
+                                                 ef_runtime, filter.get(),
+                                                 &cancel_condition)
+                        : algo.searchKnn(code.data(), candidate_count,
+                                         ef_runtime, filter.get(),
+                                         &cancel_condition);
+                return Rerank(query, std::move(candidates), search_count);
+              }
+              if (filtered_traversal) {
+                return algo.searchKnnFiltered((T *)query.data(), search_count,
+                                              ef_runtime, filter.get(),
+                                              &cancel_condition);
+              }
+              return algo.searchKnn((T *)query.data(), search_count,
+                                    ef_runtime, filter.get(),
+                                    &cancel_condition);
+            }));
+    if (!enable_partial_results && cancellation_token->IsCancelled()) {
+      return absl::CancelledError("Search operation cancelled due to timeout");
+    }
+    return res;
+  };
+  std::vector<char> norm_record;
+  if (normalize_) {
+    norm_record = NormalizeEmbedding(query, data_type_);
+    query = absl::string_view(norm_record.data(), norm_record.size());
+  }
+  return SearchKeys(count, [&](uint64_t search_count) {
+    return perform_search(query, search_count);
+  });
+}
+
+template <typename T>
+absl::StatusOr<std::vector<Neighbor>> VectorHNSW<T>::SearchRange(
+    absl::string_view query, float radius, cancel::Token &cancellation_token,
+    std::unique_ptr<hnswlib::BaseFilterFunctor> filter) {
+  if (!IsValidSizeVector(query)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Error parsing vector range query: query vector blob size (",
+        query.size(), ") does not match index's expected size (",
+        GetVectorDataSize(), ")."));
+  }
+  std::vector<char> code;
+  if (UsesCodes()) {
+    code.resize(code_space_->get_data_size());
+    quantizer_->encode(query.data(), code.data());
+  }
+  VMSDK_ASSIGN_OR_RETURN(
+      auto search_result,
+      SearchShards(
+          std::numeric_limits<uint64_t>::max(),
+          [&](hnswlib::HierarchicalNSW<float> &algo) {
+            CancelCondition cancel_condition(cancellation_token);
+            std::priority_queue<std::pair<float, hnswlib::labeltype>> res;
+            if (UsesCodes() && !KeepsVectors()) {
+              for (const auto &[distance, label] :
+                   algo.searchRange(code.data(), radius, algo.ef_,
+                                    filter.get(), &cancel_condition)) {
+                res.emplace(distance, label);
+              }
+            } else if (UsesCodes()) {
+              // Walk the graph over the codes and keep the candidates whose
+              // full precision distance is within the radius. Elements close
+              // to the radius may be missed, as the code distances only
+              // approximate it.
+              auto candidates =
+                  algo.searchRange(code.data(), radius, algo.ef_,
+                                   filter.get(), &cancel_condition);
+              auto dist_func = space_->get_dist_func();
+              auto dist_func_param = space_->get_dist_func_param();
+              for (const auto &[code_distance, label] : candidates) {
+                char *vector = algo.getPoint(label);
+                if (vector == nullptr) {
+                  continue;
+                }
+                float distance =
+                    dist_func(query.data(), vector, dist_func_param);
+                if (distance <= radius) {
+                  res.emplace(distance, label);
+                }
+              }
+            } else {
+              for (const auto &[distance, label] :
+                   algo.searchRange((T *)query.data(), radius, algo.ef_,
+                                    filter.get(), &cancel_condition)) {
+                res.emplace(distance, label);
+              }
+            }
+            return res;
+          }));
+  return CreateReply(search_result);
+}
+
+template <typename T>
+absl::StatusOr<std::priority_queue<std::pair<float, hnswlib::labeltype>>>
+VectorHNSW<T>::SearchShards(
+    uint64_t count,
+    absl::FunctionRef<std::priority_queue<std::pair<
+        float, hnswlib::labeltype>>(hnswlib::HierarchicalNSW<float> &)>
+        search) const {
+  std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>>
+      results(shards_.size());
+  std::vector<absl::Status> statuses(shards_.size());
+  auto search_shard = [&](size_t shard) ABSL_NO_THREAD_SAFETY_ANALYSIS {
     try {
-      CancelCondition cancel_condition(cancellation_token);
-      auto res = algo_->searchKnn((T *)query.data(), count, ef_runtime,
-                                  filter.get(), &cancel_condition);
-      if (!enable_partial_results && cancellation_token->IsCancelled()) {
-        return absl::CancelledError(
-            "Search operation cancelled due to timeout");
-      }
-      return res;
+      results[shard] = search(*shards_[shard]);
     } catch (const std::exception &e) {
       Metrics::GetStats().hnsw_search_exceptions_cnt.fetch_add(
           1, std::memory_order_relaxed);
-      return absl::InternalError(e.what());
+      statuses[shard] = absl::InternalError(e.what());
     }
   };
-  if (normalize_) {
-    auto norm_record = NormalizeEmbedding(query, GetDataTypeSize());
-    VMSDK_ASSIGN_OR_RETURN(
-        auto search_result,
-        perform_search(absl::string_view((const char *)norm_record.data(),
-                                         norm_record.size())));
-    return CreateReply(search_result);
+  if (shards_.size() == 1) {
+    search_shard(0);
+  } else {
+    // The graphs are searched on the reader threads while this thread waits
+    // for them, and searches one of them itself.
+    vmsdk::RunInParallel(ValkeySearch::Instance().GetReaderThreadPool(),
+                         shards_.size(), search_shard);
   }
-  VMSDK_ASSIGN_OR_RETURN(auto search_result, perform_search(query));
-  return CreateReply(search_result);
+  for (auto &status : statuses) {
+    VMSDK_RETURN_IF_ERROR(status);
+  }
+  if (shards_.size() == 1) {
+    return std::move(results[0]);
+  }
+  return MergeSearchResults(results, count);
 }
 
 template <typename T>
 void VectorHNSW<T>::ToProtoImpl(
     data_model::VectorIndex *vector_index_proto) const {
-  data_model::VectorDataType data_type;
-  if constexpr (std::is_same_v<T, float>) {
-    data_type = data_model::VectorDataType::VECTOR_DATA_TYPE_FLOAT32;
-  } else {
-    DCHECK(false) << "Unsupported type: " << typeid(T).name();
-    data_type = data_model::VectorDataType::VECTOR_DATA_TYPE_UNSPECIFIED;
-  }
-  vector_index_proto->set_vector_data_type(data_type);
+  vector_index_proto->set_vector_data_type(data_type_);
   absl::ReaderMutexLock lock(&resize_mutex_);
   auto hnsw_algorithm_proto = std::make_unique<data_model::HNSWAlgorithm>();
   hnsw_algorithm_proto->set_ef_construction(GetEfConstruction());
   hnsw_algorithm_proto->set_ef_runtime(GetEfRuntime());
   hnsw_algorithm_proto->set_m(GetM());
+  hnsw_algorithm_proto->set_quantization(
+      !IsQuantized()       ? data_model::VECTOR_QUANTIZATION_NONE
+      : rerank_quantized_ ? data_model::VECTOR_QUANTIZATION_INT8
+                          : data_model::VECTOR_QUANTIZATION_INT8_CODES_ONLY);
+  hnsw_algorithm_proto->set_shards(shards_.size());
+  hnsw_algorithm_proto->set_graph_dimensions(GetGraphDimensions());
   vector_index_proto->set_allocated_hnsw_algorithm(
       hnsw_algorithm_proto.release());
 }
@@ -389,18 +1073,55 @@ template <typename T>
 absl::StatusOr<std::pair<float, hnswlib::labeltype>>
 VectorHNSW<T>::ComputeDistanceFromRecordImpl(uint64_t internal_id,
                                              absl::string_view query) const {
-  auto id =
-      hnswlib_helpers::GetInternalIdDuringSearch(algo_.get(), internal_id);
+  auto &algo = GetShard(internal_id);
+  auto id = hnswlib_helpers::GetInternalIdDuringSearch(&algo, internal_id);
   if (!id.has_value()) {
     return absl::InternalError(
         absl::StrCat("Couldn't find internal id: ", internal_id));
   }
+  if (!algo.keep_vectors_) {
+    std::vector<char> code(code_space_->get_data_size());
+    quantizer_->encode(query.data(), code.data());
+    return (std::pair<float, hnswlib::labeltype>){
+        code_space_->get_dist_func()(code.data(),
+                                     algo.getDataByInternalId(*id),
+                                     code_space_->get_dist_func_param()),
+        internal_id};
+  }
+  // Use the full precision vector whenever the graph keeps it.
   return (std::pair<float, hnswlib::labeltype>){
-      algo_->fstdistfunc_((T *)query.data(), algo_->getDataByInternalId(*id),
-                          algo_->dist_func_param_),
+      space_->get_dist_func()((T *)query.data(),
+                              algo.getVectorByInternalId(*id),
+                              space_->get_dist_func_param()),
       internal_id};
 }
 
+template <typename T>
+std::priority_queue<std::pair<float, hnswlib::labeltype>>
+VectorHNSW<T>::Rerank(
+    absl::string_view query,
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> candidates,
+    uint64_t count) const {
+  auto dist_func = space_->get_dist_func();
+  auto dist_func_param = space_->get_dist_func_param();
+  std::priority_queue<std::pair<float, hnswlib::labeltype>> results;
+  for (; !candidates.empty(); candidates.pop()) {
+    auto label = candidates.top().second;
+    char *vector = GetShard(label).getPoint(label);
+    if (vector == nullptr) {
+      continue;
+    }
+    results.emplace(dist_func(query.data(), vector, dist_func_param), label);
+    if (results.size() > count) {
+      results.pop();
+    }
+  }
+  return results;
+}
+
 template class VectorHNSW<float>;
+template class VectorHNSW<hnswlib::float16>;
+template class VectorHNSW<hnswlib::bfloat16>;
+template class VectorHNSW<hnswlib::bit8>;
 
 }  // namespace valkey_search::indexes
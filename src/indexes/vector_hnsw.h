@@ -7,14 +7,19 @@
 
 #ifndef VALKEYSEARCH_SRC_INDEXES_VECTOR_HNSW_H_
 #define VALKEYSEARCH_SRC_INDEXES_VECTOR_HNSW_H_
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
-#include <deque>
 #include <memory>
 #include <optional>
+#include <queue>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
@@ -26,6 +31,8 @@
 #include "src/utils/string_interning.h"
 #include "third_party/hnswlib/hnswalg.h"
 #include "third_party/hnswlib/hnswlib.h"
+#include "third_party/hnswlib/space_prefix.h"
+#include "third_party/hnswlib/space_sq8.h"
 #include "vmsdk/src/valkey_module_api/valkey_module.h"
 
 namespace valkey_search::indexes {
@@ -53,27 +60,81 @@ class VectorHNSW : public VectorBase {
   int GetDimensions() const { return dimensions_; }
   size_t GetCapacity() const override
       ABSL_SHARED_LOCKS_REQUIRED(resize_mutex_) {
-    return algo_->max_elements_;
+    size_t capacity = 0;
+    for (const auto& shard : shards_) {
+      capacity += shard->max_elements_;
+    }
+    return capacity;
   }
   int GetM() const ABSL_SHARED_LOCKS_REQUIRED(resize_mutex_) {
-    return algo_->M_;
+    return shards_[0]->M_;
   }
   int GetEfConstruction() const ABSL_SHARED_LOCKS_REQUIRED(resize_mutex_) {
-    return algo_->ef_construction_;
+    return shards_[0]->ef_construction_;
   }
   size_t GetEfRuntime() const ABSL_SHARED_LOCKS_REQUIRED(resize_mutex_) {
-    return algo_->ef_;
+    return shards_[0]->ef_;
   }
+  // The graphs are all created with the index, their number never changes.
+  size_t GetShardCount() const ABSL_NO_THREAD_SAFETY_ANALYSIS {
+    return shards_.size();
+  }
+  bool IsQuantized() const { return quantized_space_ != nullptr; }
+  // Whether the full vectors are kept alongside the codes the graph is built
+  // over. An INT8_CODES_ONLY index drops them once its quantization ranges
+  // are fit.
+  bool KeepsVectors() const ABSL_NO_THREAD_SAFETY_ANALYSIS {
+    return shards_[0]->keep_vectors_;
+  }
+  // Number of leading dimensions the graph is built over, or zero when it is
+  // built over whole vectors.
+  size_t GetGraphDimensions() const {
+    return prefix_space_ ? prefix_space_->get_dim() : 0;
+  }
+  // Whether the graph is built over codes, quantized or truncated vectors,
+  // whose candidates are re-ranked with the full vectors.
+  bool UsesCodes() const { return quantizer_ != nullptr; }
+  // Share of the graph elements that are marked as deleted.
+  double GetTombstoneRatio() const ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  bool ClaimConsolidation(double min_tombstone_ratio) override;
+  absl::StatusOr<bool> RepairDeletedLinks(size_t max_records) override
+      ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  absl::StatusOr<size_t> ConsolidateDeletes() override
+      ABSL_LOCKS_EXCLUDED(resize_mutex_, tracked_vectors_mutex_);
+  bool ClaimReorder(double min_growth_ratio) override;
+  // Renumbers the elements of each graph in the breadth-first order of its
+  // bottom level, so that a search hops between nearby elements in memory.
+  absl::Status ReorderForLocality() override
+      ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  absl::Status PrepareReorder() override ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  absl::Status ApplyReorder() override ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  absl::Status ReserveCapacity(size_t additional_records) override
+      ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  InlineSearchEstimate EstimateInlineSearch(
+      uint64_t k, double selectivity,
+      std::optional<size_t> search_width) const override
+      ABSL_LOCKS_EXCLUDED(resize_mutex_);
 
   absl::StatusOr<std::vector<Neighbor>> Search(
       absl::string_view query, uint64_t count,
       cancel::Token& cancellation_token,
       std::unique_ptr<hnswlib::BaseFilterFunctor> filter = nullptr,
       std::optional<size_t> ef_runtime = std::nullopt,
-      bool enable_partial_results = false) ABSL_LOCKS_EXCLUDED(resize_mutex_);
+      bool enable_partial_results = false, bool filtered_traversal = false,
+      std::optional<size_t> oversample = std::nullopt)
+      ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  absl::StatusOr<std::vector<Neighbor>> SearchRange(
+      absl::string_view query, float radius, cancel::Token& cancellation_token,
+      std::unique_ptr<hnswlib::BaseFilterFunctor> filter = nullptr) override
+      ABSL_LOCKS_EXCLUDED(resize_mutex_);
 
  protected:
-  absl::Status ResizeIfFull() ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  absl::Status ResizeIfFull(size_t shard) ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  // Fits the quantization ranges to the record while they are learned from
+  // the first kQuantizationSampleSize records, re-encoding the graph when it
+  // falls outside of them. Later records outside of the ranges are clamped.
+  void FitQuantizer(absl::string_view record)
+      ABSL_LOCKS_EXCLUDED(resize_mutex_);
   absl::Status AddRecordImpl(uint64_t internal_id,
                              absl::string_view record) override
       ABSL_LOCKS_EXCLUDED(resize_mutex_);
@@ -91,7 +152,7 @@ class VectorHNSW : public VectorBase {
       const override ABSL_NO_THREAD_SAFETY_ANALYSIS;
   char* GetValueImpl(uint64_t internal_id) const override
       ABSL_NO_THREAD_SAFETY_ANALYSIS {
-    return algo_->getPoint(internal_id);
+    return GetShard(internal_id).getPoint(internal_id);
   }
   bool IsVectorMatch(uint64_t internal_id,
                      const InternedStringPtr& vector) override
@@ -105,13 +166,85 @@ class VectorHNSW : public VectorBase {
  private:
   VectorHNSW(int dimensions, absl::string_view attribute_identifier,
              data_model::AttributeDataType attribute_data_type);
-  std::unique_ptr<hnswlib::HierarchicalNSW<T>> algo_
+  void InitQuantization(const data_model::HNSWAlgorithm& hnsw_proto)
+      ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  // Marks the quantization ranges as fit and, unless the index re-ranks with
+  // the full vectors, releases them.
+  void FinishQuantizerFit() ABSL_EXCLUSIVE_LOCKS_REQUIRED(resize_mutex_)
+      ABSL_LOCKS_EXCLUDED(tracked_vectors_mutex_);
+  // Drops the copies of a failed reordering and ends it.
+  void CancelReorder() ABSL_LOCKS_EXCLUDED(resize_mutex_);
+  // Returns the index of the graph holding the record of `internal_id`.
+  size_t GetShardIndex(uint64_t internal_id) const
+      ABSL_NO_THREAD_SAFETY_ANALYSIS {
+    return internal_id % shards_.size();
+  }
+  hnswlib::HierarchicalNSW<float>& GetShard(uint64_t internal_id) const
+      ABSL_NO_THREAD_SAFETY_ANALYSIS {
+    return *shards_[GetShardIndex(internal_id)];
+  }
+  // Runs `search` over every graph, in parallel on the reader threads when
+  // there are several, and merges their `count` best matches.
+  absl::StatusOr<std::priority_queue<std::pair<float, hnswlib::labeltype>>>
+  SearchShards(uint64_t count,
+               absl::FunctionRef<
+                   std::priority_queue<std::pair<float, hnswlib::labeltype>>(
+                       hnswlib::HierarchicalNSW<float>&)>
+                   search) const ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  std::priority_queue<std::pair<float, hnswlib::labeltype>> Rerank(
+      absl::string_view query,
+      std::priority_queue<std::pair<float, hnswlib::labeltype>> candidates,
+      uint64_t count) const ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  // The vectors are partitioned across independent graphs by internal id,
+  // a single one unless the index was created with SHARDS. The graphs share
+  // the spaces and the quantizer.
+  std::vector<std::unique_ptr<hnswlib::HierarchicalNSW<float>>> shards_
       ABSL_GUARDED_BY(resize_mutex_);
-  std::unique_ptr<hnswlib::SpaceInterface<T>> space_;
+  std::unique_ptr<hnswlib::SpaceInterface<float>> space_;
+  // Set when the graph is built over INT8 codes. space_ is then only used to
+  // re-rank candidates against the full precision vectors.
+  // Binary vectors are never quantized, the float instantiation only stands in
+  // for their element type, which has no float conversion.
+  using QuantizedSpace = hnswlib::SQ8Space<
+      std::conditional_t<std::is_same_v<T, hnswlib::bit8>, float, T>>;
+  std::unique_ptr<QuantizedSpace> quantized_space_;
+  // Whether a quantized index keeps the tracked full vectors to re-rank the
+  // candidates, as INT8 does. INT8_CODES_ONLY drops them.
+  bool rerank_quantized_{false};
+  // Set once the quantization ranges are fit, they no longer change.
+  std::atomic<bool> quantizer_fit_{false};
+  // Set when the graph is built over a prefix of the dimensions instead.
+  using PrefixSpace = hnswlib::PrefixSpace<
+      std::conditional_t<std::is_same_v<T, hnswlib::bit8>, float, T>>;
+  std::unique_ptr<PrefixSpace> prefix_space_;
+  // The space and encoder of the codes the graph is built over, either of the
+  // above, or null when it is built over the full vectors.
+  hnswlib::SpaceInterface<float>* code_space_{nullptr};
+  const hnswlib::VectorQuantizer* quantizer_{nullptr};
   mutable absl::Mutex resize_mutex_;
   mutable absl::Mutex tracked_vectors_mutex_;
-  std::deque<InternedStringPtr> tracked_vectors_
+  absl::flat_hash_map<uint64_t, InternedStringPtr> tracked_vectors_
       ABSL_GUARDED_BY(tracked_vectors_mutex_);
+  // Cleared when the graph drops the full vectors.
+  bool track_vectors_ ABSL_GUARDED_BY(tracked_vectors_mutex_){true};
+  // Vectors which are no longer tracked but may still be referenced by a
+  // deleted or not yet updated graph element. Released by ConsolidateDeletes.
+  std::vector<InternedStringPtr> retired_vectors_
+      ABSL_GUARDED_BY(tracked_vectors_mutex_);
+  std::atomic<bool> consolidation_pending_{false};
+  // Position of RepairDeletedLinks in the claimed consolidation. Elements
+  // added behind it are left to ConsolidateDeletes.
+  size_t repair_shard_ ABSL_GUARDED_BY(resize_mutex_){0};
+  hnswlib::tableint repair_element_ ABSL_GUARDED_BY(resize_mutex_){0};
+  std::atomic<uint64_t> reclaimed_bytes_{0};
+  std::atomic<bool> reorder_pending_{false};
+  // Number of graph elements at the last reordering.
+  std::atomic<size_t> reordered_element_count_{0};
+  // Renumbered copies of the shards built by PrepareReorder, null for the
+  // shards too small to reorder.
+  using ReorderedCopy = hnswlib::HierarchicalNSW<float>::ReorderedCopy;
+  std::vector<std::unique_ptr<ReorderedCopy>> reordered_copies_
+      ABSL_GUARDED_BY(resize_mutex_);
 };
 
 }  // namespace valkey_search::indexes
@@ -0,0 +1,972 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#include "src/indexes/vector_ivf.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <random>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "src/attribute_data_type.h"
+#include "src/index_schema.pb.h"
+#include "src/indexes/index_base.h"
+#include "src/indexes/kmeans.h"
+#include "src/indexes/pq_fast_scan.h"
+#include "src/indexes/product_quantizer.h"
+#include "src/indexes/vector_base.h"
+#include "src/rdb_serialization.h"
+#include "src/utils/cancel.h"
+#include "src/utils/string_interning.h"
+#include "vmsdk/src/log.h"
+#include "vmsdk/src/status/status_macros.h"
+#include "vmsdk/src/valkey_module_api/valkey_module.h"
+
+// Note that the ordering matters here - we want to minimize the memory
+// overrides to just the hnswlib code.
+// clang-format off
+#include "vmsdk/src/memory_allocation_overrides.h"  // IWYU pragma: keep
+#include "third_party/hnswlib/hnswlib.h"
+#include "third_party/hnswlib/space_half.h"
+#include "third_party/hnswlib/space_ip.h"
+#include "third_party/hnswlib/space_l2.h"
+// clang-format on
+
+namespace valkey_search::indexes {
+
+namespace {
+// The centroids are trained once the index holds this many vectors per list.
+constexpr size_t kTrainingVectorsPerList{32};
+// Upper bound of the training sample size, per list.
+constexpr size_t kMaxTrainingVectorsPerList{64};
+constexpr uint64_t kTrainingSeed{0x1f5};
+// The vectors indexed while training are assigned to the trained lists in at
+// most this many rounds without holding the index lock, until no more than
+// kTrainingCatchUpVectors are left to assign while holding it.
+constexpr size_t kMaxTrainingCatchUpRounds{4};
+constexpr size_t kTrainingCatchUpVectors{1024};
+constexpr size_t kCancellationCheckInterval{256};
+
+float InnerProduct(const float *a, const float *b, size_t dimensions) {
+  float product = 0.0f;
+  for (size_t d = 0; d < dimensions; ++d) {
+    product += a[d] * b[d];
+  }
+  return product;
+}
+}  // namespace
+
+template <typename T>
+absl::StatusOr<std::shared_ptr<VectorIVF<T>>> VectorIVF<T>::Create(
+    const data_model::VectorIndex &vector_index_proto,
+    absl::string_view attribute_identifier,
+    data_model::AttributeDataType attribute_data_type) {
+  if (vector_index_proto.ivf_algorithm().nlist() == 0 ||
+      vector_index_proto.ivf_algorithm().nprobe() == 0) {
+    return absl::InvalidArgumentError(
+        "IVF index requires positive NLIST and NPROBE values");
+  }
+  const auto &ivf_algorithm = vector_index_proto.ivf_algorithm();
+  if (ivf_algorithm.pq_m() > 0 &&
+      vector_index_proto.dimension_count() % ivf_algorithm.pq_m() != 0) {
+    return absl::InvalidArgumentError(
+        "IVF index requires PQ_M to divide the vector dimensions");
+  }
+  const uint32_t pq_nbits = ivf_algorithm.pq_nbits() == 0
+                                ? ProductQuantizer::kDefaultBits
+                                : ivf_algorithm.pq_nbits();
+  if (pq_nbits != 4 && pq_nbits != 8) {
+    return absl::InvalidArgumentError(
+        "IVF index requires PQ_NBITS to be 4 or 8");
+  }
+  auto index = std::shared_ptr<VectorIVF<T>>(new VectorIVF<T>(
+      vector_index_proto.dimension_count(),
+      vector_index_proto.distance_metric(), ivf_algorithm.nlist(),
+      ivf_algorithm.nprobe(), ivf_algorithm.pq_m(), ivf_algorithm.pq_rerank(),
+      pq_nbits, attribute_identifier, attribute_data_type));
+  index->template Init<T>(vector_index_proto.dimension_count(),
+                          vector_index_proto.distance_metric(), index->space_);
+  index->InitCentroidSpace();
+  return index;
+}
+
+template <typename T>
+absl::StatusOr<std::shared_ptr<VectorIVF<T>>> VectorIVF<T>::LoadFromRDB(
+    ValkeyModuleCtx *ctx, const AttributeDataType *attribute_data_type,
+    const data_model::VectorIndex &vector_index_proto,
+    absl::string_view attribute_identifier,
+    SupplementalContentChunkIter &&iter) {
+  VMSDK_ASSIGN_OR_RETURN(
+      auto index, Create(vector_index_proto, attribute_identifier,
+                         attribute_data_type->ToProto()));
+  RDBChunkInputStream input(std::move(iter));
+  VMSDK_ASSIGN_OR_RETURN(auto serialized_header, input.LoadChunk());
+  data_model::IVFIndexHeader header;
+  if (!header.ParseFromString(*serialized_header)) {
+    return absl::InternalError("Could not deserialize IVF header");
+  }
+  const uint32_t pq_nbits = header.pq_nbits() == 0
+                                ? ProductQuantizer::kDefaultBits
+                                : header.pq_nbits();
+  if (header.dimension_count() != vector_index_proto.dimension_count() ||
+      header.nlist() != index->nlist_ || header.pq_m() != index->pq_m_ ||
+      (index->pq_m_ > 0 && pq_nbits != index->pq_nbits_)) {
+    return absl::InternalError(
+        "Persisted IVF header does not match the index definition");
+  }
+  absl::WriterMutexLock lock(&index->index_mutex_);
+  if (header.trained()) {
+    VMSDK_ASSIGN_OR_RETURN(auto centroids, input.LoadChunk());
+    if (centroids->size() !=
+        index->nlist_ * index->dimensions_ * sizeof(float)) {
+      return absl::InternalError("Persisted IVF centroids size mismatch");
+    }
+    index->centroids_.resize(index->nlist_ * index->dimensions_);
+    std::memcpy(index->centroids_.data(), centroids->data(),
+                centroids->size());
+    index->lists_.resize(index->nlist_);
+    if (index->pq_m_ > 0) {
+      VMSDK_ASSIGN_OR_RETURN(auto codebooks, input.LoadChunk());
+      index->pq_.emplace(index->dimensions_, index->pq_m_, index->pq_nbits_);
+      VMSDK_RETURN_IF_ERROR(index->pq_->LoadCodebooks(*codebooks));
+    }
+  }
+  if (header.codes_only()) {
+    index->keep_vectors_ = false;
+    index->track_vectors_ = false;
+  }
+  const size_t vector_size =
+      index->keep_vectors_ ? index->GetVectorDataSize() : 0;
+  const size_t code_size = index->pq_ ? index->pq_->GetCodeSize() : 0;
+  const size_t code_offset = vector_size + sizeof(uint64_t) + sizeof(uint32_t);
+  std::vector<uint8_t> code(code_size);
+  for (uint64_t i = 0; i < header.element_count(); ++i) {
+    VMSDK_ASSIGN_OR_RETURN(auto chunk, input.LoadChunk());
+    if (chunk->size() != code_offset + code_size) {
+      return absl::InternalError("Persisted IVF element size mismatch");
+    }
+    uint64_t internal_id;
+    uint32_t list;
+    std::memcpy(&internal_id, chunk->data() + vector_size, sizeof(uint64_t));
+    std::memcpy(&list, chunk->data() + vector_size + sizeof(uint64_t),
+                sizeof(uint32_t));
+    if (list >= index->lists_.size()) {
+      return absl::InternalError(
+          absl::StrCat("Persisted IVF list is out of range: ", list));
+    }
+    std::memcpy(code.data(), chunk->data() + code_offset, code_size);
+    char *vector = nullptr;
+    if (vector_size > 0) {
+      vector = index->VectorBase::TrackVector(internal_id, chunk->data(),
+                                              vector_size);
+    }
+    index->Append(internal_id, vector, list, code);
+  }
+  return index;
+}
+
+template <typename T>
+VectorIVF<T>::VectorIVF(
+    int dimensions, valkey_search::data_model::DistanceMetric distance_metric,
+    uint32_t nlist, uint32_t nprobe, uint32_t pq_m, uint32_t pq_rerank,
+    uint32_t pq_nbits, absl::string_view attribute_identifier,
+    data_model::AttributeDataType attribute_data_type)
+    : VectorBase(IndexerType::kIVF, dimensions, VectorDataTypeOf<T>(),
+                 attribute_data_type, attribute_identifier),
+      nlist_(nlist),
+      nprobe_(nprobe),
+      pq_m_(pq_m),
+      pq_rerank_(pq_rerank),
+      pq_nbits_(pq_nbits),
+      lists_(1) {}
+
+template <typename T>
+void VectorIVF<T>::InitCentroidSpace() {
+  if (distance_metric_ == data_model::DistanceMetric::DISTANCE_METRIC_L2) {
+    centroid_space_ = std::make_unique<hnswlib::L2Space>(dimensions_);
+  } else {
+    centroid_space_ =
+        std::make_unique<hnswlib::InnerProductSpace>(dimensions_);
+  }
+}
+
+template <typename T>
+std::vector<float> VectorIVF<T>::ToFloatVector(const char *vector) const {
+  std::vector<float> result(dimensions_);
+  if constexpr (std::is_same_v<T, float>) {
+    std::memcpy(result.data(), vector, dimensions_ * sizeof(float));
+  } else {
+    const T *elements = reinterpret_cast<const T *>(vector);
+    for (int i = 0; i < dimensions_; ++i) {
+      result[i] = hnswlib::ToFloat(elements[i]);
+    }
+  }
+  return result;
+}
+
+template <typename T>
+uint32_t VectorIVF<T>::AssignList(const char *vector,
+                                  std::vector<uint8_t> &code) const {
+  if (!IsTrainedLocked()) {
+    return 0;
+  }
+  if (pq_) {
+    code.resize(pq_->GetCodeSize());
+  }
+  return AssignList(vector, centroids_, pq_ ? &*pq_ : nullptr, code.data());
+}
+
+template <typename T>
+uint32_t VectorIVF<T>::AssignList(const char *vector,
+                                  const std::vector<float> &centroids,
+                                  const ProductQuantizer *pq,
+                                  uint8_t *code) const {
+  auto float_vector = ToFloatVector(vector);
+  uint32_t list = NearestCentroid(float_vector.data(), centroids, dimensions_,
+                                  centroid_space_.get());
+  if (pq) {
+    const float *centroid = &centroids[list * dimensions_];
+    for (int d = 0; d < dimensions_; ++d) {
+      float_vector[d] -= centroid[d];
+    }
+    pq->Encode(float_vector.data(), code);
+  }
+  return list;
+}
+
+template <typename T>
+void VectorIVF<T>::Append(uint64_t internal_id, char *vector, uint32_t list,
+                          absl::Span<const uint8_t> code) {
+  auto &posting_list = lists_[list];
+  const size_t offset = posting_list.ids.size();
+  locations_[internal_id] = {.list = list,
+                             .offset = static_cast<uint32_t>(offset)};
+  if (keep_vectors_) {
+    posting_list.vectors.push_back(vector);
+  }
+  posting_list.ids.push_back(internal_id);
+  if (pq_) {
+    ResizeCodes(posting_list, offset + 1);
+    StoreCode(posting_list, offset, code.data());
+  }
+}
+
+template <typename T>
+absl::Status VectorIVF<T>::Erase(uint64_t internal_id) {
+  auto it = locations_.find(internal_id);
+  if (it == locations_.end()) {
+    return absl::InternalError(
+        absl::StrCat("Couldn't find internal id: ", internal_id));
+  }
+  auto [list, offset] = it->second;
+  locations_.erase(it);
+  // Keep the posting list dense by moving its last element into the hole.
+  auto &posting_list = lists_[list];
+  const uint32_t last = posting_list.ids.size() - 1;
+  if (offset != last) {
+    if (keep_vectors_) {
+      posting_list.vectors[offset] = posting_list.vectors[last];
+    }
+    posting_list.ids[offset] = posting_list.ids[last];
+    if (pq_) {
+      std::vector<uint8_t> code(pq_->GetCodeSize());
+      LoadCode(posting_list, last, code.data());
+      StoreCode(posting_list, offset, code.data());
+    }
+    locations_[posting_list.ids[offset]].offset = offset;
+  }
+  if (keep_vectors_) {
+    posting_list.vectors.pop_back();
+  }
+  posting_list.ids.pop_back();
+  if (pq_) {
+    ResizeCodes(posting_list, last);
+  }
+  return absl::OkStatus();
+}
+
+template <typename T>
+void VectorIVF<T>::ResizeCodes(PostingList &posting_list, size_t size) const {
+  if (pq_->GetBits() == 4) {
+    const size_t blocks = (size + kFastScanBlockSize - 1) / kFastScanBlockSize;
+    posting_list.codes.resize(blocks * GetFastScanBlockBytes(pq_->GetM()));
+  } else {
+    posting_list.codes.resize(size * pq_->GetCodeSize());
+  }
+}
+
+template <typename T>
+void VectorIVF<T>::StoreCode(PostingList &posting_list, size_t offset,
+                             const uint8_t *code) const {
+  if (pq_->GetBits() == 4) {
+    const size_t block_bytes = GetFastScanBlockBytes(pq_->GetM());
+    PackFastScanCode(
+        code, pq_->GetM(), offset % kFastScanBlockSize,
+        &posting_list.codes[offset / kFastScanBlockSize * block_bytes]);
+  } else {
+    std::memcpy(&posting_list.codes[offset * pq_->GetCodeSize()], code,
+                pq_->GetCodeSize());
+  }
+}
+
+template <typename T>
+void VectorIVF<T>::LoadCode(const PostingList &posting_list, size_t offset,
+                            uint8_t *code) const {
+  if (pq_->GetBits() == 4) {
+    const size_t block_bytes = GetFastScanBlockBytes(pq_->GetM());
+    UnpackFastScanCode(
+        &posting_list.codes[offset / kFastScanBlockSize * block_bytes],
+        pq_->GetM(), offset % kFastScanBlockSize, code);
+  } else {
+    std::memcpy(code, &posting_list.codes[offset * pq_->GetCodeSize()],
+                pq_->GetCodeSize());
+  }
+}
+
+template <typename T>
+bool VectorIVF<T>::IsTrained() const {
+  absl::ReaderMutexLock lock(&index_mutex_);
+  return IsTrainedLocked();
+}
+
+template <typename T>
+bool VectorIVF<T>::KeepsVectors() const {
+  absl::ReaderMutexLock lock(&index_mutex_);
+  return keep_vectors_;
+}
+
+template <typename T>
+size_t VectorIVF<T>::GetCapacity() const {
+  absl::ReaderMutexLock lock(&index_mutex_);
+  return locations_.size();
+}
+
+template <typename T>
+VectorBase::InlineSearchEstimate VectorIVF<T>::EstimateInlineSearch(
+    uint64_t k, double selectivity, std::optional<size_t> search_width) const {
+  absl::ReaderMutexLock lock(&index_mutex_);
+  size_t element_count = locations_.size();
+  if (!IsTrainedLocked()) {
+    // All the vectors are held by a single list until the index is trained.
+    return {element_count, element_count};
+  }
+  size_t probes = std::min<size_t>(search_width.value_or(nprobe_), nlist_);
+  size_t scanned = element_count * probes / nlist_;
+  if (scanned * selectivity < k) {
+    // The probed lists hold fewer than k matches, so the search loses recall.
+    // Cost it as a scan of the whole index rather than as a cheap search.
+    return {element_count, element_count};
+  }
+  // Every vector of the probed lists is filtered, and the query is compared
+  // with the centroids and with the vectors that passed the filter.
+  return {nlist_ + static_cast<size_t>(scanned * selectivity), scanned};
+}
+
+template <typename T>
+void VectorIVF<T>::TrackVector(uint64_t internal_id,
+                               const InternedStringPtr &vector) {
+  absl::MutexLock lock(&tracked_vectors_mutex_);
+  if (!track_vectors_) {
+    return;
+  }
+  tracked_vectors_[internal_id] = vector;
+}
+
+template <typename T>
+bool VectorIVF<T>::IsVectorMatch(uint64_t internal_id,
+                                 const InternedStringPtr &vector) {
+  {
+    absl::MutexLock lock(&tracked_vectors_mutex_);
+    if (track_vectors_) {
+      auto it = tracked_vectors_.find(internal_id);
+      if (it == tracked_vectors_.end()) {
+        return false;
+      }
+      return it->second->Str() == vector->Str();
+    }
+  }
+  // Only the codes are left. A vector encoding to the same list and code
+  // changes nothing in the index.
+  absl::ReaderMutexLock lock(&index_mutex_);
+  auto it = locations_.find(internal_id);
+  if (it == locations_.end()) {
+    return false;
+  }
+  std::vector<uint8_t> code;
+  std::vector<uint8_t> stored_code(pq_->GetCodeSize());
+  uint32_t list = AssignList(vector->Str().data(), code);
+  LoadCode(lists_[it->second.list], it->second.offset, stored_code.data());
+  return list == it->second.list && code == stored_code;
+}
+
+template <typename T>
+void VectorIVF<T>::UnTrackVector(uint64_t internal_id) {
+  absl::MutexLock lock(&tracked_vectors_mutex_);
+  tracked_vectors_.erase(internal_id);
+}
+
+template <typename T>
+absl::Status VectorIVF<T>::AddRecordImpl(uint64_t internal_id,
+                                         absl::string_view record) {
+  char *vector = const_cast<char *>(record.data());
+  bool trained;
+  uint32_t list;
+  std::vector<uint8_t> code;
+  // The closest centroid is looked up under the shared lock, so that
+  // concurrent writers only serialize on the append itself.
+  {
+    absl::ReaderMutexLock lock(&index_mutex_);
+    trained = IsTrainedLocked();
+    list = AssignList(vector, code);
+  }
+  {
+    absl::WriterMutexLock lock(&index_mutex_);
+    if (locations_.contains(internal_id)) {
+      return absl::InternalError(
+          absl::StrCat("Internal id already exists: ", internal_id));
+    }
+    if (trained != IsTrainedLocked()) {
+      list = AssignList(vector, code);
+    }
+    Append(internal_id, vector, list, code);
+  }
+  return absl::OkStatus();
+}
+
+template <typename T>
+absl::Status VectorIVF<T>::ModifyRecordImpl(uint64_t internal_id,
+                                            absl::string_view record) {
+  char *vector = const_cast<char *>(record.data());
+  bool trained;
+  uint32_t list;
+  std::vector<uint8_t> code;
+  {
+    absl::ReaderMutexLock lock(&index_mutex_);
+    trained = IsTrainedLocked();
+    list = AssignList(vector, code);
+  }
+  absl::WriterMutexLock lock(&index_mutex_);
+  if (trained != IsTrainedLocked()) {
+    list = AssignList(vector, code);
+  }
+  VMSDK_RETURN_IF_ERROR(Erase(internal_id));
+  Append(internal_id, vector, list, code);
+  return absl::OkStatus();
+}
+
+template <typename T>
+absl::Status VectorIVF<T>::RemoveRecordImpl(uint64_t internal_id) {
+  absl::WriterMutexLock lock(&index_mutex_);
+  return Erase(internal_id);
+}
+
+template <typename T>
+size_t VectorIVF<T>::GetTrainingClusters() const {
+  // Every product quantization codebook is trained with k-means as well, so
+  // a product quantized index needs enough vectors for its codebooks too.
+  if (pq_m_ > 0) {
+    return std::max<size_t>(nlist_, size_t{1} << pq_nbits_);
+  }
+  return nlist_;
+}
+
+template <typename T>
+bool VectorIVF<T>::ClaimTraining() {
+  {
+    absl::ReaderMutexLock lock(&index_mutex_);
+    if (IsTrainedLocked() ||
+        lists_[0].ids.size() <
+            GetTrainingClusters() * kTrainingVectorsPerList) {
+      return false;
+    }
+  }
+  return !training_.exchange(true);
+}
+
+template <typename T>
+std::vector<std::pair<uint64_t, InternedStringPtr>>
+VectorIVF<T>::SnapshotTrackedVectors() const {
+  absl::MutexLock lock(&tracked_vectors_mutex_);
+  return {tracked_vectors_.begin(), tracked_vectors_.end()};
+}
+
+template <typename T>
+absl::Status VectorIVF<T>::Train() {
+  // The snapshot holds references to the vectors, so that they outlive the
+  // records removed while training.
+  auto vectors = SnapshotTrackedVectors();
+  if (vectors.size() < GetTrainingClusters()) {
+    // Most of the records were removed since the training was claimed.
+    training_ = false;
+    return absl::OkStatus();
+  }
+  // Sort first, so that the sample does not depend on the hash map order.
+  std::sort(vectors.begin(), vectors.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+  std::mt19937_64 rng(kTrainingSeed);
+  std::shuffle(vectors.begin(), vectors.end(), rng);
+  const size_t sample_count = std::min(
+      vectors.size(), GetTrainingClusters() * kMaxTrainingVectorsPerList);
+  std::vector<float> sample;
+  sample.reserve(sample_count * dimensions_);
+  for (size_t i = 0; i < sample_count; ++i) {
+    auto vector = ToFloatVector(vectors[i].second->Str().data());
+    sample.insert(sample.end(), vector.begin(), vector.end());
+  }
+  VMSDK_LOG(NOTICE, nullptr)
+      << "Training IVF index centroids, lists: " << nlist_
+      << ", sample size: " << sample_count;
+  auto centroids = TrainKMeans(
+      sample.data(), sample_count, dimensions_, nlist_, centroid_space_.get(),
+      {.spherical = distance_metric_ !=
+                    data_model::DistanceMetric::DISTANCE_METRIC_L2,
+       .seed = kTrainingSeed});
+  std::optional<ProductQuantizer> pq;
+  if (pq_m_ > 0) {
+    // The codebooks are trained on the residuals of the sample from their
+    // centroids, which is what the posting lists encode.
+    for (size_t i = 0; i < sample_count; ++i) {
+      float *vector = &sample[i * dimensions_];
+      const float *centroid =
+          &centroids[NearestCentroid(vector, centroids, dimensions_,
+                                     centroid_space_.get()) *
+                     dimensions_];
+      for (int d = 0; d < dimensions_; ++d) {
+        vector[d] -= centroid[d];
+      }
+    }
+    pq.emplace(dimensions_, pq_m_, pq_nbits_);
+    pq->Train(sample.data(), sample_count, kTrainingSeed);
+  }
+  sample = {};
+
+  // Assign the vectors to their lists without holding the index lock. The
+  // vectors indexed meanwhile are assigned in a few more rounds, so that only
+  // a bounded number of them is left for the writer section below.
+  struct Assignment {
+    InternedStringPtr vector;
+    uint32_t list;
+    size_t code_offset;
+  };
+  const size_t code_size = pq ? pq->GetCodeSize() : 0;
+  absl::flat_hash_map<uint64_t, Assignment> assignments;
+  std::vector<uint8_t> codes;
+  auto assign = [&](uint64_t internal_id, const InternedStringPtr &vector) {
+    auto [it, inserted] = assignments.try_emplace(internal_id);
+    if (!inserted && it->second.vector == vector) {
+      return false;
+    }
+    if (inserted) {
+      it->second.code_offset = codes.size();
+      codes.resize(codes.size() + code_size);
+    }
+    it->second.vector = vector;
+    it->second.list =
+        AssignList(vector->Str().data(), centroids, pq ? &*pq : nullptr,
+                   codes.data() + it->second.code_offset);
+    return true;
+  };
+  for (const auto &[internal_id, vector] : vectors) {
+    assign(internal_id, vector);
+  }
+  vectors = {};
+  for (size_t round = 0; round < kMaxTrainingCatchUpRounds; ++round) {
+    size_t assigned = 0;
+    for (const auto &[internal_id, vector] : SnapshotTrackedVectors()) {
+      assigned += assign(internal_id, vector);
+    }
+    if (assigned <= kTrainingCatchUpVectors) {
+      break;
+    }
+  }
+
+  // Released once the locks are, if the index stops keeping the vectors.
+  absl::flat_hash_map<uint64_t, InternedStringPtr> released_vectors;
+  absl::WriterMutexLock lock(&index_mutex_);
+  absl::MutexLock tracked_vectors_lock(&tracked_vectors_mutex_);
+  centroids_ = std::move(centroids);
+  pq_ = std::move(pq);
+  PostingList untrained = std::move(lists_[0]);
+  lists_.assign(nlist_, PostingList());
+  std::vector<uint8_t> code(code_size);
+  for (size_t i = 0; i < untrained.ids.size(); ++i) {
+    const uint64_t internal_id = untrained.ids[i];
+    char *vector = untrained.vectors[i];
+    auto it = assignments.find(internal_id);
+    if (it != assignments.end() &&
+        it->second.vector->Str().data() == vector) {
+      Append(internal_id, vector, it->second.list,
+             {codes.data() + it->second.code_offset, code_size});
+      continue;
+    }
+    auto tracked = tracked_vectors_.find(internal_id);
+    if (tracked != tracked_vectors_.end() &&
+        tracked->second->Str().data() == vector) {
+      Append(internal_id, vector, AssignList(vector, code), code);
+    } else {
+      // The record is being removed or modified, so its vector may already
+      // be released. It is kept in place until it is erased.
+      Append(internal_id, vector, 0, code);
+    }
+  }
+  if (keep_vectors_ && pq_ && pq_rerank_ == 0) {
+    // Without re-ranking, only the codes are used from now on.
+    keep_vectors_ = false;
+    for (auto &posting_list : lists_) {
+      posting_list.vectors = {};
+    }
+    track_vectors_ = false;
+    released_vectors = std::move(tracked_vectors_);
+    tracked_vectors_.clear();
+  }
+  training_ = false;
+  return absl::OkStatus();
+}
+
+template <typename T>
+absl::StatusOr<std::vector<Neighbor>> VectorIVF<T>::Search(
+    absl::string_view query, uint64_t count, cancel::Token &cancellation_token,
+    std::unique_ptr<hnswlib::BaseFilterFunctor> filter,
+    std::optional<size_t> nprobe) {
+  if (!IsValidSizeVector(query)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Error parsing vector similarity query: query vector blob size (",
+        query.size(), ") does not match index's expected size (",
+        GetVectorDataSize(), ")."));
+  }
+  std::vector<char> norm_record;
+  if (normalize_) {
+    norm_record = NormalizeEmbedding(query, data_type_);
+    query = absl::string_view(norm_record.data(), norm_record.size());
+  }
+  auto dist_func = space_->get_dist_func();
+  auto *dist_func_param = space_->get_dist_func_param();
+  auto perform_search = [&](uint64_t search_count)
+      -> absl::StatusOr<
+          std::priority_queue<std::pair<float, hnswlib::labeltype>>> {
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> search_result;
+    auto add_result = [&](float distance, uint64_t internal_id) {
+      if (search_result.size() < search_count) {
+        search_result.emplace(distance, internal_id);
+      } else if (!search_result.empty() &&
+                 distance < search_result.top().first) {
+        search_result.pop();
+        search_result.emplace(distance, internal_id);
+      }
+    };
+    {
+      absl::ReaderMutexLock lock(&index_mutex_);
+      std::vector<uint32_t> probes{0};
+      std::vector<float> float_query;
+      if (IsTrainedLocked()) {
+        float_query = ToFloatVector(query.data());
+        probes = NearestCentroids(float_query.data(), centroids_, dimensions_,
+                                  nprobe.value_or(nprobe_),
+                                  centroid_space_.get());
+      }
+      if (pq_) {
+        auto candidates = ScanCodes(float_query, probes,
+                                    search_count *
+                                        std::max<uint32_t>(pq_rerank_, 1),
+                                    cancellation_token, filter.get());
+        while (!candidates.empty()) {
+          auto [distance, internal_id, vector] = candidates.top();
+          candidates.pop();
+          if (pq_rerank_ > 0) {
+            distance = dist_func(query.data(), vector, dist_func_param);
+          }
+          add_result(distance, internal_id);
+        }
+      } else {
+        size_t scanned = 0;
+        bool cancelled = false;
+        for (size_t p = 0; p < probes.size() && !cancelled; ++p) {
+          const auto &posting_list = lists_[probes[p]];
+          for (size_t i = 0; i < posting_list.ids.size(); ++i) {
+            if (++scanned % kCancellationCheckInterval == 0 &&
+                cancellation_token->IsCancelled()) {
+              cancelled = true;
+              break;
+            }
+            const uint64_t internal_id = posting_list.ids[i];
+            if (filter && !(*filter)(internal_id)) {
+              continue;
+            }
+            add_result(dist_func(query.data(), posting_list.vectors[i],
+                                 dist_func_param),
+                       internal_id);
+          }
+        }
+      }
+    }
+    return search_result;
+  };
+  return SearchKeys(count, perform_search);
+}
+
+template <typename T>
+std::priority_queue<std::tuple<float, uint64_t, const char *>>
+VectorIVF<T>::ScanCodes(const std::vector<float> &query,
+                        const std::vector<uint32_t> &probes, size_t candidates,
+                        cancel::Token &cancellation_token,
+                        hnswlib::BaseFilterFunctor *filter) const {
+  std::priority_queue<std::tuple<float, uint64_t, const char *>> result;
+  const bool is_l2 =
+      distance_metric_ == data_model::DistanceMetric::DISTANCE_METRIC_L2;
+  const size_t code_size = pq_->GetCodeSize();
+  std::vector<float> table(pq_->GetTableSize());
+  std::vector<float> residual(dimensions_);
+  if (!is_l2) {
+    // <q, c + r> = <q, c> + <q, r>, so a single table of the query against
+    // the residual codebooks serves every probed list.
+    pq_->ComputeNegativeIPTable(query.data(), table.data());
+  }
+  size_t scanned = 0;
+  for (uint32_t list : probes) {
+    const float *centroid = &centroids_[list * dimensions_];
+    float base = 0.0f;
+    if (is_l2) {
+      for (int d = 0; d < dimensions_; ++d) {
+        residual[d] = query[d] - centroid[d];
+      }
+      pq_->ComputeL2Table(residual.data(), table.data());
+    } else {
+      base = 1.0f - InnerProduct(query.data(), centroid, dimensions_);
+    }
+    const auto &posting_list = lists_[list];
+    const size_t size = posting_list.ids.size();
+    auto add_candidate = [&](float distance, size_t i) {
+      const char *vector = keep_vectors_ ? posting_list.vectors[i] : nullptr;
+      if (result.size() < candidates) {
+        result.emplace(distance, posting_list.ids[i], vector);
+      } else if (!result.empty() && distance < std::get<0>(result.top())) {
+        result.pop();
+        result.emplace(distance, posting_list.ids[i], vector);
+      }
+    };
+    if (pq_->GetBits() == 4) {
+      // The block distances are approximate. The exact table distance is
+      // only computed for the codes which may make it into the candidates.
+      FastScanTable fast_scan_table(table.data(), pq_->GetM());
+      const float max_error = fast_scan_table.GetMaxError();
+      const size_t block_bytes = GetFastScanBlockBytes(pq_->GetM());
+      std::vector<uint8_t> code(code_size);
+      float block_distances[kFastScanBlockSize];
+      for (size_t first = 0; first < size; first += kFastScanBlockSize) {
+        scanned += kFastScanBlockSize;
+        if (scanned % kCancellationCheckInterval == 0 &&
+            cancellation_token->IsCancelled()) {
+          return result;
+        }
+        const uint8_t *block =
+            &posting_list.codes[first / kFastScanBlockSize * block_bytes];
+        fast_scan_table.ScanBlock(block, block_distances);
+        const size_t count = std::min(kFastScanBlockSize, size - first);
+        for (size_t j = 0; j < count; ++j) {
+          if (result.size() >= candidates &&
+              base + block_distances[j] - max_error >=
+                  std::get<0>(result.top())) {
+            continue;
+          }
+          if (filter && !(*filter)(posting_list.ids[first + j])) {
+            continue;
+          }
+          UnpackFastScanCode(block, pq_->GetM(), j, code.data());
+          add_candidate(base + pq_->Distance(table.data(), code.data()),
+                        first + j);
+        }
+      }
+      continue;
+    }
+    for (size_t i = 0; i < size; ++i) {
+      if (++scanned % kCancellationCheckInterval == 0 &&
+          cancellation_token->IsCancelled()) {
+        return result;
+      }
+      if (filter && !(*filter)(posting_list.ids[i])) {
+        continue;
+      }
+      const uint8_t *code = &posting_list.codes[i * code_size];
+      add_candidate(base + pq_->Distance(table.data(), code), i);
+    }
+  }
+  return result;
+}
+
+template <typename T>
+absl::StatusOr<std::pair<float, hnswlib::labeltype>>
+VectorIVF<T>::ComputeDistanceFromRecordImpl(uint64_t internal_id,
+                                            absl::string_view query) const {
+  absl::ReaderMutexLock lock(&index_mutex_);
+  auto it = locations_.find(internal_id);
+  if (it == locations_.end()) {
+    return absl::InternalError(
+        absl::StrCat("Couldn't find internal id: ", internal_id));
+  }
+  const auto [list, offset] = it->second;
+  if (!keep_vectors_) {
+    // Only the code is left to compute the distance with.
+    auto float_query = ToFloatVector(query.data());
+    const float *centroid = &centroids_[list * dimensions_];
+    std::vector<float> table(pq_->GetTableSize());
+    float base = 0.0f;
+    if (distance_metric_ == data_model::DistanceMetric::DISTANCE_METRIC_L2) {
+      for (int d = 0; d < dimensions_; ++d) {
+        float_query[d] -= centroid[d];
+      }
+      pq_->ComputeL2Table(float_query.data(), table.data());
+    } else {
+      pq_->ComputeNegativeIPTable(float_query.data(), table.data());
+      base = 1.0f - InnerProduct(float_query.data(), centroid, dimensions_);
+    }
+    std::vector<uint8_t> code(pq_->GetCodeSize());
+    LoadCode(lists_[list], offset, code.data());
+    return (std::pair<float, hnswlib::labeltype>){
+        base + pq_->Distance(table.data(), code.data()), internal_id};
+  }
+  const char *vector = lists_[list].vectors[offset];
+  return (std::pair<float, hnswlib::labeltype>){
+      space_->get_dist_func()(query.data(), vector,
+                              space_->get_dist_func_param()),
+      internal_id};
+}
+
+template <typename T>
+char *VectorIVF<T>::GetValueImpl(uint64_t internal_id) const {
+  absl::ReaderMutexLock lock(&index_mutex_);
+  auto it = locations_.find(internal_id);
+  if (it == locations_.end() || !keep_vectors_) {
+    return nullptr;
+  }
+  return lists_[it->second.list].vectors[it->second.offset];
+}
+
+template <typename T>
+void VectorIVF<T>::ToProtoImpl(
+    data_model::VectorIndex *vector_index_proto) const {
+  vector_index_proto->set_vector_data_type(data_type_);
+
+  auto ivf_algorithm_proto = std::make_unique<data_model::IVFAlgorithm>();
+  ivf_algorithm_proto->set_nlist(nlist_);
+  ivf_algorithm_proto->set_nprobe(nprobe_);
+  ivf_algorithm_proto->set_pq_m(pq_m_);
+  ivf_algorithm_proto->set_pq_rerank(pq_rerank_);
+  ivf_algorithm_proto->set_pq_nbits(pq_nbits_);
+  vector_index_proto->set_allocated_ivf_algorithm(
+      ivf_algorithm_proto.release());
+}
+
+template <typename T>
+int VectorIVF<T>::RespondWithInfoImpl(ValkeyModuleCtx *ctx) const {
+  ValkeyModule_ReplyWithSimpleString(ctx, "algorithm");
+  ValkeyModule_ReplyWithSimpleString(
+      ctx,
+      LookupKeyByValue(*kVectorAlgoByStr,
+                       data_model::VectorIndex::AlgorithmCase::kIvfAlgorithm)
+          .data());
+  ValkeyModule_ReplyWithSimpleString(ctx, "data_type");
+  ValkeyModule_ReplyWithSimpleString(
+      ctx, LookupKeyByValue(*kVectorDataTypeByStr, data_type_).data());
+  ValkeyModule_ReplyWithSimpleString(ctx, "dim");
+  ValkeyModule_ReplyWithLongLong(ctx, dimensions_);
+  ValkeyModule_ReplyWithSimpleString(ctx, "distance_metric");
+  ValkeyModule_ReplyWithSimpleString(
+      ctx, LookupKeyByValue(*kDistanceMetricByStr, distance_metric_).data());
+
+  ValkeyModule_ReplyWithSimpleString(ctx, "nlist");
+  ValkeyModule_ReplyWithLongLong(ctx, nlist_);
+  ValkeyModule_ReplyWithSimpleString(ctx, "nprobe");
+  ValkeyModule_ReplyWithLongLong(ctx, nprobe_);
+  if (pq_m_ == 0) {
+    return 12;
+  }
+  ValkeyModule_ReplyWithSimpleString(ctx, "pq_m");
+  ValkeyModule_ReplyWithLongLong(ctx, pq_m_);
+  ValkeyModule_ReplyWithSimpleString(ctx, "pq_rerank");
+  ValkeyModule_ReplyWithLongLong(ctx, pq_rerank_);
+  ValkeyModule_ReplyWithSimpleString(ctx, "pq_nbits");
+  ValkeyModule_ReplyWithLongLong(ctx, pq_nbits_);
+
+  return 18;
+}
+
+template <typename T>
+absl::Status VectorIVF<T>::SaveIndexImpl(
+    RDBChunkOutputStream chunked_out) const {
+  absl::ReaderMutexLock lock(&index_mutex_);
+  data_model::IVFIndexHeader header;
+  header.set_dimension_count(dimensions_);
+  header.set_nlist(nlist_);
+  header.set_trained(IsTrainedLocked());
+  header.set_element_count(locations_.size());
+  header.set_pq_m(pq_m_);
+  header.set_pq_nbits(pq_nbits_);
+  header.set_codes_only(!keep_vectors_);
+  std::string serialized;
+  if (!header.SerializeToString(&serialized)) {
+    return absl::InternalError("Could not serialize IVF header");
+  }
+  VMSDK_RETURN_IF_ERROR(
+      chunked_out.SaveChunk(serialized.data(), serialized.size()));
+  if (IsTrainedLocked()) {
+    VMSDK_RETURN_IF_ERROR(chunked_out.SaveChunk(
+        reinterpret_cast<const char *>(centroids_.data()),
+        centroids_.size() * sizeof(float)));
+  }
+  if (pq_) {
+    auto codebooks = pq_->GetSerializedCodebooks();
+    VMSDK_RETURN_IF_ERROR(
+        chunked_out.SaveChunk(codebooks.data(), codebooks.size()));
+  }
+  // Each element is saved as its vector, unless only the codes are kept,
+  // followed by its internal id, the posting list it belongs to and, if
+  // product quantized, its code.
+  const size_t vector_size = keep_vectors_ ? GetVectorDataSize() : 0;
+  const size_t code_size = pq_ ? pq_->GetCodeSize() : 0;
+  const size_t code_offset = vector_size + sizeof(uint64_t) + sizeof(uint32_t);
+  std::vector<char> buf(code_offset + code_size);
+  for (uint32_t list = 0; list < lists_.size(); ++list) {
+    const auto &posting_list = lists_[list];
+    for (size_t i = 0; i < posting_list.ids.size(); ++i) {
+      if (keep_vectors_) {
+        std::memcpy(buf.data(), posting_list.vectors[i], vector_size);
+      }
+      std::memcpy(buf.data() + vector_size, &posting_list.ids[i],
+                  sizeof(uint64_t));
+      std::memcpy(buf.data() + vector_size + sizeof(uint64_t), &list,
+                  sizeof(uint32_t));
+      if (code_size > 0) {
+        LoadCode(posting_list, i,
+                 reinterpret_cast<uint8_t *>(buf.data() + code_offset));
+      }
+      VMSDK_RETURN_IF_ERROR(chunked_out.SaveChunk(buf.data(), buf.size()));
+    }
+  }
+  return absl::OkStatus();
+}
+
+template class VectorIVF<float>;
+template class VectorIVF<hnswlib::float16>;
+template class VectorIVF<hnswlib::bfloat16>;
+
+}  // namespace valkey_search::indexes
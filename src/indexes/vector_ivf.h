@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#ifndef VALKEYSEARCH_SRC_INDEXES_VECTOR_IVF_H_
+#define VALKEYSEARCH_SRC_INDEXES_VECTOR_IVF_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "src/attribute_data_type.h"
+#include "src/indexes/product_quantizer.h"
+#include "src/indexes/vector_base.h"
+#include "src/rdb_serialization.h"
+#include "src/utils/cancel.h"
+#include "src/utils/string_interning.h"
+#include "third_party/hnswlib/hnswlib.h"
+#include "vmsdk/src/valkey_module_api/valkey_module.h"
+
+namespace valkey_search::indexes {
+
+// Inverted-file index. Vectors are partitioned into `nlist` posting lists by
+// their closest k-means centroid and a query only scans the `nprobe` lists
+// whose centroids are closest to it. Until enough vectors are indexed to train
+// the centroids, all vectors live in a single list that is scanned
+// exhaustively. The training is claimed from the server cron and runs on the
+// utility pool, see ClaimTraining() and Train().
+//
+// With product quantization (IVF-PQ), the residual of every vector from its
+// centroid is also encoded as `pq_m` codes of `pq_nbits` bits that are stored
+// contiguously in the posting list. The probed lists are then scanned with
+// per-query lookup tables instead of full precision distances, and the best
+// `pq_rerank` * k candidates are re-ranked with the tracked vectors. 4 bit
+// codes are scanned a block at a time with SIMD shuffles, see pq_fast_scan.h.
+// Without re-ranking, the vectors are dropped once the index is trained and
+// only the codes are kept.
+template <typename T>
+class VectorIVF : public VectorBase {
+ public:
+  static absl::StatusOr<std::shared_ptr<VectorIVF<T>>> Create(
+      const data_model::VectorIndex& vector_index_proto,
+      absl::string_view attribute_identifier,
+      data_model::AttributeDataType attribute_data_type)
+      ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  static absl::StatusOr<std::shared_ptr<VectorIVF<T>>> LoadFromRDB(
+      ValkeyModuleCtx* ctx, const AttributeDataType* attribute_data_type,
+      const data_model::VectorIndex& vector_index_proto,
+      absl::string_view attribute_identifier,
+      SupplementalContentChunkIter&& iter) ABSL_NO_THREAD_SAFETY_ANALYSIS;
+  ~VectorIVF() override = default;
+  size_t GetDataTypeSize() const override { return sizeof(T); }
+
+  const hnswlib::SpaceInterface<float>* GetSpace() const {
+    return space_.get();
+  }
+  int GetDimensions() const { return dimensions_; }
+  uint32_t GetNlist() const { return nlist_; }
+  uint32_t GetNprobe() const { return nprobe_; }
+  uint32_t GetPqM() const { return pq_m_; }
+  uint32_t GetPqRerank() const { return pq_rerank_; }
+  uint32_t GetPqNbits() const { return pq_nbits_; }
+  // False once a product quantized index without re-ranking is trained.
+  bool KeepsVectors() const ABSL_LOCKS_EXCLUDED(index_mutex_);
+  bool IsTrained() const ABSL_LOCKS_EXCLUDED(index_mutex_);
+  bool ClaimTraining() override ABSL_LOCKS_EXCLUDED(index_mutex_);
+  absl::Status Train() override
+      ABSL_LOCKS_EXCLUDED(index_mutex_, tracked_vectors_mutex_);
+  size_t GetCapacity() const override ABSL_LOCKS_EXCLUDED(index_mutex_);
+  InlineSearchEstimate EstimateInlineSearch(
+      uint64_t k, double selectivity,
+      std::optional<size_t> search_width) const override
+      ABSL_LOCKS_EXCLUDED(index_mutex_);
+  absl::StatusOr<std::vector<Neighbor>> Search(
+      absl::string_view query, uint64_t count,
+      cancel::Token& cancellation_token,
+      std::unique_ptr<hnswlib::BaseFilterFunctor> filter = nullptr,
+      std::optional<size_t> nprobe = std::nullopt)
+      ABSL_LOCKS_EXCLUDED(index_mutex_);
+
+ protected:
+  absl::Status AddRecordImpl(uint64_t internal_id,
+                             absl::string_view record) override
+      ABSL_LOCKS_EXCLUDED(index_mutex_);
+  absl::Status RemoveRecordImpl(uint64_t internal_id) override
+      ABSL_LOCKS_EXCLUDED(index_mutex_);
+  absl::Status ModifyRecordImpl(uint64_t internal_id,
+                                absl::string_view record) override
+      ABSL_LOCKS_EXCLUDED(index_mutex_);
+  void ToProtoImpl(data_model::VectorIndex* vector_index_proto) const override;
+  int RespondWithInfoImpl(ValkeyModuleCtx* ctx) const override;
+  absl::Status SaveIndexImpl(RDBChunkOutputStream chunked_out) const override
+      ABSL_LOCKS_EXCLUDED(index_mutex_);
+  absl::StatusOr<std::pair<float, hnswlib::labeltype>>
+  ComputeDistanceFromRecordImpl(uint64_t internal_id,
+                                absl::string_view query) const override
+      ABSL_LOCKS_EXCLUDED(index_mutex_);
+  char* GetValueImpl(uint64_t internal_id) const override
+      ABSL_LOCKS_EXCLUDED(index_mutex_);
+  void TrackVector(uint64_t internal_id,
+                   const InternedStringPtr& vector) override
+      ABSL_LOCKS_EXCLUDED(tracked_vectors_mutex_);
+  bool IsVectorMatch(uint64_t internal_id,
+                     const InternedStringPtr& vector) override
+      ABSL_LOCKS_EXCLUDED(tracked_vectors_mutex_);
+  void UnTrackVector(uint64_t internal_id) override
+      ABSL_LOCKS_EXCLUDED(tracked_vectors_mutex_);
+
+ private:
+  // A posting list holds pointers to the tracked (interned) vectors rather
+  // than copies, so that the vectors are stored once, as with FLAT and HNSW.
+  struct PostingList {
+    // Empty once the index no longer keeps the vectors.
+    std::vector<char*> vectors;
+    std::vector<uint64_t> ids;
+    // Product quantization codes, only populated once a product quantized
+    // index is trained. GetCodeSize() bytes per vector with 8 bit codes, and
+    // blocks of kFastScanBlockSize packed codes with 4 bit codes.
+    std::vector<uint8_t> codes;
+  };
+  struct Location {
+    uint32_t list;
+    uint32_t offset;
+  };
+
+  VectorIVF(int dimensions, data_model::DistanceMetric distance_metric,
+            uint32_t nlist, uint32_t nprobe, uint32_t pq_m,
+            uint32_t pq_rerank, uint32_t pq_nbits,
+            absl::string_view attribute_identifier,
+            data_model::AttributeDataType attribute_data_type);
+  void InitCentroidSpace();
+  std::vector<float> ToFloatVector(const char* vector) const;
+  // Returns the posting list of the vector and, for a trained product
+  // quantized index, writes the code of its residual to `code`.
+  uint32_t AssignList(const char* vector, std::vector<uint8_t>& code) const
+      ABSL_SHARED_LOCKS_REQUIRED(index_mutex_);
+  // Same, against the given centroids and quantizer rather than the ones the
+  // index is trained with. `code` holds GetCodeSize() bytes if `pq` is set.
+  uint32_t AssignList(const char* vector, const std::vector<float>& centroids,
+                      const ProductQuantizer* pq, uint8_t* code) const;
+  bool IsTrainedLocked() const ABSL_SHARED_LOCKS_REQUIRED(index_mutex_) {
+    return !centroids_.empty();
+  }
+  void Append(uint64_t internal_id, char* vector, uint32_t list,
+              absl::Span<const uint8_t> code)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(index_mutex_);
+  absl::Status Erase(uint64_t internal_id)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(index_mutex_);
+  // Accessors of the codes of a posting list, in their packed layout.
+  void ResizeCodes(PostingList& posting_list, size_t size) const
+      ABSL_SHARED_LOCKS_REQUIRED(index_mutex_);
+  void StoreCode(PostingList& posting_list, size_t offset,
+                 const uint8_t* code) const
+      ABSL_SHARED_LOCKS_REQUIRED(index_mutex_);
+  void LoadCode(const PostingList& posting_list, size_t offset,
+                uint8_t* code) const ABSL_SHARED_LOCKS_REQUIRED(index_mutex_);
+
+  std::vector<std::pair<uint64_t, InternedStringPtr>> SnapshotTrackedVectors()
+      const ABSL_LOCKS_EXCLUDED(tracked_vectors_mutex_);
+  // Number of clusters the largest k-means run of the training computes.
+  size_t GetTrainingClusters() const;
+  // Scans the probed lists with the product quantization lookup tables and
+  // returns the `candidates` closest elements, farthest first.
+  std::priority_queue<std::tuple<float, uint64_t, const char*>> ScanCodes(
+      const std::vector<float>& query, const std::vector<uint32_t>& probes,
+      size_t candidates, cancel::Token& cancellation_token,
+      hnswlib::BaseFilterFunctor* filter) const
+      ABSL_SHARED_LOCKS_REQUIRED(index_mutex_);
+
+  std::unique_ptr<hnswlib::SpaceInterface<float>> space_;
+  // Float space the centroids are trained and probed in, regardless of the
+  // vector data type.
+  std::unique_ptr<hnswlib::SpaceInterface<float>> centroid_space_;
+  uint32_t nlist_;
+  uint32_t nprobe_;
+  uint32_t pq_m_;
+  uint32_t pq_rerank_;
+  uint32_t pq_nbits_;
+  mutable absl::Mutex index_mutex_;
+  // Row-major centroids, empty until the index is trained.
+  std::vector<float> centroids_ ABSL_GUARDED_BY(index_mutex_);
+  // Set when a product quantized index is trained.
+  std::optional<ProductQuantizer> pq_ ABSL_GUARDED_BY(index_mutex_);
+  std::vector<PostingList> lists_ ABSL_GUARDED_BY(index_mutex_);
+  absl::flat_hash_map<uint64_t, Location> locations_
+      ABSL_GUARDED_BY(index_mutex_);
+  bool keep_vectors_ ABSL_GUARDED_BY(index_mutex_){true};
+  std::atomic<bool> training_{false};
+  mutable absl::Mutex tracked_vectors_mutex_;
+  bool track_vectors_ ABSL_GUARDED_BY(tracked_vectors_mutex_){true};
+  absl::flat_hash_map<uint64_t, InternedStringPtr> tracked_vectors_
+      ABSL_GUARDED_BY(tracked_vectors_mutex_);
+};
+}  // namespace valkey_search::indexes
+
+#endif  // VALKEYSEARCH_SRC_INDEXES_VECTOR_IVF_H_
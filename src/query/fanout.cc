@@ -9,6 +9,7 @@
 
 #include <netinet/in.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
 #include <deque>
@@ -66,23 +67,28 @@ struct NeighborComparator {
 
 // SearchPartitionResultsTracker is a thread-safe class that tracks the results
 // of a query fanout. It aggregates the results from multiple nodes and returns
-// the top k results to the callback.
+// the top k results to the callback. Batched KNN queries are aggregated per
+// query vector.
 struct SearchPartitionResultsTracker {
+  using NeighborQueue =
+      std::priority_queue<indexes::Neighbor, std::vector<indexes::Neighbor>,
+                          NeighborComparator>;
   absl::Mutex mutex;
-  std::priority_queue<indexes::Neighbor, std::vector<indexes::Neighbor>,
-                      NeighborComparator>
-      results ABSL_GUARDED_BY(mutex);
+  // One queue per query vector of a batched query, a single queue otherwise.
+  std::vector<NeighborQueue> results ABSL_GUARDED_BY(mutex);
+  std::vector<size_t> accumulated_total_counts ABSL_GUARDED_BY(mutex);
   int outstanding_requests ABSL_GUARDED_BY(mutex);
   query::SearchResponseCallback callback;
   std::unique_ptr<SearchParameters> parameters ABSL_GUARDED_BY(mutex);
   std::atomic_bool reached_oom{false};
   std::atomic_bool consistency_failed{false};
-  std::atomic<size_t> accumulated_total_count{0};
 
   SearchPartitionResultsTracker(int outstanding_requests, int k,
                                 query::SearchResponseCallback callback,
                                 std::unique_ptr<SearchParameters> parameters)
-      : outstanding_requests(outstanding_requests),
+      : results(std::max<size_t>(parameters->batch_queries.size(), 1)),
+        accumulated_total_counts(results.size(), 0),
+        outstanding_requests(outstanding_requests),
         callback(std::move(callback)),
         parameters(std::move(parameters)) {}
 
@@ -113,8 +119,25 @@ struct SearchPartitionResultsTracker {
     }
 
     absl::MutexLock lock(&mutex);
-    accumulated_total_count.fetch_add(response.total_count(),
-                                      std::memory_order_relaxed);
+    if (parameters->IsBatchedQuery()) {
+      if (static_cast<size_t>(response.batch_responses_size()) !=
+          results.size()) {
+        VMSDK_LOG_EVERY_N_SEC(WARNING, nullptr, 1)
+            << "Unexpected number of batched results from node " << address
+            << ": " << response.batch_responses_size();
+        return;
+      }
+      for (size_t i = 0; i < results.size(); ++i) {
+        AddResponse(*response.mutable_batch_responses(i), i);
+      }
+      return;
+    }
+    AddResponse(response, 0);
+  }
+
+  void AddResponse(coordinator::SearchIndexPartitionResponse &response,
+                   size_t query_index) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+    accumulated_total_counts[query_index] += response.total_count();
     while (response.neighbors_size() > 0) {
       auto neighbor_entry = std::unique_ptr<coordinator::NeighborEntry>(
           response.mutable_neighbors()->ReleaseLast());
@@ -132,36 +155,68 @@ struct SearchPartitionResultsTracker {
       indexes::Neighbor neighbor{
           StringInternStore::Intern(neighbor_entry->key()),
           neighbor_entry->score(), std::move(attribute_contents)};
-      AddResult(neighbor);
+      if (neighbor_entry->has_sort_value()) {
+        neighbor.sort_value = neighbor_entry->sort_value();
+      }
+      AddResult(neighbor, query_index);
     }
   }
 
-  void AddResults(std::vector<indexes::Neighbor> &neighbors) {
+  void AddLocalResult(SearchResult &result) {
     absl::MutexLock lock(&mutex);
-    for (auto &neighbor : neighbors) {
-      AddResult(neighbor);
+    if (parameters->IsBatchedQuery()) {
+      for (size_t i = 0;
+           i < std::min(results.size(), result.batch_results.size()); ++i) {
+        AddLocalQueryResult(result.batch_results[i], i);
+      }
+      return;
     }
+    AddLocalQueryResult(result, 0);
   }
 
-  void AddTotalCount(size_t count) {
-    accumulated_total_count.fetch_add(count, std::memory_order_relaxed);
+  void AddLocalQueryResult(SearchResult &result, size_t query_index)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+    accumulated_total_counts[query_index] += result.total_count;
+    for (auto &neighbor : result.neighbors) {
+      AddResult(neighbor, query_index);
+    }
   }
 
-  void AddResult(indexes::Neighbor &neighbor)
+  void AddResult(indexes::Neighbor &neighbor, size_t query_index)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+    auto &query_results = results[query_index];
     // For non-vector queries, we can add the result directly.
     if (parameters->IsNonVectorQuery()) {
-      results.emplace(std::move(neighbor));
+      query_results.emplace(std::move(neighbor));
       return;
     }
-    if (results.size() < parameters->k) {
-      results.emplace(std::move(neighbor));
-    } else if (neighbor.distance < results.top().distance) {
-      results.emplace(std::move(neighbor));
-      results.pop();
+    if (query_results.size() < parameters->k) {
+      query_results.emplace(std::move(neighbor));
+    } else if (neighbor.distance < query_results.top().distance) {
+      query_results.emplace(std::move(neighbor));
+      query_results.pop();
     }
   }
 
+  SearchResult MakeSearchResult(size_t query_index)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+    auto &query_results = results[query_index];
+    std::vector<indexes::Neighbor> neighbors;
+    while (!query_results.empty()) {
+      neighbors.push_back(
+          std::move(const_cast<indexes::Neighbor &>(query_results.top())));
+      query_results.pop();
+    }
+    if (parameters->sortby.has_value()) {
+      SortNeighbors(neighbors, *parameters->sortby, neighbors.size());
+    }
+    // SearchResult construction automatically applies trimming based on LIMIT
+    // offset count IF the command allows it (ie - it does not require
+    // complete results).
+    return SearchResult(accumulated_total_counts[query_index],
+                        std::move(neighbors), *parameters);
+  }
+
   ~SearchPartitionResultsTracker() {
     absl::MutexLock lock(&mutex);
     absl::StatusOr<SearchResult> result;
@@ -169,18 +224,15 @@ struct SearchPartitionResultsTracker {
       result = absl::FailedPreconditionError(kFailedPreconditionMsg);
     } else if (reached_oom) {
       result = absl::ResourceExhaustedError(kOOMMsg);
-    } else {
-      std::vector<indexes::Neighbor> neighbors;
-      while (!results.empty()) {
-        neighbors.push_back(
-            std::move(const_cast<indexes::Neighbor &>(results.top())));
-        results.pop();
+    } else if (parameters->IsBatchedQuery()) {
+      std::vector<SearchResult> batch_results;
+      batch_results.reserve(results.size());
+      for (size_t i = 0; i < results.size(); ++i) {
+        batch_results.push_back(MakeSearchResult(i));
       }
-      // SearchResult construction automatically applies trimming based on LIMIT
-      // offset count IF the command allows it (ie - it does not require
-      // complete results).
-      result = SearchResult(accumulated_total_count, std::move(neighbors),
-                            *parameters);
+      result = SearchResult(std::move(batch_results));
+    } else {
+      result = MakeSearchResult(0);
     }
     callback(result, std::move(parameters));
   }
@@ -285,8 +337,7 @@ absl::Status PerformSearchFanoutAsync(
         [tracker](absl::StatusOr<SearchResult> &result,
                   std::unique_ptr<SearchParameters> parameters) {
           if (result.ok()) {
-            tracker->AddResults(result->neighbors);
-            tracker->AddTotalCount(result->total_count);
+            tracker->AddLocalResult(result.value());
           } else {
             if (absl::IsResourceExhausted(result.status())) {
               tracker->reached_oom.store(true);
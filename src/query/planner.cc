@@ -7,36 +7,274 @@
 
 #include "src/query/planner.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
 
-#include "absl/log/check.h"
-#include "src/indexes/index_base.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "src/indexes/vector_base.h"
+#include "src/query/predicate.h"
+#include "third_party/hnswlib/space_l2.h"
 
 namespace valkey_search::query {
-// TODO: Tune this parameter.
-constexpr double kPreFilteringThresholdRatio = 0.001;  // 0.1%
+namespace {
+// Used until the cost model is calibrated, e.g. in tests. They are in the
+// range measured on current server CPUs.
+constexpr CostModel kDefaultCostModel{
+    .distance_ns_per_byte = 0.1,
+    .memory_access_ns = 80,
+    .lookup_ns = 20,
+    .bit_test_ns = 1,
+};
+
+// The calibrated costs are published whole, once measured, so that the
+// planners on the reader threads see either the defaults or all of them.
+CostModel calibrated_cost_model;
+std::atomic<const CostModel *> cost_model{&kDefaultCostModel};
+
+// The microbenchmark takes a few tens of milliseconds, once at startup on a
+// utility thread, most of it linking the pointer chase.
+constexpr size_t kCalibrationDimensions = 128;
+constexpr size_t kCalibrationVectors = 256;
+constexpr size_t kCalibrationDistances = 64 * 1024;
+// The pointer chase spans twice the last level cache, so that most of its
+// steps miss it: only lines it touches take cache space, so a smaller chase,
+// however sparse, would be served from the cache. The bounds keep the memory
+// it briefly takes small, and the default covers the caches of most CPUs when
+// the size is unknown.
+constexpr size_t kCalibrationChaseCacheMultiple = 2;
+constexpr size_t kCalibrationChaseMinBytes = size_t{8} << 20;
+constexpr size_t kCalibrationChaseMaxBytes = size_t{64} << 20;
+constexpr size_t kCalibrationChaseDefaultBytes = size_t{32} << 20;
+constexpr size_t kCalibrationChaseSteps = 128 * 1024;
+constexpr size_t kCalibrationKeys = 64 * 1024;
+constexpr size_t kCalibrationLookups = 128 * 1024;
+// A bitmap over a million internal ids.
+constexpr size_t kCalibrationBitmapWords = 16 * 1024;
+constexpr size_t kCalibrationBitTests = 128 * 1024;
+
+double NanosecondsPerOp(absl::Duration elapsed, size_t ops) {
+  return absl::ToDoubleNanoseconds(elapsed) / ops;
+}
+
+double MeasureDistanceNsPerByte(std::mt19937 &gen) {
+  std::uniform_real_distribution<float> dist(-1, 1);
+  std::vector<float> vectors(kCalibrationVectors * kCalibrationDimensions);
+  for (auto &value : vectors) {
+    value = dist(gen);
+  }
+  hnswlib::L2Space space(kCalibrationDimensions);
+  auto dist_func = space.get_dist_func();
+  auto *dist_func_param = space.get_dist_func_param();
+  volatile float sink = 0;
+  auto start = absl::Now();
+  for (size_t i = 0; i < kCalibrationDistances; ++i) {
+    const float *lhs =
+        &vectors[(i % kCalibrationVectors) * kCalibrationDimensions];
+    const float *rhs =
+        &vectors[((i * 7 + 1) % kCalibrationVectors) * kCalibrationDimensions];
+    sink = sink + dist_func(lhs, rhs, dist_func_param);
+  }
+  return NanosecondsPerOp(absl::Now() - start, kCalibrationDistances) /
+         space.get_data_size();
+}
+
+size_t GetChaseBytes() {
+  long cache_bytes = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  cache_bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+  if (cache_bytes <= 0) {
+    return kCalibrationChaseDefaultBytes;
+  }
+  return std::clamp(static_cast<size_t>(cache_bytes) *
+                        kCalibrationChaseCacheMultiple,
+                    kCalibrationChaseMinBytes, kCalibrationChaseMaxBytes);
+}
+
+double MeasureMemoryAccessNs(std::mt19937 &gen) {
+  // One slot per cache line, so that every step loads a new line.
+  struct alignas(64) ChaseSlot {
+    uint32_t next;
+  };
+  // Sattolo's algorithm links all the slots into a single random cycle.
+  std::vector<ChaseSlot> slots(GetChaseBytes() / sizeof(ChaseSlot));
+  for (size_t i = 0; i < slots.size(); ++i) {
+    slots[i].next = i;
+  }
+  for (size_t i = slots.size() - 1; i > 0; --i) {
+    std::uniform_int_distribution<size_t> pick(0, i - 1);
+    std::swap(slots[i].next, slots[pick(gen)].next);
+  }
+  volatile uint32_t sink = 0;
+  uint32_t slot = 0;
+  auto start = absl::Now();
+  for (size_t i = 0; i < kCalibrationChaseSteps; ++i) {
+    slot = slots[slot].next;
+  }
+  sink = slot;
+  (void)sink;
+  return NanosecondsPerOp(absl::Now() - start, kCalibrationChaseSteps);
+}
+
+double MeasureLookupNs(std::mt19937 &gen) {
+  std::vector<std::string> keys;
+  keys.reserve(kCalibrationKeys);
+  absl::flat_hash_map<std::string, uint32_t> map;
+  for (size_t i = 0; i < kCalibrationKeys; ++i) {
+    keys.push_back(absl::StrCat("calibration:key:", i));
+    map[keys.back()] = i;
+  }
+  std::uniform_int_distribution<size_t> pick(0, kCalibrationKeys - 1);
+  std::vector<uint32_t> order(kCalibrationLookups);
+  for (auto &index : order) {
+    index = pick(gen);
+  }
+  volatile uint32_t sink = 0;
+  auto start = absl::Now();
+  for (auto index : order) {
+    auto it = map.find(keys[index]);
+    sink = sink + it->second;
+  }
+  return NanosecondsPerOp(absl::Now() - start, kCalibrationLookups);
+}
+
+double MeasureBitTestNs(std::mt19937 &gen) {
+  std::vector<uint64_t> bitmap(kCalibrationBitmapWords);
+  for (auto &word : bitmap) {
+    word = gen();
+  }
+  std::uniform_int_distribution<uint32_t> pick(
+      0, kCalibrationBitmapWords * 64 - 1);
+  std::vector<uint32_t> order(kCalibrationBitTests);
+  for (auto &bit : order) {
+    bit = pick(gen);
+  }
+  volatile uint32_t sink = 0;
+  auto start = absl::Now();
+  for (auto bit : order) {
+    sink = sink + ((bitmap[bit / 64] >> (bit % 64)) & 1);
+  }
+  return NanosecondsPerOp(absl::Now() - start, kCalibrationBitTests);
+}
+
+// Returns the cost of evaluating the filter for one key. Tag, numeric and
+// text predicates look the key up in their index, while a vector range also
+// compares the query with the vector of the key.
+double FilterCostNs(const Predicate *predicate, const CostModel &model,
+                    double distance_ns) {
+  switch (predicate->GetType()) {
+    case PredicateType::kComposedAnd:
+    case PredicateType::kComposedOr: {
+      double cost = 0;
+      for (const auto &child :
+           static_cast<const ComposedPredicate *>(predicate)->GetChildren()) {
+        cost += FilterCostNs(child.get(), model, distance_ns);
+      }
+      return cost;
+    }
+    case PredicateType::kNegate:
+      return FilterCostNs(
+          static_cast<const NegatePredicate *>(predicate)->GetPredicate(),
+          model, distance_ns);
+    case PredicateType::kVectorRange:
+      return model.lookup_ns + model.memory_access_ns + distance_ns;
+    default:
+      return model.lookup_ns;
+  }
+}
+}  // namespace
+
+const CostModel &GetCostModel() {
+  return *cost_model.load(std::memory_order_acquire);
+}
+
+const CostModel &CalibrateCostModel() {
+  std::mt19937 gen(42);
+  CostModel model = kDefaultCostModel;
+  CostModel measured{
+      .distance_ns_per_byte = MeasureDistanceNsPerByte(gen),
+      .memory_access_ns = MeasureMemoryAccessNs(gen),
+      .lookup_ns = MeasureLookupNs(gen),
+      .bit_test_ns = MeasureBitTestNs(gen),
+  };
+  // Keep the defaults of any cost the clock was too coarse to measure.
+  if (measured.distance_ns_per_byte > 0) {
+    model.distance_ns_per_byte = measured.distance_ns_per_byte;
+  }
+  if (measured.memory_access_ns > 0) {
+    model.memory_access_ns = measured.memory_access_ns;
+  }
+  if (measured.lookup_ns > 0) {
+    model.lookup_ns = measured.lookup_ns;
+  }
+  if (measured.bit_test_ns > 0) {
+    model.bit_test_ns = measured.bit_test_ns;
+  }
+  calibrated_cost_model = model;
+  cost_model.store(&calibrated_cost_model, std::memory_order_release);
+  return calibrated_cost_model;
+}
+
 // The query planner decides whether to use pre or inline filtering based on
-// heuristics.
-bool UsePreFiltering(size_t estimated_num_of_keys,
-                     indexes::VectorBase *vector_index) {
-  if (vector_index->GetIndexerType() == indexes::IndexerType::kFlat) {
-    /* With a flat index, the search needs to go through all the vectors,
-    taking O(N*log(k)). With pre-filtering, we can do the same search on the
-    reduced space, taking O(n*log(k)). Therefore we should always choose
-    pre-filtering */
-    return true;
-  }
-  if (vector_index->GetIndexerType() == indexes::IndexerType::kHNSW) {
-    // TODO: Come up with a formulation accounting for various
-    // other factors like ef_construction, M, size of vectors, ef_runtime, k
-    // etc. Also benchmark various combinations to tune the hyperparameters.
-    size_t N = vector_index->GetCapacity();
-    // We choose pre-filtering if the size of the filtered space is below a
-    // certain threshold (relative to the total size).
-    return estimated_num_of_keys <= kPreFilteringThresholdRatio * N;
-  }
-  CHECK(false) << "Unsupported indexer type: "
-               << (int)vector_index->GetIndexerType();
+// the estimated cost of both plans.
+QueryPlan PlanFilteredSearch(size_t estimated_num_of_keys,
+                             const Predicate *filter_predicate, uint64_t k,
+                             size_t num_queries,
+                             std::optional<size_t> search_width,
+                             indexes::VectorBase *vector_index) {
+  const CostModel &model = GetCostModel();
+  size_t tracked_keys = vector_index->GetTrackedKeyCount();
+  double selectivity =
+      tracked_keys == 0
+          ? 1.0
+          : std::min(1.0, static_cast<double>(estimated_num_of_keys) /
+                              tracked_keys);
+  double distance_ns =
+      model.distance_ns_per_byte * vector_index->GetVectorDataSize();
+  double filter_ns = FilterCostNs(filter_predicate, model, distance_ns);
+
+  // Pre-filtering fetches the vector of every qualified key and compares it
+  // with each query. The keys are filtered once for all the queries.
+  double prefiltering_cost_ns =
+      estimated_num_of_keys *
+      (model.lookup_ns + filter_ns + model.memory_access_ns +
+       num_queries * distance_ns);
+  // Inline filtering searches the index once per query, filtering the
+  // candidates as they are reached.
+  auto estimate =
+      vector_index->EstimateInlineSearch(k, selectivity, search_width);
+  double scoring_cost_ns = estimate.distance_computations *
+                           (model.memory_access_ns + distance_ns);
+  double evaluated_filter_cost_ns =
+      num_queries * (scoring_cost_ns + estimate.filter_evaluations *
+                                           (model.lookup_ns + filter_ns));
+  // A filter bitmap is built like pre-filtering without the distances, and
+  // turns every filter evaluation of the searches into a bit test.
+  double bitmap_filter_cost_ns =
+      estimated_num_of_keys * (model.lookup_ns + filter_ns) +
+      num_queries * (scoring_cost_ns +
+                     estimate.filter_evaluations * model.bit_test_ns);
+  bool filter_bitmap = bitmap_filter_cost_ns < evaluated_filter_cost_ns;
+  double inline_filtering_cost_ns =
+      std::min(evaluated_filter_cost_ns, bitmap_filter_cost_ns);
+  bool use_prefiltering = prefiltering_cost_ns <= inline_filtering_cost_ns;
+  return QueryPlan{
+      .use_prefiltering = use_prefiltering,
+      .filtered_traversal = !use_prefiltering && estimate.filtered_traversal,
+      .filter_bitmap = !use_prefiltering && filter_bitmap,
+      .prefiltering_cost_ns = prefiltering_cost_ns,
+      .inline_filtering_cost_ns = inline_filtering_cost_ns,
+  };
 }
 }  // namespace valkey_search::query
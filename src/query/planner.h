@@ -8,14 +8,58 @@
 #ifndef VALKEYSEARCH_SRC_QUERY_PLANNER_H_
 #define VALKEYSEARCH_SRC_QUERY_PLANNER_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
 #include "src/indexes/vector_base.h"
+#include "src/query/predicate.h"
 
 namespace valkey_search::query {
 
-// Returns whether to use pre-filtering as opposed to inline filtering based on
-// heuristics.
-bool UsePreFiltering(size_t estimated_num_of_keys,
-                     indexes::VectorBase *vector_index);
+// Unit costs of the query planner's cost model, in nanoseconds.
+struct CostModel {
+  // Comparing one byte of a query vector with a stored vector.
+  double distance_ns_per_byte;
+  // Fetching a stored vector which is not in the CPU caches.
+  double memory_access_ns;
+  // Looking up a key in a hash table, the unit of filter evaluation.
+  double lookup_ns;
+  // Testing a bit of a filter bitmap.
+  double bit_test_ns;
+};
+
+// Returns the cost model in use, the defaults until CalibrateCostModel is
+// done. Safe to call from any thread.
+const CostModel &GetCostModel();
+
+// Measures the unit costs of the cost model with a short microbenchmark and
+// uses them for all the following plans. Runs off the main thread, at most
+// once.
+const CostModel &CalibrateCostModel();
+
+struct QueryPlan {
+  bool use_prefiltering;
+  // Whether an inline filtered search traverses the index around the
+  // candidates rejected by the filter, see VectorHNSW::Search.
+  bool filtered_traversal;
+  // Whether the keys passing the filter are collected into a bitmap of
+  // internal ids before an inline filtered search, which then tests a bit per
+  // candidate instead of evaluating the filter.
+  bool filter_bitmap;
+  // Estimated costs of both plans, in nanoseconds.
+  double prefiltering_cost_ns;
+  double inline_filtering_cost_ns;
+};
+
+// Chooses between pre-filtering and inline filtering by estimating the cost of
+// both plans. `estimated_num_of_keys` is the number of keys the filter was
+// estimated to keep, and `search_width` the EF_RUNTIME or NPROBE of the query.
+QueryPlan PlanFilteredSearch(size_t estimated_num_of_keys,
+                             const Predicate *filter_predicate, uint64_t k,
+                             size_t num_queries,
+                             std::optional<size_t> search_width,
+                             indexes::VectorBase *vector_index);
 }  // namespace valkey_search::query
 
 #endif  // VALKEYSEARCH_SRC_QUERY_PLANNER_H_
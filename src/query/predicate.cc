@@ -7,7 +7,11 @@
 
 #include "src/query/predicate.h"
 
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 
@@ -29,6 +33,61 @@
 
 namespace valkey_search::query {
 
+namespace {
+// 2^63, the first double above the int64 range.
+constexpr double kInt64Limit = 9223372036854775808.0;
+
+// Returns the first int64 after `start`, or at it if `inclusive`, or nullopt
+// if there is none.
+std::optional<int64_t> IntegerRangeStart(double start,
+                                         std::optional<int64_t> integer,
+                                         bool inclusive) {
+  if (integer.has_value()) {
+    if (inclusive) {
+      return integer;
+    }
+    if (*integer == std::numeric_limits<int64_t>::max()) {
+      return std::nullopt;
+    }
+    return *integer + 1;
+  }
+  double bound = inclusive ? std::ceil(start) : std::floor(start);
+  if (bound >= kInt64Limit) {
+    return std::nullopt;
+  }
+  if (bound < -kInt64Limit) {
+    return std::numeric_limits<int64_t>::min();
+  }
+  // Steps past an exclusive bound as an integer, since beyond 2^53 a double
+  // step would be rounded off.
+  return static_cast<int64_t>(bound) + (inclusive ? 0 : 1);
+}
+
+// Returns the last int64 before `end`, or at it if `inclusive`, or nullopt if
+// there is none.
+std::optional<int64_t> IntegerRangeEnd(double end,
+                                       std::optional<int64_t> integer,
+                                       bool inclusive) {
+  if (integer.has_value()) {
+    if (inclusive) {
+      return integer;
+    }
+    if (*integer == std::numeric_limits<int64_t>::min()) {
+      return std::nullopt;
+    }
+    return *integer - 1;
+  }
+  double bound = inclusive ? std::floor(end) : std::ceil(end);
+  if (bound < -kInt64Limit || (!inclusive && bound == -kInt64Limit)) {
+    return std::nullopt;
+  }
+  if (bound >= kInt64Limit) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  return static_cast<int64_t>(bound) - (inclusive ? 0 : 1);
+}
+}  // namespace
+
 EvaluationResult NegatePredicate::Evaluate(Evaluator& evaluator) const {
   EvaluationResult result = predicate_->Evaluate(evaluator);
   return EvaluationResult(!result.matches);
@@ -260,7 +319,9 @@ NumericPredicate::NumericPredicate(const indexes::Numeric* index,
                                    absl::string_view alias,
                                    absl::string_view identifier, double start,
                                    bool is_inclusive_start, double end,
-                                   bool is_inclusive_end)
+                                   bool is_inclusive_end,
+                                   std::optional<int64_t> integer_start,
+                                   std::optional<int64_t> integer_end)
     : Predicate(PredicateType::kNumeric),
       index_(index),
       alias_(alias),
@@ -268,7 +329,19 @@ NumericPredicate::NumericPredicate(const indexes::Numeric* index,
       start_(start),
       is_inclusive_start_(is_inclusive_start),
       end_(end),
-      is_inclusive_end_(is_inclusive_end) {}
+      is_inclusive_end_(is_inclusive_end),
+      integer_start_(integer_start),
+      integer_end_(integer_end) {}
+
+std::optional<NumericPredicate::IntegerRange>
+NumericPredicate::GetIntegerRange() const {
+  auto start = IntegerRangeStart(start_, integer_start_, is_inclusive_start_);
+  auto end = IntegerRangeEnd(end_, integer_end_, is_inclusive_end_);
+  if (!start.has_value() || !end.has_value() || *start > *end) {
+    return std::nullopt;
+  }
+  return IntegerRange{*start, *end};
+}
 
 EvaluationResult NumericPredicate::Evaluate(Evaluator& evaluator) const {
   return evaluator.EvaluateNumeric(*this);
@@ -285,6 +358,34 @@ EvaluationResult NumericPredicate::Evaluate(const double* value) const {
   return EvaluationResult(matches);
 }
 
+EvaluationResult NumericPredicate::Evaluate(int64_t value) const {
+  auto range = GetIntegerRange();
+  return EvaluationResult(range.has_value() && value >= range->start &&
+                          value <= range->end);
+}
+
+VectorRangePredicate::VectorRangePredicate(indexes::VectorBase* index,
+                                           absl::string_view alias,
+                                           absl::string_view identifier,
+                                           float radius, std::string query)
+    : Predicate(PredicateType::kVectorRange),
+      index_(index),
+      alias_(alias),
+      identifier_(vmsdk::MakeUniqueValkeyString(identifier)),
+      radius_(radius),
+      query_(std::move(query)) {}
+
+EvaluationResult VectorRangePredicate::Evaluate(Evaluator& evaluator) const {
+  return evaluator.EvaluateVectorRange(*this);
+}
+
+EvaluationResult VectorRangePredicate::Evaluate(const float* distance) const {
+  if (!distance) {
+    return EvaluationResult(false);
+  }
+  return EvaluationResult(*distance <= radius_);
+}
+
 TagPredicate::TagPredicate(const indexes::Tag* index, absl::string_view alias,
                            absl::string_view identifier,
                            absl::string_view raw_tag_string,
@@ -8,7 +8,9 @@
 #ifndef VALKEYSEARCH_SRC_QUERY_PREDICATE_H_
 #define VALKEYSEARCH_SRC_QUERY_PREDICATE_H_
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -24,6 +26,7 @@ namespace valkey_search::indexes {
 class Text;
 class Numeric;
 class Tag;
+class VectorBase;
 class EntriesFetcherBase;
 }  // namespace valkey_search::indexes
 
@@ -42,12 +45,14 @@ enum class PredicateType {
   kComposedOr,
   kNegate,
   kText,
+  kVectorRange,
   kNone
 };
 
 class TextPredicate;
 class TagPredicate;
 class NumericPredicate;
+class VectorRangePredicate;
 
 struct EvaluationResult {
   bool matches;
@@ -77,6 +82,8 @@ class Evaluator {
   virtual EvaluationResult EvaluateTags(const TagPredicate& predicate) = 0;
   virtual EvaluationResult EvaluateNumeric(
       const NumericPredicate& predicate) = 0;
+  virtual EvaluationResult EvaluateVectorRange(
+      const VectorRangePredicate& predicate) = 0;
   // Access target key for proximity validation (only for Text)
   virtual const InternedStringPtr& GetTargetKey() const = 0;
   virtual bool IsPrefilterEvaluator() const { return false; }
@@ -112,9 +119,13 @@ class NegatePredicate : public Predicate {
 
 class NumericPredicate : public Predicate {
  public:
+  // `integer_start` and `integer_end` are the bounds as parsed, if they are
+  // int64 literals, which beyond 2^53 are more exact than the doubles.
   NumericPredicate(const indexes::Numeric* index, absl::string_view alias,
                    absl::string_view identifier, double start,
-                   bool is_inclusive_start, double end, bool is_inclusive_end);
+                   bool is_inclusive_start, double end, bool is_inclusive_end,
+                   std::optional<int64_t> integer_start = std::nullopt,
+                   std::optional<int64_t> integer_end = std::nullopt);
   const indexes::Numeric* GetIndex() const { return index_; }
   absl::string_view GetIdentifier() const {
     return vmsdk::ToStringView(identifier_.get());
@@ -127,8 +138,19 @@ class NumericPredicate : public Predicate {
   bool IsStartInclusive() const { return is_inclusive_start_; }
   double GetEnd() const { return end_; }
   bool IsEndInclusive() const { return is_inclusive_end_; }
+  std::optional<int64_t> GetIntegerStart() const { return integer_start_; }
+  std::optional<int64_t> GetIntegerEnd() const { return integer_end_; }
+  struct IntegerRange {
+    int64_t start;
+    int64_t end;
+  };
+  // Returns the inclusive range of the int64 values in the range, or nullopt
+  // if there is none.
+  std::optional<IntegerRange> GetIntegerRange() const;
   EvaluationResult Evaluate(Evaluator& evaluator) const override;
   EvaluationResult Evaluate(const double* value) const;
+  // Compares an integer value exactly, also beyond 2^53.
+  EvaluationResult Evaluate(int64_t value) const;
 
  private:
   const indexes::Numeric* index_;
@@ -138,6 +160,36 @@ class NumericPredicate : public Predicate {
   bool is_inclusive_start_;
   double end_;
   bool is_inclusive_end_;
+  std::optional<int64_t> integer_start_;
+  std::optional<int64_t> integer_end_;
+};
+
+// Matches the keys whose vector is within `radius` of the query vector.
+class VectorRangePredicate : public Predicate {
+ public:
+  VectorRangePredicate(indexes::VectorBase* index, absl::string_view alias,
+                       absl::string_view identifier, float radius,
+                       std::string query);
+  indexes::VectorBase* GetIndex() const { return index_; }
+  absl::string_view GetAlias() const { return alias_; }
+  absl::string_view GetIdentifier() const {
+    return vmsdk::ToStringView(identifier_.get());
+  }
+  vmsdk::UniqueValkeyString GetRetainedIdentifier() const {
+    return vmsdk::RetainUniqueValkeyString(identifier_.get());
+  }
+  float GetRadius() const { return radius_; }
+  // The query vector, normalized the same way as the indexed vectors.
+  absl::string_view GetQuery() const { return query_; }
+  EvaluationResult Evaluate(Evaluator& evaluator) const override;
+  EvaluationResult Evaluate(const float* distance) const;
+
+ private:
+  indexes::VectorBase* index_;
+  std::string alias_;
+  vmsdk::UniqueValkeyString identifier_;
+  float radius_;
+  std::string query_;
 };
 
 class TagPredicate : public Predicate {
@@ -8,6 +8,7 @@
 #include "src/query/response_generator.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <deque>
 #include <optional>
 #include <string>
@@ -17,6 +18,7 @@
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/string_view.h"
 #include "src/attribute_data_type.h"
 #include "src/indexes/tag.h"
@@ -117,14 +119,30 @@ class PredicateEvaluator : public query::Evaluator {
     if (it == records_.end()) {
       return EvaluationResult(false);
     }
-    auto out_numeric =
-        vmsdk::To<double>(vmsdk::ToStringView(it->second.value.get()));
+    auto data = vmsdk::ToStringView(it->second.value.get());
+    if (int64_t integer; absl::SimpleAtoi(data, &integer)) {
+      return predicate.Evaluate(integer);
+    }
+    auto out_numeric = vmsdk::To<double>(data);
     if (!out_numeric.ok()) {
       return EvaluationResult(false);
     }
     return predicate.Evaluate(&out_numeric.value());
   }
 
+  EvaluationResult EvaluateVectorRange(
+      const query::VectorRangePredicate &predicate) override {
+    auto identifier = predicate.GetRetainedIdentifier();
+    auto it = records_.find(vmsdk::ToStringView(identifier.get()));
+    if (it == records_.end()) {
+      return EvaluationResult(false);
+    }
+    auto distance = predicate.GetIndex()->ComputeDistance(
+        predicate.GetQuery(),
+        vmsdk::RetainUniqueValkeyString(it->second.value.get()));
+    return predicate.Evaluate(distance.ok() ? &distance.value() : nullptr);
+  }
+
   EvaluationResult EvaluateText(const query::TextPredicate &predicate,
                                 bool require_positions) override {
     CHECK(target_key_);
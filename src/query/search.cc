@@ -7,12 +7,16 @@
 
 #include "src/query/search.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <queue>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -23,6 +27,7 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "absl/time/time.h"
 #include "src/attribute_data_type.h"
 #include "src/indexes/index_base.h"
 #include "src/indexes/numeric.h"
@@ -33,12 +38,15 @@
 #include "src/indexes/vector_base.h"
 #include "src/indexes/vector_flat.h"
 #include "src/indexes/vector_hnsw.h"
+#include "src/indexes/vector_ivf.h"
 #include "src/metrics.h"
 #include "src/query/planner.h"
 #include "src/query/predicate.h"
 #include "src/valkey_search.h"
 #include "src/valkey_search_options.h"
 #include "third_party/hnswlib/hnswlib.h"
+#include "third_party/hnswlib/space_binary.h"
+#include "third_party/hnswlib/space_half.h"
 #include "vmsdk/src/latency_sampler.h"
 #include "vmsdk/src/log.h"
 #include "vmsdk/src/managed_pointers.h"
@@ -46,6 +54,7 @@
 #include "vmsdk/src/thread_pool.h"
 #include "vmsdk/src/time_sliced_mrmw_mutex.h"
 #include "vmsdk/src/type_conversions.h"
+#include "vmsdk/src/utils.h"
 #include "vmsdk/src/valkey_module_api/valkey_module.h"
 
 namespace valkey_search::query {
@@ -82,47 +91,178 @@ class InlineVectorFilter : public hnswlib::BaseFilterFunctor {
   const InternedStringNodeHashMap<valkey_search::indexes::text::TextIndex>
       *per_key_indexes_;
 };
-absl::StatusOr<std::vector<indexes::Neighbor>> PerformVectorSearch(
-    indexes::VectorBase *vector_index, const SearchParameters &parameters) {
-  std::unique_ptr<InlineVectorFilter> inline_filter;
-  if (parameters.filter_parse_results.root_predicate != nullptr) {
-    const InternedStringNodeHashMap<valkey_search::indexes::text::TextIndex>
-        *per_key_indexes = nullptr;
-    if (parameters.index_schema->GetTextIndexSchema()) {
-      per_key_indexes = &parameters.index_schema->GetTextIndexSchema()
-                             ->GetPerKeyTextIndexes();
-    }
-    inline_filter = std::make_unique<InlineVectorFilter>(
-        parameters.filter_parse_results.root_predicate.get(), vector_index,
-        per_key_indexes);
-    VMSDK_LOG(DEBUG, nullptr) << "Performing vector search with inline filter";
+
+class BitmapVectorFilter : public hnswlib::BaseFilterFunctor {
+ public:
+  explicit BitmapVectorFilter(const FilterBitmap &filter_bitmap)
+      : filter_bitmap_(filter_bitmap) {}
+  ~BitmapVectorFilter() override = default;
+
+  bool operator()(hnswlib::labeltype id) override {
+    size_t word = id / 64;
+    return word < filter_bitmap_.size() &&
+           (filter_bitmap_[word] >> (id % 64)) & 1;
   }
+
+ private:
+  const FilterBitmap &filter_bitmap_;
+};
+
+template <typename T>
+absl::StatusOr<std::vector<indexes::Neighbor>> PerformVectorSearch(
+    indexes::VectorBase *vector_index, absl::string_view query,
+    const SearchParameters &parameters,
+    std::unique_ptr<hnswlib::BaseFilterFunctor> inline_filter,
+    bool filtered_traversal) {
   if (vector_index->GetIndexerType() == indexes::IndexerType::kHNSW) {
-    auto vector_hnsw = dynamic_cast<indexes::VectorHNSW<float> *>(vector_index);
+    auto vector_hnsw = dynamic_cast<indexes::VectorHNSW<T> *>(vector_index);
 
     auto latency_sample = SAMPLE_EVERY_N(100);
-    auto res = vector_hnsw->Search(parameters.query, parameters.k,
+    auto res = vector_hnsw->Search(query, parameters.k,
                                    parameters.cancellation_token,
                                    std::move(inline_filter), parameters.ef,
-                                   parameters.enable_partial_results);
+                                   parameters.enable_partial_results,
+                                   filtered_traversal, parameters.oversample);
     Metrics::GetStats().hnsw_vector_index_search_latency.SubmitSample(
         std::move(latency_sample));
     return res;
   }
   if (vector_index->GetIndexerType() == indexes::IndexerType::kFlat) {
-    auto vector_flat = dynamic_cast<indexes::VectorFlat<float> *>(vector_index);
+    auto vector_flat = dynamic_cast<indexes::VectorFlat<T> *>(vector_index);
     auto latency_sample = SAMPLE_EVERY_N(100);
-    auto res = vector_flat->Search(parameters.query, parameters.k,
+    auto res = vector_flat->Search(query, parameters.k,
                                    parameters.cancellation_token,
                                    std::move(inline_filter));
     Metrics::GetStats().flat_vector_index_search_latency.SubmitSample(
         std::move(latency_sample));
     return res;
   }
+  if constexpr (std::is_same_v<T, hnswlib::bit8>) {
+    // IVF indexes are not created over binary vectors.
+  } else if (vector_index->GetIndexerType() == indexes::IndexerType::kIVF) {
+    auto vector_ivf = dynamic_cast<indexes::VectorIVF<T> *>(vector_index);
+    auto latency_sample = SAMPLE_EVERY_N(100);
+    auto res = vector_ivf->Search(query, parameters.k,
+                                  parameters.cancellation_token,
+                                  std::move(inline_filter), parameters.nprobe);
+    Metrics::GetStats().ivf_vector_index_search_latency.SubmitSample(
+        std::move(latency_sample));
+    return res;
+  }
   CHECK(false) << "Unsupported indexer type: "
                << (int)vector_index->GetIndexerType();
 }
 
+std::unique_ptr<hnswlib::BaseFilterFunctor> MakeInlineVectorFilter(
+    indexes::VectorBase *vector_index, const SearchParameters &parameters,
+    const FilterBitmap *filter_bitmap) {
+  if (parameters.filter_parse_results.root_predicate == nullptr) {
+    return nullptr;
+  }
+  if (filter_bitmap) {
+    VMSDK_LOG(DEBUG, nullptr)
+        << "Performing vector search with a filter bitmap";
+    return std::make_unique<BitmapVectorFilter>(*filter_bitmap);
+  }
+  const InternedStringNodeHashMap<valkey_search::indexes::text::TextIndex>
+      *per_key_indexes = nullptr;
+  if (parameters.index_schema->GetTextIndexSchema()) {
+    per_key_indexes =
+        &parameters.index_schema->GetTextIndexSchema()->GetPerKeyTextIndexes();
+  }
+  VMSDK_LOG(DEBUG, nullptr) << "Performing vector search with inline filter";
+  return std::make_unique<InlineVectorFilter>(
+      parameters.filter_parse_results.root_predicate.get(), vector_index,
+      per_key_indexes);
+}
+
+absl::StatusOr<std::vector<indexes::Neighbor>> PerformVectorSearch(
+    indexes::VectorBase *vector_index, const SearchParameters &parameters,
+    const InlineFilterOptions &options) {
+  auto inline_filter = MakeInlineVectorFilter(vector_index, parameters,
+                                              options.filter_bitmap);
+  bool filtered_traversal = options.filtered_traversal;
+  switch (vector_index->GetDataType()) {
+    case data_model::VECTOR_DATA_TYPE_FLOAT32:
+      return PerformVectorSearch<float>(vector_index, parameters.query,
+                                        parameters, std::move(inline_filter),
+                                        filtered_traversal);
+    case data_model::VECTOR_DATA_TYPE_FLOAT16:
+      return PerformVectorSearch<hnswlib::float16>(
+          vector_index, parameters.query, parameters, std::move(inline_filter),
+          filtered_traversal);
+    case data_model::VECTOR_DATA_TYPE_BFLOAT16:
+      return PerformVectorSearch<hnswlib::bfloat16>(
+          vector_index, parameters.query, parameters, std::move(inline_filter),
+          filtered_traversal);
+    case data_model::VECTOR_DATA_TYPE_BINARY:
+      return PerformVectorSearch<hnswlib::bit8>(
+          vector_index, parameters.query, parameters, std::move(inline_filter),
+          filtered_traversal);
+    default:
+      CHECK(false) << "Unsupported vector data type: "
+                   << (int)vector_index->GetDataType();
+  }
+}
+
+template <typename T>
+absl::StatusOr<std::vector<std::vector<indexes::Neighbor>>>
+PerformVectorSearchBatch(indexes::VectorBase *vector_index,
+                         const SearchParameters &parameters,
+                         const InlineFilterOptions &options) {
+  if (vector_index->GetIndexerType() == indexes::IndexerType::kFlat) {
+    auto vector_flat = dynamic_cast<indexes::VectorFlat<T> *>(vector_index);
+    std::vector<absl::string_view> queries(parameters.batch_queries.begin(),
+                                           parameters.batch_queries.end());
+    auto latency_sample = SAMPLE_EVERY_N(100);
+    auto res = vector_flat->SearchBatch(
+        queries, parameters.k, parameters.cancellation_token,
+        MakeInlineVectorFilter(vector_index, parameters,
+                               options.filter_bitmap));
+    Metrics::GetStats().flat_vector_index_search_latency.SubmitSample(
+        std::move(latency_sample));
+    return res;
+  }
+  // Graph and inverted file indexes are searched one query at a time, still
+  // under the single reader lock taken for the whole batch.
+  std::vector<std::vector<indexes::Neighbor>> results;
+  results.reserve(parameters.batch_queries.size());
+  for (const auto &query : parameters.batch_queries) {
+    VMSDK_ASSIGN_OR_RETURN(
+        auto neighbors,
+        PerformVectorSearch<T>(
+            vector_index, query, parameters,
+            MakeInlineVectorFilter(vector_index, parameters,
+                                   options.filter_bitmap),
+            options.filtered_traversal));
+    results.push_back(std::move(neighbors));
+  }
+  return results;
+}
+
+absl::StatusOr<std::vector<std::vector<indexes::Neighbor>>>
+PerformVectorSearchBatch(indexes::VectorBase *vector_index,
+                         const SearchParameters &parameters,
+                         const InlineFilterOptions &options = {}) {
+  switch (vector_index->GetDataType()) {
+    case data_model::VECTOR_DATA_TYPE_FLOAT32:
+      return PerformVectorSearchBatch<float>(
+          vector_index, parameters, options);
+    case data_model::VECTOR_DATA_TYPE_FLOAT16:
+      return PerformVectorSearchBatch<hnswlib::float16>(
+          vector_index, parameters, options);
+    case data_model::VECTOR_DATA_TYPE_BFLOAT16:
+      return PerformVectorSearchBatch<hnswlib::bfloat16>(
+          vector_index, parameters, options);
+    case data_model::VECTOR_DATA_TYPE_BINARY:
+      return PerformVectorSearchBatch<hnswlib::bit8>(
+          vector_index, parameters, options);
+    default:
+      CHECK(false) << "Unsupported vector data type: "
+                   << (int)vector_index->GetDataType();
+  }
+}
+
 void AppendQueue(
     std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> &dest,
     std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> &src) {
@@ -154,7 +294,8 @@ inline bool IsExactPhraseOnly(QueryOperations query_operations) {
 size_t EvaluateFilterAsPrimary(
     const Predicate *predicate,
     std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> &entries_fetchers,
-    bool negate, QueryOperations query_operations) {
+    bool negate, QueryOperations query_operations,
+    cancel::Token &cancellation_token) {
   // Faster path for pure exact phrase queries.
   // This is an optimization to avoid building multiple term iterators and a
   // proximity iterator for every key's evaluation in the filtering stage (using
@@ -180,8 +321,9 @@ size_t EvaluateFilterAsPrimary(
       std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> best_fetchers;
       for (const auto &child : composed_predicate->GetChildren()) {
         std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> child_fetchers;
-        size_t child_size = EvaluateFilterAsPrimary(child.get(), child_fetchers,
-                                                    negate, query_operations);
+        size_t child_size =
+            EvaluateFilterAsPrimary(child.get(), child_fetchers, negate,
+                                    query_operations, cancellation_token);
         if (child_size < min_size) {
           min_size = child_size;
           best_fetchers = std::move(child_fetchers);
@@ -193,8 +335,9 @@ size_t EvaluateFilterAsPrimary(
       size_t total_size = 0;
       for (const auto &child : composed_predicate->GetChildren()) {
         std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> child_fetchers;
-        size_t child_size = EvaluateFilterAsPrimary(child.get(), child_fetchers,
-                                                    negate, query_operations);
+        size_t child_size =
+            EvaluateFilterAsPrimary(child.get(), child_fetchers, negate,
+                                    query_operations, cancellation_token);
         AppendQueue(entries_fetchers, child_fetchers);
         total_size += child_size;
       }
@@ -225,11 +368,20 @@ size_t EvaluateFilterAsPrimary(
     entries_fetchers.push(std::move(fetcher));
     return size;
   }
+  if (predicate->GetType() == PredicateType::kVectorRange) {
+    auto range_predicate =
+        dynamic_cast<const VectorRangePredicate *>(predicate);
+    auto fetcher = range_predicate->GetIndex()->Search(
+        *range_predicate, negate, cancellation_token);
+    size_t size = fetcher->Size();
+    entries_fetchers.push(std::move(fetcher));
+    return size;
+  }
   if (predicate->GetType() == PredicateType::kNegate) {
     auto negate_predicate = dynamic_cast<const NegatePredicate *>(predicate);
-    size_t result =
-        EvaluateFilterAsPrimary(negate_predicate->GetPredicate(),
-                                entries_fetchers, !negate, query_operations);
+    size_t result = EvaluateFilterAsPrimary(
+        negate_predicate->GetPredicate(), entries_fetchers, !negate,
+        query_operations, cancellation_token);
     return result;
   }
   CHECK(false);
@@ -240,6 +392,34 @@ struct PrefilteredKey {
   float distance;
 };
 
+// Returns the per-key text indexes of the schema, if it has text fields.
+const InternedStringNodeHashMap<valkey_search::indexes::text::TextIndex>
+    *GetPerKeyTextIndexes(const SearchParameters &parameters) {
+  // Get per-key text indexes directly since we have reader lock
+  if (parameters.index_schema &&
+      parameters.index_schema->GetTextIndexSchema()) {
+    return &parameters.index_schema->GetTextIndexSchema()
+                ->GetPerKeyTextIndexes();
+  }
+  return nullptr;
+}
+
+// Returns true if the key passes the filter of the query.
+bool EvaluateFilter(
+    const SearchParameters &parameters,
+    const InternedStringNodeHashMap<valkey_search::indexes::text::TextIndex>
+        *per_key_indexes,
+    const InternedStringPtr &key) {
+  const valkey_search::indexes::text::TextIndex *text_index = nullptr;
+  if (per_key_indexes) {
+    text_index = valkey_search::indexes::text::TextIndexSchema::LookupTextIndex(
+        *per_key_indexes, key);
+  }
+  indexes::PrefilterEvaluator key_evaluator(text_index);
+  return key_evaluator.Evaluate(
+      *parameters.filter_parse_results.root_predicate, key);
+}
+
 void EvaluatePrefilteredKeys(
     const SearchParameters &parameters,
     std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> &entries_fetchers,
@@ -256,14 +436,7 @@ void EvaluatePrefilteredKeys(
   if (needs_dedup) {
     result_keys.reserve(max_keys);
   }
-  // Get per-key text indexes directly since we have reader lock
-  const InternedStringNodeHashMap<valkey_search::indexes::text::TextIndex>
-      *per_key_indexes = nullptr;
-  if (parameters.index_schema &&
-      parameters.index_schema->GetTextIndexSchema()) {
-    per_key_indexes =
-        &parameters.index_schema->GetTextIndexSchema()->GetPerKeyTextIndexes();
-  }
+  auto per_key_indexes = GetPerKeyTextIndexes(parameters);
   while (!entries_fetchers.empty()) {
     auto fetcher = std::move(entries_fetchers.front());
     entries_fetchers.pop();
@@ -275,16 +448,8 @@ void EvaluatePrefilteredKeys(
         iterator->Next();
         continue;
       }
-      const valkey_search::indexes::text::TextIndex *text_index = nullptr;
-      if (per_key_indexes) {
-        text_index =
-            valkey_search::indexes::text::TextIndexSchema::LookupTextIndex(
-                *per_key_indexes, key);
-      }
-      indexes::PrefilterEvaluator key_evaluator(text_index);
-      // 3. Evaluate predicate
-      if (key_evaluator.Evaluate(
-              *parameters.filter_parse_results.root_predicate, key)) {
+      // 2. Evaluate predicate
+      if (EvaluateFilter(parameters, per_key_indexes, key)) {
         if (needs_dedup) {
           result_keys.insert(key->Str().data());
         }
@@ -304,33 +469,153 @@ CalcBestMatchingPrefilteredKeys(
     std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> &entries_fetchers,
     indexes::VectorBase *vector_index, size_t qualified_entries) {
   std::priority_queue<std::pair<float, hnswlib::labeltype>> results;
+  size_t range_size = options::GetExactSearchRangeSize().GetValue();
+  if (range_size == 0 || qualified_entries <= range_size) {
+    auto results_appender =
+        [&results, &parameters, vector_index](
+            const InternedStringPtr &key,
+            absl::flat_hash_set<const char *> &top_keys) -> bool {
+      return vector_index->AddPrefilteredKey(parameters.query, parameters.k,
+                                             key, results, top_keys);
+    };
+    EvaluatePrefilteredKeys(parameters, entries_fetchers,
+                            std::move(results_appender), qualified_entries);
+    return results;
+  }
+  // Many keys pass the filter: collect them, then score them in ranges on the
+  // reader threads.
+  std::vector<InternedStringPtr> keys;
+  keys.reserve(qualified_entries);
+  auto keys_appender = [&keys](const InternedStringPtr &key,
+                               absl::flat_hash_set<const char *> &) -> bool {
+    keys.push_back(key);
+    return true;
+  };
+  EvaluatePrefilteredKeys(parameters, entries_fetchers,
+                          std::move(keys_appender), qualified_entries);
+  size_t num_ranges = (keys.size() + range_size - 1) / range_size;
+  std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>>
+      range_results(num_ranges);
+  vmsdk::RunInParallel(
+      ValkeySearch::Instance().GetReaderThreadPool(), num_ranges,
+      [&](size_t range) {
+        // The keys are already deduplicated.
+        absl::flat_hash_set<const char *> unused_top_keys;
+        size_t end = std::min((range + 1) * range_size, keys.size());
+        for (size_t i = range * range_size; i < end; ++i) {
+          if (parameters.cancellation_token->IsCancelled()) {
+            return;
+          }
+          vector_index->AddPrefilteredKey(parameters.query, parameters.k,
+                                          keys[i], range_results[range],
+                                          unused_top_keys);
+        }
+      });
+  return indexes::MergeSearchResults(range_results, parameters.k);
+}
+
+std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>>
+CalcBestMatchingPrefilteredKeysBatch(
+    const SearchParameters &parameters,
+    std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> &entries_fetchers,
+    indexes::VectorBase *vector_index, size_t qualified_entries) {
+  std::vector<std::priority_queue<std::pair<float, hnswlib::labeltype>>>
+      results(parameters.batch_queries.size());
+  // The filter is evaluated once per key, and every qualified key is scored
+  // against all the queries of the batch.
   auto results_appender =
       [&results, &parameters, vector_index](
           const InternedStringPtr &key,
           absl::flat_hash_set<const char *> &top_keys) -> bool {
-    return vector_index->AddPrefilteredKey(parameters.query, parameters.k, key,
-                                           results, top_keys);
+    // AddPrefilteredKey drops evicted keys from the deduplication set, but a
+    // key evicted from one query's results may still be in another's, so the
+    // shared set is left untouched.
+    absl::flat_hash_set<const char *> unused_top_keys;
+    bool added = false;
+    for (size_t i = 0; i < results.size(); ++i) {
+      added |= vector_index->AddPrefilteredKey(parameters.batch_queries[i],
+                                               parameters.k, key, results[i],
+                                               unused_top_keys);
+    }
+    return added;
   };
   EvaluatePrefilteredKeys(parameters, entries_fetchers,
                           std::move(results_appender), qualified_entries);
   return results;
 }
 
-std::string StringFormatVector(std::vector<char> vector) {
-  if (vector.size() % sizeof(float) != 0) {
+FilterBitmap BuildFilterBitmap(
+    const SearchParameters &parameters,
+    std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> &entries_fetchers,
+    indexes::VectorBase *vector_index, size_t qualified_entries) {
+  FilterBitmap filter_bitmap((vector_index->GetCapacity() + 63) / 64);
+  auto bitmap_appender =
+      [&filter_bitmap, vector_index](
+          const InternedStringPtr &key,
+          absl::flat_hash_set<const char *> &) -> bool {
+    uint32_t vector_count;
+    auto internal_id =
+        vector_index->GetInternalIdDuringSearch(key, &vector_count);
+    if (!internal_id.ok()) {
+      return false;
+    }
+    for (uint64_t id = *internal_id; id < *internal_id + vector_count; ++id) {
+      size_t word = id / 64;
+      if (word >= filter_bitmap.size()) {
+        filter_bitmap.resize(word + 1);
+      }
+      filter_bitmap[word] |= uint64_t{1} << (id % 64);
+    }
+    return true;
+  };
+  EvaluatePrefilteredKeys(parameters, entries_fetchers,
+                          std::move(bitmap_appender), qualified_entries);
+  return filter_bitmap;
+}
+
+template <typename T>
+std::string StringFormatVector(const std::vector<char> &vector) {
+  if (vector.size() % sizeof(T) != 0) {
     return {vector.data(), vector.size()};
   }
 
   std::vector<std::string> float_strings;
-  for (size_t i = 0; i < vector.size(); i += sizeof(float)) {
-    float value;
-    std::memcpy(&value, vector.data() + i, sizeof(float));
-    float_strings.push_back(absl::StrCat(value));
+  for (size_t i = 0; i < vector.size(); i += sizeof(T)) {
+    T value;
+    std::memcpy(&value, vector.data() + i, sizeof(T));
+    float_strings.push_back(absl::StrCat(hnswlib::ToFloat(value)));
   }
 
   return absl::StrCat("[", absl::StrJoin(float_strings, ","), "]");
 }
 
+// Formats binary vectors the way they are ingested from JSON, one 0 or 1
+// element per dimension.
+std::string StringFormatBinaryVector(const std::vector<char> &vector) {
+  std::vector<absl::string_view> bits;
+  bits.reserve(vector.size() * hnswlib::kBitsPerBit8);
+  for (char byte : vector) {
+    for (int bit = hnswlib::kBitsPerBit8 - 1; bit >= 0; --bit) {
+      bits.push_back((static_cast<uint8_t>(byte) >> bit) & 1 ? "1" : "0");
+    }
+  }
+  return absl::StrCat("[", absl::StrJoin(bits, ","), "]");
+}
+
+std::string StringFormatVector(const std::vector<char> &vector,
+                               data_model::VectorDataType data_type) {
+  switch (data_type) {
+    case data_model::VECTOR_DATA_TYPE_BINARY:
+      return StringFormatBinaryVector(vector);
+    case data_model::VECTOR_DATA_TYPE_FLOAT16:
+      return StringFormatVector<hnswlib::float16>(vector);
+    case data_model::VECTOR_DATA_TYPE_BFLOAT16:
+      return StringFormatVector<hnswlib::bfloat16>(vector);
+    default:
+      return StringFormatVector<float>(vector);
+  }
+}
+
 absl::StatusOr<std::vector<indexes::Neighbor>> MaybeAddIndexedContent(
     absl::StatusOr<std::vector<indexes::Neighbor>> results,
     const SearchParameters &parameters) {
@@ -378,16 +663,16 @@ absl::StatusOr<std::vector<indexes::Neighbor>> MaybeAddIndexedContent(
         case indexes::IndexerType::kNumeric: {
           auto numeric_index =
               dynamic_cast<indexes::Numeric *>(attribute_info.index);
-          auto numeric = numeric_index->GetValue(neighbor.external_id);
-          if (numeric != nullptr) {
-            attribute_value =
-                vmsdk::MakeUniqueValkeyString(absl::StrCat(*numeric));
+          auto numeric = numeric_index->GetValueString(neighbor.external_id);
+          if (numeric.has_value()) {
+            attribute_value = vmsdk::MakeUniqueValkeyString(*numeric);
           }
           break;
         }
         case indexes::IndexerType::kVector:
         case indexes::IndexerType::kHNSW:
-        case indexes::IndexerType::kFlat: {
+        case indexes::IndexerType::kFlat:
+        case indexes::IndexerType::kIVF: {
           auto vector_index =
               dynamic_cast<indexes::VectorBase *>(attribute_info.index);
           auto vector = vector_index->GetValue(neighbor.external_id);
@@ -395,13 +680,15 @@ absl::StatusOr<std::vector<indexes::Neighbor>> MaybeAddIndexedContent(
             if (parameters.index_schema->GetAttributeDataType().ToProto() ==
                 data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_JSON) {
               attribute_value = vmsdk::MakeUniqueValkeyString(
-                  StringFormatVector(vector.value()));
+                  StringFormatVector(vector.value(),
+                                     vector_index->GetDataType()));
             } else {
               attribute_value =
                   vmsdk::UniqueValkeyString(ValkeyModule_CreateString(
                       nullptr, vector->data(), vector->size()));
             }
-          } else {
+          } else if (!absl::IsUnimplemented(vector.status())) {
+            // Keys with several vectors are fetched from the keyspace.
             VMSDK_LOG_EVERY_N_SEC(WARNING, nullptr, 1)
                 << "Failed to get vector value during fetching through index "
                    "contents: "
@@ -441,12 +728,11 @@ absl::StatusOr<std::vector<indexes::Neighbor>> MaybeAddIndexedContent(
   return results;
 }
 
-absl::StatusOr<std::vector<indexes::Neighbor>> SearchNonVectorQuery(
-    const SearchParameters &parameters) {
-  std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> entries_fetchers;
-  size_t qualified_entries = EvaluateFilterAsPrimary(
-      parameters.filter_parse_results.root_predicate.get(), entries_fetchers,
-      false, parameters.filter_parse_results.query_operations);
+// Returns the keys of the fetchers that pass the filter of the query.
+std::vector<indexes::Neighbor> CollectNonVectorNeighbors(
+    const SearchParameters &parameters,
+    std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> &entries_fetchers,
+    size_t qualified_entries) {
   std::vector<indexes::Neighbor> neighbors;
   // TODO: For now, we just reserve a fixed size because text search operators
   // return a size of 0 currently.
@@ -488,10 +774,110 @@ absl::StatusOr<std::vector<indexes::Neighbor>> SearchNonVectorQuery(
   return neighbors;
 }
 
-absl::StatusOr<std::vector<indexes::Neighbor>> DoSearch(
-    const SearchParameters &parameters, SearchMode search_mode) {
-  // Handle OOM for search requests, defends against request
-  // coming from the coordinator
+absl::StatusOr<std::vector<indexes::Neighbor>> SearchNonVectorQuery(
+    const SearchParameters &parameters) {
+  std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> entries_fetchers;
+  size_t qualified_entries = EvaluateFilterAsPrimary(
+      parameters.filter_parse_results.root_predicate.get(), entries_fetchers,
+      false, parameters.filter_parse_results.query_operations,
+      parameters.cancellation_token);
+  return CollectNonVectorNeighbors(parameters, entries_fetchers,
+                                   qualified_entries);
+}
+
+absl::StatusOr<const indexes::Numeric *> GetSortByIndex(
+    const SearchParameters &parameters) {
+  VMSDK_ASSIGN_OR_RETURN(auto index, parameters.index_schema->GetIndex(
+                                         parameters.sortby->attribute_alias));
+  if (index->GetIndexerType() != indexes::IndexerType::kNumeric) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        parameters.sortby->attribute_alias, " is not a Numeric index"));
+  }
+  return dynamic_cast<const indexes::Numeric *>(index.get());
+}
+
+// The number of neighbors a query with SORTBY needs before the LIMIT offset is
+// applied, with the same buffer TrimResults keeps for the keys that are gone
+// by the time the reply is built.
+size_t GetSortedNeighborsNeeded(const SearchParameters &parameters) {
+  double needed = (static_cast<double>(parameters.limit.first_index) +
+                   static_cast<double>(parameters.limit.number)) *
+                  options::GetSearchResultBufferMultiplier();
+  if (needed >= static_cast<double>(std::numeric_limits<size_t>::max())) {
+    return std::numeric_limits<size_t>::max();
+  }
+  return static_cast<size_t>(needed);
+}
+
+void SortBySortValues(std::vector<indexes::Neighbor> &neighbors,
+                      const indexes::Numeric &sort_index,
+                      const SortByParameter &sortby, size_t count) {
+  for (auto &neighbor : neighbors) {
+    if (auto value = sort_index.GetValue(neighbor.external_id)) {
+      neighbor.sort_value = *value;
+    }
+  }
+  SortNeighbors(neighbors, sortby, count);
+}
+
+// Walks the SORTBY index in value order and evaluates the filter per key, up
+// to the matches the LIMIT needs. The number of matches is only known upfront
+// when the entries fetchers resolve the filter, otherwise all of them are
+// collected and sorted. Collecting is also cheaper when few keys match, as
+// the walk visits about `needed / selectivity` keys.
+absl::StatusOr<std::vector<indexes::Neighbor>> SearchSortedNonVectorQuery(
+    const SearchParameters &parameters, std::optional<size_t> &total_count) {
+  VMSDK_ASSIGN_OR_RETURN(auto sort_index, GetSortByIndex(parameters));
+  std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> entries_fetchers;
+  size_t qualified_entries = EvaluateFilterAsPrimary(
+      parameters.filter_parse_results.root_predicate.get(), entries_fetchers,
+      false, parameters.filter_parse_results.query_operations,
+      parameters.cancellation_token);
+  size_t needed = GetSortedNeighborsNeeded(parameters);
+  bool resolved_by_fetchers =
+      !(parameters.filter_parse_results.query_operations &
+        (QueryOperations::kContainsOr | QueryOperations::kContainsAnd));
+  if (!resolved_by_fetchers || qualified_entries == 0 ||
+      static_cast<double>(needed) * sort_index->GetTrackedKeyCount() >=
+          static_cast<double>(qualified_entries) * qualified_entries) {
+    auto neighbors = CollectNonVectorNeighbors(parameters, entries_fetchers,
+                                               qualified_entries);
+    total_count = neighbors.size();
+    SortBySortValues(neighbors, *sort_index, *parameters.sortby, needed);
+    return neighbors;
+  }
+  std::vector<indexes::Neighbor> neighbors;
+  neighbors.reserve(needed);
+  auto per_key_indexes = GetPerKeyTextIndexes(parameters);
+  sort_index->ForEachInValueOrder(
+      parameters.sortby->ascending,
+      [&](const InternedStringPtr &key, double value) {
+        if (EvaluateFilter(parameters, per_key_indexes, key)) {
+          neighbors.emplace_back(key, 0.0f);
+          neighbors.back().sort_value = value;
+        }
+        return neighbors.size() < needed &&
+               !parameters.cancellation_token->IsCancelled();
+      });
+  // The matches without a value for the SORTBY field come last.
+  while (neighbors.size() < needed && !entries_fetchers.empty()) {
+    auto fetcher = std::move(entries_fetchers.front());
+    entries_fetchers.pop();
+    for (auto iterator = fetcher->Begin();
+         !iterator->Done() && neighbors.size() < needed; iterator->Next()) {
+      const auto &key = **iterator;
+      if (!sort_index->GetValue(key).has_value()) {
+        neighbors.emplace_back(key, 0.0f);
+      }
+    }
+  }
+  total_count = qualified_entries;
+  return neighbors;
+}
+
+// Handle OOM for search requests, defends against request
+// coming from the coordinator
+absl::Status CheckRemoteSearchMemory(SearchMode search_mode) {
   if (search_mode == SearchMode::kRemote) {
     auto ctx = vmsdk::MakeUniqueValkeyThreadSafeContext(nullptr);
     auto ctx_flags = ValkeyModule_GetContextFlags(ctx.get());
@@ -499,22 +885,54 @@ absl::StatusOr<std::vector<indexes::Neighbor>> DoSearch(
       return absl::ResourceExhaustedError(kOOMMsg);
     }
   }
+  return absl::OkStatus();
+}
 
-  auto &time_sliced_mutex = parameters.index_schema->GetTimeSlicedMutex();
-  vmsdk::ReaderMutexLock lock(&time_sliced_mutex);
-  ++Metrics::GetStats().time_slice_queries;
-  // Handle non vector queries first where attribute_alias is empty.
-  if (parameters.IsNonVectorQuery()) {
-    return SearchNonVectorQuery(parameters);
-  }
+absl::StatusOr<indexes::VectorBase *> GetVectorIndex(
+    const SearchParameters &parameters) {
   VMSDK_ASSIGN_OR_RETURN(auto index, parameters.index_schema->GetIndex(
                                          parameters.attribute_alias));
-  auto vector_index = dynamic_cast<indexes::VectorBase *>(index.get());
   if (index->GetIndexerType() != indexes::IndexerType::kHNSW &&
-      index->GetIndexerType() != indexes::IndexerType::kFlat) {
+      index->GetIndexerType() != indexes::IndexerType::kFlat &&
+      index->GetIndexerType() != indexes::IndexerType::kIVF) {
     return absl::InvalidArgumentError(
         absl::StrCat(parameters.attribute_alias, " is not a Vector index "));
   }
+  return dynamic_cast<indexes::VectorBase *>(index.get());
+}
+
+QueryPlan PlanQuery(const SearchParameters &parameters,
+                    indexes::VectorBase *vector_index, size_t qualified_entries,
+                    size_t num_queries) {
+  std::optional<size_t> search_width = parameters.ef;
+  if (vector_index->GetIndexerType() == indexes::IndexerType::kIVF) {
+    search_width = parameters.nprobe;
+  }
+  return PlanFilteredSearch(
+      qualified_entries, parameters.filter_parse_results.root_predicate.get(),
+      parameters.k, num_queries, search_width, vector_index);
+}
+
+// Reports the estimated cost of the chosen plan next to the actual one, which
+// is what the cost model is checked against.
+void LogQueryPlan(const QueryPlan &plan, size_t qualified_entries,
+                  absl::Duration actual) {
+  VMSDK_LOG(DEBUG, nullptr)
+      << "Using " << (plan.use_prefiltering ? "pre-filter" : "inline-filter")
+      << " query execution"
+      << (plan.filtered_traversal ? " with filtered traversal" : "")
+      << (plan.filter_bitmap ? " with filter bitmap" : "")
+      << ", qualified entries=" << qualified_entries
+      << ", estimated pre-filter cost="
+      << absl::Nanoseconds(plan.prefiltering_cost_ns)
+      << ", estimated inline-filter cost="
+      << absl::Nanoseconds(plan.inline_filtering_cost_ns)
+      << ", actual cost=" << actual;
+}
+
+absl::StatusOr<std::vector<indexes::Neighbor>> SearchVectorQuery(
+    const SearchParameters &parameters, vmsdk::ReaderMutexLock &lock) {
+  VMSDK_ASSIGN_OR_RETURN(auto vector_index, GetVectorIndex(parameters));
 
   if (!parameters.filter_parse_results.root_predicate) {
     return PerformVectorSearch(vector_index, parameters);
@@ -522,24 +940,113 @@ absl::StatusOr<std::vector<indexes::Neighbor>> DoSearch(
   std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> entries_fetchers;
   size_t qualified_entries = EvaluateFilterAsPrimary(
       parameters.filter_parse_results.root_predicate.get(), entries_fetchers,
-      false, parameters.filter_parse_results.query_operations);
+      false, parameters.filter_parse_results.query_operations,
+      parameters.cancellation_token);
 
   // Query planner makes the decision for pre-filtering vs inline-filtering.
-  if (UsePreFiltering(qualified_entries, vector_index)) {
-    VMSDK_LOG(DEBUG, nullptr)
-        << "Using pre-filter query execution, qualified entries="
-        << qualified_entries;
+  auto plan = PlanQuery(parameters, vector_index, qualified_entries, 1);
+  vmsdk::StopWatch stop_watch;
+  if (plan.use_prefiltering) {
     // Do an exact nearest neighbour search on the reduced search space.
     ++Metrics::GetStats().query_prefiltering_requests_cnt;
     std::priority_queue<std::pair<float, hnswlib::labeltype>> results =
         CalcBestMatchingPrefilteredKeys(parameters, entries_fetchers,
                                         vector_index, qualified_entries);
-
+    LogQueryPlan(plan, qualified_entries, stop_watch.Duration());
     return vector_index->CreateReply(results);
   }
   ++Metrics::GetStats().query_inline_filtering_requests_cnt;
   lock.SetMayProlong();
-  return PerformVectorSearch(vector_index, parameters);
+  FilterBitmap filter_bitmap;
+  if (plan.filter_bitmap) {
+    filter_bitmap = BuildFilterBitmap(parameters, entries_fetchers,
+                                      vector_index, qualified_entries);
+  }
+  auto neighbors = PerformVectorSearch(
+      vector_index, parameters,
+      {.filtered_traversal = plan.filtered_traversal,
+       .filter_bitmap = plan.filter_bitmap ? &filter_bitmap : nullptr});
+  LogQueryPlan(plan, qualified_entries, stop_watch.Duration());
+  return neighbors;
+}
+
+// Sets `total_count` when the neighbors are only the first of the matching
+// keys.
+absl::StatusOr<std::vector<indexes::Neighbor>> DoSearch(
+    const SearchParameters &parameters, SearchMode search_mode,
+    std::optional<size_t> &total_count) {
+  VMSDK_RETURN_IF_ERROR(CheckRemoteSearchMemory(search_mode));
+
+  auto &time_sliced_mutex = parameters.index_schema->GetTimeSlicedMutex();
+  vmsdk::ReaderMutexLock lock(&time_sliced_mutex);
+  ++Metrics::GetStats().time_slice_queries;
+  // Handle non vector queries first where attribute_alias is empty.
+  if (parameters.IsNonVectorQuery()) {
+    if (parameters.sortby.has_value()) {
+      return SearchSortedNonVectorQuery(parameters, total_count);
+    }
+    return SearchNonVectorQuery(parameters);
+  }
+  VMSDK_ASSIGN_OR_RETURN(auto neighbors, SearchVectorQuery(parameters, lock));
+  if (parameters.sortby.has_value()) {
+    // The k nearest neighbors are sorted, not the keys walked in value order.
+    VMSDK_ASSIGN_OR_RETURN(auto sort_index, GetSortByIndex(parameters));
+    SortBySortValues(neighbors, *sort_index, *parameters.sortby,
+                     neighbors.size());
+  }
+  return neighbors;
+}
+
+// Executes all the queries of a batched KNN query under a single reader lock
+// of the index schema.
+absl::StatusOr<std::vector<std::vector<indexes::Neighbor>>> DoBatchSearch(
+    const SearchParameters &parameters, SearchMode search_mode) {
+  VMSDK_RETURN_IF_ERROR(CheckRemoteSearchMemory(search_mode));
+
+  auto &time_sliced_mutex = parameters.index_schema->GetTimeSlicedMutex();
+  vmsdk::ReaderMutexLock lock(&time_sliced_mutex);
+  ++Metrics::GetStats().time_slice_queries;
+  VMSDK_ASSIGN_OR_RETURN(auto vector_index, GetVectorIndex(parameters));
+
+  if (!parameters.filter_parse_results.root_predicate) {
+    return PerformVectorSearchBatch(vector_index, parameters);
+  }
+  std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> entries_fetchers;
+  size_t qualified_entries = EvaluateFilterAsPrimary(
+      parameters.filter_parse_results.root_predicate.get(), entries_fetchers,
+      false, parameters.filter_parse_results.query_operations,
+      parameters.cancellation_token);
+
+  auto plan = PlanQuery(parameters, vector_index, qualified_entries,
+                        parameters.batch_queries.size());
+  vmsdk::StopWatch stop_watch;
+  if (plan.use_prefiltering) {
+    ++Metrics::GetStats().query_prefiltering_requests_cnt;
+    auto results = CalcBestMatchingPrefilteredKeysBatch(
+        parameters, entries_fetchers, vector_index, qualified_entries);
+    LogQueryPlan(plan, qualified_entries, stop_watch.Duration());
+    std::vector<std::vector<indexes::Neighbor>> replies;
+    replies.reserve(results.size());
+    for (auto &result : results) {
+      VMSDK_ASSIGN_OR_RETURN(auto reply, vector_index->CreateReply(result));
+      replies.push_back(std::move(reply));
+    }
+    return replies;
+  }
+  ++Metrics::GetStats().query_inline_filtering_requests_cnt;
+  lock.SetMayProlong();
+  // A single bitmap serves all the queries of the batch.
+  FilterBitmap filter_bitmap;
+  if (plan.filter_bitmap) {
+    filter_bitmap = BuildFilterBitmap(parameters, entries_fetchers,
+                                      vector_index, qualified_entries);
+  }
+  auto replies = PerformVectorSearchBatch(
+      vector_index, parameters,
+      {.filtered_traversal = plan.filtered_traversal,
+       .filter_bitmap = plan.filter_bitmap ? &filter_bitmap : nullptr});
+  LogQueryPlan(plan, qualified_entries, stop_watch.Duration());
+  return replies;
 }
 
 // Check if no results should be returned based on query parameters.
@@ -553,6 +1060,29 @@ bool ShouldReturnNoResults(const SearchParameters &parameters) {
          parameters.limit.number == 0;
 }
 
+void SortNeighbors(std::vector<indexes::Neighbor> &neighbors,
+                   const SortByParameter &sortby, size_t count) {
+  auto less = [ascending = sortby.ascending](const indexes::Neighbor &a,
+                                             const indexes::Neighbor &b) {
+    if (a.sort_value.has_value() != b.sort_value.has_value()) {
+      return a.sort_value.has_value();
+    }
+    if (a.sort_value.has_value() && *a.sort_value != *b.sort_value) {
+      return ascending ? *a.sort_value < *b.sort_value
+                       : *a.sort_value > *b.sort_value;
+    }
+    // By key for consistent ordering across shards when the values are equal.
+    return a.external_id->Str() < b.external_id->Str();
+  };
+  if (count < neighbors.size()) {
+    std::partial_sort(neighbors.begin(), neighbors.begin() + count,
+                      neighbors.end(), less);
+    neighbors.erase(neighbors.begin() + count, neighbors.end());
+  } else {
+    std::sort(neighbors.begin(), neighbors.end(), less);
+  }
+}
+
 SearchResult::SearchResult(size_t total_count,
                            std::vector<indexes::Neighbor> neighbors,
                            const SearchParameters &parameters)
@@ -571,6 +1101,12 @@ SearchResult::SearchResult(size_t total_count,
   }
 }
 
+SearchResult::SearchResult(std::vector<SearchResult> batch_results)
+    : total_count(0),
+      is_limited_with_buffer(false),
+      is_offsetted(false),
+      batch_results(std::move(batch_results)) {}
+
 // Apply limiting in background thread if possible.
 void SearchResult::TrimResults(std::vector<indexes::Neighbor> &neighbors,
                                const SearchParameters &parameters) {
@@ -637,15 +1173,34 @@ SerializationRange SearchResult::GetSerializationRange(
   return {start_index, end_index};
 }
 
+absl::StatusOr<SearchResult> SearchBatch(const SearchParameters &parameters,
+                                         SearchMode search_mode) {
+  VMSDK_ASSIGN_OR_RETURN(auto batch_neighbors,
+                         DoBatchSearch(parameters, search_mode));
+  std::vector<SearchResult> batch_results;
+  batch_results.reserve(batch_neighbors.size());
+  for (auto &neighbors : batch_neighbors) {
+    VMSDK_ASSIGN_OR_RETURN(
+        auto result, MaybeAddIndexedContent(std::move(neighbors), parameters));
+    size_t total_count = result.size();
+    batch_results.emplace_back(total_count, std::move(result), parameters);
+  }
+  return SearchResult(std::move(batch_results));
+}
+
 absl::StatusOr<SearchResult> Search(const SearchParameters &parameters,
                                     SearchMode search_mode) {
-  auto result =
-      MaybeAddIndexedContent(DoSearch(parameters, search_mode), parameters);
+  if (parameters.IsBatchedQuery()) {
+    return SearchBatch(parameters, search_mode);
+  }
+  std::optional<size_t> total_count;
+  auto result = MaybeAddIndexedContent(
+      DoSearch(parameters, search_mode, total_count), parameters);
   if (!result.ok()) {
     return result.status();
   }
-  size_t total_count = result.value().size();
-  return SearchResult(total_count, std::move(result.value()), parameters);
+  return SearchResult(total_count.value_or(result.value().size()),
+                      std::move(result.value()), parameters);
 }
 
 absl::Status SearchAsync(std::unique_ptr<SearchParameters> parameters,
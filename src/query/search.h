@@ -55,6 +55,12 @@ struct LimitParameter {
   uint64_t number{10};
 };
 
+// SORTBY of a query, on a Numeric field.
+struct SortByParameter {
+  std::string attribute_alias;
+  bool ascending{true};
+};
+
 struct ReturnAttribute {
   vmsdk::UniqueValkeyString identifier;
   vmsdk::UniqueValkeyString attribute_alias;
@@ -78,6 +84,9 @@ struct SearchParameters {
   std::string attribute_alias;
   vmsdk::UniqueValkeyString score_as;
   std::string query;
+  // Query vectors of a batched KNN query, in query order. Empty for single
+  // vector queries, which only use `query`.
+  std::vector<std::string> batch_queries;
   uint32_t dialect{kDialect};
   uint32_t db_num_;
   bool local_only{false};
@@ -85,7 +94,12 @@ struct SearchParameters {
   bool enable_consistency{options::GetPreferConsistentResults().GetValue()};
   int k{0};
   std::optional<unsigned> ef;
+  std::optional<unsigned> nprobe;
+  // Multiple of k of the candidates re-ranked with the full vectors, when the
+  // graph is traversed over quantized or truncated vectors.
+  std::optional<unsigned> oversample;
   LimitParameter limit;
+  std::optional<SortByParameter> sortby;
   uint64_t timeout_ms;
   bool no_content{false};
   FilterParseResults filter_parse_results;
@@ -104,25 +118,28 @@ struct SearchParameters {
     absl::string_view query_vector_string;
     absl::string_view k_string;
     absl::string_view ef_string;
+    absl::string_view nprobe_string;
+    absl::string_view oversample_string;
     //
     // A Map of param names to values. The target of the map is a pair
     // that is the string of the value AND a reference count so that we can
     // detect unused parameters.
     // Marked mutable so that const parsing functions can bump the ref-count
-    mutable absl::flat_hash_map<absl::string_view,
-                                std::pair<int, absl::string_view>>
-        params;
+    mutable QueryParams params;
     void ClearAtEndOfParse() {
       query_string = absl::string_view();
       score_as_string = absl::string_view();
       query_vector_string = absl::string_view();
       k_string = absl::string_view();
       ef_string = absl::string_view();
+      nprobe_string = absl::string_view();
+      oversample_string = absl::string_view();
       params.clear();
     }
   } parse_vars;
   bool IsNonVectorQuery() const { return attribute_alias.empty(); }
   bool IsVectorQuery() const { return !IsNonVectorQuery(); }
+  bool IsBatchedQuery() const { return !batch_queries.empty(); }
   // Indicates whether the search requires complete results (neighbors/keys) to
   // be able to return correct results. An example of this is when sorting on a
   // particular is needed on the results. This should be overridden in derived
@@ -150,10 +167,15 @@ struct SearchResult {
   bool is_limited_with_buffer;
   // True if neighbors were offset using LIMIT first_index.
   bool is_offsetted;
+  // Per query results of a batched KNN query, in query order. The other
+  // members are unused for batched queries.
+  std::vector<SearchResult> batch_results;
 
   // Constructor with automatic trimming based on query requirements
   SearchResult(size_t total_count, std::vector<indexes::Neighbor> neighbors,
                const SearchParameters& parameters);
+  // Constructor for the results of a batched KNN query.
+  explicit SearchResult(std::vector<SearchResult> batch_results);
   // Get the range of neighbors to serialize in response.
   SerializationRange GetSerializationRange(
       const SearchParameters& parameters) const;
@@ -185,11 +207,25 @@ class Predicate;
 size_t EvaluateFilterAsPrimary(
     const Predicate* predicate,
     std::queue<std::unique_ptr<indexes::EntriesFetcherBase>>& entries_fetchers,
-    bool negate, QueryOperations query_operations);
+    bool negate, QueryOperations query_operations,
+    cancel::Token& cancellation_token);
+
+// Internal ids of a vector index that pass a filter, one bit per id.
+using FilterBitmap = std::vector<uint64_t>;
+
+// How an inline filtered vector search applies the filter.
+struct InlineFilterOptions {
+  // Traverse the index around the candidates rejected by the filter.
+  bool filtered_traversal{false};
+  // If set, the candidates are tested against the bitmap rather than
+  // evaluated against the filter.
+  const FilterBitmap* filter_bitmap{nullptr};
+};
 
 // Defined in the header to support testing
 absl::StatusOr<std::vector<indexes::Neighbor>> PerformVectorSearch(
-    indexes::VectorBase* vector_index, const SearchParameters& parameters);
+    indexes::VectorBase* vector_index, const SearchParameters& parameters,
+    const InlineFilterOptions& options = {});
 
 std::priority_queue<std::pair<float, hnswlib::labeltype>>
 CalcBestMatchingPrefilteredKeys(
@@ -197,8 +233,19 @@ CalcBestMatchingPrefilteredKeys(
     std::queue<std::unique_ptr<indexes::EntriesFetcherBase>>& entries_fetchers,
     indexes::VectorBase* vector_index, size_t qualified_entries);
 
+// Collects the internal ids of the keys that pass the filter of the query.
+FilterBitmap BuildFilterBitmap(
+    const SearchParameters& parameters,
+    std::queue<std::unique_ptr<indexes::EntriesFetcherBase>>& entries_fetchers,
+    indexes::VectorBase* vector_index, size_t qualified_entries);
+
 // Check if no results should be returned based on limit parameters
 bool ShouldReturnNoResults(const SearchParameters& parameters);
 
+// Orders the neighbors of a query with SORTBY by their sort values, the keys
+// without one last, and keeps the first `count` of them.
+void SortNeighbors(std::vector<indexes::Neighbor>& neighbors,
+                   const SortByParameter& sortby, size_t count);
+
 }  // namespace valkey_search::query
 #endif  // VALKEYSEARCH_SRC_QUERY_SEARCH_H_
@@ -690,6 +690,36 @@ void SchemaManager::OnServerCronCallback(ValkeyModuleCtx *ctx,
                                          [[maybe_unused]] void *data) {
   SchemaManager::Instance().PerformBackfill(
       ctx, options::GetBackfillBatchSize().GetValue());
+  SchemaManager::Instance().ScheduleConsolidation();
+  SchemaManager::Instance().ScheduleReorder();
+  SchemaManager::Instance().ScheduleTraining();
+}
+
+void SchemaManager::ScheduleConsolidation() {
+  absl::MutexLock lock(&db_to_index_schemas_mutex_);
+  for (const auto &[db_num, inner_map] : db_to_index_schemas_) {
+    for (const auto &[name, schema] : inner_map) {
+      schema->ScheduleConsolidation();
+    }
+  }
+}
+
+void SchemaManager::ScheduleReorder() {
+  absl::MutexLock lock(&db_to_index_schemas_mutex_);
+  for (const auto &[db_num, inner_map] : db_to_index_schemas_) {
+    for (const auto &[name, schema] : inner_map) {
+      schema->ScheduleReorder();
+    }
+  }
+}
+
+void SchemaManager::ScheduleTraining() {
+  absl::MutexLock lock(&db_to_index_schemas_mutex_);
+  for (const auto &[db_num, inner_map] : db_to_index_schemas_) {
+    for (const auto &[name, schema] : inner_map) {
+      schema->ScheduleTraining();
+    }
+  }
 }
 
 void SchemaManager::PopulateFingerprintVersionFromMetadata(
@@ -80,6 +80,9 @@ class SchemaManager {
 
   void PerformBackfill(ValkeyModuleCtx *ctx, uint32_t batch_size)
       ABSL_LOCKS_EXCLUDED(db_to_index_schemas_mutex_);
+  void ScheduleConsolidation() ABSL_LOCKS_EXCLUDED(db_to_index_schemas_mutex_);
+  void ScheduleReorder() ABSL_LOCKS_EXCLUDED(db_to_index_schemas_mutex_);
+  void ScheduleTraining() ABSL_LOCKS_EXCLUDED(db_to_index_schemas_mutex_);
 
   void OnFlushDBCallback(ValkeyModuleCtx *ctx, ValkeyModuleEvent eid,
                          uint64_t subevent, void *data)
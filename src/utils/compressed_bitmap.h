@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#ifndef VALKEYSEARCH_SRC_UTILS_COMPRESSED_BITMAP_H_
+#define VALKEYSEARCH_SRC_UTILS_COMPRESSED_BITMAP_H_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "absl/log/check.h"
+
+namespace valkey_search::utils {
+
+// A set of uint32 values, compressed like a Roaring bitmap. The values are
+// grouped by their high 16 bits into containers, which keep the low 16 bits of
+// up to kMaxArraySize values in a sorted array, two bytes per value, and those
+// of more values in a bitset of 2^16 bits. Dense sets thus cost about a bit per
+// value, sparse ones about two bytes. Containers go back to arrays when they
+// drop to half of kMaxArraySize, so that a set at the threshold does not flip
+// between the two on every change. A single value, e.g. that of a unique tag,
+// is kept inline without any container.
+//
+// The interface follows the standard sets, so that it can hold the values of a
+// PatriciaTree.
+class CompressedBitmap {
+ public:
+  class const_iterator;
+  using value_type = uint32_t;
+
+  CompressedBitmap() = default;
+  CompressedBitmap(CompressedBitmap &&) = default;
+  CompressedBitmap &operator=(CompressedBitmap &&) = default;
+  CompressedBitmap(const CompressedBitmap &other) { *this = other; }
+  CompressedBitmap &operator=(const CompressedBitmap &other) {
+    containers_.clear();
+    containers_.reserve(other.containers_.size());
+    for (const auto &container : other.containers_) {
+      containers_.push_back(container.Copy());
+    }
+    size_ = other.size_;
+    single_ = other.single_;
+    return *this;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  bool contains(uint32_t value) const {
+    if (containers_.empty()) {
+      return size_ == 1 && single_ == value;
+    }
+    auto it = FindContainer(value >> 16);
+    return it != containers_.end() && it->high == value >> 16 &&
+           it->Contains(value & 0xffff);
+  }
+
+  // Returns whether `value` was added.
+  bool insert(uint32_t value) {
+    if (containers_.empty()) {
+      if (size_ == 0) {
+        single_ = value;
+        size_ = 1;
+        return true;
+      }
+      if (single_ == value) {
+        return false;
+      }
+      MoveSingleToContainer();
+    }
+    auto it = FindContainer(value >> 16);
+    if (it == containers_.end() || it->high != value >> 16) {
+      it = containers_.insert(it, Container{.high = uint16_t(value >> 16)});
+    }
+    if (!it->Insert(value & 0xffff)) {
+      return false;
+    }
+    ++size_;
+    return true;
+  }
+
+  // Returns the number of values removed, 0 or 1.
+  size_t erase(uint32_t value) {
+    if (containers_.empty()) {
+      if (size_ == 0 || single_ != value) {
+        return 0;
+      }
+      size_ = 0;
+      return 1;
+    }
+    auto it = FindContainer(value >> 16);
+    if (it == containers_.end() || it->high != value >> 16 ||
+        !it->Erase(value & 0xffff)) {
+      return 0;
+    }
+    if (it->cardinality == 0) {
+      containers_.erase(it);
+    }
+    --size_;
+    return 1;
+  }
+
+  // Adds the values of `other`.
+  void UnionWith(const CompressedBitmap &other) {
+    if (other.containers_.empty()) {
+      if (other.size_ == 1) {
+        insert(other.single_);
+      }
+      return;
+    }
+    if (containers_.empty() && size_ == 1) {
+      MoveSingleToContainer();
+    }
+    auto it = containers_.begin();
+    for (const auto &other_container : other.containers_) {
+      it = std::lower_bound(it, containers_.end(), other_container.high,
+                            [](const Container &container, uint16_t high) {
+                              return container.high < high;
+                            });
+      if (it == containers_.end() || it->high != other_container.high) {
+        it = containers_.insert(it, other_container.Copy());
+        size_ += it->cardinality;
+      } else {
+        size_ -= it->cardinality;
+        it->UnionWith(other_container);
+        size_ += it->cardinality;
+      }
+      ++it;
+    }
+  }
+
+  // Iterates over the values in ascending order.
+  class const_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = uint32_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const uint32_t *;
+    using reference = uint32_t;
+
+    const_iterator() = default;
+    uint32_t operator*() const { return value_; }
+    const_iterator &operator++() {
+      ++position_;
+      Settle();
+      return *this;
+    }
+    const_iterator operator++(int) {
+      auto copy = *this;
+      ++*this;
+      return copy;
+    }
+    bool operator==(const const_iterator &other) const {
+      return container_ == other.container_ && position_ == other.position_;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class CompressedBitmap;
+    const_iterator(const CompressedBitmap *bitmap, size_t container)
+        : bitmap_(bitmap), container_(container) {
+      Settle();
+    }
+
+    // Moves to the first value at or after the position, or to the end.
+    void Settle() {
+      const auto &containers = bitmap_->containers_;
+      if (containers.empty()) {
+        if (container_ < bitmap_->size_ && position_ == 0) {
+          value_ = bitmap_->single_;
+        } else {
+          container_ = bitmap_->size_;
+          position_ = 0;
+        }
+        return;
+      }
+      for (; container_ < containers.size(); ++container_, position_ = 0) {
+        const auto &container = containers[container_];
+        uint32_t high = uint32_t(container.high) << 16;
+        if (container.bitset == nullptr) {
+          if (position_ < container.array.size()) {
+            value_ = high | container.array[position_];
+            return;
+          }
+          continue;
+        }
+        for (size_t word = position_ / 64; word < kBitsetWords; ++word) {
+          uint64_t bits = (*container.bitset)[word];
+          if (word == position_ / 64) {
+            bits &= ~uint64_t{0} << (position_ % 64);
+          }
+          if (bits != 0) {
+            position_ = word * 64 + std::countr_zero(bits);
+            value_ = high | position_;
+            return;
+          }
+        }
+      }
+      position_ = 0;
+    }
+
+    const CompressedBitmap *bitmap_{nullptr};
+    size_t container_{0};
+    // The index in the array, or the bit in the bitset, of the value.
+    uint32_t position_{0};
+    uint32_t value_{0};
+  };
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  // Without containers, the single value, if any, is in a "container" 0.
+  const_iterator end() const {
+    return const_iterator(this,
+                          containers_.empty() ? size_ : containers_.size());
+  }
+
+ private:
+  static constexpr size_t kMaxArraySize = 4096;
+  static constexpr size_t kBitsetWords = (1 << 16) / 64;
+  using Bitset = std::array<uint64_t, kBitsetWords>;
+
+  struct Container {
+    uint16_t high;
+    uint32_t cardinality{0};
+    // The sorted low halves, unless there is a bitset.
+    std::vector<uint16_t> array;
+    std::unique_ptr<Bitset> bitset;
+
+    Container Copy() const {
+      Container copy{
+          .high = high, .cardinality = cardinality, .array = array};
+      if (bitset != nullptr) {
+        copy.bitset = std::make_unique<Bitset>(*bitset);
+      }
+      return copy;
+    }
+
+    bool Contains(uint16_t low) const {
+      if (bitset != nullptr) {
+        return ((*bitset)[low / 64] >> (low % 64)) & 1;
+      }
+      return std::binary_search(array.begin(), array.end(), low);
+    }
+
+    bool Insert(uint16_t low) {
+      if (bitset == nullptr) {
+        auto it = std::lower_bound(array.begin(), array.end(), low);
+        if (it != array.end() && *it == low) {
+          return false;
+        }
+        if (array.size() < kMaxArraySize) {
+          array.insert(it, low);
+          ++cardinality;
+          return true;
+        }
+        ToBitset();
+      }
+      uint64_t &word = (*bitset)[low / 64];
+      uint64_t bit = uint64_t{1} << (low % 64);
+      if (word & bit) {
+        return false;
+      }
+      word |= bit;
+      ++cardinality;
+      return true;
+    }
+
+    bool Erase(uint16_t low) {
+      if (bitset == nullptr) {
+        auto it = std::lower_bound(array.begin(), array.end(), low);
+        if (it == array.end() || *it != low) {
+          return false;
+        }
+        array.erase(it);
+        --cardinality;
+        return true;
+      }
+      uint64_t &word = (*bitset)[low / 64];
+      uint64_t bit = uint64_t{1} << (low % 64);
+      if (!(word & bit)) {
+        return false;
+      }
+      word &= ~bit;
+      if (--cardinality <= kMaxArraySize / 2) {
+        ToArray();
+      }
+      return true;
+    }
+
+    void UnionWith(const Container &other) {
+      if (bitset == nullptr && other.bitset == nullptr &&
+          cardinality + other.cardinality <= kMaxArraySize) {
+        std::vector<uint16_t> merged;
+        merged.reserve(cardinality + other.cardinality);
+        std::set_union(array.begin(), array.end(), other.array.begin(),
+                       other.array.end(), std::back_inserter(merged));
+        array = std::move(merged);
+        cardinality = array.size();
+        return;
+      }
+      if (bitset == nullptr) {
+        ToBitset();
+      }
+      if (other.bitset != nullptr) {
+        cardinality = 0;
+        for (size_t word = 0; word < kBitsetWords; ++word) {
+          (*bitset)[word] |= (*other.bitset)[word];
+          cardinality += std::popcount((*bitset)[word]);
+        }
+        return;
+      }
+      for (auto low : other.array) {
+        uint64_t &word = (*bitset)[low / 64];
+        uint64_t bit = uint64_t{1} << (low % 64);
+        cardinality += (word & bit) == 0;
+        word |= bit;
+      }
+    }
+
+    void ToBitset() {
+      bitset = std::make_unique<Bitset>();
+      bitset->fill(0);
+      for (auto low : array) {
+        (*bitset)[low / 64] |= uint64_t{1} << (low % 64);
+      }
+      array = {};
+    }
+
+    void ToArray() {
+      DCHECK(bitset != nullptr);
+      array.reserve(cardinality);
+      for (size_t word = 0; word < kBitsetWords; ++word) {
+        for (uint64_t bits = (*bitset)[word]; bits != 0; bits &= bits - 1) {
+          array.push_back(word * 64 + std::countr_zero(bits));
+        }
+      }
+      bitset = nullptr;
+    }
+  };
+
+  void MoveSingleToContainer() {
+    DCHECK(containers_.empty() && size_ == 1);
+    containers_.push_back(Container{.high = uint16_t(single_ >> 16)});
+    containers_.back().Insert(single_ & 0xffff);
+  }
+
+  // Returns the first container whose high half is not below `high`.
+  std::vector<Container>::const_iterator FindContainer(uint16_t high) const {
+    return std::lower_bound(containers_.begin(), containers_.end(), high,
+                            [](const Container &container, uint16_t high) {
+                              return container.high < high;
+                            });
+  }
+  std::vector<Container>::iterator FindContainer(uint16_t high) {
+    return std::lower_bound(containers_.begin(), containers_.end(), high,
+                            [](const Container &container, uint16_t high) {
+                              return container.high < high;
+                            });
+  }
+
+  // Sorted by their high halves. Empty if there are less than two values and
+  // no value was ever removed from a container.
+  std::vector<Container> containers_;
+  size_t size_{0};
+  // The value, if `containers_` is empty and `size_` is 1.
+  uint32_t single_{0};
+};
+
+}  // namespace valkey_search::utils
+
+#endif  // VALKEYSEARCH_SRC_UTILS_COMPRESSED_BITMAP_H_
@@ -0,0 +1,840 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#ifndef VALKEYSEARCH_SRC_UTILS_COUNTED_BTREE_H_
+#define VALKEYSEARCH_SRC_UTILS_COUNTED_BTREE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/hash/hash.h"
+
+namespace valkey_search::utils {
+namespace counted_btree_internal {
+
+// The sorted keys of a leaf. The number of keys is kept by the leaf, and
+// passed in as `size`.
+template <typename K, uint16_t kCapacity, typename Enable = void>
+class LeafKeys {
+ public:
+  K Get(uint16_t pos) const { return keys_[pos]; }
+  // Returns the position of the first key at least `key`.
+  uint16_t LowerBound(uint16_t size, const K &key) const {
+    return std::lower_bound(keys_, keys_ + size, key) - keys_;
+  }
+  // Returns the position of the first key above `key`.
+  uint16_t UpperBound(uint16_t size, const K &key) const {
+    return std::upper_bound(keys_, keys_ + size, key) - keys_;
+  }
+  void Insert(uint16_t size, uint16_t pos, const K &key) {
+    std::move_backward(keys_ + pos, keys_ + size, keys_ + size + 1);
+    keys_[pos] = key;
+  }
+  void Erase(uint16_t size, uint16_t pos) {
+    std::move(keys_ + pos + 1, keys_ + size, keys_ + pos);
+  }
+  // Copies out the keys, or replaces them with `keys`.
+  void Decode(uint16_t size, K *keys) const {
+    std::copy(keys_, keys_ + size, keys);
+  }
+  void Encode(uint16_t size, const K *keys) {
+    std::copy(keys, keys + size, keys_);
+  }
+
+ private:
+  K keys_[kCapacity];
+};
+
+// Integer keys are stored as 32 bit offsets from a base at most all of them,
+// which halves the leaves' keys of 64 bit integers whose neighbors are less
+// than 2^32 apart, e.g. timestamps, counters or ids. A leaf whose keys span
+// more than that stores them whole, in an array of its own.
+template <typename K, uint16_t kCapacity>
+class LeafKeys<K, kCapacity,
+               std::enable_if_t<std::is_integral_v<K> &&
+                                (sizeof(K) > sizeof(uint32_t))>> {
+ public:
+  K Get(uint16_t pos) const {
+    return wide_ != nullptr ? wide_[pos] : FromOffset(offsets_[pos]);
+  }
+  uint16_t LowerBound(uint16_t size, const K &key) const {
+    if (wide_ != nullptr) {
+      return std::lower_bound(wide_.get(), wide_.get() + size, key) -
+             wide_.get();
+    }
+    if (key <= base_) {
+      return 0;
+    }
+    auto offset = ToOffset(key);
+    if (!offset.has_value()) {
+      return size;
+    }
+    return std::lower_bound(offsets_, offsets_ + size, *offset) - offsets_;
+  }
+  uint16_t UpperBound(uint16_t size, const K &key) const {
+    if (wide_ != nullptr) {
+      return std::upper_bound(wide_.get(), wide_.get() + size, key) -
+             wide_.get();
+    }
+    if (key < base_) {
+      return 0;
+    }
+    auto offset = ToOffset(key);
+    if (!offset.has_value()) {
+      return size;
+    }
+    return std::upper_bound(offsets_, offsets_ + size, *offset) - offsets_;
+  }
+  void Insert(uint16_t size, uint16_t pos, const K &key) {
+    if (wide_ == nullptr && size > 0 && key >= base_) {
+      if (auto offset = ToOffset(key); offset.has_value()) {
+        std::move_backward(offsets_ + pos, offsets_ + size,
+                           offsets_ + size + 1);
+        offsets_[pos] = *offset;
+        return;
+      }
+    }
+    K keys[kCapacity];
+    Decode(size, keys);
+    std::move_backward(keys + pos, keys + size, keys + size + 1);
+    keys[pos] = key;
+    Encode(size + 1, keys);
+  }
+  void Erase(uint16_t size, uint16_t pos) {
+    if (wide_ == nullptr) {
+      std::move(offsets_ + pos + 1, offsets_ + size, offsets_ + pos);
+      return;
+    }
+    std::move(wide_.get() + pos + 1, wide_.get() + size, wide_.get() + pos);
+    // The remaining keys may fit in offsets again.
+    K keys[kCapacity];
+    Decode(size - 1, keys);
+    Encode(size - 1, keys);
+  }
+  void Decode(uint16_t size, K *keys) const {
+    for (uint16_t i = 0; i < size; ++i) {
+      keys[i] = Get(i);
+    }
+  }
+  void Encode(uint16_t size, const K *keys) {
+    base_ = size == 0 ? K() : keys[0];
+    if (size == 0 || ToOffset(keys[size - 1]).has_value()) {
+      for (uint16_t i = 0; i < size; ++i) {
+        offsets_[i] = *ToOffset(keys[i]);
+      }
+      wide_.reset();
+      return;
+    }
+    if (wide_ == nullptr) {
+      wide_ = std::make_unique<K[]>(kCapacity);
+    }
+    std::copy(keys, keys + size, wide_.get());
+  }
+
+ private:
+  using Unsigned = std::make_unsigned_t<K>;
+
+  K FromOffset(uint32_t offset) const {
+    return static_cast<K>(static_cast<Unsigned>(base_) + offset);
+  }
+  // Returns the offset of a key at least base_, if it fits.
+  std::optional<uint32_t> ToOffset(const K &key) const {
+    Unsigned offset = static_cast<Unsigned>(key) - static_cast<Unsigned>(base_);
+    if (offset > std::numeric_limits<uint32_t>::max()) {
+      return std::nullopt;
+    }
+    return offset;
+  }
+
+  K base_{};
+  // Set while the keys span more than the offsets do.
+  std::unique_ptr<K[]> wide_;
+  uint32_t offsets_[kCapacity];
+};
+
+}  // namespace counted_btree_internal
+
+// A B+tree from ordered keys to sets of values, whose inner nodes keep the
+// number of values of each subtree. Counting the values in a key range takes
+// one descent per bound, and iterating them walks the linked leaves, so the
+// tree serves both range iteration and range counting.
+template <typename K, typename V, typename Hasher = absl::Hash<V>,
+          typename Equalizer = std::equal_to<V>>
+class CountedBTree {
+ public:
+  // The values of one key. A single value is stored inline, a few in a small
+  // array, and many in a hash set. Most keys of a numeric field have a single
+  // value, which then costs no allocation.
+  class Postings {
+   public:
+    using SetType = absl::flat_hash_set<V, Hasher, Equalizer>;
+    using value_type = V;
+
+    class const_iterator {
+     public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = V;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const V *;
+      using reference = const V &;
+
+      const_iterator() = default;
+      const V &operator*() const { return in_set_ ? *set_iter_ : *ptr_; }
+      const V *operator->() const { return &**this; }
+      const_iterator &operator++() {
+        if (in_set_) {
+          ++set_iter_;
+        } else {
+          ++ptr_;
+        }
+        return *this;
+      }
+      bool operator==(const const_iterator &other) const {
+        return in_set_ ? set_iter_ == other.set_iter_ : ptr_ == other.ptr_;
+      }
+      bool operator!=(const const_iterator &other) const {
+        return !(*this == other);
+      }
+
+     private:
+      friend class Postings;
+      const V *ptr_{nullptr};
+      typename SetType::const_iterator set_iter_{};
+      bool in_set_{false};
+    };
+
+    Postings() {}
+    Postings(Postings &&other) noexcept { MoveFrom(other); }
+    Postings &operator=(Postings &&other) noexcept {
+      if (this != &other) {
+        Clear();
+        MoveFrom(other);
+      }
+      return *this;
+    }
+    Postings(const Postings &) = delete;
+    Postings &operator=(const Postings &) = delete;
+    ~Postings() { Clear(); }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool contains(const V &value) const {
+      if (capacity_ == kSetMode) {
+        return set_->contains(value);
+      }
+      return Find(value) != nullptr;
+    }
+    const_iterator begin() const {
+      const_iterator it;
+      if (capacity_ == kSetMode) {
+        it.in_set_ = true;
+        it.set_iter_ = set_->begin();
+      } else {
+        it.ptr_ = Data();
+      }
+      return it;
+    }
+    const_iterator end() const {
+      const_iterator it;
+      if (capacity_ == kSetMode) {
+        it.in_set_ = true;
+        it.set_iter_ = set_->end();
+      } else {
+        it.ptr_ = Data() + size_;
+      }
+      return it;
+    }
+
+    // Returns false if the value is already there.
+    bool Add(const V &value) {
+      if (capacity_ == kSetMode) {
+        if (!set_->insert(value).second) {
+          return false;
+        }
+      } else if (Find(value) != nullptr) {
+        return false;
+      } else if (size_ == 0) {
+        new (&value_) V(value);
+      } else if (capacity_ == 0) {
+        V *array = new V[kInitialArrayCapacity];
+        array[0] = std::move(value_);
+        value_.~V();
+        array[1] = value;
+        array_ = array;
+        capacity_ = kInitialArrayCapacity;
+      } else if (size_ < capacity_) {
+        array_[size_] = value;
+      } else if (capacity_ < kMaxArrayValues) {
+        V *array = new V[capacity_ * 2];
+        std::move(array_, array_ + size_, array);
+        delete[] array_;
+        array[size_] = value;
+        array_ = array;
+        capacity_ *= 2;
+      } else {
+        auto set = new SetType(std::make_move_iterator(array_),
+                               std::make_move_iterator(array_ + size_));
+        set->insert(value);
+        delete[] array_;
+        set_ = set;
+        capacity_ = kSetMode;
+      }
+      ++size_;
+      return true;
+    }
+
+    // Returns false if the value is not there.
+    bool Remove(const V &value) {
+      if (capacity_ == kSetMode) {
+        if (set_->erase(value) == 0) {
+          return false;
+        }
+        if (--size_ <= kMaxArrayValues / 2) {
+          V *array = new V[kMaxArrayValues];
+          std::copy(set_->begin(), set_->end(), array);
+          delete set_;
+          array_ = array;
+          capacity_ = kMaxArrayValues;
+        }
+        return true;
+      }
+      const V *found = Find(value);
+      if (found == nullptr) {
+        return false;
+      }
+      if (capacity_ == 0) {
+        value_.~V();
+        --size_;
+        return true;
+      }
+      V *slot = array_ + (found - array_);
+      *slot = std::move(array_[size_ - 1]);
+      array_[size_ - 1] = V();
+      if (--size_ == 1) {
+        V last = std::move(array_[0]);
+        delete[] array_;
+        new (&value_) V(std::move(last));
+        capacity_ = 0;
+      }
+      return true;
+    }
+
+   private:
+    static constexpr uint32_t kInitialArrayCapacity = 2;
+    // Larger sets are kept in a hash set, and go back to an array when they
+    // shrink to half of this.
+    static constexpr uint32_t kMaxArrayValues = 8;
+    static constexpr uint32_t kSetMode = UINT32_MAX;
+
+    const V *Data() const {
+      return capacity_ == 0 ? (size_ == 0 ? nullptr : &value_) : array_;
+    }
+    const V *Find(const V &value) const {
+      const V *data = Data();
+      for (uint32_t i = 0; i < size_; ++i) {
+        if (Equalizer{}(data[i], value)) {
+          return data + i;
+        }
+      }
+      return nullptr;
+    }
+    void Clear() {
+      if (capacity_ == kSetMode) {
+        delete set_;
+      } else if (capacity_ > 0) {
+        delete[] array_;
+      } else if (size_ == 1) {
+        value_.~V();
+      }
+      size_ = 0;
+      capacity_ = 0;
+    }
+    void MoveFrom(Postings &other) {
+      size_ = other.size_;
+      capacity_ = other.capacity_;
+      if (capacity_ == kSetMode) {
+        set_ = other.set_;
+      } else if (capacity_ > 0) {
+        array_ = other.array_;
+      } else if (size_ == 1) {
+        new (&value_) V(std::move(other.value_));
+        other.value_.~V();
+      }
+      other.size_ = 0;
+      other.capacity_ = 0;
+    }
+
+    uint32_t size_{0};
+    // 0 while the values are inline, kSetMode once they are in set_, and the
+    // size of array_ otherwise.
+    uint32_t capacity_{0};
+    union {
+      V value_;
+      V *array_;
+      SetType *set_;
+    };
+  };
+
+ private:
+  static constexpr uint16_t kLeafCapacity = 32;
+  static constexpr uint16_t kInnerCapacity = 32;
+
+  struct Node {
+    explicit Node(bool is_leaf) : is_leaf(is_leaf) {}
+    virtual ~Node() = default;
+    const bool is_leaf;
+    // The number of keys of a leaf, or of children of an inner node.
+    uint16_t size{0};
+  };
+  struct Leaf : Node {
+    Leaf() : Node(true) {}
+    // One extra slot holds the overflow until the leaf is split.
+    counted_btree_internal::LeafKeys<K, kLeafCapacity + 1> keys;
+    Postings postings[kLeafCapacity + 1];
+    Leaf *prev{nullptr};
+    Leaf *next{nullptr};
+  };
+  struct Inner : Node {
+    Inner() : Node(false) {}
+    // keys[i] is above the keys of children[i], and at most the keys of
+    // children[i + 1].
+    K keys[kInnerCapacity];
+    std::unique_ptr<Node> children[kInnerCapacity + 1];
+    // The number of values of each child's subtree.
+    uint64_t counts[kInnerCapacity + 1];
+  };
+
+ public:
+  // Iterates the keys in ascending order, or in descending order from Last()
+  // with operator--.
+  class ConstIterator {
+   public:
+    ConstIterator() = default;
+    K key() const { return leaf_->keys.Get(pos_); }
+    const Postings &values() const { return leaf_->postings[pos_]; }
+    ConstIterator &operator++() {
+      if (++pos_ == leaf_->size) {
+        leaf_ = leaf_->next;
+        pos_ = 0;
+      }
+      return *this;
+    }
+    // Moves to the previous key, or to end() from the first one.
+    ConstIterator &operator--() {
+      if (pos_ == 0) {
+        leaf_ = leaf_->prev;
+        pos_ = leaf_ == nullptr ? 0 : leaf_->size - 1;
+      } else {
+        --pos_;
+      }
+      return *this;
+    }
+    bool operator==(const ConstIterator &other) const {
+      return leaf_ == other.leaf_ && pos_ == other.pos_;
+    }
+    bool operator!=(const ConstIterator &other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class CountedBTree;
+    ConstIterator(const Leaf *leaf, uint16_t pos) : leaf_(leaf), pos_(pos) {
+      if (leaf_ != nullptr && pos_ == leaf_->size) {
+        leaf_ = leaf_->next;
+        pos_ = 0;
+      }
+    }
+    const Leaf *leaf_{nullptr};
+    uint16_t pos_{0};
+  };
+
+  CountedBTree() = default;
+  CountedBTree(const CountedBTree &) = delete;
+  CountedBTree &operator=(const CountedBTree &) = delete;
+
+  // Returns false if the value is already under the key.
+  bool Add(const K &key, const V &value) {
+    if (root_ == nullptr) {
+      root_ = std::make_unique<Leaf>();
+    }
+    std::optional<Split> split;
+    if (!Add(root_.get(), key, value, split)) {
+      return false;
+    }
+    ++size_;
+    if (split.has_value()) {
+      auto root = std::make_unique<Inner>();
+      root->keys[0] = split->separator;
+      root->counts[0] = NodeCount(root_.get());
+      root->counts[1] = NodeCount(split->right.get());
+      root->children[0] = std::move(root_);
+      root->children[1] = std::move(split->right);
+      root->size = 2;
+      root_ = std::move(root);
+    }
+    return true;
+  }
+
+  // Returns false if the value is not under the key.
+  bool Remove(const K &key, const V &value) {
+    if (root_ == nullptr || !Remove(root_.get(), key, value)) {
+      return false;
+    }
+    --size_;
+    if (root_->is_leaf) {
+      if (root_->size == 0) {
+        root_.reset();
+      }
+    } else if (root_->size == 1) {
+      auto child = std::move(static_cast<Inner *>(root_.get())->children[0]);
+      root_ = std::move(child);
+    }
+    return true;
+  }
+
+  // The number of values, over all keys.
+  size_t Size() const { return size_; }
+
+  ConstIterator begin() const {
+    const Node *node = root_.get();
+    while (node != nullptr && !node->is_leaf) {
+      node = static_cast<const Inner *>(node)->children[0].get();
+    }
+    return ConstIterator(static_cast<const Leaf *>(node), 0);
+  }
+  ConstIterator end() const { return ConstIterator(); }
+  // Returns the last key, or end() if the tree is empty.
+  ConstIterator Last() const {
+    const Node *node = root_.get();
+    while (node != nullptr && !node->is_leaf) {
+      auto inner = static_cast<const Inner *>(node);
+      node = inner->children[inner->size - 1].get();
+    }
+    if (node == nullptr) {
+      return end();
+    }
+    return ConstIterator(static_cast<const Leaf *>(node), node->size - 1);
+  }
+  // Returns the first key at least `key`.
+  ConstIterator LowerBound(const K &key) const {
+    const Leaf *leaf = FindLeaf(key);
+    if (leaf == nullptr) {
+      return end();
+    }
+    return ConstIterator(leaf, leaf->keys.LowerBound(leaf->size, key));
+  }
+  // Returns the first key above `key`.
+  ConstIterator UpperBound(const K &key) const {
+    const Leaf *leaf = FindLeaf(key);
+    if (leaf == nullptr) {
+      return end();
+    }
+    return ConstIterator(leaf, leaf->keys.UpperBound(leaf->size, key));
+  }
+
+  // Returns the number of values whose key is below `key`, or at most `key`
+  // if `inclusive`.
+  uint64_t CountLess(const K &key, bool inclusive) const {
+    uint64_t count = 0;
+    const Node *node = root_.get();
+    while (node != nullptr && !node->is_leaf) {
+      auto inner = static_cast<const Inner *>(node);
+      size_t child = ChildIndex(inner, key);
+      for (size_t i = 0; i < child; ++i) {
+        count += inner->counts[i];
+      }
+      node = inner->children[child].get();
+    }
+    if (node == nullptr) {
+      return 0;
+    }
+    auto leaf = static_cast<const Leaf *>(node);
+    uint16_t end = inclusive ? leaf->keys.UpperBound(leaf->size, key)
+                             : leaf->keys.LowerBound(leaf->size, key);
+    for (uint16_t i = 0; i < end; ++i) {
+      count += leaf->postings[i].size();
+    }
+    return count;
+  }
+
+  // Returns the number of values whose key is between `start` and `end`.
+  uint64_t Count(const K &start, const K &end, bool start_inclusive,
+                 bool end_inclusive) const {
+    uint64_t below_end = CountLess(end, end_inclusive);
+    uint64_t below_start = CountLess(start, !start_inclusive);
+    return below_end > below_start ? below_end - below_start : 0;
+  }
+
+  // Testing only
+  int GetHeight() const {
+    int height = 0;
+    for (const Node *node = root_.get(); node != nullptr; ++height) {
+      node = node->is_leaf
+                 ? nullptr
+                 : static_cast<const Inner *>(node)->children[0].get();
+    }
+    return height;
+  }
+
+ private:
+  struct Split {
+    std::unique_ptr<Node> right;
+    K separator;
+  };
+
+  // Returns the child of `inner` whose keys range covers `key`.
+  static size_t ChildIndex(const Inner *inner, const K &key) {
+    return std::upper_bound(inner->keys, inner->keys + inner->size - 1, key) -
+           inner->keys;
+  }
+
+  static uint64_t NodeCount(const Node *node) {
+    uint64_t count = 0;
+    if (node->is_leaf) {
+      auto leaf = static_cast<const Leaf *>(node);
+      for (uint16_t i = 0; i < leaf->size; ++i) {
+        count += leaf->postings[i].size();
+      }
+    } else {
+      auto inner = static_cast<const Inner *>(node);
+      for (uint16_t i = 0; i < inner->size; ++i) {
+        count += inner->counts[i];
+      }
+    }
+    return count;
+  }
+
+  const Leaf *FindLeaf(const K &key) const {
+    const Node *node = root_.get();
+    while (node != nullptr && !node->is_leaf) {
+      auto inner = static_cast<const Inner *>(node);
+      node = inner->children[ChildIndex(inner, key)].get();
+    }
+    return static_cast<const Leaf *>(node);
+  }
+
+  // Adds the value to the subtree of `node`, and sets `split` if the node had
+  // to be split.
+  static bool Add(Node *node, const K &key, const V &value,
+                  std::optional<Split> &split) {
+    if (node->is_leaf) {
+      auto leaf = static_cast<Leaf *>(node);
+      uint16_t pos = leaf->keys.LowerBound(leaf->size, key);
+      if (pos < leaf->size && !(key < leaf->keys.Get(pos))) {
+        return leaf->postings[pos].Add(value);
+      }
+      leaf->keys.Insert(leaf->size, pos, key);
+      std::move_backward(leaf->postings + pos, leaf->postings + leaf->size,
+                         leaf->postings + leaf->size + 1);
+      leaf->postings[pos] = Postings();
+      leaf->postings[pos].Add(value);
+      if (++leaf->size > kLeafCapacity) {
+        auto right = std::make_unique<Leaf>();
+        uint16_t mid = leaf->size / 2;
+        K keys[kLeafCapacity + 1];
+        leaf->keys.Decode(leaf->size, keys);
+        right->keys.Encode(leaf->size - mid, keys + mid);
+        leaf->keys.Encode(mid, keys);
+        std::move(leaf->postings + mid, leaf->postings + leaf->size,
+                  right->postings);
+        right->size = leaf->size - mid;
+        leaf->size = mid;
+        right->prev = leaf;
+        right->next = leaf->next;
+        if (right->next != nullptr) {
+          right->next->prev = right.get();
+        }
+        leaf->next = right.get();
+        split = Split{nullptr, right->keys.Get(0)};
+        split->right = std::move(right);
+      }
+      return true;
+    }
+    auto inner = static_cast<Inner *>(node);
+    size_t child = ChildIndex(inner, key);
+    std::optional<Split> child_split;
+    if (!Add(inner->children[child].get(), key, value, child_split)) {
+      return false;
+    }
+    ++inner->counts[child];
+    if (!child_split.has_value()) {
+      return true;
+    }
+    std::move_backward(inner->keys + child, inner->keys + inner->size - 1,
+                       inner->keys + inner->size);
+    std::move_backward(inner->children + child + 1,
+                       inner->children + inner->size,
+                       inner->children + inner->size + 1);
+    std::move_backward(inner->counts + child + 1, inner->counts + inner->size,
+                       inner->counts + inner->size + 1);
+    inner->keys[child] = child_split->separator;
+    inner->children[child + 1] = std::move(child_split->right);
+    inner->counts[child] = NodeCount(inner->children[child].get());
+    inner->counts[child + 1] = NodeCount(inner->children[child + 1].get());
+    if (++inner->size > kInnerCapacity) {
+      auto right = std::make_unique<Inner>();
+      uint16_t mid = inner->size / 2;
+      std::move(inner->keys + mid, inner->keys + inner->size - 1, right->keys);
+      std::move(inner->children + mid, inner->children + inner->size,
+                right->children);
+      std::copy(inner->counts + mid, inner->counts + inner->size,
+                right->counts);
+      right->size = inner->size - mid;
+      inner->size = mid;
+      split = Split{nullptr, inner->keys[mid - 1]};
+      split->right = std::move(right);
+    }
+    return true;
+  }
+
+  static bool Remove(Node *node, const K &key, const V &value) {
+    if (node->is_leaf) {
+      auto leaf = static_cast<Leaf *>(node);
+      uint16_t pos = leaf->keys.LowerBound(leaf->size, key);
+      if (pos == leaf->size || key < leaf->keys.Get(pos) ||
+          !leaf->postings[pos].Remove(value)) {
+        return false;
+      }
+      if (leaf->postings[pos].empty()) {
+        leaf->keys.Erase(leaf->size, pos);
+        std::move(leaf->postings + pos + 1, leaf->postings + leaf->size,
+                  leaf->postings + pos);
+        --leaf->size;
+      }
+      return true;
+    }
+    auto inner = static_cast<Inner *>(node);
+    size_t child = ChildIndex(inner, key);
+    if (!Remove(inner->children[child].get(), key, value)) {
+      return false;
+    }
+    --inner->counts[child];
+    const Node *child_node = inner->children[child].get();
+    if (child_node->size <
+        (child_node->is_leaf ? kLeafCapacity : kInnerCapacity) / 2) {
+      Rebalance(inner, child + 1 < inner->size ? child : child - 1);
+    }
+    return true;
+  }
+
+  // Merges the children `left` and `left + 1` of `inner`, or evens out their
+  // sizes if they do not fit in one node.
+  static void Rebalance(Inner *inner, size_t left) {
+    Node *left_node = inner->children[left].get();
+    Node *right_node = inner->children[left + 1].get();
+    if (left_node->is_leaf) {
+      auto left_leaf = static_cast<Leaf *>(left_node);
+      auto right_leaf = static_cast<Leaf *>(right_node);
+      uint16_t total = left_leaf->size + right_leaf->size;
+      uint16_t target = total <= kLeafCapacity ? total : total / 2;
+      if (left_leaf->size != target) {
+        K keys[2 * kLeafCapacity];
+        left_leaf->keys.Decode(left_leaf->size, keys);
+        right_leaf->keys.Decode(right_leaf->size, keys + left_leaf->size);
+        left_leaf->keys.Encode(target, keys);
+        right_leaf->keys.Encode(total - target, keys + target);
+      }
+      if (left_leaf->size < target) {
+        uint16_t moved = target - left_leaf->size;
+        std::move(right_leaf->postings, right_leaf->postings + moved,
+                  left_leaf->postings + left_leaf->size);
+        std::move(right_leaf->postings + moved,
+                  right_leaf->postings + right_leaf->size,
+                  right_leaf->postings);
+        left_leaf->size = target;
+        right_leaf->size -= moved;
+      } else if (left_leaf->size > target) {
+        uint16_t moved = left_leaf->size - target;
+        std::move_backward(right_leaf->postings,
+                           right_leaf->postings + right_leaf->size,
+                           right_leaf->postings + right_leaf->size + moved);
+        std::move(left_leaf->postings + target,
+                  left_leaf->postings + left_leaf->size, right_leaf->postings);
+        left_leaf->size = target;
+        right_leaf->size += moved;
+      }
+      if (right_leaf->size == 0) {
+        left_leaf->next = right_leaf->next;
+        if (left_leaf->next != nullptr) {
+          left_leaf->next->prev = left_leaf;
+        }
+        RemoveChild(inner, left + 1);
+      } else {
+        inner->keys[left] = right_leaf->keys.Get(0);
+      }
+    } else {
+      auto left_inner = static_cast<Inner *>(left_node);
+      auto right_inner = static_cast<Inner *>(right_node);
+      // Lay out both nodes' children with the separators between them, and
+      // cut the sequence anew.
+      std::vector<K> keys;
+      std::vector<std::unique_ptr<Node>> children;
+      std::vector<uint64_t> counts;
+      for (auto node : {left_inner, right_inner}) {
+        if (!children.empty()) {
+          keys.push_back(inner->keys[left]);
+        }
+        keys.insert(keys.end(), node->keys, node->keys + node->size - 1);
+        for (uint16_t i = 0; i < node->size; ++i) {
+          children.push_back(std::move(node->children[i]));
+          counts.push_back(node->counts[i]);
+        }
+      }
+      uint16_t total = children.size();
+      uint16_t target = total <= kInnerCapacity ? total : total / 2;
+      std::move(keys.begin(), keys.begin() + target - 1, left_inner->keys);
+      std::move(children.begin(), children.begin() + target,
+                left_inner->children);
+      std::copy(counts.begin(), counts.begin() + target, left_inner->counts);
+      left_inner->size = target;
+      if (target == total) {
+        RemoveChild(inner, left + 1);
+      } else {
+        inner->keys[left] = keys[target - 1];
+        std::move(keys.begin() + target, keys.end(), right_inner->keys);
+        std::move(children.begin() + target, children.end(),
+                  right_inner->children);
+        std::copy(counts.begin() + target, counts.end(), right_inner->counts);
+        right_inner->size = total - target;
+      }
+    }
+    inner->counts[left] = NodeCount(inner->children[left].get());
+    if (left + 1 < inner->size) {
+      inner->counts[left + 1] = NodeCount(inner->children[left + 1].get());
+    }
+  }
+
+  // Removes the empty child `index` of `inner` and the separator before it.
+  static void RemoveChild(Inner *inner, size_t index) {
+    std::move(inner->keys + index, inner->keys + inner->size - 1,
+              inner->keys + index - 1);
+    std::move(inner->children + index + 1, inner->children + inner->size,
+              inner->children + index);
+    std::move(inner->counts + index + 1, inner->counts + inner->size,
+              inner->counts + index);
+    --inner->size;
+    inner->children[inner->size].reset();
+  }
+
+  std::unique_ptr<Node> root_;
+  size_t size_{0};
+};
+
+}  // namespace valkey_search::utils
+
+#endif  // VALKEYSEARCH_SRC_UTILS_COUNTED_BTREE_H_
@@ -17,8 +17,8 @@
 #include <stack>
 #include <string>
 #include <utility>
+#include <vector>
 
-#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/hash/hash.h"
 #include "absl/log/check.h"
@@ -28,25 +28,179 @@
 
 namespace valkey_search {
 
+// The children of a node, indexed by the first bytes of their edge labels,
+// which differ between the children. Like the nodes of an adaptive radix tree,
+// the index grows with the number of children: up to kMaxSorted sorted bytes,
+// then a table of the slots of up to kMaxSlotted children by byte, then a
+// child per byte. It shrinks back, with some slack, on removals.
+template <typename NodeT>
+class PatriciaChildren {
+ public:
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Returns the owner of the child of `byte`, or nullptr if there is none.
+  std::unique_ptr<NodeT> *Find(uint8_t byte) {
+    switch (layout_) {
+      case Layout::kSorted:
+        for (size_t i = 0; i < keys_.size(); ++i) {
+          if (keys_[i] == byte) {
+            return &nodes_[i];
+          }
+        }
+        return nullptr;
+      case Layout::kSlotted:
+        return keys_[byte] == 0 ? nullptr : &nodes_[keys_[byte] - 1];
+      case Layout::kDirect:
+        return nodes_[byte] == nullptr ? nullptr : &nodes_[byte];
+    }
+    return nullptr;
+  }
+
+  // Adds the child of `byte`, which must not have one.
+  void Insert(uint8_t byte, std::unique_ptr<NodeT> child) {
+    if (layout_ == Layout::kSorted && size_ == kMaxSorted) {
+      Relayout(Layout::kSlotted);
+    } else if (layout_ == Layout::kSlotted && size_ == kMaxSlotted) {
+      Relayout(Layout::kDirect);
+    }
+    switch (layout_) {
+      case Layout::kSorted: {
+        auto pos = std::lower_bound(keys_.begin(), keys_.end(), byte);
+        DCHECK(pos == keys_.end() || *pos != byte);
+        nodes_.insert(nodes_.begin() + (pos - keys_.begin()), std::move(child));
+        keys_.insert(pos, byte);
+        break;
+      }
+      case Layout::kSlotted:
+        DCHECK_EQ(keys_[byte], 0);
+        nodes_.push_back(std::move(child));
+        keys_[byte] = nodes_.size();
+        break;
+      case Layout::kDirect:
+        DCHECK(nodes_[byte] == nullptr);
+        nodes_[byte] = std::move(child);
+        break;
+    }
+    ++size_;
+  }
+
+  // Removes the child of `byte`, which must have one.
+  void Erase(uint8_t byte) {
+    switch (layout_) {
+      case Layout::kSorted: {
+        auto pos = std::find(keys_.begin(), keys_.end(), byte);
+        DCHECK(pos != keys_.end());
+        nodes_.erase(nodes_.begin() + (pos - keys_.begin()));
+        keys_.erase(pos);
+        break;
+      }
+      case Layout::kSlotted: {
+        // Moves the last child to the freed slot.
+        size_t slot = keys_[byte];
+        DCHECK_NE(slot, 0);
+        if (slot != nodes_.size()) {
+          nodes_[slot - 1] = std::move(nodes_.back());
+          *std::find(keys_.begin(), keys_.end(), nodes_.size()) = slot;
+        }
+        nodes_.pop_back();
+        keys_[byte] = 0;
+        break;
+      }
+      case Layout::kDirect:
+        DCHECK(nodes_[byte] != nullptr);
+        nodes_[byte] = nullptr;
+        break;
+    }
+    --size_;
+    if (layout_ == Layout::kSlotted && size_ <= kMinSlotted) {
+      Relayout(Layout::kSorted);
+    } else if (layout_ == Layout::kDirect && size_ <= kMinDirect) {
+      Relayout(Layout::kSlotted);
+    }
+  }
+
+  // Calls `fn` with the children in the order of their bytes.
+  template <typename Fn>
+  void ForEach(Fn &&fn) const {
+    if (layout_ == Layout::kSlotted) {
+      for (auto slot : keys_) {
+        if (slot != 0) {
+          fn(nodes_[slot - 1].get());
+        }
+      }
+      return;
+    }
+    for (const auto &node : nodes_) {
+      if (node != nullptr) {
+        fn(node.get());
+      }
+    }
+  }
+
+ private:
+  enum class Layout : uint8_t { kSorted, kSlotted, kDirect };
+  static constexpr size_t kMaxSorted = 16;
+  static constexpr size_t kMaxSlotted = 48;
+  static constexpr size_t kMinSlotted = 12;
+  static constexpr size_t kMinDirect = 40;
+
+  void Relayout(Layout layout) {
+    std::vector<std::pair<uint8_t, std::unique_ptr<NodeT>>> children;
+    children.reserve(size_);
+    for (size_t byte = 0; byte < 256; ++byte) {
+      if (auto *child = Find(byte)) {
+        children.emplace_back(byte, std::move(*child));
+      }
+    }
+    layout_ = layout;
+    size_ = 0;
+    keys_.clear();
+    nodes_.clear();
+    if (layout == Layout::kSlotted) {
+      keys_.resize(256, 0);
+    } else if (layout == Layout::kDirect) {
+      nodes_.resize(256);
+    }
+    for (auto &[byte, child] : children) {
+      Insert(byte, std::move(child));
+    }
+    keys_.shrink_to_fit();
+    nodes_.shrink_to_fit();
+  }
+
+  Layout layout_{Layout::kSorted};
+  uint16_t size_{0};
+  // kSorted: the bytes of the children, sorted. kSlotted: one plus the slot in
+  // `nodes_` of the child of each byte, or 0. kDirect: empty.
+  std::vector<uint8_t> keys_;
+  // kSorted and kSlotted: the children. kDirect: the child of each byte.
+  std::vector<std::unique_ptr<NodeT>> nodes_;
+};
+
+// `SetT` holds the values of a key, with the insert, erase by value, size and
+// empty of the standard sets.
 template <typename T, typename Hasher = absl::Hash<T>,
-          typename Equaler = std::equal_to<T>>
+          typename Equaler = std::equal_to<T>,
+          typename SetT = absl::flat_hash_set<T, Hasher, Equaler>>
 class PatriciaNode {
  public:
   PatriciaNode() = default;
-  absl::flat_hash_map<std::string,
-                      std::unique_ptr<PatriciaNode<T, Hasher, Equaler>>>
-      children;
+  // The label of the edge from the parent.
+  std::string label;
+  PatriciaChildren<PatriciaNode<T, Hasher, Equaler, SetT>> children;
   int64_t subtree_values_count = 0;
-  std::optional<absl::flat_hash_set<T, Hasher, Equaler>> value;
+  std::optional<SetT> value;
   void PrintValue() {}
 };
 
 template <typename T, typename Hasher = absl::Hash<T>,
-          typename Equaler = std::equal_to<T>>
+          typename Equaler = std::equal_to<T>,
+          typename SetT = absl::flat_hash_set<T, Hasher, Equaler>>
 class PatriciaTree {
  public:
-  using SetType = absl::flat_hash_set<T, Hasher, Equaler>;
-  using PatriciaNodeType = PatriciaNode<T, Hasher, Equaler>;
+  using SetType = SetT;
+  using PatriciaNodeType = PatriciaNode<T, Hasher, Equaler, SetT>;
   PatriciaTree(bool case_sensitive)
       : root_(std::make_unique<PatriciaNodeType>()),
         case_sensitive_(case_sensitive) {}
@@ -57,47 +211,37 @@ class PatriciaTree {
       node->subtree_values_count++;
       if (remaining_key.empty()) {
         if (!node->value.has_value()) {
-          node->value.emplace(std::move(SetType{value}));
-        } else {
-          node->value.value().insert(value);
+          node->value.emplace();
         }
+        node->value.value().insert(value);
         return;
       }
-      bool found = false;
-      for (auto &[child_key, child_node] : node->children) {
-        absl::string_view common_prefix =
-            GetCommonPrefix(remaining_key, child_key, case_sensitive_);
-        if (!common_prefix.empty()) {
-          if (common_prefix.size() == child_key.size()) {
-            // Continue in this branch
-            node = child_node.get();
-            remaining_key = remaining_key.substr(common_prefix.size());
-            found = true;
-            break;
-          }
-          // Split the edge
-          auto new_node = std::make_unique<PatriciaNodeType>();
-          new_node->subtree_values_count = child_node->subtree_values_count;
-          new_node
-              ->children[std::string(child_key.substr(common_prefix.size()))] =
-              std::move(child_node);
-          auto common_prefix_str = std::string(common_prefix);
-          node->children.erase(std::string(child_key));
-          node->children[common_prefix_str] = std::move(new_node);
-          node = node->children[common_prefix_str].get();
-          remaining_key = remaining_key.substr(common_prefix.size());
-          found = true;
-          break;
-        }
-      }
-
-      if (!found) {
+      auto byte = FirstByte(remaining_key, case_sensitive_);
+      auto *child = node->children.Find(byte);
+      if (child == nullptr) {
         auto new_node = std::make_unique<PatriciaNodeType>();
+        new_node->label = std::string(remaining_key);
         auto new_node_ptr = new_node.get();
-        node->children[std::string(remaining_key)] = std::move(new_node);
+        node->children.Insert(byte, std::move(new_node));
         node = new_node_ptr;
         remaining_key = "";
+        continue;
       }
+      // Not empty, as the first bytes match.
+      absl::string_view common_prefix =
+          GetCommonPrefix(remaining_key, (*child)->label, case_sensitive_);
+      if (common_prefix.size() < (*child)->label.size()) {
+        // Split the edge
+        auto new_node = std::make_unique<PatriciaNodeType>();
+        new_node->label = std::string(common_prefix);
+        new_node->subtree_values_count = (*child)->subtree_values_count;
+        (*child)->label.erase(0, common_prefix.size());
+        auto child_byte = FirstByte((*child)->label, case_sensitive_);
+        new_node->children.Insert(child_byte, std::move(*child));
+        *child = std::move(new_node);
+      }
+      node = child->get();
+      remaining_key = remaining_key.substr(common_prefix.size());
     }
   }
 
@@ -161,9 +305,8 @@ class PatriciaTree {
       if (node->value.has_value()) {
         values_.push(node);
       }
-      for (const auto &[child_key, child_node] : node->children) {
-        DfsHelper(child_node.get());
-      }
+      node->children.ForEach(
+          [this](PatriciaNodeType *child) { DfsHelper(child); });
     }
   };
 
@@ -190,21 +333,15 @@ class PatriciaTree {
         values_.push(root);
       }
       while (!str.empty()) {
-        bool found = false;
-        for (const auto &child : root->children) {
-          if (str.compare(0, child.first.size(), child.first) == 0) {
-            found = true;
-            if (child.second->value != std::nullopt) {
-              values_.push(child.second.get());
-            }
-            str = str.substr(child.first.size());
-            root = child.second.get();
-            break;
-          }
-        }
-        if (!found) {
+        auto *child = root->children.Find(FirstByte(str, case_sensitive));
+        if (child == nullptr || !absl::StartsWith(str, (*child)->label)) {
           return;
         }
+        root = child->get();
+        if (root->value != std::nullopt) {
+          values_.push(root);
+        }
+        str = str.substr(root->label.size());
       }
     }
 
@@ -231,6 +368,12 @@ class PatriciaTree {
   std::unique_ptr<PatriciaNodeType> root_;
   bool case_sensitive_;
 
+  // Returns the byte that indexes the child whose edge label starts `key`.
+  static uint8_t FirstByte(absl::string_view key, bool case_sensitive) {
+    DCHECK(!key.empty());
+    return case_sensitive ? key[0] : absl::ascii_tolower(key[0]);
+  }
+
   static absl::string_view GetCommonPrefix(absl::string_view str1,
                                            absl::string_view str2,
                                            bool case_sensitive) {
@@ -253,34 +396,31 @@ class PatriciaTree {
       if (!node->value) {
         return false;  // Key not found
       }
-      auto itr = node->value.value().find(value);
-      if (itr != node->value.value().end()) {
-        node->value.value().erase(itr);
+      if (node->value.value().erase(value) != 0) {
         node->subtree_values_count--;
         return true;
       }
       return false;
     }
 
-    for (auto it = node->children.begin(); it != node->children.end(); ++it) {
-      absl::string_view common_prefix =
-          GetCommonPrefix(key, it->first, case_sensitive_);
-      PatriciaNodeType *child_node = it->second.get();
-      if (!common_prefix.empty() && common_prefix.size() == it->first.size()) {
-        bool found =
-            RemoveHelper(child_node, key.substr(common_prefix.size()), value);
-        if (found) {
-          node->subtree_values_count--;
-          if (child_node->children.empty() &&
-              (!child_node->value.has_value() ||
-               child_node->value.value().empty())) {
-            node->children.erase(it);
-          }
-          return found;
-        }
-      }
+    auto byte = FirstByte(key, case_sensitive_);
+    auto *child = node->children.Find(byte);
+    if (child == nullptr) {
+      return false;  // Key not found
+    }
+    PatriciaNodeType *child_node = child->get();
+    absl::string_view common_prefix =
+        GetCommonPrefix(key, child_node->label, case_sensitive_);
+    if (common_prefix.size() != child_node->label.size() ||
+        !RemoveHelper(child_node, key.substr(common_prefix.size()), value)) {
+      return false;  // Key not found
+    }
+    node->subtree_values_count--;
+    if (child_node->children.empty() &&
+        (!child_node->value.has_value() || child_node->value.value().empty())) {
+      node->children.Erase(byte);
     }
-    return false;  // Key not found
+    return true;
   }
 
   // Returns leaf node of the prefix of the key, nullptr otherwise.
@@ -289,27 +429,25 @@ class PatriciaTree {
     PatriciaNodeType *node = root_.get();
     absl::string_view remaining_key = key;
     while (!remaining_key.empty()) {
-      bool found = false;
-      for (const auto &[child_key, child_node] : node->children) {
-        auto common_prefix =
-            GetCommonPrefix(remaining_key, child_key, case_sensitive_);
-        if (!exact_match && common_prefix.size() == remaining_key.size()) {
-          // This takes care of case where key is a prefix of a node
-          // e.g. "a" matches "abc"
-          DCHECK(child_key.size() >= remaining_key.size());
-          node = child_node.get();
-          remaining_key = "";
-          found = true;
-          break;
-        } else if (common_prefix.size() == child_key.size()) {
-          // For key "abc" This takes of care of going to node "abc"
-          node = child_node.get();
-          remaining_key = remaining_key.substr(common_prefix.size());
-          found = true;
-          break;
-        }
+      auto *child =
+          node->children.Find(FirstByte(remaining_key, case_sensitive_));
+      if (child == nullptr) {
+        return nullptr;
       }
-      if (!found) {
+      const std::string &child_key = (*child)->label;
+      auto common_prefix =
+          GetCommonPrefix(remaining_key, child_key, case_sensitive_);
+      if (!exact_match && common_prefix.size() == remaining_key.size()) {
+        // This takes care of case where key is a prefix of a node
+        // e.g. "a" matches "abc"
+        DCHECK(child_key.size() >= remaining_key.size());
+        node = child->get();
+        remaining_key = "";
+      } else if (common_prefix.size() == child_key.size()) {
+        // For key "abc" This takes of care of going to node "abc"
+        node = child->get();
+        remaining_key = remaining_key.substr(common_prefix.size());
+      } else {
         return nullptr;
       }
     }
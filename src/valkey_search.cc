@@ -29,11 +29,13 @@
 #include "src/coordinator/server.h"
 #include "src/coordinator/util.h"
 #include "src/metrics.h"
+#include "src/query/planner.h"
 #include "src/rdb_serialization.h"
 #include "src/schema_manager.h"
 #include "src/utils/string_interning.h"
 #include "src/valkey_search_options.h"
 #include "src/vector_externalizer.h"
+#include "third_party/hnswlib/simsimd.h"
 #include "vmsdk/src/info.h"
 #include "vmsdk/src/latency_sampler.h"
 #include "vmsdk/src/log.h"
@@ -385,6 +387,77 @@ static vmsdk::info_field::Integer hnsw_create_exceptions_count(
       return Metrics::GetStats().hnsw_create_exceptions_cnt;
     }));
 
+// The distance kernels picked for the CPU when the module was loaded.
+static vmsdk::info_field::String distance_kernel_l2_float32(
+    "distance_kernels", "distance_kernel_l2_float32",
+    vmsdk::info_field::StringBuilder()
+        .App()
+        .ComputedCharPtr([]() -> const char * {
+          return hnswlib::GetCapabilityName(
+              hnswlib::distance_kernels.l2sq_f32.capability);
+        })
+        .CrashSafe());
+
+static vmsdk::info_field::String distance_kernel_ip_float32(
+    "distance_kernels", "distance_kernel_ip_float32",
+    vmsdk::info_field::StringBuilder()
+        .App()
+        .ComputedCharPtr([]() -> const char * {
+          return hnswlib::GetCapabilityName(
+              hnswlib::distance_kernels.dot_f32.capability);
+        })
+        .CrashSafe());
+
+static vmsdk::info_field::String distance_kernel_l2_float16(
+    "distance_kernels", "distance_kernel_l2_float16",
+    vmsdk::info_field::StringBuilder()
+        .App()
+        .ComputedCharPtr([]() -> const char * {
+          return hnswlib::GetCapabilityName(
+              hnswlib::distance_kernels.l2sq_f16.capability);
+        })
+        .CrashSafe());
+
+static vmsdk::info_field::String distance_kernel_ip_float16(
+    "distance_kernels", "distance_kernel_ip_float16",
+    vmsdk::info_field::StringBuilder()
+        .App()
+        .ComputedCharPtr([]() -> const char * {
+          return hnswlib::GetCapabilityName(
+              hnswlib::distance_kernels.dot_f16.capability);
+        })
+        .CrashSafe());
+
+static vmsdk::info_field::String distance_kernel_l2_bfloat16(
+    "distance_kernels", "distance_kernel_l2_bfloat16",
+    vmsdk::info_field::StringBuilder()
+        .App()
+        .ComputedCharPtr([]() -> const char * {
+          return hnswlib::GetCapabilityName(
+              hnswlib::distance_kernels.l2sq_bf16.capability);
+        })
+        .CrashSafe());
+
+static vmsdk::info_field::String distance_kernel_ip_bfloat16(
+    "distance_kernels", "distance_kernel_ip_bfloat16",
+    vmsdk::info_field::StringBuilder()
+        .App()
+        .ComputedCharPtr([]() -> const char * {
+          return hnswlib::GetCapabilityName(
+              hnswlib::distance_kernels.dot_bf16.capability);
+        })
+        .CrashSafe());
+
+static vmsdk::info_field::String distance_kernel_hamming_binary(
+    "distance_kernels", "distance_kernel_hamming_binary",
+    vmsdk::info_field::StringBuilder()
+        .App()
+        .ComputedCharPtr([]() -> const char * {
+          return hnswlib::GetCapabilityName(
+              hnswlib::distance_kernels.hamming_b8.capability);
+        })
+        .CrashSafe());
+
 static vmsdk::info_field::Integer string_interning_store_size(
     "string_interning", "string_interning_store_size",
     vmsdk::info_field::IntegerBuilder().App().Computed([]() -> long long {
@@ -776,6 +849,19 @@ static vmsdk::info_field::String flat_vector_index_search_latency_usec(
               .flat_vector_index_search_latency.HasSamples();
         }));
 
+static vmsdk::info_field::String ivf_vector_index_search_latency_usec(
+    "latency", "ivf_vector_index_search_latency_usec",
+    vmsdk::info_field::StringBuilder()
+        .App()
+        .ComputedString([]() -> std::string {
+          auto &sampler = Metrics::GetStats().ivf_vector_index_search_latency;
+          return sampler.GetStatsString();
+        })
+        .VisibleIf([]() -> bool {
+          return Metrics::GetStats()
+              .ivf_vector_index_search_latency.HasSamples();
+        }));
+
 static vmsdk::info_field::Integer info_fanout_retry_count(
     "fanout", "info_fanout_retry_count",
     vmsdk::info_field::IntegerBuilder().App().Computed([]() -> long long {
@@ -1045,6 +1131,20 @@ absl::Status ValkeySearch::Startup(ValkeyModuleCtx *ctx) {
       "utility-worker-", options::GetUtilityThreadCount().GetValue(),
       options::GetThreadPoolWaitTimeSamples().GetValue());
   utility_thread_pool_->StartWorkers();
+  if (options::GetEnablePlannerCalibration().GetValue()) {
+    // The planner uses the default costs until the calibration is done.
+    utility_thread_pool_->Schedule(
+        [] {
+          const auto &cost_model = query::CalibrateCostModel();
+          VMSDK_LOG(NOTICE, nullptr)
+              << "Query planner cost model, distance ns per byte: "
+              << cost_model.distance_ns_per_byte
+              << ", memory access ns: " << cost_model.memory_access_ns
+              << ", lookup ns: " << cost_model.lookup_ns
+              << ", bit test ns: " << cost_model.bit_test_ns;
+        },
+        vmsdk::ThreadPool::Priority::kLow);
+  }
 
   VMSDK_LOG(NOTICE, ctx) << "use_coordinator: "
                          << options::GetUseCoordinator().GetValue()
@@ -80,6 +80,44 @@ static auto hnsw_block_size =
         .WithValidationCallback(ValidateHNSWBlockSize)
         .Build();
 
+/// Register the "--hnsw-consolidation-threshold" flag. Percentage of deleted
+/// elements in an HNSW graph at which a background job repairs the graph and
+/// reclaims their slots. 0 disables the consolidation.
+constexpr absl::string_view kHNSWConsolidationThresholdConfig{
+    "hnsw-consolidation-threshold"};
+static auto hnsw_consolidation_threshold =
+    config::NumberBuilder(kHNSWConsolidationThresholdConfig,  // name
+                          20,                                 // default (20%)
+                          0,                                  // min (disabled)
+                          100)                                // max (100%)
+        .Build();
+
+/// Register the "--hnsw-reorder-growth-threshold" flag. Percentage by which an
+/// HNSW graph must grow, since it was last reordered, before a background job
+/// renumbers its elements so that neighbors are stored close together. The
+/// job waits for backfills to complete. 0 disables the reordering.
+constexpr absl::string_view kHNSWReorderGrowthThresholdConfig{
+    "hnsw-reorder-growth-threshold"};
+static auto hnsw_reorder_growth_threshold =
+    config::NumberBuilder(kHNSWReorderGrowthThresholdConfig,  // name
+                          100,                                // default (100%)
+                          0,                                  // min (disabled)
+                          10000)                              // max (10000%)
+        .Build();
+
+/// Register the "--exact-search-range-size" flag. Number of vectors an exact
+/// search, a FLAT scan or the scoring of pre-filtered keys, hands to each
+/// sub-task it runs on the reader threads. Smaller searches run on a single
+/// thread. 0 disables the split.
+constexpr absl::string_view kExactSearchRangeSizeConfig{
+    "exact-search-range-size"};
+static auto exact_search_range_size =
+    config::NumberBuilder(kExactSearchRangeSizeConfig,  // name
+                          64 * 1024,                    // default size
+                          0,                            // min (disabled)
+                          UINT_MAX)                     // max size
+        .Build();
+
 static const int64_t kDefaultThreadsCount = vmsdk::GetPhysicalCPUCoresCount();
 constexpr uint32_t kMaxThreadsCount{1024};
 
@@ -372,12 +410,31 @@ constexpr absl::string_view kDrainMutationQueueOnSaveConfig{
 static auto drain_mutation_queue_on_save =
     config::BooleanBuilder(kDrainMutationQueueOnSaveConfig, false).Build();
 
+/// Register the "enable-planner-calibration" flag
+/// Measure the unit costs of the query planner on a utility thread at startup
+constexpr absl::string_view kEnablePlannerCalibrationConfig{
+    "enable-planner-calibration"};
+static auto enable_planner_calibration =
+    config::BooleanBuilder(kEnablePlannerCalibrationConfig, true).Build();
+
 uint32_t GetQueryStringBytes() { return query_string_bytes->GetValue(); }
 
 vmsdk::config::Number& GetHNSWBlockSize() {
   return dynamic_cast<vmsdk::config::Number&>(*hnsw_block_size);
 }
 
+vmsdk::config::Number& GetHNSWConsolidationThreshold() {
+  return dynamic_cast<vmsdk::config::Number&>(*hnsw_consolidation_threshold);
+}
+
+vmsdk::config::Number& GetHNSWReorderGrowthThreshold() {
+  return dynamic_cast<vmsdk::config::Number&>(*hnsw_reorder_growth_threshold);
+}
+
+vmsdk::config::Number& GetExactSearchRangeSize() {
+  return dynamic_cast<vmsdk::config::Number&>(*exact_search_range_size);
+}
+
 vmsdk::config::Number& GetReaderThreadCount() {
   return dynamic_cast<vmsdk::config::Number&>(*reader_threads_count);
 }
@@ -468,5 +525,10 @@ const vmsdk::config::Boolean& GetDrainMutationQueueOnLoad() {
       *drain_mutation_queue_on_load);
 }
 
+const vmsdk::config::Boolean& GetEnablePlannerCalibration() {
+  return dynamic_cast<const vmsdk::config::Boolean&>(
+      *enable_planner_calibration);
+}
+
 }  // namespace options
 }  // namespace valkey_search
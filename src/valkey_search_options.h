@@ -22,6 +22,18 @@ uint32_t GetQueryStringBytes();
 /// Return a mutable reference to the HNSW resize configuration parameter
 config::Number& GetHNSWBlockSize();
 
+/// Return the percentage of deleted HNSW elements that triggers a background
+/// consolidation, 0 when disabled
+config::Number& GetHNSWConsolidationThreshold();
+
+/// Return the percentage by which an HNSW graph must grow before it is
+/// reordered for locality again, 0 when disabled
+config::Number& GetHNSWReorderGrowthThreshold();
+
+/// Return the number of vectors per reader thread sub-task of an exact search,
+/// 0 when exact searches run on a single thread
+config::Number& GetExactSearchRangeSize();
+
 /// Return the configuration entry that allows the caller to control the
 /// number of reader threads
 config::Number& GetReaderThreadCount();
@@ -97,5 +109,9 @@ const config::Boolean& GetDrainMutationQueueOnSave();
 /// Return the configuration entry for draining mutation queue on load
 const config::Boolean& GetDrainMutationQueueOnLoad();
 
+/// Return the configuration entry for calibrating the query planner costs at
+/// startup
+const config::Boolean& GetEnablePlannerCalibration();
+
 }  // namespace options
 }  // namespace valkey_search
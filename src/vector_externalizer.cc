@@ -27,15 +27,28 @@ namespace valkey_search {
 VectorExternalizer::VectorExternalizer()
     : lru_cache_(std::make_unique<LRU<LRUCacheEntry>>(kLRUCapacity)) {}
 
-std::vector<char> DenormalizeVector(absl::string_view record, size_t type_size,
+std::vector<char> DenormalizeVector(absl::string_view record,
+                                    data_model::VectorDataType data_type,
                                     float magnitude) {
   std::vector<char> ret(record.size());
-  if (type_size == sizeof(float)) {
-    CopyAndDenormalizeEmbedding((float*)ret.data(), (float*)record.data(),
-                                ret.size() / sizeof(float), magnitude);
-    return ret;
+  switch (data_type) {
+    case data_model::VECTOR_DATA_TYPE_FLOAT32:
+      CopyAndDenormalizeEmbedding((float*)ret.data(), (float*)record.data(),
+                                  ret.size() / sizeof(float), magnitude);
+      return ret;
+    case data_model::VECTOR_DATA_TYPE_FLOAT16:
+      CopyAndDenormalizeEmbedding(
+          (hnswlib::float16*)ret.data(), (hnswlib::float16*)record.data(),
+          ret.size() / sizeof(hnswlib::float16), magnitude);
+      return ret;
+    case data_model::VECTOR_DATA_TYPE_BFLOAT16:
+      CopyAndDenormalizeEmbedding(
+          (hnswlib::bfloat16*)ret.data(), (hnswlib::bfloat16*)record.data(),
+          ret.size() / sizeof(hnswlib::bfloat16), magnitude);
+      return ret;
+    default:
+      CHECK(false) << "unsupported vector data type";
   }
-  CHECK(false) << "unsupported type size";
 }
 
 char* ExternalizeCB(void* cb_data, size_t* len) {
@@ -55,7 +68,8 @@ char* ExternalizeCB(void* cb_data, size_t* len) {
   if (vector_externalizer_entry->magnitude.has_value()) {
     auto vector =
         DenormalizeVector(vector_externalizer_entry->vector->Str(),
-                          sizeof(float), *vector_externalizer_entry->magnitude);
+                          vector_externalizer_entry->data_type,
+                          *vector_externalizer_entry->magnitude);
     vector_externalizer_entry->cache_normalized_ =
         std::make_unique<VectorExternalizer::LRUCacheEntry>(
             std::move(vector), vector_externalizer_entry);
@@ -105,7 +119,8 @@ VectorExternalizer::LRUCacheEntry::~LRUCacheEntry() {
 bool VectorExternalizer::Externalize(
     const InternedStringPtr& key, absl::string_view attribute_identifier,
     data_model::AttributeDataType attribute_data_type,
-    const InternedStringPtr& vector, std::optional<float> magnitude) {
+    const InternedStringPtr& vector, std::optional<float> magnitude,
+    data_model::VectorDataType data_type) {
   if (!hash_registration_supported_ ||
       attribute_data_type !=
           data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH) {
@@ -115,14 +130,14 @@ bool VectorExternalizer::Externalize(
   // This ensures that consecutive reads of the record do not lose precision due
   // to vector denormalization.
   auto& deferred_shared_vectors = deferred_shared_vectors_.Get();
-  VectorExternalizerEntry entry = {vector, magnitude};
+  VectorExternalizerEntry entry = {vector, magnitude, data_type};
   auto result = deferred_shared_vectors[key].emplace(attribute_identifier,
                                                      std::move(entry));
   if (!result.second) {
     // To maintain precision and reduce denormalization overhead, prefer
     // externalizing the unnormalized vector, if available.
     if (result.first->second.magnitude != std::nullopt) {
-      VectorExternalizerEntry tmp = {vector, magnitude};
+      VectorExternalizerEntry tmp = {vector, magnitude, data_type};
       result.first->second = std::move(tmp);
     }
   }
@@ -142,12 +157,14 @@ void VectorExternalizer::ProcessEngineUpdateQueue() {
       auto it = shared_vectors[key].find(attribute_identifier);
       if (it != shared_vectors[key].end()) {
         it->second.magnitude = vector_externalizer_entry.magnitude;
+        it->second.data_type = vector_externalizer_entry.data_type;
         it->second.vector = std::move(vector_externalizer_entry.vector);
         it->second.cache_normalized_ = nullptr;
         continue;
       }
       auto& entry = shared_vectors[key][attribute_identifier];
       entry.magnitude = vector_externalizer_entry.magnitude;
+      entry.data_type = vector_externalizer_entry.data_type;
       entry.vector = std::move(vector_externalizer_entry.vector);
       if (!key_obj) {
         auto key_str = vmsdk::MakeUniqueValkeyString(key->Str());
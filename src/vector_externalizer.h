@@ -22,6 +22,7 @@
 #include "src/index_schema.pb.h"
 #include "src/utils/lru.h"
 #include "src/utils/string_interning.h"
+#include "third_party/hnswlib/space_half.h"
 #include "vmsdk/src/managed_pointers.h"
 #include "vmsdk/src/utils.h"
 #include "vmsdk/src/valkey_module_api/valkey_module.h"
@@ -30,7 +31,8 @@ namespace valkey_search {
 
 constexpr size_t kLRUCapacity = 100;
 char* ExternalizeCB(void* cb_data, size_t* len);
-std::vector<char> DenormalizeVector(absl::string_view record, size_t type_size,
+std::vector<char> DenormalizeVector(absl::string_view record,
+                                    data_model::VectorDataType data_type,
                                     float magnitude);
 
 class VectorExternalizer {
@@ -44,7 +46,8 @@ class VectorExternalizer {
                    absl::string_view attribute_identifier,
                    data_model::AttributeDataType attribute_data_type,
                    const InternedStringPtr& vector,
-                   std::optional<float> magnitude);
+                   std::optional<float> magnitude,
+                   data_model::VectorDataType data_type);
   void Remove(const InternedStringPtr& key,
               absl::string_view attribute_identifier,
               data_model::AttributeDataType attribute_data_type);
@@ -75,6 +78,8 @@ class VectorExternalizer {
   struct VectorExternalizerEntry {
     InternedStringPtr vector;
     std::optional<float> magnitude;
+    data_model::VectorDataType data_type{
+        data_model::VectorDataType::VECTOR_DATA_TYPE_FLOAT32};
     // We cache the normalized vector to ensure that the generated normalized
     // vector string remains alive until the engine deep copy it.
     std::unique_ptr<LRUCacheEntry> cache_normalized_;
@@ -116,7 +121,7 @@ class VectorExternalizer {
 template <typename T>
 void CopyAndDenormalizeEmbedding(T* dst, T* src, size_t size, float magnitude) {
   for (size_t i = 0; i < size; i++) {
-    dst[i] = src[i] * magnitude;
+    dst[i] = hnswlib::FromFloat<T>(hnswlib::ToFloat(src[i]) * magnitude);
   }
 }
 
@@ -153,6 +153,22 @@ data_model::VectorIndex CreateFlatVectorIndexProto(
   return vector_index_proto;
 }
 
+data_model::VectorIndex CreateIVFVectorIndexProto(
+    int dimensions, data_model::DistanceMetric distance_metric, uint32_t nlist,
+    uint32_t nprobe, uint32_t pq_m, uint32_t pq_rerank, uint32_t pq_nbits) {
+  data_model::VectorIndex vector_index_proto;
+  vector_index_proto.set_dimension_count(dimensions);
+  vector_index_proto.set_distance_metric(distance_metric);
+  auto ivf_algorithm = std::make_unique<data_model::IVFAlgorithm>();
+  ivf_algorithm->set_nlist(nlist);
+  ivf_algorithm->set_nprobe(nprobe);
+  ivf_algorithm->set_pq_m(pq_m);
+  ivf_algorithm->set_pq_rerank(pq_rerank);
+  ivf_algorithm->set_pq_nbits(pq_nbits);
+  vector_index_proto.set_allocated_ivf_algorithm(ivf_algorithm.release());
+  return vector_index_proto;
+}
+
 data_model::NumericIndex CreateNumericIndexProto() { return {}; }
 
 data_model::TagIndex CreateTagIndexProto(const std::string &separator,
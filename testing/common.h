@@ -212,6 +212,11 @@ data_model::VectorIndex CreateFlatVectorIndexProto(
     int dimensions, data_model::DistanceMetric distance_metric, int initial_cap,
     uint32_t block_size);
 
+data_model::VectorIndex CreateIVFVectorIndexProto(
+    int dimensions, data_model::DistanceMetric distance_metric, uint32_t nlist,
+    uint32_t nprobe, uint32_t pq_m = 0, uint32_t pq_rerank = 0,
+    uint32_t pq_nbits = 0);
+
 data_model::NumericIndex CreateNumericIndexProto();
 
 data_model::TagIndex CreateTagIndexProto(const std::string& separator = ",",
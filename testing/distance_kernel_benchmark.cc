@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+// Compares the distance kernels of every instruction set the CPU supports,
+// for each metric and element type of the vector indexes, and marks the
+// kernels picked by the runtime dispatch with '*'. Usage:
+//
+//   distance_kernel_benchmark [distances per measurement]
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "third_party/hnswlib/simsimd.h"
+
+namespace {
+
+struct KernelSpec {
+  const char *name;
+  simsimd_metric_kind_t kind;
+  simsimd_datatype_t datatype;
+  const hnswlib::DistanceKernel &picked;
+};
+
+const KernelSpec kKernels[] = {
+    {"l2_float32", simsimd_metric_l2sq_k, simsimd_datatype_f32_k,
+     hnswlib::distance_kernels.l2sq_f32},
+    {"ip_float32", simsimd_metric_dot_k, simsimd_datatype_f32_k,
+     hnswlib::distance_kernels.dot_f32},
+    {"l2_float16", simsimd_metric_l2sq_k, simsimd_datatype_f16_k,
+     hnswlib::distance_kernels.l2sq_f16},
+    {"ip_float16", simsimd_metric_dot_k, simsimd_datatype_f16_k,
+     hnswlib::distance_kernels.dot_f16},
+    {"l2_bfloat16", simsimd_metric_l2sq_k, simsimd_datatype_bf16_k,
+     hnswlib::distance_kernels.l2sq_bf16},
+    {"ip_bfloat16", simsimd_metric_dot_k, simsimd_datatype_bf16_k,
+     hnswlib::distance_kernels.dot_bf16},
+    {"hamming_binary", simsimd_metric_hamming_k, simsimd_datatype_b8_k,
+     hnswlib::distance_kernels.hamming_b8},
+};
+
+constexpr simsimd_capability_t kCapabilities[] = {
+    simsimd_cap_serial_k,   simsimd_cap_haswell_k,   simsimd_cap_skylake_k,
+    simsimd_cap_ice_k,      simsimd_cap_genoa_k,     simsimd_cap_sapphire_k,
+    simsimd_cap_neon_k,     simsimd_cap_neon_f16_k,  simsimd_cap_neon_bf16_k,
+    simsimd_cap_neon_i8_k,  simsimd_cap_sve_k,       simsimd_cap_sve_f16_k,
+    simsimd_cap_sve_bf16_k, simsimd_cap_sve_i8_k,
+};
+
+// Common embedding sizes. Binary vectors have as many bits.
+constexpr size_t kDimensions[] = {128, 768, 1536};
+// Enough vectors to leave the L1 cache, as an index search does.
+constexpr size_t kVectors = 1024;
+constexpr size_t kDefaultDistances = 1024 * 1024;
+
+// Returns the number of scalar words the kernels take for `dimensions`.
+size_t KernelWords(simsimd_datatype_t datatype, size_t dimensions) {
+  return datatype == simsimd_datatype_b8_k ? dimensions / 8 : dimensions;
+}
+
+size_t WordSize(simsimd_datatype_t datatype) {
+  switch (datatype) {
+    case simsimd_datatype_f32_k:
+      return sizeof(simsimd_f32_t);
+    case simsimd_datatype_f16_k:
+    case simsimd_datatype_bf16_k:
+      return sizeof(uint16_t);
+    default:
+      return sizeof(uint8_t);
+  }
+}
+
+std::vector<uint8_t> RandomVectors(simsimd_datatype_t datatype, size_t words,
+                                   std::mt19937 &gen) {
+  std::uniform_real_distribution<float> dist(-1, 1);
+  size_t count = kVectors * words;
+  std::vector<uint8_t> vectors(count * WordSize(datatype));
+  for (size_t i = 0; i < count; ++i) {
+    float value = dist(gen);
+    switch (datatype) {
+      case simsimd_datatype_f32_k:
+        reinterpret_cast<simsimd_f32_t *>(vectors.data())[i] = value;
+        break;
+      case simsimd_datatype_f16_k:
+        reinterpret_cast<uint16_t *>(vectors.data())[i] =
+            simsimd_compress_f16(value);
+        break;
+      case simsimd_datatype_bf16_k:
+        reinterpret_cast<uint16_t *>(vectors.data())[i] =
+            simsimd_compress_bf16(value);
+        break;
+      default:
+        vectors[i] = static_cast<uint8_t>(gen());
+        break;
+    }
+  }
+  return vectors;
+}
+
+double MeasureNsPerDistance(simsimd_metric_punned_t metric,
+                            const std::vector<uint8_t> &vectors, size_t words,
+                            size_t vector_size, size_t distances) {
+  simsimd_distance_t distance;
+  volatile simsimd_distance_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < distances; ++i) {
+    const uint8_t *lhs = &vectors[(i % kVectors) * vector_size];
+    const uint8_t *rhs = &vectors[((i * 7 + 1) % kVectors) * vector_size];
+    metric(lhs, rhs, words, &distance);
+    sink = sink + distance;
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / distances;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t distances = kDefaultDistances;
+  if (argc > 1) {
+    distances = std::strtoull(argv[1], nullptr, 10);
+    if (distances == 0) {
+      std::fprintf(stderr, "Usage: %s [distances per measurement]\n", argv[0]);
+      return 1;
+    }
+  }
+  std::mt19937 gen(42);
+  std::printf("%-16s %6s %-12s %12s %8s\n", "kernel", "dim", "isa",
+              "ns/distance", "speedup");
+  for (const auto &spec : kKernels) {
+    for (size_t dimensions : kDimensions) {
+      size_t words = KernelWords(spec.datatype, dimensions);
+      size_t vector_size = words * WordSize(spec.datatype);
+      auto vectors = RandomVectors(spec.datatype, words, gen);
+      double serial_ns = 0;
+      for (auto capability : kCapabilities) {
+        auto kernel =
+            hnswlib::FindDistanceKernel(spec.kind, spec.datatype, capability);
+        // Skip the instruction sets without a kernel of their own.
+        if (kernel.metric == nullptr || kernel.capability != capability) {
+          continue;
+        }
+        double ns = MeasureNsPerDistance(kernel.metric, vectors, words,
+                                         vector_size, distances);
+        if (capability == simsimd_cap_serial_k) {
+          serial_ns = ns;
+        }
+        std::printf("%-16s %6zu %-12s %12.2f %7.2fx%s\n", spec.name,
+                    dimensions, hnswlib::GetCapabilityName(capability), ns,
+                    serial_ns / ns,
+                    capability == spec.picked.capability ? " *" : "");
+      }
+    }
+  }
+  return 0;
+}
@@ -68,6 +68,7 @@ struct FTCreateParserTestCase {
   bool too_many_attributes{false};
   std::vector<HNSWParameters> hnsw_parameters;
   std::vector<FlatParameters> flat_parameters;
+  std::vector<IVFParameters> ivf_parameters;
   std::vector<FTCreateTagParameters> tag_parameters;
   std::vector<PerFieldTextParams> text_parameters;
   FTCreateParameters expected;
@@ -151,6 +152,7 @@ TEST_P(FTCreateParserTest, ParseParams) {
 
     auto hnsw_index = 0;
     auto flat_index = 0;
+    auto ivf_index = 0;
     auto tag_index = 0;
     auto text_index = 0;
     for (auto i = 0; i < index_schema_proto->attributes().size(); ++i) {
@@ -174,6 +176,28 @@ TEST_P(FTCreateParserTest, ParseParams) {
                       .block_size(),
                   test_case.flat_parameters[flat_index].block_size);
         ++flat_index;
+      } else if (test_case.expected.attributes[i].indexer_type ==
+                 indexes::IndexerType::kIVF) {
+        EXPECT_TRUE(index_schema_proto->attributes(i)
+                        .index()
+                        .vector_index()
+                        .has_ivf_algorithm());
+        VerifyVectorParams(
+            index_schema_proto->attributes(i).index().vector_index(),
+            &test_case.ivf_parameters[ivf_index]);
+        auto ivf_proto = index_schema_proto->attributes(i)
+                             .index()
+                             .vector_index()
+                             .ivf_algorithm();
+        EXPECT_EQ(ivf_proto.nlist(), test_case.ivf_parameters[ivf_index].nlist);
+        EXPECT_EQ(ivf_proto.nprobe(),
+                  test_case.ivf_parameters[ivf_index].nprobe);
+        EXPECT_EQ(ivf_proto.pq_m(), test_case.ivf_parameters[ivf_index].pq_m);
+        EXPECT_EQ(ivf_proto.pq_rerank(),
+                  test_case.ivf_parameters[ivf_index].pq_rerank);
+        EXPECT_EQ(ivf_proto.pq_nbits(),
+                  test_case.ivf_parameters[ivf_index].pq_nbits);
+        ++ivf_index;
       } else if (test_case.expected.attributes[i].indexer_type ==
                  indexes::IndexerType::kHNSW) {
         EXPECT_TRUE(index_schema_proto->attributes(i)
@@ -192,6 +216,12 @@ TEST_P(FTCreateParserTest, ParseParams) {
         EXPECT_EQ(hnsw_proto.ef_runtime(),
                   test_case.hnsw_parameters[hnsw_index].ef_runtime);
         EXPECT_EQ(hnsw_proto.m(), test_case.hnsw_parameters[hnsw_index].m);
+        EXPECT_EQ(hnsw_proto.quantization(),
+                  test_case.hnsw_parameters[hnsw_index].quantization);
+        EXPECT_EQ(hnsw_proto.shards(),
+                  test_case.hnsw_parameters[hnsw_index].shards);
+        EXPECT_EQ(hnsw_proto.graph_dimensions(),
+                  test_case.hnsw_parameters[hnsw_index].graph_dimensions);
         ++hnsw_index;
       } else if (test_case.expected.attributes[i].indexer_type ==
                  indexes::IndexerType::kNumeric) {
@@ -301,6 +331,273 @@ INSTANTIATE_TEST_SUITE_P(
                               .indexer_type = indexes::IndexerType::kFlat,
                           }}},
          },
+         {
+             .test_name = "happy_path_hnsw_float16",
+             .success = true,
+             .command_str = " idx1 on HASH PREFIx 1 abc SChema hash_field1 as "
+                            "hash_field11 vector hnsw 8 TYPE FLOAT16 DIM 3 "
+                            "DISTANCE_METRIC L2 M 4 ",
+             .hnsw_parameters = {{
+                 {
+                     .dimensions = 3,
+                     .distance_metric = data_model::DISTANCE_METRIC_L2,
+                     .vector_data_type = data_model::VECTOR_DATA_TYPE_FLOAT16,
+                     .initial_cap = kDefaultInitialCap,
+                 },
+                 /* .m =*/4,
+                 /* .ef_construction =*/kDefaultEFConstruction,
+                 /* .ef_runtime =*/kDefaultEFRuntime,
+             }},
+             .expected = {.index_schema_name = "idx1",
+                          .on_data_type = data_model::ATTRIBUTE_DATA_TYPE_HASH,
+                          .prefixes = {"abc"},
+                          .attributes = {{
+                              .identifier = "hash_field1",
+                              .attribute_alias = "hash_field11",
+                              .indexer_type = indexes::IndexerType::kHNSW,
+                          }}},
+         },
+         {
+             .test_name = "happy_path_hnsw_quantize_int8",
+             .success = true,
+             .command_str = " idx1 on HASH PREFIx 1 abc SChema hash_field1 as "
+                            "hash_field11 vector hnsw 8 TYPE FLOAT32 DIM 3 "
+                            "DISTANCE_METRIC L2 QUANTIZE INT8 ",
+             .hnsw_parameters = {{
+                 {
+                     .dimensions = 3,
+                     .distance_metric = data_model::DISTANCE_METRIC_L2,
+                     .vector_data_type = data_model::VECTOR_DATA_TYPE_FLOAT32,
+                     .initial_cap = kDefaultInitialCap,
+                 },
+                 /* .m =*/kDefaultM,
+                 /* .ef_construction =*/kDefaultEFConstruction,
+                 /* .ef_runtime =*/kDefaultEFRuntime,
+                 /* .quantization =*/data_model::VECTOR_QUANTIZATION_INT8,
+             }},
+             .expected = {.index_schema_name = "idx1",
+                          .on_data_type = data_model::ATTRIBUTE_DATA_TYPE_HASH,
+                          .prefixes = {"abc"},
+                          .attributes = {{
+                              .identifier = "hash_field1",
+                              .attribute_alias = "hash_field11",
+                              .indexer_type = indexes::IndexerType::kHNSW,
+                          }}},
+         },
+         {
+             .test_name = "happy_path_hnsw_quantize_int8_codes_only",
+             .success = true,
+             .command_str = " idx1 on HASH PREFIx 1 abc SChema hash_field1 as "
+                            "hash_field11 vector hnsw 8 TYPE FLOAT32 DIM 3 "
+                            "DISTANCE_METRIC L2 QUANTIZE INT8_CODES_ONLY ",
+             .hnsw_parameters = {{
+                 {
+                     .dimensions = 3,
+                     .distance_metric = data_model::DISTANCE_METRIC_L2,
+                     .vector_data_type = data_model::VECTOR_DATA_TYPE_FLOAT32,
+                     .initial_cap = kDefaultInitialCap,
+                 },
+                 /* .m =*/kDefaultM,
+                 /* .ef_construction =*/kDefaultEFConstruction,
+                 /* .ef_runtime =*/kDefaultEFRuntime,
+                 /* .quantization =*/
+                 data_model::VECTOR_QUANTIZATION_INT8_CODES_ONLY,
+             }},
+             .expected = {.index_schema_name = "idx1",
+                          .on_data_type = data_model::ATTRIBUTE_DATA_TYPE_HASH,
+                          .prefixes = {"abc"},
+                          .attributes = {{
+                              .identifier = "hash_field1",
+                              .attribute_alias = "hash_field11",
+                              .indexer_type = indexes::IndexerType::kHNSW,
+                          }}},
+         },
+         {
+             .test_name = "happy_path_hnsw_shards",
+             .success = true,
+             .command_str = " idx1 on HASH PREFIx 1 abc SChema hash_field1 as "
+                            "hash_field11 vector hnsw 8 TYPE FLOAT32 DIM 3 "
+                            "DISTANCE_METRIC L2 SHARDS 4 ",
+             .hnsw_parameters = {{
+                 {
+                     .dimensions = 3,
+                     .distance_metric = data_model::DISTANCE_METRIC_L2,
+                     .vector_data_type = data_model::VECTOR_DATA_TYPE_FLOAT32,
+                     .initial_cap = kDefaultInitialCap,
+                 },
+                 /* .m =*/kDefaultM,
+                 /* .ef_construction =*/kDefaultEFConstruction,
+                 /* .ef_runtime =*/kDefaultEFRuntime,
+                 /* .quantization =*/data_model::VECTOR_QUANTIZATION_NONE,
+                 /* .shards =*/4,
+             }},
+             .expected = {.index_schema_name = "idx1",
+                          .on_data_type = data_model::ATTRIBUTE_DATA_TYPE_HASH,
+                          .prefixes = {"abc"},
+                          .attributes = {{
+                              .identifier = "hash_field1",
+                              .attribute_alias = "hash_field11",
+                              .indexer_type = indexes::IndexerType::kHNSW,
+                          }}},
+         },
+         {
+             .test_name = "happy_path_hnsw_graph_dim",
+             .success = true,
+             .command_str = " idx1 on HASH PREFIx 1 abc SChema hash_field1 as "
+                            "hash_field11 vector hnsw 8 TYPE FLOAT32 DIM 16 "
+                            "DISTANCE_METRIC COSINE GRAPH_DIM 4 ",
+             .hnsw_parameters = {{
+                 {
+                     .dimensions = 16,
+                     .distance_metric = data_model::DISTANCE_METRIC_COSINE,
+                     .vector_data_type = data_model::VECTOR_DATA_TYPE_FLOAT32,
+                     .initial_cap = kDefaultInitialCap,
+                 },
+                 /* .m =*/kDefaultM,
+                 /* .ef_construction =*/kDefaultEFConstruction,
+                 /* .ef_runtime =*/kDefaultEFRuntime,
+                 /* .quantization =*/data_model::VECTOR_QUANTIZATION_NONE,
+                 /* .shards =*/kDefaultShards,
+                 /* .graph_dimensions =*/4,
+             }},
+             .expected = {.index_schema_name = "idx1",
+                          .on_data_type = data_model::ATTRIBUTE_DATA_TYPE_HASH,
+                          .prefixes = {"abc"},
+                          .attributes = {{
+                              .identifier = "hash_field1",
+                              .attribute_alias = "hash_field11",
+                              .indexer_type = indexes::IndexerType::kHNSW,
+                          }}},
+         },
+         {
+             .test_name = "happy_path_hnsw_binary",
+             .success = true,
+             .command_str = " idx1 on HASH PREFIx 1 abc SChema hash_field1 as "
+                            "hash_field11 vector hnsw 6 TYPE BINARY DIM 256 "
+                            "DISTANCE_METRIC HAMMING ",
+             .hnsw_parameters = {{
+                 {
+                     .dimensions = 256,
+                     .distance_metric = data_model::DISTANCE_METRIC_HAMMING,
+                     .vector_data_type = data_model::VECTOR_DATA_TYPE_BINARY,
+                     .initial_cap = kDefaultInitialCap,
+                 },
+                 /* .m =*/kDefaultM,
+                 /* .ef_construction =*/kDefaultEFConstruction,
+                 /* .ef_runtime =*/kDefaultEFRuntime,
+             }},
+             .expected = {.index_schema_name = "idx1",
+                          .on_data_type = data_model::ATTRIBUTE_DATA_TYPE_HASH,
+                          .prefixes = {"abc"},
+                          .attributes = {{
+                              .identifier = "hash_field1",
+                              .attribute_alias = "hash_field11",
+                              .indexer_type = indexes::IndexerType::kHNSW,
+                          }}},
+         },
+         {
+             .test_name = "happy_path_flat_bfloat16",
+             .success = true,
+             .command_str = " idx1 on HASH PREFIx 1 abc SChema hash_field1 as "
+                            "hash_field11 vector flat 6 TYPE BFLOAT16 DIM 3 "
+                            "DISTANCE_METRIC COSINE ",
+             .flat_parameters = {{
+                 {
+                     .dimensions = 3,
+                     .distance_metric = data_model::DISTANCE_METRIC_COSINE,
+                     .vector_data_type = data_model::VECTOR_DATA_TYPE_BFLOAT16,
+                     .initial_cap = kDefaultInitialCap,
+                 },
+                 /*.block_size =*/kDefaultBlockSize,
+             }},
+             .expected = {.index_schema_name = "idx1",
+                          .on_data_type = data_model::ATTRIBUTE_DATA_TYPE_HASH,
+                          .prefixes = {"abc"},
+                          .attributes = {{
+                              .identifier = "hash_field1",
+                              .attribute_alias = "hash_field11",
+                              .indexer_type = indexes::IndexerType::kFlat,
+                          }}},
+         },
+         {
+             .test_name = "happy_path_ivf",
+             .success = true,
+             .command_str = " idx1 on HASH PREFIx 1 abc SChema hash_field1 as "
+                            "hash_field11 vector ivf 10 TYPE FLOAT32 DIM 3 "
+                            "DISTANCE_METRIC L2 NLIST 64 NPROBE 4 ",
+             .ivf_parameters = {{
+                 {
+                     .dimensions = 3,
+                     .distance_metric = data_model::DISTANCE_METRIC_L2,
+                     .vector_data_type = data_model::VECTOR_DATA_TYPE_FLOAT32,
+                     .initial_cap = kDefaultInitialCap,
+                 },
+                 /*.nlist =*/64,
+                 /*.nprobe =*/4,
+             }},
+             .expected = {.index_schema_name = "idx1",
+                          .on_data_type = data_model::ATTRIBUTE_DATA_TYPE_HASH,
+                          .prefixes = {"abc"},
+                          .attributes = {{
+                              .identifier = "hash_field1",
+                              .attribute_alias = "hash_field11",
+                              .indexer_type = indexes::IndexerType::kIVF,
+                          }}},
+         },
+         {
+             .test_name = "happy_path_ivf_pq",
+             .success = true,
+             .command_str = " idx1 on HASH PREFIx 1 abc SChema hash_field1 as "
+                            "hash_field11 vector ivf 12 TYPE FLOAT32 DIM 8 "
+                            "DISTANCE_METRIC L2 PQ_M 4 PQ_RERANK 16 "
+                            "PQ_NBITS 4 ",
+             .ivf_parameters = {{
+                 {
+                     .dimensions = 8,
+                     .distance_metric = data_model::DISTANCE_METRIC_L2,
+                     .vector_data_type = data_model::VECTOR_DATA_TYPE_FLOAT32,
+                     .initial_cap = kDefaultInitialCap,
+                 },
+                 /*.nlist =*/kDefaultNlist,
+                 /*.nprobe =*/kDefaultNprobe,
+                 /*.pq_m =*/4,
+                 /*.pq_rerank =*/16,
+                 /*.pq_nbits =*/4,
+             }},
+             .expected = {.index_schema_name = "idx1",
+                          .on_data_type = data_model::ATTRIBUTE_DATA_TYPE_HASH,
+                          .prefixes = {"abc"},
+                          .attributes = {{
+                              .identifier = "hash_field1",
+                              .attribute_alias = "hash_field11",
+                              .indexer_type = indexes::IndexerType::kIVF,
+                          }}},
+         },
+         {
+             .test_name = "happy_path_ivf_defaults",
+             .success = true,
+             .command_str = " idx1 on HASH PREFIx 1 abc SChema hash_field1 as "
+                            "hash_field11 vector ivf 6 TYPE FLOAT16 DIM 3 "
+                            "DISTANCE_METRIC COSINE ",
+             .ivf_parameters = {{
+                 {
+                     .dimensions = 3,
+                     .distance_metric = data_model::DISTANCE_METRIC_COSINE,
+                     .vector_data_type = data_model::VECTOR_DATA_TYPE_FLOAT16,
+                     .initial_cap = kDefaultInitialCap,
+                 },
+                 /*.nlist =*/kDefaultNlist,
+                 /*.nprobe =*/kDefaultNprobe,
+             }},
+             .expected = {.index_schema_name = "idx1",
+                          .on_data_type = data_model::ATTRIBUTE_DATA_TYPE_HASH,
+                          .prefixes = {"abc"},
+                          .attributes = {{
+                              .identifier = "hash_field1",
+                              .attribute_alias = "hash_field11",
+                              .indexer_type = indexes::IndexerType::kIVF,
+                          }}},
+         },
          {
              .test_name = "happy_path_hnsw_and_numeric",
              .success = true,
@@ -697,6 +994,37 @@ INSTANTIATE_TEST_SUITE_P(
                  "acceptable "
                  "bounds",
          },
+         {
+             .test_name = "invalid_shards_zero",
+             .success = false,
+             .command_str = "idx1 SChema hash_field1 as "
+                            "hash_field11 vector hnsw 8 TYPE  FLOAT32 DIM 3 "
+                            "DISTANCE_METRIC IP SHARDS 0",
+             .expected_error_message =
+                 "Invalid field type for field `hash_field1`: Invalid range: "
+                 "Value below minimum; SHARDS must be a positive integer "
+                 "greater than 0 and cannot exceed 64.",
+         },
+         {
+             .test_name = "invalid_graph_dim_above_dim",
+             .success = false,
+             .command_str = "idx1 SChema hash_field1 as "
+                            "hash_field11 vector hnsw 8 TYPE  FLOAT32 DIM 3 "
+                            "DISTANCE_METRIC IP GRAPH_DIM 4",
+             .expected_error_message =
+                 "Invalid field type for field `hash_field1`: Invalid range: "
+                 "Value above maximum; GRAPH_DIM cannot exceed DIM.",
+         },
+         {
+             .test_name = "invalid_graph_dim_with_quantize",
+             .success = false,
+             .command_str = "idx1 SChema hash_field1 as "
+                            "hash_field11 vector hnsw 10 TYPE  FLOAT32 DIM 3 "
+                            "DISTANCE_METRIC IP GRAPH_DIM 2 QUANTIZE INT8",
+             .expected_error_message =
+                 "Invalid field type for field `hash_field1`: GRAPH_DIM cannot "
+                 "be combined with QUANTIZE.",
+         },
          {
              .test_name = "invalid_ef_runtime_zero",
              .success = false,
@@ -885,6 +1213,84 @@ INSTANTIATE_TEST_SUITE_P(
                  "Invalid field type for field `hash_field1`: Error parsing "
                  "value for the parameter `TYPE` - Unknown argument `FLOAT321`",
          },
+         {
+             .test_name = "invalid_quantize",
+             .success = false,
+             .command_str = " idx1 SChema hash_field1 vector hnsw 8 TYPE "
+                            "FLOAT32 DIM 3 DISTANCE_METRIC IP QUANTIZE INT4 ",
+             .expected_error_message =
+                 "Invalid field type for field `hash_field1`: Error parsing "
+                 "value for the parameter `QUANTIZE` - Unknown argument `INT4`",
+         },
+         {
+             .test_name = "invalid_binary_metric",
+             .success = false,
+             .command_str = " idx1 SChema hash_field1 vector flat 6 TYPE "
+                            "BINARY DIM 64 DISTANCE_METRIC L2 ",
+             .expected_error_message =
+                 "Invalid field type for field `hash_field1`: The HAMMING "
+                 "distance metric is only supported with, and required by, "
+                 "the BINARY vector type.",
+         },
+         {
+             .test_name = "invalid_hamming_float32",
+             .success = false,
+             .command_str = " idx1 SChema hash_field1 vector flat 6 TYPE "
+                            "FLOAT32 DIM 64 DISTANCE_METRIC HAMMING ",
+             .expected_error_message =
+                 "Invalid field type for field `hash_field1`: The HAMMING "
+                 "distance metric is only supported with, and required by, "
+                 "the BINARY vector type.",
+         },
+         {
+             .test_name = "invalid_binary_dim",
+             .success = false,
+             .command_str = " idx1 SChema hash_field1 vector flat 6 TYPE "
+                            "BINARY DIM 12 DISTANCE_METRIC HAMMING ",
+             .expected_error_message =
+                 "Invalid field type for field `hash_field1`: The dimensions "
+                 "of a BINARY vector must be a multiple of 8.",
+         },
+         {
+             .test_name = "invalid_binary_quantize",
+             .success = false,
+             .command_str = " idx1 SChema hash_field1 vector hnsw 8 TYPE "
+                            "BINARY DIM 64 DISTANCE_METRIC HAMMING QUANTIZE "
+                            "INT8 ",
+             .expected_error_message =
+                 "Invalid field type for field `hash_field1`: QUANTIZE is not "
+                 "supported for BINARY vectors.",
+         },
+         {
+             .test_name = "invalid_ivf_nprobe",
+             .success = false,
+             .command_str = " idx1 SChema hash_field1 vector ivf 10 TYPE "
+                            "FLOAT32 DIM 3 DISTANCE_METRIC IP NLIST 8 "
+                            "NPROBE 16 ",
+             .expected_error_message =
+                 "Invalid field type for field `hash_field1`: Invalid range: "
+                 "Value above maximum; NPROBE must be a positive integer "
+                 "greater than 0 and cannot exceed NLIST.",
+         },
+         {
+             .test_name = "invalid_ivf_pq_m",
+             .success = false,
+             .command_str = " idx1 SChema hash_field1 vector ivf 8 TYPE "
+                            "FLOAT32 DIM 10 DISTANCE_METRIC L2 PQ_M 4 ",
+             .expected_error_message =
+                 "Invalid field type for field `hash_field1`: PQ_M must "
+                 "divide the vector dimensions (10).",
+         },
+         {
+             .test_name = "invalid_ivf_pq_nbits",
+             .success = false,
+             .command_str = " idx1 SChema hash_field1 vector ivf 10 TYPE "
+                            "FLOAT32 DIM 8 DISTANCE_METRIC L2 PQ_M 4 "
+                            "PQ_NBITS 6 ",
+             .expected_error_message =
+                 "Invalid field type for field `hash_field1`: PQ_NBITS must "
+                 "be 4 or 8.",
+         },
          {
              .test_name = "invalid_dim_1",
              .success = false,
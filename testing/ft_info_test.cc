@@ -138,7 +138,7 @@ INSTANTIATE_TEST_SUITE_P(
                             "definition\r\n*6\r\n+key_"
                             "type\r\n+HASH\r\n+prefixes\r\n*1\r\n+prefix_1\r\n+"
                             "default_score\r\n$1\r\n1\r\n+attributes\r\n*1\r\n*"
-                            "24\r\n+"
+                            "28\r\n+"
                             "identifier\r\n+test_identifier_1\r\n+"
                             "attribute\r\n+test_attribute_1\r\n+"
                             "type\r\n+VECTOR\r\n+"
@@ -149,6 +149,8 @@ INSTANTIATE_TEST_SUITE_P(
                             "M\r\n:240\r\n+"
                             "ef_construction\r\n:400\r\n+"
                             "ef_runtime\r\n:30\r\n+"
+                            "tombstone_ratio\r\n$8\r\n0.000000\r\n+"
+                            "reclaimed_bytes\r\n:0\r\n+"
                             "capacity\r\n:100\r\n+"
                             "size\r\n$1\r\n0\r\n+"
                             "num_docs\r\n:0\r\n+num_records\r\n:0\r\n+num_"
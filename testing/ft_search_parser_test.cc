@@ -61,6 +61,9 @@ struct FTSearchParserTestCase {
   std::string attribute_alias = "vec";
   int k{-1};
   std::optional<int> ef;
+  std::optional<int> nprobe;
+  std::optional<int> oversample;
+  size_t batch_size{0};
   std::string score_as;
   std::string expected_error_message;
   std::string return_str;
@@ -72,6 +75,8 @@ struct FTSearchParserTestCase {
   bool verbatim{false};
   bool inorder{false};
   std::optional<unsigned> slop{};
+  std::string sortby;
+  bool sortby_ascending{true};
 };
 
 class FTSearchParserTest
@@ -243,6 +248,10 @@ void DoVectorSearchParserTest(const FTSearchParserTestCase &test_case,
       EXPECT_EQ(search_params.value()->query, vector_str.c_str());
       EXPECT_EQ(search_params.value()->k, test_case.k);
       EXPECT_EQ(search_params.value()->ef, test_case.ef);
+      EXPECT_EQ(search_params.value()->nprobe, test_case.nprobe);
+      EXPECT_EQ(search_params.value()->oversample, test_case.oversample);
+      EXPECT_EQ(search_params.value()->batch_queries.size(),
+                test_case.batch_size);
       EXPECT_EQ(search_params.value()->attribute_alias,
                 test_case.attribute_alias);
       auto score_as = vmsdk::MakeUniqueValkeyString(test_case.score_as);
@@ -257,6 +266,8 @@ void DoVectorSearchParserTest(const FTSearchParserTestCase &test_case,
       EXPECT_TRUE(search_params.value()->query.empty());
       EXPECT_EQ(search_params.value()->k, 0);
       EXPECT_FALSE(search_params.value()->ef.has_value());
+      EXPECT_FALSE(search_params.value()->nprobe.has_value());
+      EXPECT_FALSE(search_params.value()->oversample.has_value());
       EXPECT_TRUE(search_params.value()->attribute_alias.empty());
     }
     EXPECT_EQ(search_params.value()->no_content,
@@ -281,6 +292,14 @@ void DoVectorSearchParserTest(const FTSearchParserTestCase &test_case,
     EXPECT_EQ(search_params.value()->verbatim, test_case.verbatim);
     EXPECT_EQ(search_params.value()->inorder, test_case.inorder);
     EXPECT_EQ(search_params.value()->slop, test_case.slop);
+    EXPECT_EQ(search_params.value()->sortby.has_value(),
+              !test_case.sortby.empty());
+    if (search_params.value()->sortby.has_value()) {
+      EXPECT_EQ(search_params.value()->sortby->attribute_alias,
+                test_case.sortby);
+      EXPECT_EQ(search_params.value()->sortby->ascending,
+                test_case.sortby_ascending);
+    }
   } else {
     std::cerr << "Failed to parse command: `" << vmsdk::ToStringView(args[0])
               << "` Because: " << search_params.status().message() << "\n";
@@ -386,6 +405,50 @@ INSTANTIATE_TEST_SUITE_P(
             .search_parameters_str = "TIMEOUT 200 RETURN 2 r1 r2 NOCONTENT ",
             .timeout_ms = 200,
         },
+        {
+            .test_name = "happy_path_nprobe",
+            .success = true,
+            .params_str = " PARAMS 4 NPROBE 12",
+            .filter_str = "*=>[KNN 10 @vec $BLOB NPROBE $NPROBE]",
+            .k = 10,
+            .nprobe = 12,
+        },
+        {
+            .test_name = "happy_path_oversample",
+            .success = true,
+            .params_str = " PARAMS 4 OVERSAMPLE 6",
+            .filter_str = "*=>[KNN 10 @vec $BLOB EF_RUNTIME 50 OVERSAMPLE "
+                          "$OVERSAMPLE]",
+            .k = 10,
+            .ef = 50,
+            .oversample = 6,
+        },
+        {
+            .test_name = "happy_path_batch",
+            .success = true,
+            .params_str = " PARAMS 6 BLOB2 abcdefghijkl BLOB3 mnopqrstuvwx",
+            .filter_str = "*=>[KNN 10 @vec $BLOB,$BLOB2,$BLOB3]",
+            .k = 10,
+            .batch_size = 3,
+        },
+        {
+            .test_name = "invalid_batch_literal",
+            .success = false,
+            .params_str = " PARAMS 2",
+            .filter_str = "*=>[KNN 10 @vec $BLOB,abcdefghijkl]",
+            .expected_error_message =
+                "Error parsing vector similarity parameters: Batched query "
+                "vectors must be parameters, got `abcdefghijkl`",
+        },
+        {
+            .test_name = "invalid_batch_missing_param",
+            .success = false,
+            .params_str = " PARAMS 2",
+            .filter_str = "*=>[KNN 10 @vec $BLOB,$BLOB2]",
+            .expected_error_message =
+                "Error parsing vector similarity parameters: Parameter BLOB2 "
+                "not found.",
+        },
         {
             .test_name = "happy_path_braces_prefilter",
             .success = true,
@@ -457,6 +520,24 @@ INSTANTIATE_TEST_SUITE_P(
                 "Error parsing vector similarity parameters: `[KNN 10 @vec "
                 "$BLOB EF_RUNTIMe]`. EF_RUNTIME argument is missing",
         },
+        {
+            .test_name = "missing_nprobe_value",
+            .success = false,
+            .params_str = " PARAMS 4 EF 190",
+            .filter_str = "(*)=>[KNN 10 @vec $BLOB EF_RUNTIME $EF NPROBE]",
+            .expected_error_message =
+                "Error parsing vector similarity parameters: `[KNN 10 @vec "
+                "$BLOB EF_RUNTIME $EF NPROBE]`. NPROBE argument is missing",
+        },
+        {
+            .test_name = "invalid_oversample_zero",
+            .success = false,
+            .params_str = " PARAMS 2",
+            .filter_str = "(*)=>[KNN 10 @vec $BLOB OVERSAMPLE 0]",
+            .expected_error_message =
+                "Invalid range: Value below minimum; `OVERSAMPLE` must be a "
+                "positive integer greater than 0 and cannot exceed 100.",
+        },
         {
             .test_name = "missing_as_score_value",
             .success = false,
@@ -629,6 +710,33 @@ INSTANTIATE_TEST_SUITE_P(
                 "argument `$BLOB1`. Expecting a vector field name, starting "
                 "with '@'",
         },
+        {
+            .test_name = "happy_path_vector_range_prefilter",
+            .success = true,
+            .params_str = " PARAMS 2",
+            .filter_str = "@vec:[VECTOR_RANGE 0.5 $BLOB]=>[KNN 10 @vec $BLOB]",
+            .k = 10,
+        },
+        {
+            .test_name = "invalid_vector_range_missing_param",
+            .success = false,
+            .params_str = " PARAMS 2",
+            .filter_str =
+                "@vec:[VECTOR_RANGE 0.5 $BLOB2]=>[KNN 10 @vec $BLOB]",
+            .expected_error_message =
+                "Invalid filter expression: `@vec:[VECTOR_RANGE 0.5 $BLOB2]`. "
+                "Parameter BLOB2 not found.",
+        },
+        {
+            .test_name = "invalid_vector_range_radius",
+            .success = false,
+            .params_str = " PARAMS 2",
+            .filter_str = "@vec:[VECTOR_RANGE -1 $BLOB]=>[KNN 10 @vec $BLOB]",
+            .expected_error_message =
+                "Invalid filter expression: `@vec:[VECTOR_RANGE -1 $BLOB]`. "
+                "VECTOR_RANGE radius must be a non negative number. "
+                "Position: 21",
+        },
         {
             .test_name = "invalid_prefilter_1",
             .success = false,
@@ -816,6 +924,91 @@ INSTANTIATE_TEST_SUITE_P(
             .search_parameters_str = "SLOP 0",
             .slop = 0,
         },
+        // SORTBY parameter tests
+        {
+            .test_name = "sortby_non_vector_query",
+            .success = true,
+            .params_str = "",
+            .filter_str = "@attribute_identifier_2:{electronics}",
+            .attribute_alias = "",
+            .k = 0,
+            .ef = 0,
+            .score_as = "",
+            .search_parameters_str = "SORTBY attribute_identifier_1",
+            .vector_query = false,
+            .sortby = "attribute_identifier_1",
+        },
+        {
+            .test_name = "sortby_desc",
+            .success = true,
+            .params_str = "",
+            .filter_str = "@attribute_identifier_1:[300 1000]",
+            .attribute_alias = "",
+            .k = 0,
+            .ef = 0,
+            .score_as = "",
+            .search_parameters_str = "SORTBY attribute_identifier_1 desc",
+            .vector_query = false,
+            .sortby = "attribute_identifier_1",
+            .sortby_ascending = false,
+        },
+        {
+            .test_name = "sortby_asc_with_limit",
+            .success = true,
+            .params_str = "",
+            .filter_str = "@attribute_identifier_1:[300 1000]",
+            .attribute_alias = "",
+            .k = 0,
+            .ef = 0,
+            .score_as = "",
+            .search_parameters_str =
+                "SORTBY attribute_identifier_1 ASC LIMIT 0 5",
+            .vector_query = false,
+            .sortby = "attribute_identifier_1",
+        },
+        {
+            .test_name = "sortby_tag_field",
+            .success = false,
+            .params_str = "",
+            .filter_str = "@attribute_identifier_1:[300 1000]",
+            .attribute_alias = "",
+            .k = 0,
+            .ef = 0,
+            .score_as = "",
+            .expected_error_message =
+                "Error parsing value for the parameter `SORTBY` - Index field "
+                "`attribute_identifier_2` is not a Numeric index",
+            .search_parameters_str = "SORTBY attribute_identifier_2",
+            .vector_query = false,
+        },
+        {
+            .test_name = "sortby_unknown_field",
+            .success = false,
+            .params_str = "",
+            .filter_str = "@attribute_identifier_1:[300 1000]",
+            .attribute_alias = "",
+            .k = 0,
+            .ef = 0,
+            .score_as = "",
+            .expected_error_message =
+                "Error parsing value for the parameter `SORTBY`",
+            .search_parameters_str = "SORTBY price",
+            .vector_query = false,
+        },
+        {
+            .test_name = "sortby_missing_field",
+            .success = false,
+            .params_str = "",
+            .filter_str = "@attribute_identifier_1:[300 1000]",
+            .attribute_alias = "",
+            .k = 0,
+            .ef = 0,
+            .score_as = "",
+            .expected_error_message =
+                "Error parsing value for the parameter `SORTBY`",
+            .search_parameters_str = "SORTBY",
+            .vector_query = false,
+        },
         // Combined parameter tests
         {
             .test_name = "multiple_parameters_vector_query",
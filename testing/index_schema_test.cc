@@ -8,6 +8,7 @@
 #include "src/index_schema.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
@@ -26,6 +27,8 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "absl/types/optional.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -41,6 +44,7 @@
 #include "src/keyspace_event_manager.h"
 #include "src/metrics.h"
 #include "src/schema_manager.h"
+#include "src/utils/cancel.h"
 #include "src/utils/string_interning.h"
 #include "src/valkey_search_options.h"
 #include "testing/common.h"
@@ -1052,6 +1056,65 @@ TEST_F(IndexSchemaBackfillTest, PerformBackfill_SwapDB) {
   }
 }
 
+TEST_F(IndexSchemaBackfillTest, ReserveBackfillCapacityExcludesSearches)
+ABSL_NO_THREAD_SAFETY_ANALYSIS {
+  InitThreadPools(std::nullopt, std::nullopt, 1);
+  auto index_schema =
+      CreateVectorHNSWSchema("index_schema_name", &fake_ctx_).value();
+  auto vector_index = dynamic_cast<indexes::VectorHNSW<float> *>(
+      index_schema->GetIndex("vector").value().get());
+  ASSERT_NE(vector_index, nullptr);
+  const int dimensions = 100;
+  auto vectors = DeterministicallyGenerateVectors(100, dimensions, 2);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    auto key = StringInternStore::Intern("prefix:" + std::to_string(i));
+    VMSDK_EXPECT_OK(vector_index->AddRecord(key, VectorToStr(vectors[i])));
+  }
+  const size_t initial_capacity = vector_index->GetCapacity();
+  auto &backfill_job = index_schema->backfill_job_.Get();
+  ASSERT_TRUE(backfill_job.has_value());
+  backfill_job->scanned_key_count = 1;
+  backfill_job->matched_key_count = 1;
+  backfill_job->db_size = initial_capacity * 4;
+
+  // Searches run under the schema reader lock while the graphs are grown.
+  std::atomic<bool> stop{false};
+  std::atomic<size_t> searches{0};
+  std::thread searcher([&] {
+    auto cancel_never = cancel::Make(1000000, nullptr);
+    while (!stop) {
+      vmsdk::ReaderMutexLock lock(&index_schema->GetTimeSlicedMutex());
+      const size_t capacity = vector_index->GetCapacity();
+      auto res = vector_index->Search(
+          VectorToStr(vectors[searches % vectors.size()]), 10, cancel_never);
+      VMSDK_EXPECT_OK(res);
+      EXPECT_EQ(res->size(), 10);
+      // The graphs are not resized under a search.
+      EXPECT_EQ(vector_index->GetCapacity(), capacity);
+      ++searches;
+    }
+  });
+  {
+    vmsdk::ReaderMutexLock lock(&index_schema->GetTimeSlicedMutex());
+    index_schema->ReserveBackfillCapacity();
+    absl::SleepFor(absl::Milliseconds(50));
+    EXPECT_EQ(vector_index->GetCapacity(), initial_capacity);
+  }
+  auto get_capacity = [&]() {
+    vmsdk::ReaderMutexLock lock(&index_schema->GetTimeSlicedMutex());
+    return vector_index->GetCapacity();
+  };
+  while (get_capacity() == initial_capacity) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  while (searches < 100) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  stop = true;
+  searcher.join();
+  EXPECT_GE(get_capacity(), vectors.size() + initial_capacity * 4 - 1);
+}
+
 INSTANTIATE_TEST_SUITE_P(
     IndexSchemaBackfillTests, IndexSchemaBackfillTest,
     Combine(Bool(),
@@ -5,7 +5,10 @@
  *
  */
 
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -312,6 +315,202 @@ TEST_F(NumericIndexTest, DeletedKeysNegativeSearchTest) {
   EXPECT_THAT(Fetch(*entries_fetcher), testing::UnorderedElementsAre("doc0"));
 }
 
+std::vector<std::string> KeysInValueOrder(const Numeric& index,
+                                          bool ascending) {
+  std::vector<std::string> keys;
+  index.ForEachInValueOrder(
+      ascending, [&keys](const InternedStringPtr& key, double value) {
+        keys.push_back(std::string(key->Str()));
+        return true;
+      });
+  return keys;
+}
+
+TEST_F(NumericIndexTest, IntegerMode) {
+  // Both beyond 2^53, where they are the same double.
+  VMSDK_EXPECT_OK(index.AddRecord("big2", "1700000000000000002"));
+  VMSDK_EXPECT_OK(index.AddRecord("big1", "1700000000000000001"));
+  VMSDK_EXPECT_OK(index.AddRecord("key1", "1"));
+  VMSDK_EXPECT_OK(index.AddRecord("key2", "2.0"));
+  VMSDK_EXPECT_OK(index.AddRecord("key3", "3e0"));
+  VMSDK_EXPECT_OK(index.AddRecord("neg1", "-1"));
+  EXPECT_TRUE(index.IsIntegerMode());
+  EXPECT_EQ(index.GetValueString(StringInternStore::Intern("big1")),
+            "1700000000000000001");
+  EXPECT_EQ(index.GetValueString(StringInternStore::Intern("key2")), "2");
+  EXPECT_EQ(index.GetValue(StringInternStore::Intern("key3")), 3.0);
+  EXPECT_THAT(KeysInValueOrder(index, true),
+              testing::ElementsAre("neg1", "key1", "key2", "key3", "big1",
+                                   "big2"));
+
+  auto predicate = query::NumericPredicate(&index, "attribute1", "id1", 1.5,
+                                           true, 2.5, true);
+  auto fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 1);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre("key2"));
+  EXPECT_TRUE(index.IsInRange(StringInternStore::Intern("key2"), predicate));
+  EXPECT_FALSE(index.IsInRange(StringInternStore::Intern("key1"), predicate));
+
+  predicate = query::NumericPredicate(&index, "attribute1", "id1", -1.5, true,
+                                      -0.5, false);
+  fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 1);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre("neg1"));
+
+  predicate = query::NumericPredicate(&index, "attribute1", "id1", 1.0, false,
+                                      3.0, false);
+  fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 1);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre("key2"));
+
+  predicate = query::NumericPredicate(&index, "attribute1", "id1", 2.2, true,
+                                      2.8, true);
+  fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 0);
+  fetcher = index.Search(predicate, true);
+  EXPECT_EQ(fetcher->Size(), 6);
+
+  predicate = query::NumericPredicate(&index, "attribute1", "id1", 1e15,
+                                      false, 1e19, true);
+  fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 2);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre("big1", "big2"));
+  fetcher = index.Search(predicate, true);
+  EXPECT_EQ(fetcher->Size(), 4);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre(
+                                   "neg1", "key1", "key2", "key3"));
+
+  predicate = query::NumericPredicate(
+      &index, "attribute1", "id1", -std::numeric_limits<double>::infinity(),
+      true, std::numeric_limits<double>::infinity(), true);
+  fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 6);
+  predicate = query::NumericPredicate(&index, "attribute1", "id1", 1e19, true,
+                                      std::numeric_limits<double>::infinity(),
+                                      true);
+  fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 0);
+}
+
+TEST_F(NumericIndexTest, SwitchToDoubleMode) {
+  VMSDK_EXPECT_OK(index.AddRecord("key1", "1"));
+  VMSDK_EXPECT_OK(index.AddRecord("key2", "-2"));
+  VMSDK_EXPECT_OK(index.AddRecord("key3", "0"));
+  EXPECT_TRUE(index.IsIntegerMode());
+  VMSDK_EXPECT_OK(index.ModifyRecord("key3", "-0.5"));
+  EXPECT_FALSE(index.IsIntegerMode());
+  VMSDK_EXPECT_OK(index.AddRecord("key4", "2.5"));
+  VMSDK_EXPECT_OK(index.AddRecord("key5", "-0"));
+  EXPECT_EQ(index.GetValue(StringInternStore::Intern("key2")), -2.0);
+  EXPECT_EQ(index.GetValueString(StringInternStore::Intern("key4")), "2.5");
+  EXPECT_THAT(KeysInValueOrder(index, false),
+              testing::ElementsAre("key4", "key1", "key5", "key3", "key2"));
+
+  auto predicate = query::NumericPredicate(&index, "attribute1", "id1", -2.0,
+                                           false, 0.0, true);
+  auto fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 2);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre("key3", "key5"));
+  EXPECT_TRUE(index.IsInRange(StringInternStore::Intern("key5"), predicate));
+  EXPECT_FALSE(index.IsInRange(StringInternStore::Intern("key2"), predicate));
+
+  predicate = query::NumericPredicate(&index, "attribute1", "id1", 0.0, false,
+                                      2.5, false);
+  fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 1);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre("key1"));
+  fetcher = index.Search(predicate, true);
+  EXPECT_EQ(fetcher->Size(), 4);
+  EXPECT_THAT(Fetch(*fetcher),
+              testing::UnorderedElementsAre("key2", "key3", "key4", "key5"));
+}
+
+TEST_F(NumericIndexTest, IntegerBounds) {
+  VMSDK_EXPECT_OK(index.AddRecord("big1", "1700000000000000001"));
+  VMSDK_EXPECT_OK(index.AddRecord("big2", "1700000000000000002"));
+  VMSDK_EXPECT_OK(index.AddRecord("big3", "1700000000000000003"));
+  // The doubles of the bounds are all 1700000000000000000.
+  auto predicate = query::NumericPredicate(
+      &index, "attribute1", "id1", 1.7e18, true, 1.7e18, true,
+      1700000000000000002, 1700000000000000002);
+  auto fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 1);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre("big2"));
+  EXPECT_TRUE(index.IsInRange(StringInternStore::Intern("big2"), predicate));
+  EXPECT_FALSE(index.IsInRange(StringInternStore::Intern("big1"), predicate));
+  EXPECT_TRUE(predicate.Evaluate(int64_t{1700000000000000002}).matches);
+  EXPECT_FALSE(predicate.Evaluate(int64_t{1700000000000000003}).matches);
+
+  predicate = query::NumericPredicate(&index, "attribute1", "id1", 1.7e18,
+                                      false, 1.7e18, true,
+                                      1700000000000000001, std::nullopt);
+  fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 2);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre("big2", "big3"));
+  fetcher = index.Search(predicate, true);
+  EXPECT_EQ(fetcher->Size(), 1);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre("big1"));
+
+  predicate = query::NumericPredicate(
+      &index, "attribute1", "id1", 9.3e18, false, 9.3e18, true,
+      std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max());
+  EXPECT_FALSE(predicate.GetIntegerRange().has_value());
+  fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 0);
+}
+
+TEST_F(NumericIndexTest, SwitchBackToIntegerMode) {
+  VMSDK_EXPECT_OK(index.AddRecord("key1", "1"));
+  VMSDK_EXPECT_OK(index.AddRecord("key2", "2"));
+  VMSDK_EXPECT_OK(index.AddRecord("key3", "2.5"));
+  EXPECT_FALSE(index.IsIntegerMode());
+  VMSDK_EXPECT_OK(index.ModifyRecord("key3", "3"));
+  // Switching back waits for as many updates as there are keys since the
+  // last switch.
+  EXPECT_FALSE(index.IsIntegerMode());
+  VMSDK_EXPECT_OK(index.ModifyRecord("key1", "1"));
+  EXPECT_TRUE(index.IsIntegerMode());
+  EXPECT_EQ(index.GetValueString(StringInternStore::Intern("key3")), "3");
+  EXPECT_THAT(KeysInValueOrder(index, true),
+              testing::ElementsAre("key1", "key2", "key3"));
+
+  VMSDK_EXPECT_OK(index.AddRecord("key4", "4.5"));
+  EXPECT_FALSE(index.IsIntegerMode());
+  VMSDK_EXPECT_OK(index.RemoveRecord("key4", DeletionType::kRecord));
+  EXPECT_FALSE(index.IsIntegerMode());
+  VMSDK_EXPECT_OK(index.ModifyRecord("key2", "2"));
+  EXPECT_TRUE(index.IsIntegerMode());
+  auto predicate = query::NumericPredicate(&index, "attribute1", "id1", 1.5,
+                                           true, 3.0, false);
+  auto fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 1);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre("key2"));
+}
+
+TEST_F(NumericIndexTest, SwitchBackRestoresRoundedIntegers) {
+  VMSDK_EXPECT_OK(index.AddRecord("big1", "1700000000000000001"));
+  VMSDK_EXPECT_OK(index.AddRecord("max", "9223372036854775807"));
+  VMSDK_EXPECT_OK(index.AddRecord("half", "2.5"));
+  EXPECT_FALSE(index.IsIntegerMode());
+  EXPECT_EQ(index.GetValueString(StringInternStore::Intern("big1")),
+            "1700000000000000001");
+  VMSDK_EXPECT_OK(index.AddRecord("big3", "1700000000000000003"));
+  VMSDK_EXPECT_OK(index.RemoveRecord("half", DeletionType::kRecord));
+  EXPECT_TRUE(index.IsIntegerMode());
+  EXPECT_EQ(index.GetValueString(StringInternStore::Intern("big1")),
+            "1700000000000000001");
+  EXPECT_EQ(index.GetValueString(StringInternStore::Intern("big3")),
+            "1700000000000000003");
+  EXPECT_EQ(index.GetValueString(StringInternStore::Intern("max")),
+            "9223372036854775807");
+  auto predicate = query::NumericPredicate(
+      &index, "attribute1", "id1", 1.7e18, true, 1.7e18, true,
+      1700000000000000003, 1700000000000000003);
+  auto fetcher = index.Search(predicate, false);
+  EXPECT_EQ(fetcher->Size(), 1);
+  EXPECT_THAT(Fetch(*fetcher), testing::UnorderedElementsAre("big3"));
+}
+
 }  // namespace
 
 }  // namespace valkey_search::indexes
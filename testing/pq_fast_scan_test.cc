@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#include "src/indexes/pq_fast_scan.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace valkey_search::indexes {
+
+namespace {
+
+class FastScanTest : public testing::TestWithParam<size_t> {};
+
+TEST_P(FastScanTest, PackedCodesRoundTrip) {
+  const size_t m = GetParam();
+  std::mt19937 gen(7);
+  std::vector<uint8_t> block(GetFastScanBlockBytes(m), 0xff);
+  std::vector<std::vector<uint8_t>> codes(kFastScanBlockSize,
+                                          std::vector<uint8_t>(m));
+  for (size_t i = 0; i < kFastScanBlockSize; ++i) {
+    for (auto& code : codes[i]) {
+      code = gen() % 16;
+    }
+    PackFastScanCode(codes[i].data(), m, i, block.data());
+  }
+  std::vector<uint8_t> code(m);
+  for (size_t i = 0; i < kFastScanBlockSize; ++i) {
+    UnpackFastScanCode(block.data(), m, i, code.data());
+    EXPECT_EQ(code, codes[i]);
+  }
+}
+
+TEST_P(FastScanTest, BlockDistancesWithinError) {
+  const size_t m = GetParam();
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<float> entries(-5.0f, 20.0f);
+  std::vector<float> table(m * 16);
+  for (auto& entry : table) {
+    entry = entries(gen);
+  }
+  // The padding of an odd number of sub-quantizers is left uninitialized.
+  std::vector<uint8_t> block(GetFastScanBlockBytes(m), 0xa5);
+  std::vector<std::vector<uint8_t>> codes(kFastScanBlockSize,
+                                          std::vector<uint8_t>(m));
+  for (size_t i = 0; i < kFastScanBlockSize; ++i) {
+    for (auto& code : codes[i]) {
+      code = gen() % 16;
+    }
+    PackFastScanCode(codes[i].data(), m, i, block.data());
+  }
+  FastScanTable fast_scan_table(table.data(), m);
+  float distances[kFastScanBlockSize];
+  fast_scan_table.ScanBlock(block.data(), distances);
+  for (size_t i = 0; i < kFastScanBlockSize; ++i) {
+    float expected = 0.0f;
+    for (size_t s = 0; s < m; ++s) {
+      expected += table[s * 16 + codes[i][s]];
+    }
+    EXPECT_LE(std::abs(distances[i] - expected),
+              fast_scan_table.GetMaxError())
+        << "vector " << i;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(FastScanTests, FastScanTest,
+                         testing::Values(1, 2, 7, 16, 25, 64, 300));
+
+}  // namespace
+
+}  // namespace valkey_search::indexes
@@ -7,6 +7,7 @@
 
 #include "src/query/search.h"
 
+#include <bit>
 #include <cstddef>
 #include <cstdint>
 #include <deque>
@@ -37,8 +38,8 @@
 #include "src/indexes/vector_base.h"
 #include "src/indexes/vector_flat.h"
 #include "src/indexes/vector_hnsw.h"
+#include "src/query/planner.h"
 #include "src/query/predicate.h"
-#include "src/utils/patricia_tree.h"
 #include "src/utils/string_interning.h"
 #include "testing/common.h"
 #include "vmsdk/src/managed_pointers.h"
@@ -133,11 +134,10 @@ class MockTag : public indexes::Tag {
 
 class TestedTagEntriesFetcher : public indexes::Tag::EntriesFetcher {
  public:
-  TestedTagEntriesFetcher(
-      size_t size, PatriciaTree<InternedStringPtr> &tree,
-      absl::flat_hash_set<PatriciaNode<InternedStringPtr> *> &entries,
-      bool negate, InternedStringSet &untracked_keys)
-      : indexes::Tag::EntriesFetcher(tree, entries, size, negate,
+  TestedTagEntriesFetcher(size_t size,
+                          std::vector<InternedStringPtr> &keys_by_doc_id,
+                          bool negate, InternedStringSet &untracked_keys)
+      : indexes::Tag::EntriesFetcher(keys_by_doc_id, nullptr, size, negate,
                                      untracked_keys),
         size_(size) {}
 
@@ -215,15 +215,14 @@ void InitIndexSchema(MockIndexSchema *index_schema) {
 
   VMSDK_EXPECT_OK(index_schema->AddIndex("tag_index_100_15", "tag_index_100_15",
                                          tag_index_100_15));
-  static PatriciaTree<InternedStringPtr> tree(false);
-  static absl::flat_hash_set<PatriciaNode<InternedStringPtr> *> entries;
+  static std::vector<InternedStringPtr> keys_by_doc_id;
   static InternedStringSet untracked_keys;
   EXPECT_CALL(*tag_index_100_15, Search(_, false)).WillRepeatedly([]() {
-    return std::make_unique<TestedTagEntriesFetcher>(15, tree, entries, false,
+    return std::make_unique<TestedTagEntriesFetcher>(15, keys_by_doc_id, false,
                                                      untracked_keys);
   });
   EXPECT_CALL(*tag_index_100_15, Search(_, true)).WillRepeatedly([]() {
-    return std::make_unique<TestedTagEntriesFetcher>(85, tree, entries, false,
+    return std::make_unique<TestedTagEntriesFetcher>(85, keys_by_doc_id, false,
                                                      untracked_keys);
   });
 }
@@ -245,10 +244,12 @@ TEST_P(EvaluateFilterAsPrimaryTest, ParseParams) {
       << "Tree structure mismatch for filter: " << test_case.filter;
 
   std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> entries_fetchers;
+  auto cancellation_token = cancel::Make(query::kMaxTimeoutMs, nullptr);
   EXPECT_EQ(
       EvaluateFilterAsPrimary(filter_parse_results.value().root_predicate.get(),
                               entries_fetchers, false,
-                              filter_parse_results.value().query_operations),
+                              filter_parse_results.value().query_operations,
+                              cancellation_token),
       test_case.evaluate_size);
 
   EXPECT_EQ(entries_fetchers.size(), test_case.fetcher_ids.size());
@@ -647,6 +648,115 @@ INSTANTIATE_TEST_SUITE_P(
       return info.param.test_name;
     });
 
+class SortedSearchTest : public ValkeySearchTest {};
+
+TEST_F(SortedSearchTest, SortByNumeric) {
+  auto index_schema = CreateIndexSchemaWithMultipleAttributes();
+  size_t num_records =
+      index_schema->GetIndex("numeric").value()->GetTrackedKeyCount();
+  auto last = [num_records](size_t i) {
+    return std::to_string(num_records - 1 - i);
+  };
+  struct {
+    std::string filter;
+    bool ascending;
+    query::LimitParameter limit;
+    std::vector<std::string> expected_keys;
+    size_t expected_total_count;
+  } test_cases[] = {
+      // Most keys match, the numeric index is walked in value order.
+      {"@tag:{LT10000}", true, {0, 3}, {"0", "1", "2"}, num_records},
+      {"@tag:{LT10000}", true, {2, 3}, {"2", "3", "4"}, num_records},
+      {"@tag:{LT10000}",
+       false,
+       {0, 3},
+       {last(0), last(1), last(2)},
+       num_records},
+      // Few keys match, they are collected and sorted.
+      {"@tag:{LT5}", false, {0, 3}, {"4", "3", "2"}, 5},
+      // The filter is evaluated per key.
+      {"@numeric:[10 20] @tag:{LT10000}",
+       false,
+       {0, 3},
+       {"20", "19", "18"},
+       11},
+  };
+  for (const auto &test_case : test_cases) {
+    query::SearchParameters params(100000, nullptr, 0);
+    params.index_schema = index_schema;
+    params.index_schema_name = kIndexSchemaName;
+    params.limit = test_case.limit;
+    params.sortby = query::SortByParameter{"numeric", test_case.ascending};
+    TextParsingOptions options{};
+    FilterParser parser(*index_schema, test_case.filter, options);
+    params.filter_parse_results = std::move(parser.Parse().value());
+    auto result = Search(params, query::SearchMode::kLocal);
+    VMSDK_EXPECT_OK(result);
+    EXPECT_EQ(result->total_count, test_case.expected_total_count);
+    auto range = result->GetSerializationRange(params);
+    std::vector<std::string> keys;
+    for (auto i = range.start_index; i < range.end_index; ++i) {
+      keys.emplace_back(*result->neighbors[i].external_id);
+    }
+    EXPECT_EQ(keys, test_case.expected_keys) << test_case.filter;
+  }
+
+  // The k nearest neighbors of a vector query are sorted.
+  query::SearchParameters params(100000, nullptr, 0);
+  params.index_schema = index_schema;
+  params.index_schema_name = kIndexSchemaName;
+  params.attribute_alias = kVectorAttributeAlias;
+  params.score_as = vmsdk::MakeUniqueValkeyString(kScoreAs);
+  params.k = 5;
+  params.ef = kEfRuntime;
+  std::vector<float> query_vector(kVectorDimensions, 1.0);
+  params.query = VectorToStr(query_vector);
+  params.sortby = query::SortByParameter{"numeric", false};
+  auto result = Search(params, query::SearchMode::kLocal);
+  VMSDK_EXPECT_OK(result);
+  ASSERT_EQ(result->neighbors.size(), 5);
+  for (size_t i = 1; i < result->neighbors.size(); ++i) {
+    EXPECT_GT(result->neighbors[i - 1].sort_value,
+              result->neighbors[i].sort_value);
+  }
+}
+
+class QueryPlannerTest : public ValkeySearchTest {};
+
+TEST_F(QueryPlannerTest, PlanFilteredSearch) {
+  auto index_schema = CreateIndexSchemaWithMultipleAttributes();
+  auto vector_index = dynamic_cast<indexes::VectorBase *>(
+      index_schema->GetIndex(kVectorAttributeAlias)->get());
+  size_t num_records = vector_index->GetTrackedKeyCount();
+  TextParsingOptions options{};
+  FilterParser selective_parser(*index_schema, "@tag:{LT3}", options);
+  auto selective_filter = selective_parser.Parse().value();
+  FilterParser broad_parser(*index_schema, "@tag:{LT10000}", options);
+  auto broad_filter = broad_parser.Parse().value();
+
+  auto selective = query::PlanFilteredSearch(
+      3, selective_filter.root_predicate.get(), 10, 1, kEfRuntime,
+      vector_index);
+  EXPECT_TRUE(selective.use_prefiltering);
+  auto broad = query::PlanFilteredSearch(num_records,
+                                         broad_filter.root_predicate.get(), 10,
+                                         1, kEfRuntime, vector_index);
+  EXPECT_LT(broad.inline_filtering_cost_ns,
+            selective.inline_filtering_cost_ns);
+  EXPECT_GT(broad.prefiltering_cost_ns, selective.prefiltering_cost_ns);
+#ifndef SAN_BUILD
+  EXPECT_FALSE(broad.use_prefiltering);
+#endif
+  // Every query of a batch searches the graph again, while the pre-filtered
+  // keys are fetched once.
+  auto batch = query::PlanFilteredSearch(num_records,
+                                         broad_filter.root_predicate.get(), 10,
+                                         8, kEfRuntime, vector_index);
+  EXPECT_DOUBLE_EQ(batch.inline_filtering_cost_ns,
+                   8 * broad.inline_filtering_cost_ns);
+  EXPECT_LT(batch.prefiltering_cost_ns, 8 * broad.prefiltering_cost_ns);
+}
+
 struct FetchFilteredKeysTestCase {
   std::string test_name;
   std::string filter;
@@ -721,6 +831,47 @@ INSTANTIATE_TEST_SUITE_P(
       return info.param.test_name;
     });
 
+class FilterBitmapTest : public ValkeySearchTest {};
+
+TEST_F(FilterBitmapTest, BuildFilterBitmap) {
+  auto index_schema = CreateIndexSchemaWithMultipleAttributes();
+  auto vector_index = dynamic_cast<indexes::VectorBase *>(
+      index_schema->GetIndex(kVectorAttributeAlias)->get());
+  query::SearchParameters params(100000, nullptr, 0);
+  TextParsingOptions options{};
+  FilterParser parser(*index_schema, "@numeric:[0 4] | @numeric:[1 6]",
+                      options);
+  params.filter_parse_results = std::move(parser.Parse().value());
+  params.k = 100;
+  auto vectors = DeterministicallyGenerateVectors(1, kVectorDimensions, 10.0);
+  params.query =
+      std::string((char *)vectors[0].data(), vectors[0].size() * sizeof(float));
+  std::queue<std::unique_ptr<indexes::EntriesFetcherBase>> entries_fetchers;
+  indexes::Numeric::EntriesRange entries_range;
+  entries_fetchers.push(std::make_unique<TestedNumericEntriesFetcher>(
+      entries_range, std::make_pair(0, 4)));
+  entries_fetchers.push(std::make_unique<TestedNumericEntriesFetcher>(
+      entries_range, std::make_pair(1, 6)));
+  auto filter_bitmap =
+      query::BuildFilterBitmap(params, entries_fetchers, vector_index, 0);
+  size_t bits_set = 0;
+  for (auto word : filter_bitmap) {
+    bits_set += std::popcount(word);
+  }
+  EXPECT_EQ(bits_set, 7);
+
+  // The inline filtered search only returns the keys set in the bitmap.
+  std::unordered_set<std::string> expected_keys = {"0", "1", "2", "3",
+                                                   "4", "5", "6"};
+  auto neighbors = query::PerformVectorSearch(
+      vector_index, params, {.filter_bitmap = &filter_bitmap});
+  VMSDK_EXPECT_OK(neighbors);
+  EXPECT_FALSE(neighbors->empty());
+  for (const auto &neighbor : *neighbors) {
+    EXPECT_TRUE(expected_keys.contains(std::string(*neighbor.external_id)));
+  }
+}
+
 struct SearchTestCase {
   std::string test_name;
   std::string filter;
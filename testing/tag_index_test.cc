@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "src/commands/filter_parser.h"
@@ -274,6 +275,68 @@ TEST_F(TagIndexTest, DeletedKeysNegativeSearchTest) {
   EXPECT_THAT(Fetch(*entries_fetcher), testing::UnorderedElementsAre("doc0"));
 }
 
+TEST_F(TagIndexTest, OrSearchFetchesKeysOnce) {
+  EXPECT_TRUE(index->AddRecord("doc1", "red,blue").value());
+  EXPECT_TRUE(index->AddRecord("doc2", "blue").value());
+  EXPECT_TRUE(index->AddRecord("doc3", "red,green").value());
+  EXPECT_TRUE(index->AddRecord("doc4", "green").value());
+  EXPECT_FALSE(index->RemoveRecord("doc5").value());  // now untracked
+
+  std::string filter_tag_string = "red|blue";
+  auto parsed_tags = FilterParser::ParseQueryTags(filter_tag_string).value();
+  query::TagPredicate predicate(index.get(), alias, identifier,
+                                filter_tag_string, parsed_tags);
+  auto entries_fetcher = index->Search(predicate, false);
+  EXPECT_EQ(entries_fetcher->Size(), 3);
+  EXPECT_THAT(Fetch(*entries_fetcher),
+              testing::UnorderedElementsAre("doc1", "doc2", "doc3"));
+
+  // doc3 also has green, but it is not fetched by the negation.
+  entries_fetcher = index->Search(predicate, true);
+  EXPECT_EQ(entries_fetcher->Size(), 2);
+  EXPECT_THAT(Fetch(*entries_fetcher),
+              testing::UnorderedElementsAre("doc4", "doc5"));
+}
+
+TEST_F(TagIndexTest, ReusesDocumentNumbers) {
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(
+        index->AddRecord(absl::StrCat("doc", i), i % 2 ? "odd" : "even")
+            .value());
+  }
+  for (int i = 0; i < 100; i += 3) {
+    EXPECT_TRUE(
+        index->RemoveRecord(absl::StrCat("doc", i), DeletionType::kRecord)
+            .value());
+  }
+  for (int i = 100; i < 120; ++i) {
+    EXPECT_TRUE(index->AddRecord(absl::StrCat("doc", i), "odd").value());
+  }
+  EXPECT_TRUE(index->ModifyRecord("doc1", "even").value());
+
+  std::string filter_tag_string = "odd";
+  auto parsed_tags = FilterParser::ParseQueryTags(filter_tag_string).value();
+  query::TagPredicate predicate(index.get(), alias, identifier,
+                                filter_tag_string, parsed_tags);
+  std::vector<std::string> expected_odd;
+  std::vector<std::string> expected_even;
+  for (int i = 0; i < 120; ++i) {
+    if (i < 100 && i % 3 == 0) {
+      continue;
+    }
+    (i >= 100 || (i % 2 == 1 && i != 1) ? expected_odd : expected_even)
+        .push_back(absl::StrCat("doc", i));
+  }
+  auto entries_fetcher = index->Search(predicate, false);
+  EXPECT_EQ(entries_fetcher->Size(), expected_odd.size());
+  EXPECT_THAT(Fetch(*entries_fetcher),
+              testing::UnorderedElementsAreArray(expected_odd));
+  entries_fetcher = index->Search(predicate, true);
+  EXPECT_EQ(entries_fetcher->Size(), expected_even.size());
+  EXPECT_THAT(Fetch(*entries_fetcher),
+              testing::UnorderedElementsAreArray(expected_even));
+}
+
 // Tests for escaped separator handling in ParseSearchTags and UnescapeTag
 // Per Redis spec: \| should be treated as literal pipe, not a separator
 
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#include "src/utils/compressed_bitmap.h"
+
+#include <cstdint>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace valkey_search::utils {
+
+namespace {
+
+std::vector<uint32_t> Values(const CompressedBitmap &bitmap) {
+  return std::vector<uint32_t>(bitmap.begin(), bitmap.end());
+}
+
+TEST(CompressedBitmapTest, SimpleAddRemove) {
+  CompressedBitmap bitmap;
+  EXPECT_TRUE(bitmap.empty());
+  EXPECT_TRUE(bitmap.begin() == bitmap.end());
+  EXPECT_TRUE(bitmap.insert(70000));
+  EXPECT_TRUE(bitmap.insert(1));
+  EXPECT_TRUE(bitmap.insert(0xffffffff));
+  EXPECT_FALSE(bitmap.insert(1));
+  EXPECT_EQ(bitmap.size(), 3);
+  EXPECT_TRUE(bitmap.contains(70000));
+  EXPECT_FALSE(bitmap.contains(2));
+  EXPECT_THAT(Values(bitmap), testing::ElementsAre(1, 70000, 0xffffffff));
+
+  EXPECT_EQ(bitmap.erase(2), 0);
+  EXPECT_EQ(bitmap.erase(70000), 1);
+  EXPECT_EQ(bitmap.erase(70000), 0);
+  EXPECT_THAT(Values(bitmap), testing::ElementsAre(1, 0xffffffff));
+  EXPECT_EQ(bitmap.size(), 2);
+}
+
+TEST(CompressedBitmapTest, SingleValue) {
+  CompressedBitmap bitmap;
+  EXPECT_TRUE(bitmap.insert(42));
+  EXPECT_FALSE(bitmap.insert(42));
+  EXPECT_TRUE(bitmap.contains(42));
+  EXPECT_FALSE(bitmap.contains(43));
+  EXPECT_THAT(Values(bitmap), testing::ElementsAre(42));
+  CompressedBitmap other;
+  other.insert(7);
+  other.UnionWith(bitmap);
+  EXPECT_THAT(Values(other), testing::ElementsAre(7, 42));
+  bitmap.UnionWith(other);
+  EXPECT_THAT(Values(bitmap), testing::ElementsAre(7, 42));
+  EXPECT_EQ(bitmap.erase(7), 1);
+  EXPECT_EQ(bitmap.erase(42), 1);
+  EXPECT_TRUE(bitmap.empty());
+  EXPECT_TRUE(bitmap.begin() == bitmap.end());
+  EXPECT_EQ(other.erase(42), 1);
+  EXPECT_EQ(other.erase(7), 1);
+  EXPECT_TRUE(other.begin() == other.end());
+}
+
+TEST(CompressedBitmapTest, ArrayToBitsetAndBack) {
+  CompressedBitmap bitmap;
+  std::vector<uint32_t> expected;
+  for (uint32_t value = 0; value < 20000; value += 2) {
+    EXPECT_TRUE(bitmap.insert(value));
+    expected.push_back(value);
+  }
+  EXPECT_EQ(bitmap.size(), expected.size());
+  EXPECT_EQ(Values(bitmap), expected);
+  EXPECT_TRUE(bitmap.contains(19998));
+  EXPECT_FALSE(bitmap.contains(19999));
+  for (uint32_t value = 0; value < 19000; value += 2) {
+    EXPECT_EQ(bitmap.erase(value), 1);
+  }
+  EXPECT_THAT(Values(bitmap), testing::SizeIs(500));
+  EXPECT_EQ(*bitmap.begin(), 19000);
+  EXPECT_TRUE(bitmap.contains(19998));
+}
+
+TEST(CompressedBitmapTest, Union) {
+  CompressedBitmap sparse;
+  CompressedBitmap dense;
+  for (uint32_t value = 0; value < 100000; value += 7) {
+    sparse.insert(value);
+  }
+  for (uint32_t value = 50000; value < 200000; ++value) {
+    dense.insert(value);
+  }
+  std::set<uint32_t> expected(sparse.begin(), sparse.end());
+  expected.insert(dense.begin(), dense.end());
+
+  CompressedBitmap copy = sparse;
+  copy.UnionWith(dense);
+  EXPECT_EQ(copy.size(), expected.size());
+  EXPECT_EQ(Values(copy), std::vector<uint32_t>(expected.begin(),
+                                                expected.end()));
+  dense.UnionWith(sparse);
+  EXPECT_EQ(Values(dense), Values(copy));
+  // The copy is unchanged.
+  EXPECT_EQ(sparse.size(), (100000 + 6) / 7);
+}
+
+// Compares the bitmap with a set over random additions and removals, which
+// convert the containers between arrays and bitsets.
+TEST(CompressedBitmapTest, RandomOperations) {
+  for (uint32_t keyspace : {1000u, 300000u}) {
+    CompressedBitmap bitmap;
+    std::set<uint32_t> expected;
+    std::mt19937 gen(keyspace);
+    for (int step = 0; step < 200000; ++step) {
+      uint32_t value = gen() % keyspace;
+      if (gen() % 100 < (step < 100000 ? 70 : 20)) {
+        EXPECT_EQ(bitmap.insert(value), expected.insert(value).second);
+      } else {
+        EXPECT_EQ(bitmap.erase(value), expected.erase(value));
+      }
+      if (step % 20000 != 0) {
+        continue;
+      }
+      EXPECT_EQ(bitmap.size(), expected.size());
+      EXPECT_EQ(Values(bitmap),
+                std::vector<uint32_t>(expected.begin(), expected.end()));
+      for (int i = 0; i < 100; ++i) {
+        value = gen() % keyspace;
+        EXPECT_EQ(bitmap.contains(value), expected.contains(value));
+      }
+    }
+  }
+}
+
+}  // namespace
+
+}  // namespace valkey_search::utils
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2025, valkey-search contributors
+ * All rights reserved.
+ * SPDX-License-Identifier: BSD 3-Clause
+ *
+ */
+
+#include "src/utils/counted_btree.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace valkey_search::utils {
+
+namespace {
+
+using Tree = CountedBTree<double, int>;
+
+std::vector<double> Keys(const Tree &tree) {
+  std::vector<double> keys;
+  for (auto it = tree.begin(); it != tree.end(); ++it) {
+    keys.push_back(it.key());
+  }
+  return keys;
+}
+
+std::vector<double> ReversedKeys(const Tree &tree) {
+  std::vector<double> keys;
+  for (auto it = tree.Last(); it != tree.end(); --it) {
+    keys.push_back(it.key());
+  }
+  return keys;
+}
+
+TEST(CountedBTreeTest, SimpleAddRemove) {
+  Tree tree;
+  EXPECT_TRUE(tree.Add(1.0, 1));
+  EXPECT_TRUE(tree.Add(0.0, 2));
+  EXPECT_TRUE(tree.Add(2.0, 3));
+  EXPECT_FALSE(tree.Add(2.0, 3));
+  EXPECT_EQ(tree.Size(), 3);
+  EXPECT_THAT(Keys(tree), testing::ElementsAre(0.0, 1.0, 2.0));
+  EXPECT_THAT(ReversedKeys(tree), testing::ElementsAre(2.0, 1.0, 0.0));
+  EXPECT_EQ(tree.Count(0.0, 2.0, false, false), 1);
+  EXPECT_EQ(tree.Count(0.0, 2.0, true, true), 3);
+  EXPECT_EQ(tree.Count(2.0, 0.0, true, true), 0);
+
+  EXPECT_FALSE(tree.Remove(1.0, 2));
+  EXPECT_TRUE(tree.Remove(1.0, 1));
+  EXPECT_FALSE(tree.Remove(1.0, 1));
+  EXPECT_THAT(Keys(tree), testing::ElementsAre(0.0, 2.0));
+  EXPECT_EQ(tree.Count(0.0, 2.0, true, true), 2);
+  EXPECT_TRUE(tree.Remove(0.0, 2));
+  EXPECT_TRUE(tree.Remove(2.0, 3));
+  EXPECT_EQ(tree.Size(), 0);
+  EXPECT_TRUE(tree.begin() == tree.end());
+  EXPECT_TRUE(tree.Last() == tree.end());
+  EXPECT_EQ(tree.GetHeight(), 0);
+}
+
+TEST(CountedBTreeTest, Postings) {
+  Tree tree;
+  // The values of a key go from inline, to an array, to a hash set, and back.
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(tree.Add(1.0, i));
+    EXPECT_EQ(tree.LowerBound(1.0).values().size(), i + 1);
+  }
+  EXPECT_TRUE(tree.LowerBound(1.0).values().contains(50));
+  for (int i = 99; i > 0; --i) {
+    EXPECT_TRUE(tree.Remove(1.0, i));
+    const auto &values = tree.LowerBound(1.0).values();
+    EXPECT_EQ(std::set<int>(values.begin(), values.end()).size(), i);
+  }
+  EXPECT_THAT(tree.LowerBound(1.0).values(), testing::ElementsAre(0));
+  EXPECT_EQ(tree.Count(1.0, 1.0, true, true), 1);
+}
+
+TEST(CountedBTreeTest, Bounds) {
+  Tree tree;
+  for (int i = 0; i < 1000; ++i) {
+    tree.Add(i * 2, i);
+  }
+  EXPECT_GT(tree.GetHeight(), 1);
+  EXPECT_EQ(tree.LowerBound(10).key(), 10);
+  EXPECT_EQ(tree.LowerBound(11).key(), 12);
+  EXPECT_EQ(tree.UpperBound(10).key(), 12);
+  EXPECT_EQ(tree.LowerBound(-1).key(), 0);
+  EXPECT_TRUE(tree.LowerBound(1999) == tree.end());
+  EXPECT_TRUE(tree.UpperBound(1998) == tree.end());
+  EXPECT_EQ(tree.Count(100, 200, true, true), 51);
+  EXPECT_EQ(tree.Count(100, 200, false, false), 49);
+  EXPECT_EQ(tree.Count(-10, 10000, false, false), 1000);
+}
+
+// Compares the tree with a map of sets over random additions and removals,
+// which split, merge and rebalance the nodes.
+TEST(CountedBTreeTest, RandomOperations) {
+  for (int keyspace : {50, 10000}) {
+    Tree tree;
+    std::map<double, std::set<int>> expected;
+    std::mt19937 gen(keyspace);
+    for (int step = 0; step < 40000; ++step) {
+      double key = gen() % keyspace;
+      int value = gen() % 16;
+      if (gen() % 100 < (step < 20000 ? 70 : 30)) {
+        EXPECT_EQ(tree.Add(key, value), expected[key].insert(value).second);
+      } else {
+        bool removed = false;
+        if (auto it = expected.find(key); it != expected.end()) {
+          removed = it->second.erase(value);
+          if (it->second.empty()) {
+            expected.erase(it);
+          }
+        }
+        EXPECT_EQ(tree.Remove(key, value), removed);
+      }
+      if (step % 1000 != 0) {
+        continue;
+      }
+      auto expected_it = expected.begin();
+      size_t size = 0;
+      for (auto it = tree.begin(); it != tree.end(); ++it, ++expected_it) {
+        ASSERT_NE(expected_it, expected.end());
+        EXPECT_EQ(it.key(), expected_it->first);
+        EXPECT_EQ(std::set<int>(it.values().begin(), it.values().end()),
+                  expected_it->second);
+        size += expected_it->second.size();
+      }
+      EXPECT_EQ(expected_it, expected.end());
+      EXPECT_EQ(tree.Size(), size);
+      auto reversed = Keys(tree);
+      std::reverse(reversed.begin(), reversed.end());
+      EXPECT_EQ(ReversedKeys(tree), reversed);
+      double start = gen() % keyspace;
+      double end = start + gen() % keyspace;
+      uint64_t count = 0;
+      for (auto it = expected.lower_bound(start);
+           it != expected.end() && it->first <= end; ++it) {
+        count += it->second.size();
+      }
+      EXPECT_EQ(tree.Count(start, end, true, true), count);
+    }
+  }
+}
+
+// Integer keys are stored as offsets in the leaves whose keys span less than
+// 2^32, and whole in the others. Mixes both, and the limits of the int64 range.
+TEST(CountedBTreeTest, RandomIntegerOperations) {
+  CountedBTree<int64_t, int> tree;
+  std::map<int64_t, std::set<int>> expected;
+  std::mt19937_64 gen(23);
+  constexpr int64_t kBase = 1700000000000000000;
+  auto random_key = [&gen]() -> int64_t {
+    switch (gen() % 4) {
+      case 0:
+        return kBase + static_cast<int64_t>(gen() % 5000);
+      case 1:
+        return kBase + static_cast<int64_t>(gen() % 5000) * (int64_t{1} << 30);
+      case 2:
+        return gen() % 2 == 0 ? std::numeric_limits<int64_t>::min() +
+                                    static_cast<int64_t>(gen() % 100)
+                              : std::numeric_limits<int64_t>::max() -
+                                    static_cast<int64_t>(gen() % 100);
+      default:
+        return static_cast<int64_t>(gen());
+    }
+  };
+  for (int step = 0; step < 40000; ++step) {
+    int64_t key = random_key();
+    int value = gen() % 4;
+    if (gen() % 100 < (step < 20000 ? 70 : 30)) {
+      EXPECT_EQ(tree.Add(key, value), expected[key].insert(value).second);
+    } else {
+      // Mostly removes existing keys, whose random draw is unlikely.
+      if (!expected.empty() && gen() % 4 != 0) {
+        key = expected.lower_bound(key) == expected.end()
+                  ? expected.begin()->first
+                  : expected.lower_bound(key)->first;
+      }
+      bool removed = false;
+      if (auto it = expected.find(key); it != expected.end()) {
+        removed = it->second.erase(value);
+        if (it->second.empty()) {
+          expected.erase(it);
+        }
+      }
+      EXPECT_EQ(tree.Remove(key, value), removed);
+    }
+    if (step % 1000 != 0) {
+      continue;
+    }
+    std::vector<int64_t> keys;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+      keys.push_back(it.key());
+    }
+    std::vector<int64_t> expected_keys;
+    for (const auto &[expected_key, _] : expected) {
+      expected_keys.push_back(expected_key);
+    }
+    EXPECT_EQ(keys, expected_keys);
+    int64_t start = random_key();
+    int64_t end = std::max(start, random_key());
+    uint64_t count = 0;
+    for (auto it = expected.lower_bound(start);
+         it != expected.end() && it->first <= end; ++it) {
+      count += it->second.size();
+    }
+    EXPECT_EQ(tree.Count(start, end, true, true), count);
+    auto lower = expected.lower_bound(start);
+    if (lower == expected.end()) {
+      EXPECT_TRUE(tree.LowerBound(start) == tree.end());
+    } else {
+      EXPECT_EQ(tree.LowerBound(start).key(), lower->first);
+    }
+    auto upper = expected.upper_bound(start);
+    if (upper == expected.end()) {
+      EXPECT_TRUE(tree.UpperBound(start) == tree.end());
+    } else {
+      EXPECT_EQ(tree.UpperBound(start).key(), upper->first);
+    }
+  }
+}
+
+}  // namespace
+
+}  // namespace valkey_search::utils
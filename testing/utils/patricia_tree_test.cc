@@ -7,7 +7,9 @@
 
 #include "src/utils/patricia_tree.h"
 
+#include <string>
 #include <unordered_set>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -184,5 +186,55 @@ TEST_F(PatriciaTreeSetTest, TriePathIterator) {
   }
   EXPECT_EQ(got, expected);
 }
+
+// Grows the children of the root through every layout and shrinks them back.
+TEST_F(PatriciaTreeSetTest, ManyChildren) {
+  std::vector<std::string> keys;
+  for (int byte = 1; byte < 256; ++byte) {
+    keys.push_back(std::string(1, static_cast<char>(byte)) + "x");
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    tree_case_sensitive_->AddKeyValue(keys[i], i);
+    for (size_t j = 0; j <= i; j += 7) {
+      EXPECT_THAT(*tree_case_sensitive_->GetValue(keys[j], true),
+                  testing::UnorderedElementsAre(j));
+    }
+  }
+  EXPECT_EQ(tree_case_sensitive_->GetQualifiedElementsCount("", false),
+            keys.size());
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    EXPECT_TRUE(tree_case_sensitive_->Remove(keys[i], i));
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    EXPECT_EQ(tree_case_sensitive_->HasKey(keys[i]), i % 2 == 1);
+  }
+  for (size_t i = 1; i < keys.size(); i += 2) {
+    EXPECT_TRUE(tree_case_sensitive_->Remove(keys[i], i));
+    for (size_t j = i + 2; j < keys.size(); j += 14) {
+      EXPECT_THAT(*tree_case_sensitive_->GetValue(keys[j], false),
+                  testing::UnorderedElementsAre(j));
+    }
+  }
+  EXPECT_EQ(tree_case_sensitive_->GetQualifiedElementsCount("", false), 0);
+  EXPECT_TRUE(tree_case_sensitive_->RootIterator().Done());
+}
+
+TEST_F(PatriciaTreeSetTest, ChildrenCaseInsensitive) {
+  for (char c = 'a'; c <= 'z'; ++c) {
+    tree_->AddKeyValue(std::string(1, c) + "bc", c);
+  }
+  tree_->AddKeyValue("ABD", 0);
+  EXPECT_THAT(*tree_->GetValue("aBc", true),
+              testing::UnorderedElementsAre('a'));
+  EXPECT_THAT(*tree_->GetValue("abd", true), testing::UnorderedElementsAre(0));
+  EXPECT_EQ(tree_->GetQualifiedElementsCount("Ab", false), 2);
+  EXPECT_TRUE(tree_->Remove("Zbc", 'z'));
+  EXPECT_FALSE(tree_->HasKey("zbc"));
+  int cnt = 0;
+  for (auto itr = tree_->RootIterator(); !itr.Done(); itr.Next()) {
+    cnt++;
+  }
+  EXPECT_EQ(cnt, 26);
+}
 }  // namespace
 }  // namespace valkey_search
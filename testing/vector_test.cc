@@ -5,6 +5,9 @@
  *
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <deque>
@@ -12,11 +15,13 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
@@ -26,12 +31,18 @@
 #include "src/attribute_data_type.h"
 #include "src/index_schema.pb.h"
 #include "src/indexes/index_base.h"
+#include "src/indexes/product_quantizer.h"
 #include "src/indexes/vector_base.h"
 #include "src/indexes/vector_flat.h"
 #include "src/indexes/vector_hnsw.h"
+#include "src/indexes/vector_ivf.h"
 #include "src/utils/cancel.h"
 #include "src/utils/string_interning.h"
+#include "src/valkey_search_options.h"
 #include "testing/common.h"
+#include "third_party/hnswlib/hnswalg.h"
+#include "third_party/hnswlib/simsimd.h"
+#include "third_party/hnswlib/space_half.h"
 #include "third_party/hnswlib/space_ip.h"
 #include "third_party/hnswlib/space_l2.h"
 #include "vmsdk/src/managed_pointers.h"
@@ -46,6 +57,10 @@ constexpr static uint32_t kBlockSize = 250;
 constexpr static int kM = 16;
 constexpr static int kEFConstruction = 20;
 constexpr static int kEFRuntime = 20;
+constexpr static uint32_t kNlist = 16;
+constexpr static uint32_t kNprobe = 4;
+constexpr static uint32_t kPqM = 25;
+constexpr static uint32_t kPqRerank = 4;
 const hnswlib::InnerProductSpace kInnerProductSpace{kDimensions};
 const hnswlib::L2Space kL2Space{kDimensions};
 const absl::flat_hash_map<data_model::DistanceMetric, std::string>
@@ -65,6 +80,33 @@ class VectorIndexTest : public ValkeySearchTest {
   HashAttributeDataType hash_attribute_data_type_;
 };
 
+// Passes the vectors whose internal id is a multiple of `modulus`.
+class ModulusFilter : public hnswlib::BaseFilterFunctor {
+ public:
+  explicit ModulusFilter(uint64_t modulus) : modulus_(modulus) {}
+  bool operator()(hnswlib::labeltype id) override {
+    return id % modulus_ == 0;
+  }
+
+ private:
+  uint64_t modulus_;
+};
+
+// Counts the calls, which the filtered traversal makes once per element it
+// visits.
+class CountingModulusFilter : public ModulusFilter {
+ public:
+  CountingModulusFilter(uint64_t modulus, size_t* calls)
+      : ModulusFilter(modulus), calls_(calls) {}
+  bool operator()(hnswlib::labeltype id) override {
+    ++*calls_;
+    return ModulusFilter::operator()(id);
+  }
+
+ private:
+  size_t* calls_;
+};
+
 void TestInitializationHNSW(int dimensions,
                             data_model::DistanceMetric distance_metric,
                             const std::string& distance_metric_name,
@@ -300,6 +342,388 @@ TEST_F(VectorIndexTest, BasicFlat) {
   }
 }
 
+TEST_F(VectorIndexTest, BatchFlat) {
+  for (auto& distance_metric :
+       {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
+    auto index = VectorFlat<float>::Create(
+        CreateFlatVectorIndexProto(kDimensions, distance_metric, kInitialCap,
+                                   kBlockSize),
+        "attribute_identifier_1",
+        data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+    VMSDK_EXPECT_OK(index);
+    // Spans several blocks of the batched scan, the last one partial.
+    auto vectors = DeterministicallyGenerateVectors(300, kDimensions, 10.0);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      VerifyAdd(index->get(), vectors, i, ExpectedResults::kSuccess);
+    }
+    std::vector<absl::string_view> queries;
+    for (size_t i = 0; i < vectors.size(); i += 60) {
+      queries.push_back(VectorToStr(vectors[i]));
+    }
+    auto batch_res = (*index)->SearchBatch(queries, 10, CancelNever());
+    VMSDK_EXPECT_OK(batch_res);
+    ASSERT_EQ(batch_res->size(), queries.size());
+    for (size_t q = 0; q < queries.size(); ++q) {
+      auto res = (*index)->Search(queries[q], 10, CancelNever());
+      VMSDK_EXPECT_OK(res);
+      ASSERT_EQ((*batch_res)[q].size(), res->size());
+      for (size_t i = 0; i < res->size(); ++i) {
+        EXPECT_EQ((*batch_res)[q][i].external_id, (*res)[i].external_id);
+        EXPECT_FLOAT_EQ((*batch_res)[q][i].distance, (*res)[i].distance);
+      }
+    }
+
+    auto small_vectors =
+        DeterministicallyGenerateVectors(1, kDimensions - 1, 1.0);
+    queries.push_back(VectorToStr(small_vectors[0]));
+    EXPECT_FALSE((*index)->SearchBatch(queries, 10, CancelNever()).ok());
+  }
+}
+
+TEST_F(VectorIndexTest, BasicIVF) {
+  for (auto& distance_metric :
+       {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
+    auto index = VectorIVF<float>::Create(
+        CreateIVFVectorIndexProto(kDimensions, distance_metric, kNlist,
+                                  kNprobe),
+        "attribute_identifier_1",
+        data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+    VMSDK_EXPECT_OK(index);
+    EXPECT_EQ((*index)->GetNlist(), kNlist);
+    EXPECT_EQ((*index)->GetNprobe(), kNprobe);
+    TestIndex<VectorIVF<float>>(index->get(), kDimensions, 100);
+    // 100 vectors are not enough to train 16 lists, so every search is
+    // exhaustive.
+    EXPECT_FALSE((*index)->IsTrained());
+  }
+}
+
+template <typename T>
+std::string VectorToHalfStr(const std::vector<float>& vector) {
+  std::string result;
+  result.reserve(vector.size() * sizeof(T));
+  for (float value : vector) {
+    T element = hnswlib::FromFloat<T>(value);
+    result.append((const char*)&element, sizeof(T));
+  }
+  return result;
+}
+
+template <typename IndexT, typename T>
+void TestHalfPrecisionIndex(IndexT* index,
+                            data_model::VectorDataType data_type) {
+  EXPECT_EQ(index->GetDataTypeSize(), sizeof(T));
+  EXPECT_EQ(index->GetDataType(), data_type);
+  EXPECT_EQ(index->ToProto()->vector_index().vector_data_type(), data_type);
+  auto vectors = DeterministicallyGenerateVectors(100, kDimensions, 10.0);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    VMSDK_EXPECT_OK(
+        index->AddRecord(IndexToKey(i), VectorToHalfStr<T>(vectors[i])));
+  }
+  // A FLOAT32 sized blob does not match a half-precision index.
+  EXPECT_FALSE(index->Search(VectorToStr(vectors[0]), 10, CancelNever()).ok());
+  for (size_t i = 1; i < vectors.size() - 1; ++i) {
+    auto res = index->Search(VectorToHalfStr<T>(vectors[i]), 10, CancelNever());
+    VMSDK_EXPECT_OK(res);
+    bool found = false;
+    for (const auto& neighbor : res.value()) {
+      if (neighbor.external_id == IndexToKey(i)) {
+        EXPECT_LT(neighbor.distance - res.value()[0].distance, 0.001);
+        found = true;
+        break;
+      }
+    }
+    EXPECT_TRUE(found);
+  }
+  auto value = index->GetValue(IndexToKey(1));
+  VMSDK_EXPECT_OK(value);
+  EXPECT_EQ(value->size(), kDimensions * sizeof(T));
+}
+
+TEST_F(VectorIndexTest, HalfPrecisionHNSW) {
+  for (auto& distance_metric :
+       {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
+    auto fp16_index = VectorHNSW<hnswlib::float16>::Create(
+        CreateHNSWVectorIndexProto(kDimensions, distance_metric, kInitialCap,
+                                   kM, kEFConstruction, kEFRuntime),
+        "attribute_identifier_1",
+        data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+    VMSDK_EXPECT_OK(fp16_index);
+    TestHalfPrecisionIndex<VectorHNSW<hnswlib::float16>, hnswlib::float16>(
+        fp16_index->get(), data_model::VECTOR_DATA_TYPE_FLOAT16);
+    auto bf16_index = VectorHNSW<hnswlib::bfloat16>::Create(
+        CreateHNSWVectorIndexProto(kDimensions, distance_metric, kInitialCap,
+                                   kM, kEFConstruction, kEFRuntime),
+        "attribute_identifier_1",
+        data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+    VMSDK_EXPECT_OK(bf16_index);
+    TestHalfPrecisionIndex<VectorHNSW<hnswlib::bfloat16>, hnswlib::bfloat16>(
+        bf16_index->get(), data_model::VECTOR_DATA_TYPE_BFLOAT16);
+  }
+}
+
+TEST_F(VectorIndexTest, HalfPrecisionFlat) {
+  for (auto& distance_metric :
+       {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
+    auto fp16_index = VectorFlat<hnswlib::float16>::Create(
+        CreateFlatVectorIndexProto(kDimensions, distance_metric, kInitialCap,
+                                   kBlockSize),
+        "attribute_identifier_1",
+        data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+    VMSDK_EXPECT_OK(fp16_index);
+    TestHalfPrecisionIndex<VectorFlat<hnswlib::float16>, hnswlib::float16>(
+        fp16_index->get(), data_model::VECTOR_DATA_TYPE_FLOAT16);
+    auto bf16_index = VectorFlat<hnswlib::bfloat16>::Create(
+        CreateFlatVectorIndexProto(kDimensions, distance_metric, kInitialCap,
+                                   kBlockSize),
+        "attribute_identifier_1",
+        data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+    VMSDK_EXPECT_OK(bf16_index);
+    TestHalfPrecisionIndex<VectorFlat<hnswlib::bfloat16>, hnswlib::bfloat16>(
+        bf16_index->get(), data_model::VECTOR_DATA_TYPE_BFLOAT16);
+  }
+}
+
+TEST_F(VectorIndexTest, HalfPrecisionConversions) {
+  for (float value : {0.0f, 1.0f, -2.5f, 0.1f, 1024.0f, -65504.0f}) {
+    EXPECT_NEAR(hnswlib::ToFloat(hnswlib::FromFloat<hnswlib::float16>(value)),
+                value, std::abs(value) / 1024.0f);
+    EXPECT_NEAR(hnswlib::ToFloat(hnswlib::FromFloat<hnswlib::bfloat16>(value)),
+                value, std::abs(value) / 128.0f);
+  }
+  EXPECT_TRUE(std::isinf(
+      hnswlib::ToFloat(hnswlib::FromFloat<hnswlib::float16>(70000.0f))));
+}
+
+TEST_F(VectorIndexTest, DistanceKernelsMatchSerial) {
+  // Not a multiple of the SIMD widths, to cover the tails of the kernels.
+  constexpr size_t kDim = 100;
+  std::vector<float> lhs(kDim);
+  std::vector<float> rhs(kDim);
+  for (size_t i = 0; i < kDim; ++i) {
+    lhs[i] = std::sin(i * 0.37f);
+    rhs[i] = std::cos(i * 0.11f);
+  }
+  std::vector<hnswlib::float16> lhs_f16, rhs_f16;
+  std::vector<hnswlib::bfloat16> lhs_bf16, rhs_bf16;
+  for (size_t i = 0; i < kDim; ++i) {
+    lhs_f16.push_back(hnswlib::FromFloat<hnswlib::float16>(lhs[i]));
+    rhs_f16.push_back(hnswlib::FromFloat<hnswlib::float16>(rhs[i]));
+    lhs_bf16.push_back(hnswlib::FromFloat<hnswlib::bfloat16>(lhs[i]));
+    rhs_bf16.push_back(hnswlib::FromFloat<hnswlib::bfloat16>(rhs[i]));
+  }
+  auto expect_matches_serial = [](const hnswlib::DistanceKernel& kernel,
+                                  simsimd_metric_kind_t kind,
+                                  simsimd_datatype_t datatype, const void* a,
+                                  const void* b, size_t n) {
+    auto serial =
+        hnswlib::FindDistanceKernel(kind, datatype, simsimd_cap_serial_k);
+    ASSERT_NE(kernel.metric, nullptr);
+    ASSERT_NE(serial.metric, nullptr);
+    simsimd_distance_t expected;
+    simsimd_distance_t actual;
+    serial.metric(a, b, n, &expected);
+    kernel.metric(a, b, n, &actual);
+    EXPECT_NEAR(actual, expected, 1e-2 * std::max(1.0, std::abs(expected)))
+        << hnswlib::GetCapabilityName(kernel.capability);
+  };
+  const auto& kernels = hnswlib::distance_kernels;
+  expect_matches_serial(kernels.l2sq_f32, simsimd_metric_l2sq_k,
+                        simsimd_datatype_f32_k, lhs.data(), rhs.data(), kDim);
+  expect_matches_serial(kernels.dot_f32, simsimd_metric_dot_k,
+                        simsimd_datatype_f32_k, lhs.data(), rhs.data(), kDim);
+  expect_matches_serial(kernels.l2sq_f16, simsimd_metric_l2sq_k,
+                        simsimd_datatype_f16_k, lhs_f16.data(),
+                        rhs_f16.data(), kDim);
+  expect_matches_serial(kernels.dot_f16, simsimd_metric_dot_k,
+                        simsimd_datatype_f16_k, lhs_f16.data(),
+                        rhs_f16.data(), kDim);
+  expect_matches_serial(kernels.l2sq_bf16, simsimd_metric_l2sq_k,
+                        simsimd_datatype_bf16_k, lhs_bf16.data(),
+                        rhs_bf16.data(), kDim);
+  expect_matches_serial(kernels.dot_bf16, simsimd_metric_dot_k,
+                        simsimd_datatype_bf16_k, lhs_bf16.data(),
+                        rhs_bf16.data(), kDim);
+  // The float32 bytes double as binary vectors of kDim * 32 bits.
+  expect_matches_serial(kernels.hamming_b8, simsimd_metric_hamming_k,
+                        simsimd_datatype_b8_k, lhs.data(), rhs.data(),
+                        kDim * sizeof(float));
+}
+
+TEST_F(VectorIndexTest, NormalizeStringRecordHalfPrecision) {
+  auto index = VectorHNSW<hnswlib::float16>::Create(
+      CreateHNSWVectorIndexProto(3, data_model::DISTANCE_METRIC_L2,
+                                 kInitialCap, kM, kEFConstruction, kEFRuntime),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_JSON);
+  auto norm_record = index.value()->NormalizeStringRecord(
+      vmsdk::MakeUniqueValkeyString("[0.5, -1, 2]"));
+  auto norm_record_str = vmsdk::ToStringView(norm_record.get());
+  ASSERT_EQ(norm_record_str.size(), 3 * sizeof(hnswlib::float16));
+  auto* values = (const hnswlib::float16*)norm_record_str.data();
+  EXPECT_FLOAT_EQ(hnswlib::ToFloat(values[0]), 0.5f);
+  EXPECT_FLOAT_EQ(hnswlib::ToFloat(values[1]), -1.0f);
+  EXPECT_FLOAT_EQ(hnswlib::ToFloat(values[2]), 2.0f);
+}
+
+constexpr static int kBinaryDimensions = 128;
+
+// Deterministic, well spread binary vectors of kBinaryDimensions bits.
+std::vector<std::string> GenerateBinaryVectors(int size) {
+  std::vector<std::string> result(size);
+  uint64_t state = 0x9e3779b97f4a7c15;
+  for (auto& vector : result) {
+    for (int i = 0; i < kBinaryDimensions / 8; ++i) {
+      state = state * 6364136223846793005 + 1442695040888963407;
+      vector.push_back(static_cast<char>(state >> 56));
+    }
+  }
+  return result;
+}
+
+template <typename IndexT>
+void TestBinaryIndex(IndexT* index) {
+  EXPECT_EQ(index->GetDataType(), data_model::VECTOR_DATA_TYPE_BINARY);
+  EXPECT_EQ(index->GetVectorDataSize(), kBinaryDimensions / 8);
+  auto vectors = GenerateBinaryVectors(200);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    VMSDK_EXPECT_OK(index->AddRecord(IndexToKey(i), vectors[i]));
+  }
+  // A vector with one byte per dimension does not match a binary index.
+  EXPECT_FALSE(index
+                   ->Search(std::string(kBinaryDimensions, '\0'), 10,
+                            CancelNever())
+                   .ok());
+  for (size_t i = 0; i < vectors.size(); i += 7) {
+    std::string query = vectors[i];
+    // Flip 3 bits, the vector is still the nearest one.
+    query[0] ^= 0x01;
+    query[5] ^= 0x10;
+    query[9] ^= 0x80;
+    auto res = index->Search(query, 5, CancelNever());
+    VMSDK_EXPECT_OK(res);
+    ASSERT_FALSE(res->empty());
+    EXPECT_EQ(res->at(0).external_id, IndexToKey(i));
+    EXPECT_FLOAT_EQ(res->at(0).distance, 3.0f);
+  }
+  auto value = index->GetValue(IndexToKey(1));
+  VMSDK_EXPECT_OK(value);
+  EXPECT_EQ(std::string(value->begin(), value->end()), vectors[1]);
+}
+
+TEST_F(VectorIndexTest, BinaryHNSW) {
+  auto index = VectorHNSW<hnswlib::bit8>::Create(
+      CreateHNSWVectorIndexProto(kBinaryDimensions,
+                                 data_model::DISTANCE_METRIC_HAMMING,
+                                 kInitialCap, kM, kEFConstruction, kEFRuntime),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  VMSDK_EXPECT_OK(index);
+  TestBinaryIndex(index->get());
+}
+
+TEST_F(VectorIndexTest, BinaryFlat) {
+  auto index = VectorFlat<hnswlib::bit8>::Create(
+      CreateFlatVectorIndexProto(kBinaryDimensions,
+                                 data_model::DISTANCE_METRIC_HAMMING,
+                                 kInitialCap, kBlockSize),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  VMSDK_EXPECT_OK(index);
+  TestBinaryIndex(index->get());
+}
+
+TEST_F(VectorIndexTest, NormalizeStringRecordBinary) {
+  auto index = VectorFlat<hnswlib::bit8>::Create(
+      CreateFlatVectorIndexProto(16, data_model::DISTANCE_METRIC_HAMMING,
+                                 kInitialCap, kBlockSize),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_JSON);
+  auto norm_record = index.value()->NormalizeStringRecord(
+      vmsdk::MakeUniqueValkeyString(
+          "[1, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1]"));
+  EXPECT_EQ(vmsdk::ToStringView(norm_record.get()), "\x81\x55");
+  // Elements must be bits, and fill whole bytes.
+  EXPECT_EQ(index.value()->NormalizeStringRecord(
+                vmsdk::MakeUniqueValkeyString("[1, 0, 2, 0, 0, 0, 0, 1]")),
+            nullptr);
+  EXPECT_EQ(index.value()->NormalizeStringRecord(
+                vmsdk::MakeUniqueValkeyString("[1, 0, 1]")),
+            nullptr);
+}
+
+TEST_F(VectorIndexTest, MultiVectorJSON) {
+  auto index = VectorFlat<float>::Create(
+      CreateFlatVectorIndexProto(3, data_model::DISTANCE_METRIC_L2, kInitialCap,
+                                 kBlockSize),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_JSON);
+  // A JSON path matching several arrays, once the outer brackets are removed.
+  auto norm_record = index.value()->NormalizeStringRecord(
+      vmsdk::MakeUniqueValkeyString("[0, 0, 0], [10, 10, 10]"));
+  EXPECT_EQ(vmsdk::ToStringView(norm_record.get()),
+            std::string(VectorToStr({0, 0, 0})) +
+                std::string(VectorToStr({10, 10, 10})));
+  // Each of the arrays must have as many elements as the index dimensions.
+  EXPECT_EQ(index.value()->NormalizeStringRecord(
+                vmsdk::MakeUniqueValkeyString("[0, 0, 0], [10, 10]")),
+            nullptr);
+  // A single array is not split into vectors either.
+  EXPECT_EQ(index.value()->NormalizeStringRecord(
+                vmsdk::MakeUniqueValkeyString("[0, 0, 0, 10, 10, 10]")),
+            nullptr);
+
+  VMSDK_EXPECT_OK(index.value()->AddRecord(
+      StringInternStore::Intern("a"), vmsdk::ToStringView(norm_record.get())));
+  VMSDK_EXPECT_OK(index.value()->AddRecord(StringInternStore::Intern("b"),
+                                           VectorToStr({1, 1, 1})));
+  VMSDK_EXPECT_OK(index.value()->AddRecord(StringInternStore::Intern("c"),
+                                           VectorToStr({5, 5, 5})));
+  EXPECT_EQ(index.value()->GetTrackedKeyCount(), 3);
+  EXPECT_TRUE(absl::IsUnimplemented(
+      index.value()->GetValue(StringInternStore::Intern("a")).status()));
+
+  // A key is as close as its closest vector, and is returned once.
+  auto search = [&](const std::vector<float>& query, uint64_t k) {
+    std::vector<std::string> keys;
+    auto res = index.value()->Search(VectorToStr(query), k, CancelNever());
+    VMSDK_EXPECT_OK(res);
+    for (const auto& neighbor : *res) {
+      keys.push_back(std::string(neighbor.external_id->Str()));
+    }
+    return keys;
+  };
+  EXPECT_THAT(search({10, 10, 10}, 2), testing::ElementsAre("a", "c"));
+  EXPECT_THAT(search({0, 0, 0}, 3), testing::ElementsAre("a", "b", "c"));
+  EXPECT_THAT(search({0, 0, 0}, 1), testing::ElementsAre("a"));
+
+  // Modifying the key replaces all of its vectors.
+  VMSDK_EXPECT_OK(index.value()->ModifyRecord(StringInternStore::Intern("a"),
+                                              VectorToStr({20, 20, 20})));
+  EXPECT_THAT(search({0, 0, 0}, 3), testing::ElementsAre("b", "c", "a"));
+  VMSDK_EXPECT_OK(index.value()->ModifyRecord(
+      StringInternStore::Intern("b"), vmsdk::ToStringView(norm_record.get())));
+  EXPECT_THAT(search({10, 10, 10}, 3), testing::ElementsAre("b", "c", "a"));
+  VMSDK_EXPECT_OK(index.value()->RemoveRecord(StringInternStore::Intern("b")));
+  EXPECT_FALSE(index.value()->IsTracked(StringInternStore::Intern("b")));
+  EXPECT_THAT(search({10, 10, 10}, 3), testing::ElementsAre("c", "a"));
+
+  // A key with more of the nearest vectors than the first search fetches
+  // widens the search.
+  std::string many_vectors;
+  for (int i = 0; i < 40; ++i) {
+    many_vectors += VectorToStr({0, 0, 0.01f * i});
+  }
+  VMSDK_EXPECT_OK(
+      index.value()->AddRecord(StringInternStore::Intern("d"), many_vectors));
+  EXPECT_GT(index.value()->GetSearchCount(2), 2);
+  EXPECT_THAT(search({0, 0, 0}, 2), testing::ElementsAre("d", "c"));
+  // Searches are sized for single vector keys again once none has several.
+  VMSDK_EXPECT_OK(index.value()->RemoveRecord(StringInternStore::Intern("d")));
+  EXPECT_EQ(index.value()->GetSearchCount(2), 2);
+  EXPECT_THAT(search({0, 0, 0}, 2), testing::ElementsAre("c", "a"));
+}
+
 TEST_F(VectorIndexTest, ResizeHNSW) ABSL_NO_THREAD_SAFETY_ANALYSIS {
   for (auto& distance_metric :
        {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
@@ -334,6 +758,27 @@ TEST_F(VectorIndexTest, ResizeHNSW) ABSL_NO_THREAD_SAFETY_ANALYSIS {
   }
 }
 
+TEST_F(VectorIndexTest, ReserveCapacityHNSW) ABSL_NO_THREAD_SAFETY_ANALYSIS {
+  const int initial_cap = 10;
+  auto index = VectorHNSW<float>::Create(
+      CreateHNSWVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kM, kEFConstruction, kEFRuntime),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  ValkeySearch::Instance().SetHNSWBlockSize(1024);
+  uint32_t block_size = ValkeySearch::Instance().GetHNSWBlockSize();
+  VMSDK_EXPECT_OK(index.value()->ReserveCapacity(initial_cap));
+  EXPECT_EQ(index.value()->GetCapacity(), initial_cap);
+  auto vectors =
+      DeterministicallyGenerateVectors(block_size + 100, kDimensions, 10.0);
+  VMSDK_EXPECT_OK(index.value()->ReserveCapacity(vectors.size()));
+  EXPECT_EQ(index.value()->GetCapacity(), initial_cap + 2 * block_size);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    VerifyAdd(index->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  EXPECT_EQ(index.value()->GetCapacity(), initial_cap + 2 * block_size);
+}
+
 TEST_F(VectorIndexTest, ResizeFlat) ABSL_NO_THREAD_SAFETY_ANALYSIS {
   for (auto& distance_metric :
        {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
@@ -362,6 +807,94 @@ TEST_F(VectorIndexTest, ResizeFlat) ABSL_NO_THREAD_SAFETY_ANALYSIS {
   }
 }
 
+TEST_F(VectorIndexTest, ContiguousStorageFlat) {
+  // Spans two chunks of the contiguous vector storage.
+  const int num_vectors = 3000;
+  auto index = VectorFlat<float>::Create(
+      CreateFlatVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 num_vectors, kBlockSize),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  VMSDK_EXPECT_OK(index);
+  auto vectors =
+      DeterministicallyGenerateVectors(num_vectors, kDimensions, 10.0);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    VerifyAdd(index->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  // Every removal moves the last stored vector into the freed slot.
+  for (size_t i = 0; i < vectors.size(); i += 3) {
+    VMSDK_EXPECT_OK(
+        index.value()->RemoveRecord(IndexToKey(i), DeletionType::kNone));
+  }
+  for (size_t i = 1; i < vectors.size(); i += 97) {
+    auto value = index.value()->GetValue(IndexToKey(i));
+    if (i % 3 == 0) {
+      EXPECT_FALSE(value.ok());
+      continue;
+    }
+    VMSDK_EXPECT_OK(value);
+    EXPECT_EQ(absl::string_view(value->data(), value->size()),
+              VectorToStr(vectors[i]));
+    auto res = index.value()->Search(VectorToStr(vectors[i]), 10,
+                                     CancelNever());
+    VMSDK_EXPECT_OK(res);
+    ASSERT_EQ(res->size(), 10);
+    EXPECT_EQ(res->front().external_id, IndexToKey(i));
+    EXPECT_FLOAT_EQ(res->front().distance, 0);
+    // Modifications compare against the stored, possibly moved, vector.
+    auto unchanged =
+        index.value()->ModifyRecord(IndexToKey(i), VectorToStr(vectors[i]));
+    VMSDK_EXPECT_OK(unchanged);
+    EXPECT_FALSE(*unchanged);
+  }
+  auto modified =
+      index.value()->ModifyRecord(IndexToKey(1), VectorToStr(vectors[0]));
+  VMSDK_EXPECT_OK(modified);
+  EXPECT_TRUE(*modified);
+  auto value = index.value()->GetValue(IndexToKey(1));
+  VMSDK_EXPECT_OK(value);
+  EXPECT_EQ(absl::string_view(value->data(), value->size()),
+            VectorToStr(vectors[0]));
+}
+
+TEST_F(VectorIndexTest, ParallelSearchFlat) {
+  InitThreadPools(4, std::nullopt, std::nullopt);
+  const int num_vectors = 1000;
+  const uint64_t k = 10;
+  auto index = VectorFlat<float>::Create(
+      CreateFlatVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 num_vectors, kBlockSize),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  VMSDK_EXPECT_OK(index);
+  auto vectors =
+      DeterministicallyGenerateVectors(num_vectors, kDimensions, 10.0);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    VerifyAdd(index->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  auto search_vectors = DeterministicallyGenerateVectors(5, kDimensions, 7.5);
+  auto& range_size = options::GetExactSearchRangeSize();
+  auto default_range_size = range_size.GetValue();
+  for (const auto& search_vector : search_vectors) {
+    absl::string_view query = VectorToStr(search_vector);
+    VMSDK_EXPECT_OK(range_size.SetValue(0));
+    auto single_res = (*index)->Search(query, k, CancelNever());
+    // Split into ranges which are not a multiple of the scan block size.
+    VMSDK_EXPECT_OK(range_size.SetValue(150));
+    auto parallel_res = (*index)->Search(query, k, CancelNever(),
+                                         std::make_unique<ModulusFilter>(1));
+    VMSDK_EXPECT_OK(single_res);
+    VMSDK_EXPECT_OK(parallel_res);
+    ASSERT_EQ(parallel_res->size(), k);
+    ASSERT_EQ(single_res->size(), k);
+    for (size_t i = 0; i < k; ++i) {
+      EXPECT_EQ((*parallel_res)[i].external_id, (*single_res)[i].external_id);
+      EXPECT_FLOAT_EQ((*parallel_res)[i].distance, (*single_res)[i].distance);
+    }
+  }
+  VMSDK_EXPECT_OK(range_size.SetValue(default_range_size));
+}
+
 float CalcRecall(VectorFlat<float>* flat_index, VectorHNSW<float>* hnsw_index,
                  uint64_t k, int dimensions, std::optional<size_t> ef_runtime) {
   auto search_vectors = DeterministicallyGenerateVectors(50, dimensions, 1.5);
@@ -419,6 +952,459 @@ TEST_F(VectorIndexTest, EfRuntimeRecall) {
   }
 }
 
+TEST_F(VectorIndexTest, ConsolidateHNSW) ABSL_NO_THREAD_SAFETY_ANALYSIS {
+  const int initial_cap = 1000;
+  const uint64_t k = 10;
+  auto index_hnsw = VectorHNSW<float>::Create(
+      CreateHNSWVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kM, kEFConstruction, kEFRuntime),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  auto index_flat = VectorFlat<float>::Create(
+      CreateFlatVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kBlockSize),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  auto vectors =
+      DeterministicallyGenerateVectors(initial_cap, kDimensions, 2.2);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+    VerifyAdd(index_flat->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  EXPECT_FALSE((*index_hnsw)->ClaimConsolidation(0.2));
+
+  for (size_t i = 0; i < vectors.size(); i += 2) {
+    VMSDK_EXPECT_OK((*index_hnsw)->RemoveRecord(IndexToKey(i)));
+    VMSDK_EXPECT_OK((*index_flat)->RemoveRecord(IndexToKey(i)));
+  }
+  EXPECT_DOUBLE_EQ((*index_hnsw)->GetTombstoneRatio(), 0.5);
+  EXPECT_FALSE((*index_hnsw)->ClaimConsolidation(0.6));
+  EXPECT_TRUE((*index_hnsw)->ClaimConsolidation(0.2));
+  // A claimed consolidation is not scheduled twice.
+  EXPECT_FALSE((*index_hnsw)->ClaimConsolidation(0.2));
+
+  auto reclaimed_bytes = (*index_hnsw)->ConsolidateDeletes();
+  VMSDK_EXPECT_OK(reclaimed_bytes);
+  EXPECT_GE(*reclaimed_bytes, vectors.size() / 2 * kDimensions * sizeof(float));
+  EXPECT_EQ((*index_hnsw)->GetTombstoneRatio(), 0);
+  EXPECT_EQ((*index_hnsw)->GetCapacity(), initial_cap);
+  for (size_t i = 1; i < vectors.size(); i += 2) {
+    EXPECT_TRUE((*index_hnsw)->IsTracked(IndexToKey(i)));
+  }
+  for (size_t i = 1; i < vectors.size(); i += 50) {
+    auto res = (*index_hnsw)->Search(VectorToStr(vectors[i]), k, CancelNever());
+    VMSDK_EXPECT_OK(res);
+    EXPECT_EQ(res->size(), k);
+    EXPECT_EQ(res->front().external_id, IndexToKey(i));
+    for (const auto& neighbor : *res) {
+      EXPECT_TRUE((*index_hnsw)->IsTracked(neighbor.external_id));
+    }
+  }
+  EXPECT_GE(CalcRecall(index_flat->get(), index_hnsw->get(), k, kDimensions,
+                       kEFRuntime * 8),
+            0.96f);
+
+  // The reclaimed slots are reused without growing the graph.
+  for (size_t i = 0; i < vectors.size(); i += 2) {
+    VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+    VerifyAdd(index_flat->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  EXPECT_EQ((*index_hnsw)->GetCapacity(), initial_cap);
+  EXPECT_GE(CalcRecall(index_flat->get(), index_hnsw->get(), k, kDimensions,
+                       kEFRuntime * 8),
+            0.96f);
+}
+
+TEST_F(VectorIndexTest, ConsolidateHNSWInSteps) ABSL_NO_THREAD_SAFETY_ANALYSIS {
+  const int initial_cap = 1000;
+  const uint64_t k = 10;
+  auto index_hnsw = VectorHNSW<float>::Create(
+      CreateHNSWVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kM, kEFConstruction, kEFRuntime),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  auto index_flat = VectorFlat<float>::Create(
+      CreateFlatVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kBlockSize),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  auto vectors =
+      DeterministicallyGenerateVectors(initial_cap, kDimensions, 2.2);
+  for (size_t i = 0; i < vectors.size() * 3 / 4; ++i) {
+    VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+    VerifyAdd(index_flat->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  for (size_t i = 0; i < vectors.size() * 3 / 4; i += 2) {
+    VMSDK_EXPECT_OK((*index_hnsw)->RemoveRecord(IndexToKey(i)));
+    VMSDK_EXPECT_OK((*index_flat)->RemoveRecord(IndexToKey(i)));
+  }
+  EXPECT_TRUE((*index_hnsw)->ClaimConsolidation(0.2));
+  EXPECT_FALSE((*index_hnsw)->ClaimReorder(0));
+
+  // Records are added and removed between the steps, as when the schema lock
+  // is released. New elements may link to the deleted ones again.
+  size_t steps = 0;
+  size_t next = vectors.size() * 3 / 4;
+  for (bool repaired = false; !repaired; ++steps) {
+    auto status = (*index_hnsw)->RepairDeletedLinks(100);
+    VMSDK_EXPECT_OK(status);
+    repaired = *status;
+    if (!repaired && next < vectors.size()) {
+      for (size_t i = next; i < next + 25 && i < vectors.size(); ++i) {
+        VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+        VerifyAdd(index_flat->get(), vectors, i, ExpectedResults::kSuccess);
+      }
+      next += 25;
+      VMSDK_EXPECT_OK((*index_hnsw)->RemoveRecord(IndexToKey(steps * 2 + 1)));
+      VMSDK_EXPECT_OK((*index_flat)->RemoveRecord(IndexToKey(steps * 2 + 1)));
+    }
+  }
+  EXPECT_GT(steps, 1);
+  VMSDK_EXPECT_OK((*index_hnsw)->ConsolidateDeletes());
+  EXPECT_EQ((*index_hnsw)->GetTombstoneRatio(), 0);
+  for (size_t i = 1; i < vectors.size(); i += 50) {
+    auto res = (*index_hnsw)->Search(VectorToStr(vectors[i]), k, CancelNever());
+    VMSDK_EXPECT_OK(res);
+    EXPECT_EQ(res->size(), k);
+    for (const auto& neighbor : *res) {
+      EXPECT_TRUE((*index_hnsw)->IsTracked(neighbor.external_id));
+    }
+  }
+  EXPECT_GE(CalcRecall(index_flat->get(), index_hnsw->get(), k, kDimensions,
+                       kEFRuntime * 8),
+            0.96f);
+}
+
+TEST_F(VectorIndexTest, ReorderHNSW) ABSL_NO_THREAD_SAFETY_ANALYSIS {
+  const int initial_cap = 1000;
+  const uint64_t k = 10;
+  auto index_hnsw = VectorHNSW<float>::Create(
+      CreateHNSWVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kM, kEFConstruction, kEFRuntime),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  auto vectors =
+      DeterministicallyGenerateVectors(initial_cap, kDimensions, 2.2);
+  for (size_t i = 0; i < vectors.size() / 2; ++i) {
+    VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  EXPECT_FALSE((*index_hnsw)->ClaimReorder(1.0));
+  for (size_t i = vectors.size() / 2; i < vectors.size(); ++i) {
+    VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  // Deleted elements keep their tombstones through the reordering.
+  for (size_t i = 0; i < vectors.size(); i += 10) {
+    VMSDK_EXPECT_OK((*index_hnsw)->RemoveRecord(IndexToKey(i)));
+  }
+  std::vector<std::vector<Neighbor>> expected_results;
+  for (size_t i = 1; i < vectors.size(); i += 50) {
+    auto res = (*index_hnsw)->Search(VectorToStr(vectors[i]), k, CancelNever());
+    VMSDK_EXPECT_OK(res);
+    expected_results.push_back(*std::move(res));
+  }
+  EXPECT_TRUE((*index_hnsw)->ClaimReorder(1.0));
+  // A claimed reordering is not scheduled twice.
+  EXPECT_FALSE((*index_hnsw)->ClaimReorder(1.0));
+  VMSDK_EXPECT_OK((*index_hnsw)->ReorderForLocality());
+  // The index has not grown since.
+  EXPECT_FALSE((*index_hnsw)->ClaimReorder(1.0));
+
+  // The graph is the same up to the element numbering, so are the results.
+  EXPECT_DOUBLE_EQ((*index_hnsw)->GetTombstoneRatio(), 0.1);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    EXPECT_EQ((*index_hnsw)->IsTracked(IndexToKey(i)), i % 10 != 0);
+  }
+  for (size_t i = 1, j = 0; i < vectors.size(); i += 50, ++j) {
+    auto res = (*index_hnsw)->Search(VectorToStr(vectors[i]), k, CancelNever());
+    VMSDK_EXPECT_OK(res);
+    ASSERT_EQ(res->size(), expected_results[j].size());
+    for (size_t n = 0; n < res->size(); ++n) {
+      EXPECT_EQ((*res)[n].external_id->Str(),
+                expected_results[j][n].external_id->Str());
+    }
+  }
+}
+
+TEST_F(VectorIndexTest, ReorderHNSWCatchesUpWithMutations)
+ABSL_NO_THREAD_SAFETY_ANALYSIS {
+  const int initial_cap = 1000;
+  const uint64_t k = 10;
+  auto create = [&]() {
+    return VectorHNSW<float>::Create(
+        CreateHNSWVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                   initial_cap, kM, kEFConstruction,
+                                   kEFRuntime),
+        "attribute_identifier_1",
+        data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  };
+  // The same mutations are applied to an index which is not reordered.
+  auto index_hnsw = create();
+  auto reference = create();
+  auto vectors =
+      DeterministicallyGenerateVectors(initial_cap * 2, kDimensions, 2.2);
+  for (int i = 0; i < initial_cap; ++i) {
+    VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+    VerifyAdd(reference->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  EXPECT_TRUE((*index_hnsw)->ClaimReorder(1.0));
+  VMSDK_EXPECT_OK((*index_hnsw)->PrepareReorder());
+  // Deleted, modified and added records, the latter growing the index, while
+  // the reordered copy waits to be swapped in.
+  for (auto *index : {index_hnsw->get(), reference->get()}) {
+    for (int i = 0; i < initial_cap; i += 10) {
+      VMSDK_EXPECT_OK(index->RemoveRecord(IndexToKey(i)));
+    }
+    for (int i = 5; i < initial_cap; i += 20) {
+      VerifyModify(index, vectors[initial_cap + i], i,
+                   ExpectedResults::kSuccess, true);
+    }
+    for (int i = initial_cap; i < initial_cap + 200; ++i) {
+      VerifyAdd(index, vectors, i, ExpectedResults::kSuccess);
+    }
+  }
+  VMSDK_EXPECT_OK((*index_hnsw)->ApplyReorder());
+  EXPECT_FALSE((*index_hnsw)->ClaimReorder(1.0));
+
+  EXPECT_DOUBLE_EQ((*index_hnsw)->GetTombstoneRatio(),
+                   (*reference)->GetTombstoneRatio());
+  for (int i = 0; i < initial_cap + 200; i += 7) {
+    auto res = (*index_hnsw)->Search(VectorToStr(vectors[i]), k, CancelNever());
+    auto expected =
+        (*reference)->Search(VectorToStr(vectors[i]), k, CancelNever());
+    VMSDK_EXPECT_OK(res);
+    VMSDK_EXPECT_OK(expected);
+    ASSERT_EQ(res->size(), expected->size());
+    for (size_t n = 0; n < res->size(); ++n) {
+      EXPECT_EQ((*res)[n].external_id->Str(),
+                (*expected)[n].external_id->Str());
+    }
+  }
+}
+
+TEST_F(VectorIndexTest, HNSWLinkListLock) {
+  const size_t element_count = 3000;
+  const size_t initial_count = 200;
+  const size_t adder_count = 4;
+  hnswlib::L2Space space(kDimensions);
+  hnswlib::HierarchicalNSW<float> algo(&space, element_count, kM,
+                                       kEFConstruction);
+  auto vectors =
+      DeterministicallyGenerateVectors(element_count, kDimensions, 10.0);
+  for (size_t i = 0; i < initial_count; ++i) {
+    algo.addPoint(vectors[i].data(), i);
+  }
+  // The lock byte of an element sits past its neighbor count and delete mark.
+  hnswlib::linklistsizeint* ll0 = algo.get_linklist0(0);
+  const auto count = algo.getListCount(ll0);
+  {
+    hnswlib::LinkListLock lock(ll0);
+    EXPECT_EQ(algo.getListCount(ll0), count);
+    EXPECT_FALSE(algo.isMarkedDeleted(0));
+    EXPECT_NE(reinterpret_cast<unsigned char*>(ll0)[3], 0);
+  }
+  EXPECT_EQ(reinterpret_cast<unsigned char*>(ll0)[3], 0);
+
+  // Searches and link list reads run while elements are added and their
+  // neighbors relinked.
+  std::atomic<size_t> adders_left{adder_count};
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < adder_count; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = initial_count + t; i < element_count; i += adder_count) {
+        algo.addPoint(vectors[i].data(), i);
+      }
+      --adders_left;
+    });
+  }
+  std::atomic<size_t> bad_lists{0};
+  std::atomic<size_t> bad_results{0};
+  for (size_t t = 0; t < 2; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t q = t; adders_left > 0; q += 2) {
+        auto result =
+            algo.searchKnn(vectors[q % initial_count].data(), kEFRuntime);
+        for (; !result.empty(); result.pop()) {
+          bad_results += result.top().second >= element_count;
+        }
+        hnswlib::tableint id = q % algo.cur_element_count_;
+        auto neighbors = algo.getConnectionsWithLock(id, 0);
+        bad_lists += neighbors.size() > algo.maxM0_;
+        for (auto neighbor : neighbors) {
+          bad_lists += neighbor == id || neighbor >= element_count;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(bad_results.load(), 0);
+  EXPECT_EQ(bad_lists.load(), 0);
+
+  ASSERT_EQ(algo.cur_element_count_, element_count);
+  for (hnswlib::tableint id = 0; id < element_count; ++id) {
+    EXPECT_EQ(reinterpret_cast<unsigned char*>(algo.get_linklist0(id))[3], 0);
+    for (int level = 0; level <= algo.element_levels_[id]; ++level) {
+      hnswlib::linklistsizeint* ll = algo.get_linklist_at_level(id, level);
+      size_t size = algo.getListCount(ll);
+      EXPECT_LE(size, level == 0 ? algo.maxM0_ : algo.maxM_);
+      if (level == 0) {
+        EXPECT_GT(size, 0);
+      }
+      auto* data = reinterpret_cast<hnswlib::tableint*>(ll + 1);
+      absl::flat_hash_set<hnswlib::tableint> unique(data, data + size);
+      EXPECT_EQ(unique.size(), size);
+      EXPECT_FALSE(unique.contains(id));
+      for (auto neighbor : unique) {
+        EXPECT_LT(neighbor, element_count);
+        EXPECT_GE(algo.element_levels_[neighbor], level);
+      }
+    }
+  }
+}
+
+TEST_F(VectorIndexTest, SearchRange) {
+  const int initial_cap = 1000;
+  auto index_hnsw = VectorHNSW<float>::Create(
+      CreateHNSWVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kM, kEFConstruction, kEFRuntime),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  auto index_flat = VectorFlat<float>::Create(
+      CreateFlatVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kBlockSize),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  auto vectors =
+      DeterministicallyGenerateVectors(initial_cap, kDimensions, 2.2);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+    VerifyAdd(index_flat->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  auto search_vectors = DeterministicallyGenerateVectors(10, kDimensions, 1.5);
+  size_t expected_cnt = 0;
+  size_t found_cnt = 0;
+  for (const auto& search_vector : search_vectors) {
+    absl::string_view query = VectorToStr(search_vector);
+    // Pick the radius that holds the 50 nearest neighbors.
+    auto knn = (*index_flat)->Search(query, 50, CancelNever());
+    VMSDK_EXPECT_OK(knn);
+    float radius = knn->back().distance;
+
+    auto res_flat = (*index_flat)->SearchRange(query, radius, CancelNever());
+    VMSDK_EXPECT_OK(res_flat);
+    EXPECT_GE(res_flat->size(), 50u);
+    absl::flat_hash_set<std::string> expected_keys;
+    for (size_t i = 0; i < res_flat->size(); ++i) {
+      EXPECT_LE((*res_flat)[i].distance, radius);
+      if (i > 0) {
+        EXPECT_LE((*res_flat)[i - 1].distance, (*res_flat)[i].distance);
+      }
+      expected_keys.insert(std::string((*res_flat)[i].external_id->Str()));
+    }
+
+    auto res_hnsw = (*index_hnsw)->SearchRange(query, radius, CancelNever());
+    VMSDK_EXPECT_OK(res_hnsw);
+    for (const auto& neighbor : *res_hnsw) {
+      EXPECT_LE(neighbor.distance, radius);
+      EXPECT_TRUE(
+          expected_keys.contains(std::string(neighbor.external_id->Str())));
+    }
+    expected_cnt += expected_keys.size();
+    found_cnt += res_hnsw->size();
+  }
+  // The beam keeps expanding while it reaches into the radius, so the graph
+  // finds nearly all of the vectors within it, well past ef_runtime.
+  EXPECT_GE(((float)found_cnt) / expected_cnt, 0.9f);
+
+  auto empty = (*index_hnsw)->SearchRange(VectorToStr(search_vectors[0]), 0,
+                                          CancelNever());
+  VMSDK_EXPECT_OK(empty);
+  EXPECT_TRUE(empty->empty());
+  EXPECT_FALSE((*index_hnsw)->SearchRange("bad", 1, CancelNever()).ok());
+}
+
+TEST_F(VectorIndexTest, SearchFilteredTraversal) {
+  const int initial_cap = 2000;
+  const uint64_t k = 10;
+  auto index_hnsw = VectorHNSW<float>::Create(
+      CreateHNSWVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kM, kEFConstruction, kEFRuntime),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  auto index_flat = VectorFlat<float>::Create(
+      CreateFlatVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kBlockSize),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  auto vectors =
+      DeterministicallyGenerateVectors(initial_cap, kDimensions, 2.2);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+    VerifyAdd(index_flat->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  // 2% of the vectors pass the filter, few enough that most neighbors of an
+  // element are rejected.
+  const uint64_t modulus = 50;
+  EXPECT_TRUE((*index_hnsw)
+                  ->EstimateInlineSearch(k, 1.0 / modulus, std::nullopt)
+                  .filtered_traversal);
+  EXPECT_FALSE((*index_hnsw)
+                   ->EstimateInlineSearch(k, 1.0, std::nullopt)
+                   .filtered_traversal);
+
+  auto search_vectors = DeterministicallyGenerateVectors(10, kDimensions, 1.5);
+  size_t expected_cnt = 0;
+  size_t found_cnt = 0;
+  for (const auto& search_vector : search_vectors) {
+    absl::string_view query = VectorToStr(search_vector);
+    auto res_flat = (*index_flat)->Search(
+        query, k, CancelNever(), std::make_unique<ModulusFilter>(modulus));
+    VMSDK_EXPECT_OK(res_flat);
+    absl::flat_hash_set<std::string> expected_keys;
+    for (const auto& neighbor : *res_flat) {
+      expected_keys.insert(std::string(neighbor.external_id->Str()));
+    }
+    auto res_hnsw = (*index_hnsw)->Search(
+        query, k, CancelNever(), std::make_unique<ModulusFilter>(modulus),
+        std::nullopt, false, /*filtered_traversal=*/true);
+    VMSDK_EXPECT_OK(res_hnsw);
+    // ef grows until k vectors passed the filter.
+    EXPECT_EQ(res_hnsw->size(), k);
+    for (const auto& neighbor : *res_hnsw) {
+      if (expected_keys.contains(std::string(neighbor.external_id->Str()))) {
+        ++found_cnt;
+      }
+    }
+    expected_cnt += expected_keys.size();
+  }
+  EXPECT_GE(((float)found_cnt) / expected_cnt, 0.9f);
+
+  // Fewer than k vectors pass. Once the traversal runs out of candidates, a
+  // larger ef visits the same elements, so ef is not grown to the size of the
+  // graph: the filter is called as often as in a single search of that size.
+  const uint64_t sparse_modulus = initial_cap / 4;
+  for (const auto& search_vector : search_vectors) {
+    absl::string_view query = VectorToStr(search_vector);
+    size_t calls = 0;
+    auto res = (*index_hnsw)->Search(
+        query, k, CancelNever(),
+        std::make_unique<CountingModulusFilter>(sparse_modulus, &calls),
+        std::nullopt, false, /*filtered_traversal=*/true);
+    VMSDK_EXPECT_OK(res);
+    EXPECT_LT(res->size(), k);
+    size_t single_round_calls = 0;
+    auto single_round_res = (*index_hnsw)->Search(
+        query, k, CancelNever(),
+        std::make_unique<CountingModulusFilter>(sparse_modulus,
+                                                &single_round_calls),
+        initial_cap, false, /*filtered_traversal=*/true);
+    VMSDK_EXPECT_OK(single_round_res);
+    EXPECT_EQ(res->size(), single_round_res->size());
+    EXPECT_EQ(calls, single_round_calls);
+  }
+}
+
 TEST_F(VectorIndexTest, SaveAndLoadHnsw) {
   for (auto& distance_metric :
        {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
@@ -499,6 +1485,588 @@ TEST_F(VectorIndexTest, SaveAndLoadHnsw) {
   }
 }
 
+TEST_F(VectorIndexTest, ShardedHNSW) ABSL_NO_THREAD_SAFETY_ANALYSIS {
+  InitThreadPools(4, std::nullopt, std::nullopt);
+  const int initial_cap = 1000;
+  const uint64_t k = 10;
+  const uint32_t num_shards = 4;
+  auto vectors = DeterministicallyGenerateVectors(1000, kDimensions, 2.2);
+  auto index_flat = VectorFlat<float>::Create(
+      CreateFlatVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kBlockSize),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  VMSDK_EXPECT_OK(index_flat);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    VerifyAdd(index_flat->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  data_model::VectorIndex hnsw_proto =
+      CreateHNSWVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                 initial_cap, kM, kEFConstruction, kEFRuntime);
+  hnsw_proto.mutable_hnsw_algorithm()->set_shards(num_shards);
+  FakeSafeRDB rdb;
+  {
+    auto index_hnsw = VectorHNSW<float>::Create(
+        hnsw_proto, "attribute_identifier_2",
+        data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+    VMSDK_EXPECT_OK(index_hnsw);
+    EXPECT_EQ((*index_hnsw)->GetShardCount(), num_shards);
+    // The initial capacity is split across the graphs.
+    EXPECT_EQ((*index_hnsw)->GetCapacity(), initial_cap);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+    }
+    // Every query searches all the graphs, each with the full ef.
+    EXPECT_GE(CalcRecall(index_flat->get(), index_hnsw->get(), k, kDimensions,
+                         kEFRuntime),
+              0.96f);
+    VMSDK_EXPECT_OK((*index_hnsw)->SaveIndex(RDBChunkOutputStream(&rdb)));
+    VMSDK_EXPECT_OK((*index_hnsw)->SaveTrackedKeys(RDBChunkOutputStream(&rdb)));
+    hnsw_proto = (*index_hnsw)->ToProto()->vector_index();
+    EXPECT_EQ(hnsw_proto.hnsw_algorithm().shards(), num_shards);
+  }
+  auto loaded_index_hnsw = VectorHNSW<float>::LoadFromRDB(
+      &fake_ctx_, &hash_attribute_data_type_, hnsw_proto,
+      "attribute_identifier_3", SupplementalContentChunkIter(&rdb));
+  VMSDK_EXPECT_OK(loaded_index_hnsw);
+  VMSDK_EXPECT_OK((*loaded_index_hnsw)
+                      ->LoadTrackedKeys(&fake_ctx_, &hash_attribute_data_type_,
+                                        SupplementalContentChunkIter(&rdb)));
+  EXPECT_EQ((*loaded_index_hnsw)->GetShardCount(), num_shards);
+  EXPECT_GE(CalcRecall(index_flat->get(), loaded_index_hnsw->get(), k,
+                       kDimensions, kEFRuntime),
+            0.96f);
+  // Removed records are deleted from the graph holding them.
+  for (size_t i = 0; i < num_shards; ++i) {
+    VMSDK_EXPECT_OK((*loaded_index_hnsw)
+                        ->RemoveRecord(IndexToKey(i), DeletionType::kNone));
+    auto res = (*loaded_index_hnsw)
+                   ->Search(VectorToStr(vectors[i]), k, CancelNever());
+    VMSDK_EXPECT_OK(res);
+    for (const auto& neighbor : *res) {
+      EXPECT_NE(neighbor.external_id->Str(), IndexToKey(i)->Str());
+    }
+  }
+}
+
+TEST_F(VectorIndexTest, QuantizedHNSW) {
+  for (auto quantization : {data_model::VECTOR_QUANTIZATION_INT8,
+                            data_model::VECTOR_QUANTIZATION_INT8_CODES_ONLY}) {
+    for (auto& distance_metric :
+         {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
+      const int initial_cap = 1000;
+      const uint64_t k = 10;
+      const bool rerank = quantization == data_model::VECTOR_QUANTIZATION_INT8;
+      FakeSafeRDB rdb;
+      // The quantization ranges are fit to the first 1000 vectors.
+      auto vectors = DeterministicallyGenerateVectors(1200, kDimensions, 2.2);
+      auto index_flat = VectorFlat<float>::Create(
+          CreateFlatVectorIndexProto(kDimensions, distance_metric,
+                                     initial_cap, kBlockSize),
+          "attribute_identifier_1",
+          data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+      VMSDK_EXPECT_OK(index_flat);
+      for (size_t i = 0; i < vectors.size(); ++i) {
+        VerifyAdd(index_flat->get(), vectors, i, ExpectedResults::kSuccess);
+      }
+
+      data_model::VectorIndex hnsw_proto =
+          CreateHNSWVectorIndexProto(kDimensions, distance_metric, initial_cap,
+                                     kM, kEFConstruction, kEFRuntime);
+      hnsw_proto.mutable_hnsw_algorithm()->set_quantization(quantization);
+      {
+        auto index_hnsw = VectorHNSW<float>::Create(
+            hnsw_proto, "attribute_identifier_2",
+            data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+        VMSDK_EXPECT_OK(index_hnsw);
+        EXPECT_TRUE((*index_hnsw)->IsQuantized());
+        for (size_t i = 0; i < vectors.size(); ++i) {
+          // The vectors are kept while the ranges are fit.
+          EXPECT_EQ((*index_hnsw)->KeepsVectors(), rerank || i < 1000);
+          VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+        }
+        EXPECT_EQ((*index_hnsw)->KeepsVectors(), rerank);
+        EXPECT_GE(CalcRecall(index_flat->get(), index_hnsw->get(), k,
+                             kDimensions, kEFRuntime),
+                  0.9f);
+        auto query = VectorToStr(vectors[7]);
+        auto res_hnsw = (*index_hnsw)->Search(query, k, CancelNever());
+        auto res_flat = (*index_flat)->Search(query, k, CancelNever());
+        VMSDK_EXPECT_OK(res_hnsw);
+        VMSDK_EXPECT_OK(res_flat);
+        EXPECT_EQ(res_hnsw->at(0).external_id, IndexToKey(7));
+        auto value = (*index_hnsw)->GetValue(IndexToKey(7));
+        if (rerank) {
+          // Results are re-ranked with the full precision vectors, so
+          // distances match the exact ones.
+          EXPECT_NEAR(res_hnsw->at(0).distance, res_flat->at(0).distance,
+                      1e-5);
+          VMSDK_EXPECT_OK(value);
+          EXPECT_EQ(value->size(), kDimensions * sizeof(float));
+        } else {
+          // Only the codes are left, the distances approximate the exact ones
+          // and the vectors are read from the keys.
+          EXPECT_NEAR(res_hnsw->at(0).distance, res_flat->at(0).distance,
+                      0.05);
+          EXPECT_TRUE(absl::IsUnimplemented(value.status()));
+        }
+        // Outliers of the fit ranges are clamped rather than re-encoding the
+        // graph.
+        std::vector<float> outlier(kDimensions, 100.0f);
+        auto outlier_key = StringInternStore::Intern("outlier");
+        VMSDK_EXPECT_OK(
+            (*index_hnsw)->AddRecord(outlier_key, VectorToStr(outlier)));
+        res_hnsw = (*index_hnsw)->Search(query, k, CancelNever());
+        VMSDK_EXPECT_OK(res_hnsw);
+        EXPECT_EQ(res_hnsw->at(0).external_id, IndexToKey(7));
+        VMSDK_EXPECT_OK(
+            (*index_hnsw)->RemoveRecord(outlier_key, DeletionType::kNone));
+        VMSDK_EXPECT_OK((*index_hnsw)->SaveIndex(RDBChunkOutputStream(&rdb)));
+        VMSDK_EXPECT_OK(
+            (*index_hnsw)->SaveTrackedKeys(RDBChunkOutputStream(&rdb)));
+        hnsw_proto = (*index_hnsw)->ToProto()->vector_index();
+      }
+      EXPECT_EQ(hnsw_proto.hnsw_algorithm().quantization(), quantization);
+
+      // The quantization ranges are saved with the index.
+      auto loaded_index_hnsw = VectorHNSW<float>::LoadFromRDB(
+          &fake_ctx_, &hash_attribute_data_type_, hnsw_proto,
+          "attribute_identifier_3", SupplementalContentChunkIter(&rdb));
+      VMSDK_EXPECT_OK(loaded_index_hnsw);
+      VMSDK_EXPECT_OK(
+          (*loaded_index_hnsw)
+              ->LoadTrackedKeys(&fake_ctx_, &hash_attribute_data_type_,
+                                SupplementalContentChunkIter(&rdb)));
+      EXPECT_TRUE((*loaded_index_hnsw)->IsQuantized());
+      EXPECT_EQ((*loaded_index_hnsw)->KeepsVectors(), rerank);
+      EXPECT_GE(CalcRecall(index_flat->get(), loaded_index_hnsw->get(), k,
+                           kDimensions, kEFRuntime),
+                0.9f);
+    }
+  }
+}
+
+// Scales down all but the leading dimensions, as Matryoshka training
+// concentrates the information of an embedding in its leading dimensions.
+std::vector<std::vector<float>> GenerateMatryoshkaVectors(
+    int count, float max_value, int leading_dimensions) {
+  auto vectors =
+      DeterministicallyGenerateVectors(count, kDimensions, max_value);
+  for (auto& vector : vectors) {
+    for (int i = leading_dimensions; i < kDimensions; ++i) {
+      vector[i] *= 0.1f;
+    }
+  }
+  return vectors;
+}
+
+TEST_F(VectorIndexTest, GraphDimensionsHNSW) {
+  const size_t graph_dimensions = 25;
+  for (auto& distance_metric :
+       {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
+    const int initial_cap = 1000;
+    const uint64_t k = 10;
+    FakeSafeRDB rdb;
+    auto vectors = GenerateMatryoshkaVectors(1000, 2.2, graph_dimensions);
+    auto index_flat = VectorFlat<float>::Create(
+        CreateFlatVectorIndexProto(kDimensions, distance_metric, initial_cap,
+                                   kBlockSize),
+        "attribute_identifier_1",
+        data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+    VMSDK_EXPECT_OK(index_flat);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      VerifyAdd(index_flat->get(), vectors, i, ExpectedResults::kSuccess);
+    }
+    auto search_vectors = GenerateMatryoshkaVectors(50, 1.5, graph_dimensions);
+    auto calc_recall = [&](VectorHNSW<float>* index_hnsw,
+                           std::optional<size_t> oversample) {
+      int cnt = 0;
+      for (const auto& search_vector : search_vectors) {
+        absl::string_view query = VectorToStr(search_vector);
+        auto res_hnsw = index_hnsw->Search(query, k, CancelNever(), nullptr,
+                                           std::nullopt, false, false,
+                                           oversample);
+        auto res_flat = (*index_flat)->Search(query, k, CancelNever());
+        for (auto& label : *res_hnsw) {
+          for (auto& real_label : *res_flat) {
+            if (label.external_id == real_label.external_id) {
+              ++cnt;
+              break;
+            }
+          }
+        }
+      }
+      return static_cast<float>(cnt) / (k * search_vectors.size());
+    };
+
+    data_model::VectorIndex hnsw_proto =
+        CreateHNSWVectorIndexProto(kDimensions, distance_metric, initial_cap,
+                                   kM, kEFConstruction, kEFRuntime);
+    hnsw_proto.mutable_hnsw_algorithm()->set_graph_dimensions(
+        graph_dimensions);
+    {
+      auto index_hnsw = VectorHNSW<float>::Create(
+          hnsw_proto, "attribute_identifier_2",
+          data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+      VMSDK_EXPECT_OK(index_hnsw);
+      EXPECT_TRUE((*index_hnsw)->UsesCodes());
+      EXPECT_FALSE((*index_hnsw)->IsQuantized());
+      EXPECT_EQ((*index_hnsw)->GetGraphDimensions(), graph_dimensions);
+      for (size_t i = 0; i < vectors.size(); ++i) {
+        VerifyAdd(index_hnsw->get(), vectors, i, ExpectedResults::kSuccess);
+      }
+      auto recall = calc_recall(index_hnsw->get(), std::nullopt);
+      auto oversampled_recall = calc_recall(index_hnsw->get(), 8);
+      EXPECT_LE(recall, oversampled_recall);
+      EXPECT_GE(oversampled_recall, 0.9f);
+      // Results are re-ranked with the full vectors, so distances match the
+      // exact ones.
+      auto query = VectorToStr(vectors[7]);
+      auto res_hnsw = (*index_hnsw)->Search(query, k, CancelNever());
+      auto res_flat = (*index_flat)->Search(query, k, CancelNever());
+      VMSDK_EXPECT_OK(res_hnsw);
+      VMSDK_EXPECT_OK(res_flat);
+      EXPECT_EQ(res_hnsw->at(0).external_id, IndexToKey(7));
+      EXPECT_NEAR(res_hnsw->at(0).distance, res_flat->at(0).distance, 1e-5);
+      VMSDK_EXPECT_OK((*index_hnsw)->SaveIndex(RDBChunkOutputStream(&rdb)));
+      VMSDK_EXPECT_OK(
+          (*index_hnsw)->SaveTrackedKeys(RDBChunkOutputStream(&rdb)));
+      hnsw_proto = (*index_hnsw)->ToProto()->vector_index();
+    }
+    EXPECT_EQ(hnsw_proto.hnsw_algorithm().graph_dimensions(),
+              graph_dimensions);
+
+    // The prefixes are re-encoded from the loaded vectors.
+    auto loaded_index_hnsw = VectorHNSW<float>::LoadFromRDB(
+        &fake_ctx_, &hash_attribute_data_type_, hnsw_proto,
+        "attribute_identifier_3", SupplementalContentChunkIter(&rdb));
+    VMSDK_EXPECT_OK(loaded_index_hnsw);
+    VMSDK_EXPECT_OK(
+        (*loaded_index_hnsw)
+            ->LoadTrackedKeys(&fake_ctx_, &hash_attribute_data_type_,
+                              SupplementalContentChunkIter(&rdb)));
+    EXPECT_EQ((*loaded_index_hnsw)->GetGraphDimensions(), graph_dimensions);
+    EXPECT_GE(calc_recall(loaded_index_hnsw->get(), 8), 0.9f);
+  }
+}
+
+TEST_F(VectorIndexTest, TrainedIVF) {
+  for (auto& distance_metric :
+       {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
+    const int initial_cap = 1000;
+    const uint64_t k = 10;
+    FakeSafeRDB rdb;
+    auto vectors = DeterministicallyGenerateVectors(1000, kDimensions, 2.2);
+    auto search_vectors =
+        DeterministicallyGenerateVectors(50, kDimensions, 1.5);
+    auto index_flat = VectorFlat<float>::Create(
+        CreateFlatVectorIndexProto(kDimensions, distance_metric, initial_cap,
+                                   kBlockSize),
+        "attribute_identifier_1",
+        data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+    VMSDK_EXPECT_OK(index_flat);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      VerifyAdd(index_flat->get(), vectors, i, ExpectedResults::kSuccess);
+    }
+
+    data_model::VectorIndex ivf_proto =
+        CreateIVFVectorIndexProto(kDimensions, distance_metric, kNlist,
+                                  kNprobe);
+    std::vector<std::vector<Neighbor>> expected_results;
+    {
+      auto index_ivf = VectorIVF<float>::Create(
+          ivf_proto, "attribute_identifier_2",
+          data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+      VMSDK_EXPECT_OK(index_ivf);
+      for (size_t i = 0; i < vectors.size(); ++i) {
+        VerifyAdd(index_ivf->get(), vectors, i, ExpectedResults::kSuccess);
+      }
+      // The training is left to the server cron.
+      EXPECT_FALSE((*index_ivf)->IsTrained());
+      EXPECT_TRUE((*index_ivf)->ClaimTraining());
+      EXPECT_FALSE((*index_ivf)->ClaimTraining());
+      VMSDK_EXPECT_OK((*index_ivf)->Train());
+      EXPECT_TRUE((*index_ivf)->IsTrained());
+      EXPECT_FALSE((*index_ivf)->ClaimTraining());
+      EXPECT_EQ((*index_ivf)->GetCapacity(), vectors.size());
+      for (const auto& search_vector : search_vectors) {
+        absl::string_view vector = VectorToStr(search_vector);
+        // Probing every list is an exhaustive search.
+        auto res_exhaustive =
+            (*index_ivf)->Search(vector, k, CancelNever(), nullptr, kNlist);
+        auto res_flat = (*index_flat)->Search(vector, k, CancelNever());
+        VMSDK_EXPECT_OK(res_exhaustive);
+        VMSDK_EXPECT_OK(res_flat);
+        EXPECT_EQ(ToVectorNeighborTest(*res_exhaustive),
+                  ToVectorNeighborTest(*res_flat));
+        auto res = (*index_ivf)->Search(vector, k, CancelNever());
+        VMSDK_EXPECT_OK(res);
+        EXPECT_EQ(res->size(), k);
+        expected_results.push_back(std::move(*res));
+      }
+      // A vector is found in its own posting list.
+      auto res = (*index_ivf)->Search(VectorToStr(vectors[7]), k,
+                                      CancelNever(), nullptr, 1);
+      VMSDK_EXPECT_OK(res);
+      EXPECT_EQ(res->at(0).external_id, IndexToKey(7));
+      VMSDK_EXPECT_OK((*index_ivf)->SaveIndex(RDBChunkOutputStream(&rdb)));
+      VMSDK_EXPECT_OK(
+          (*index_ivf)->SaveTrackedKeys(RDBChunkOutputStream(&rdb)));
+      ivf_proto = (*index_ivf)->ToProto()->vector_index();
+    }
+    EXPECT_EQ(ivf_proto.ivf_algorithm().nlist(), kNlist);
+    EXPECT_EQ(ivf_proto.ivf_algorithm().nprobe(), kNprobe);
+
+    // The centroids and posting lists are restored as saved.
+    auto loaded_index_ivf = VectorIVF<float>::LoadFromRDB(
+        &fake_ctx_, &hash_attribute_data_type_, ivf_proto,
+        "attribute_identifier_3", SupplementalContentChunkIter(&rdb));
+    VMSDK_EXPECT_OK(loaded_index_ivf);
+    VMSDK_EXPECT_OK(
+        (*loaded_index_ivf)
+            ->LoadTrackedKeys(&fake_ctx_, &hash_attribute_data_type_,
+                              SupplementalContentChunkIter(&rdb)));
+    EXPECT_TRUE((*loaded_index_ivf)->IsTrained());
+    for (size_t i = 0; i < search_vectors.size(); ++i) {
+      absl::string_view vector = VectorToStr(search_vectors[i]);
+      auto res = (*loaded_index_ivf)->Search(vector, k, CancelNever());
+      VMSDK_EXPECT_OK(res);
+      EXPECT_EQ(ToVectorNeighborTest(*res),
+                ToVectorNeighborTest(expected_results[i]));
+    }
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      VMSDK_EXPECT_OK((*loaded_index_ivf)
+                          ->RemoveRecord(IndexToKey(i), DeletionType::kNone));
+    }
+    EXPECT_EQ((*loaded_index_ivf)->GetCapacity(), 0);
+  }
+}
+
+TEST_F(VectorIndexTest, TrainIVFWhileMutating) {
+  auto vectors = DeterministicallyGenerateVectors(1200, kDimensions, 2.2);
+  auto index = VectorIVF<float>::Create(
+      CreateIVFVectorIndexProto(kDimensions, data_model::DISTANCE_METRIC_L2,
+                                kNlist, kNprobe),
+      "attribute_identifier_1",
+      data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+  VMSDK_EXPECT_OK(index);
+  for (size_t i = 0; i < 1000; ++i) {
+    VerifyAdd(index->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  EXPECT_TRUE((*index)->ClaimTraining());
+  std::thread training([&index]() { VMSDK_EXPECT_OK((*index)->Train()); });
+  // Records are added, modified and removed while the index is trained.
+  for (size_t i = 1000; i < vectors.size(); ++i) {
+    VerifyAdd(index->get(), vectors, i, ExpectedResults::kSuccess);
+  }
+  for (size_t i = 100; i < 200; ++i) {
+    VMSDK_EXPECT_OK(
+        (*index)->ModifyRecord(IndexToKey(i), VectorToStr(vectors[i + 1000])));
+  }
+  for (size_t i = 0; i < 100; ++i) {
+    VMSDK_EXPECT_OK((*index)->RemoveRecord(IndexToKey(i), DeletionType::kNone));
+  }
+  training.join();
+  EXPECT_TRUE((*index)->IsTrained());
+  EXPECT_EQ((*index)->GetCapacity(), vectors.size() - 100);
+  // Every record is found in the list of its current vector.
+  for (size_t i = 100; i < vectors.size(); ++i) {
+    size_t vector_index = i < 200 ? i + 1000 : i;
+    auto res = (*index)->Search(VectorToStr(vectors[vector_index]), 1,
+                                CancelNever(), nullptr, 1);
+    VMSDK_EXPECT_OK(res);
+    ASSERT_EQ(res->size(), 1);
+    EXPECT_EQ(res->at(0).distance, 0);
+  }
+}
+
+TEST_F(VectorIndexTest, ProductQuantizedIVF) {
+  for (auto& distance_metric :
+       {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
+    const uint64_t k = 10;
+    FakeSafeRDB rdb;
+    // Training a product quantizer requires enough vectors for its 256
+    // entries codebooks.
+    auto vectors = DeterministicallyGenerateVectors(
+        (size_t{1} << ProductQuantizer::kDefaultBits) * 32, kDimensions, 2.2);
+    auto search_vectors =
+        DeterministicallyGenerateVectors(50, kDimensions, 1.5);
+    auto index_flat = VectorFlat<float>::Create(
+        CreateFlatVectorIndexProto(kDimensions, distance_metric,
+                                   vectors.size(), kBlockSize),
+        "attribute_identifier_1",
+        data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+    VMSDK_EXPECT_OK(index_flat);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      VerifyAdd(index_flat->get(), vectors, i, ExpectedResults::kSuccess);
+    }
+
+    data_model::VectorIndex ivf_proto = CreateIVFVectorIndexProto(
+        kDimensions, distance_metric, kNlist, kNprobe, kPqM, kPqRerank);
+    std::vector<std::vector<Neighbor>> expected_results;
+    {
+      auto index_ivf = VectorIVF<float>::Create(
+          ivf_proto, "attribute_identifier_2",
+          data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+      VMSDK_EXPECT_OK(index_ivf);
+      for (size_t i = 0; i < vectors.size(); ++i) {
+        VerifyAdd(index_ivf->get(), vectors, i, ExpectedResults::kSuccess);
+        if (i + 2 == vectors.size()) {
+          EXPECT_FALSE((*index_ivf)->ClaimTraining());
+        }
+      }
+      EXPECT_TRUE((*index_ivf)->ClaimTraining());
+      VMSDK_EXPECT_OK((*index_ivf)->Train());
+      EXPECT_TRUE((*index_ivf)->IsTrained());
+      size_t matches = 0;
+      for (const auto& search_vector : search_vectors) {
+        absl::string_view vector = VectorToStr(search_vector);
+        auto res =
+            (*index_ivf)->Search(vector, k, CancelNever(), nullptr, kNlist);
+        auto res_flat = (*index_flat)->Search(vector, k, CancelNever());
+        VMSDK_EXPECT_OK(res);
+        VMSDK_EXPECT_OK(res_flat);
+        EXPECT_EQ(res->size(), k);
+        for (const auto& neighbor : *res) {
+          for (const auto& flat_neighbor : *res_flat) {
+            if (neighbor.external_id == flat_neighbor.external_id) {
+              // Re-ranked distances are exact.
+              EXPECT_FLOAT_EQ(neighbor.distance, flat_neighbor.distance);
+              ++matches;
+            }
+          }
+        }
+        expected_results.push_back(std::move(*res));
+      }
+      EXPECT_GE(matches, search_vectors.size() * k * 8 / 10);
+      auto res = (*index_ivf)->Search(VectorToStr(vectors[7]), k,
+                                      CancelNever(), nullptr, 1);
+      VMSDK_EXPECT_OK(res);
+      EXPECT_EQ(res->at(0).external_id, IndexToKey(7));
+      VMSDK_EXPECT_OK((*index_ivf)->SaveIndex(RDBChunkOutputStream(&rdb)));
+      VMSDK_EXPECT_OK(
+          (*index_ivf)->SaveTrackedKeys(RDBChunkOutputStream(&rdb)));
+      ivf_proto = (*index_ivf)->ToProto()->vector_index();
+    }
+    EXPECT_EQ(ivf_proto.ivf_algorithm().pq_m(), kPqM);
+    EXPECT_EQ(ivf_proto.ivf_algorithm().pq_rerank(), kPqRerank);
+
+    // The codebooks and codes are restored as saved.
+    auto loaded_index_ivf = VectorIVF<float>::LoadFromRDB(
+        &fake_ctx_, &hash_attribute_data_type_, ivf_proto,
+        "attribute_identifier_3", SupplementalContentChunkIter(&rdb));
+    VMSDK_EXPECT_OK(loaded_index_ivf);
+    VMSDK_EXPECT_OK(
+        (*loaded_index_ivf)
+            ->LoadTrackedKeys(&fake_ctx_, &hash_attribute_data_type_,
+                              SupplementalContentChunkIter(&rdb)));
+    EXPECT_TRUE((*loaded_index_ivf)->IsTrained());
+    for (size_t i = 0; i < search_vectors.size(); ++i) {
+      absl::string_view vector = VectorToStr(search_vectors[i]);
+      auto res = (*loaded_index_ivf)
+                     ->Search(vector, k, CancelNever(), nullptr, kNlist);
+      VMSDK_EXPECT_OK(res);
+      EXPECT_EQ(ToVectorNeighborTest(*res),
+                ToVectorNeighborTest(expected_results[i]));
+    }
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      VMSDK_EXPECT_OK((*loaded_index_ivf)
+                          ->RemoveRecord(IndexToKey(i), DeletionType::kNone));
+    }
+    EXPECT_EQ((*loaded_index_ivf)->GetCapacity(), 0);
+  }
+}
+
+TEST_F(VectorIndexTest, FastScanIVF) {
+  for (auto& distance_metric :
+       {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
+    const uint64_t k = 10;
+    FakeSafeRDB rdb;
+    auto vectors = DeterministicallyGenerateVectors(2000, kDimensions, 2.2);
+    auto search_vectors =
+        DeterministicallyGenerateVectors(20, kDimensions, 1.5);
+    // 4 bit codes, without re-ranking, so that only the codes are kept.
+    data_model::VectorIndex ivf_proto =
+        CreateIVFVectorIndexProto(kDimensions, distance_metric, kNlist,
+                                  kNprobe, kPqM, /*pq_rerank=*/0,
+                                  /*pq_nbits=*/4);
+    std::vector<std::vector<Neighbor>> expected_results;
+    {
+      auto index_ivf = VectorIVF<float>::Create(
+          ivf_proto, "attribute_identifier_1",
+          data_model::AttributeDataType::ATTRIBUTE_DATA_TYPE_HASH);
+      VMSDK_EXPECT_OK(index_ivf);
+      for (size_t i = 0; i < vectors.size(); ++i) {
+        VerifyAdd(index_ivf->get(), vectors, i, ExpectedResults::kSuccess);
+      }
+      EXPECT_TRUE((*index_ivf)->KeepsVectors());
+      EXPECT_TRUE((*index_ivf)->ClaimTraining());
+      VMSDK_EXPECT_OK((*index_ivf)->Train());
+      EXPECT_TRUE((*index_ivf)->IsTrained());
+      EXPECT_FALSE((*index_ivf)->KeepsVectors());
+      // The vectors are read from the keys instead.
+      EXPECT_EQ((*index_ivf)->GetValue(IndexToKey(7)).status().code(),
+                absl::StatusCode::kUnimplemented);
+      // A vector encoding to the same code leaves the record unchanged.
+      VerifyModify(index_ivf->get(), vectors[7], 7, ExpectedResults::kSkipped,
+                   true);
+      for (const auto& search_vector : search_vectors) {
+        absl::string_view vector = VectorToStr(search_vector);
+        auto res =
+            (*index_ivf)->Search(vector, k, CancelNever(), nullptr, kNlist);
+        VMSDK_EXPECT_OK(res);
+        ASSERT_EQ(res->size(), k);
+        if (distance_metric == data_model::DISTANCE_METRIC_L2) {
+          // The block distances only preselect the codes, so the results are
+          // the k closest codes by their exact table distances.
+          std::vector<float> distances;
+          for (size_t i = 0; i < vectors.size(); ++i) {
+            auto distance =
+                (*index_ivf)->ComputeDistance(vector, IndexToKey(i));
+            VMSDK_EXPECT_OK(distance);
+            distances.push_back(*distance);
+          }
+          std::sort(distances.begin(), distances.end());
+          for (size_t i = 0; i < k; ++i) {
+            EXPECT_FLOAT_EQ(res->at(i).distance, distances[i]);
+          }
+        }
+        expected_results.push_back(std::move(*res));
+      }
+      VMSDK_EXPECT_OK((*index_ivf)->SaveIndex(RDBChunkOutputStream(&rdb)));
+      VMSDK_EXPECT_OK(
+          (*index_ivf)->SaveTrackedKeys(RDBChunkOutputStream(&rdb)));
+      ivf_proto = (*index_ivf)->ToProto()->vector_index();
+    }
+    EXPECT_EQ(ivf_proto.ivf_algorithm().pq_nbits(), 4);
+
+    // The codes are restored without the vectors.
+    auto loaded_index_ivf = VectorIVF<float>::LoadFromRDB(
+        &fake_ctx_, &hash_attribute_data_type_, ivf_proto,
+        "attribute_identifier_2", SupplementalContentChunkIter(&rdb));
+    VMSDK_EXPECT_OK(loaded_index_ivf);
+    VMSDK_EXPECT_OK(
+        (*loaded_index_ivf)
+            ->LoadTrackedKeys(&fake_ctx_, &hash_attribute_data_type_,
+                              SupplementalContentChunkIter(&rdb)));
+    EXPECT_TRUE((*loaded_index_ivf)->IsTrained());
+    EXPECT_FALSE((*loaded_index_ivf)->KeepsVectors());
+    for (size_t i = 0; i < search_vectors.size(); ++i) {
+      absl::string_view vector = VectorToStr(search_vectors[i]);
+      auto res = (*loaded_index_ivf)
+                     ->Search(vector, k, CancelNever(), nullptr, kNlist);
+      VMSDK_EXPECT_OK(res);
+      EXPECT_EQ(ToVectorNeighborTest(*res),
+                ToVectorNeighborTest(expected_results[i]));
+    }
+    for (size_t i = 0; i < vectors.size(); ++i) {
+      VMSDK_EXPECT_OK((*loaded_index_ivf)
+                          ->RemoveRecord(IndexToKey(i), DeletionType::kNone));
+    }
+    EXPECT_EQ((*loaded_index_ivf)->GetCapacity(), 0);
+  }
+}
+
 TEST_F(VectorIndexTest, SaveAndLoadFlat) {
   for (auto& distance_metric :
        {data_model::DISTANCE_METRIC_COSINE, data_model::DISTANCE_METRIC_L2}) {
@@ -1,9 +1,11 @@
 #pragma once
 #include <assert.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
@@ -28,14 +30,25 @@ namespace hnswlib {
 template <typename dist_t>
 class BruteforceSearch : public AlgorithmInterface<dist_t> {
  public:
+    // The vectors are copied back to back into chunks aligned to a cache
+    // line, and their labels are kept in a parallel array, so that a scan
+    // streams through memory rather than following a pointer per vector.
     std::unique_ptr<ChunkedArray> data_;
+    std::vector<labeltype> labels_;
     size_t cur_element_count_;
     size_t vector_size_{0};
-    const size_t data_ptr_size_ = sizeof(char*);
     DISTFUNC <dist_t> fstdistfunc_;
     void *dist_func_param_;
     std::mutex index_lock;
-    const size_t k_elements_per_chunk{10*1024};
+
+    static constexpr size_t kVectorAlignment{64};
+    // Approximate size of a chunk of vectors.
+    static constexpr size_t kChunkByteSize{1024 * 1024};
+    // Number of stored vectors scored together. Scan blocks never straddle two
+    // chunks, since the chunks hold a whole number of blocks.
+    static constexpr size_t kScanBlockSize{64};
+    // Number of vectors between the one being scored and the one prefetched.
+    static constexpr size_t kPrefetchDistance{4};
 
   std::unordered_map<labeltype, size_t> dict_external_to_internal;
 
@@ -57,11 +70,19 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
         fstdistfunc_ = s->get_dist_func();
         dist_func_param_ = s->get_dist_func_param();
         data_ = std::make_unique<ChunkedArray>(
-                data_ptr_size_ + sizeof(labeltype),
-                k_elements_per_chunk,
-                maxElements);
+                vector_size_, getVectorsPerChunk(), maxElements,
+                kVectorAlignment);
+        labels_.resize(maxElements);
+    }
+
+    size_t getVectorsPerChunk() const {
+        size_t block_byte_size = vector_size_ * kScanBlockSize;
+        return std::max<size_t>(1, kChunkByteSize / block_byte_size) *
+               kScanBlockSize;
     }
 
+    char *getVectorByIndex(size_t idx) const { return (*data_)[idx]; }
+
 
     void addPoint(const void *datapoint, labeltype label, bool replace_deleted = false) {
         int idx;
@@ -77,8 +98,8 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
             dict_external_to_internal[label] = idx;
             cur_element_count_++;
         }
-        memcpy((*data_)[idx] + data_ptr_size_, &label, sizeof(labeltype));
-        *(char**)((*data_)[idx]) = (char*)datapoint;
+        memcpy(getVectorByIndex(idx), datapoint, vector_size_);
+        labels_[idx] = label;
     }
 
     char *getPoint(labeltype cur_external) {
@@ -86,7 +107,7 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
       if (found == dict_external_to_internal.end()) {
         return nullptr;
       }
-      return *(char **)(*data_)[found->second];
+      return getVectorByIndex(found->second);
     }
 
     void removePoint(labeltype cur_external) {
@@ -104,46 +125,153 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
           return;
         }
 
-        labeltype label = *((labeltype*)((*data_)[cur_element_count_-1] + data_ptr_size_));
+        // Keep the vectors dense by moving the last one into the hole.
+        labeltype label = labels_[cur_element_count_ - 1];
         dict_external_to_internal[label] = cur_c;
-        memcpy((*data_)[cur_c],
-                (*data_)[cur_element_count_-1],
-                data_ptr_size_ + sizeof(labeltype));
+        memcpy(getVectorByIndex(cur_c),
+                getVectorByIndex(cur_element_count_ - 1),
+                vector_size_);
+        labels_[cur_c] = label;
         cur_element_count_--;
     }
 
+    // Computes the distances from the query to the vectors [start, end), a
+    // part of a single scan block, prefetching the vectors scored next.
+    void scoreBlock(const void *query_data, size_t start, size_t end,
+                    dist_t *distances) const {
+        const char *vector = getVectorByIndex(start);
+        for (size_t i = start; i < end; i++, vector += vector_size_) {
+            if (i + kPrefetchDistance < end) {
+                const char *ahead = vector + kPrefetchDistance * vector_size_;
+                for (size_t offset = 0; offset < vector_size_;
+                     offset += kVectorAlignment) {
+                    __builtin_prefetch(ahead + offset, 0, 0);
+                }
+            }
+            distances[i - start] =
+                fstdistfunc_(query_data, vector, dist_func_param_);
+        }
+    }
+
 
     std::priority_queue<std::pair<dist_t, labeltype >>
     searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr, BaseCancellationFunctor *isCancelled = nullptr) const {
         assert(k <= cur_element_count_);
-        std::priority_queue<std::pair<dist_t, labeltype >> topResults;
-        if (cur_element_count_ == 0) return topResults;
-        for (int i = 0; i < k; i++) {
-            dist_t dist = fstdistfunc_(query_data, *(char**)(*data_)[i], dist_func_param_);
-            labeltype label = *((labeltype*) ((*data_)[i] + data_ptr_size_));
-            if ((!isIdAllowed) || (*isIdAllowed)(label)) {
-                topResults.emplace(dist, label);
+        return searchKnnRange(query_data, k, 0, cur_element_count_,
+                              isIdAllowed, isCancelled);
+    }
+
+    // Returns the k best matches among the stored vectors [begin, end). A
+    // search can be split into ranges which are scanned concurrently, and
+    // whose results are then merged.
+    std::priority_queue<std::pair<dist_t, labeltype>>
+    searchKnnRange(const void *query_data, size_t k, size_t begin, size_t end,
+                   BaseFilterFunctor *isIdAllowed = nullptr,
+                   BaseCancellationFunctor *isCancelled = nullptr) const {
+        std::priority_queue<std::pair<dist_t, labeltype>> topResults;
+        end = std::min(end, cur_element_count_);
+        if (begin >= end || k == 0) return topResults;
+        dist_t distances[kScanBlockSize];
+        dist_t lastdist = std::numeric_limits<dist_t>::max();
+        for (size_t start = begin; start < end;) {
+            if (isCancelled && isCancelled->isCancelled()) {
+                break;
+            }
+            // Blocks are aligned, so that a range starting mid-block still
+            // scores within a single chunk.
+            size_t block_end =
+                std::min((start / kScanBlockSize + 1) * kScanBlockSize, end);
+            scoreBlock(query_data, start, block_end, distances);
+            for (size_t i = start; i < block_end; i++) {
+                dist_t dist = distances[i - start];
+                if (topResults.size() < k || dist <= lastdist) {
+                    labeltype label = labels_[i];
+                    if ((!isIdAllowed) || (*isIdAllowed)(label)) {
+                        topResults.emplace(dist, label);
+                        if (topResults.size() > k)
+                            topResults.pop();
+                        lastdist = topResults.top().first;
+                    }
+                }
             }
+            start = block_end;
         }
-        dist_t lastdist = topResults.empty() ? std::numeric_limits<dist_t>::max() : topResults.top().first;
-        for (int i = k; i < cur_element_count_ && (!isCancelled || !isCancelled->isCancelled()); i++) {
-            dist_t dist = fstdistfunc_(query_data, *(char**)(*data_)[i], dist_func_param_);
-            if (dist <= lastdist) {
-                labeltype label = *((labeltype *) ((*data_)[i] + data_ptr_size_));
+        return topResults;
+    }
+
+    // Answers several queries with a single pass over the stored vectors. The
+    // vectors are scanned in blocks of kScanBlockSize and every query visits
+    // the block while it is still cache resident, and the filter is evaluated
+    // once per vector rather than once per query.
+    std::vector<std::priority_queue<std::pair<dist_t, labeltype>>>
+    searchKnnBatch(const std::vector<const void *> &queries, size_t k,
+                   BaseFilterFunctor *isIdAllowed = nullptr,
+                   BaseCancellationFunctor *isCancelled = nullptr) const {
+        assert(k <= cur_element_count_);
+        std::vector<std::priority_queue<std::pair<dist_t, labeltype>>>
+            topResults(queries.size());
+        if (cur_element_count_ == 0 || k == 0) return topResults;
+        std::vector<dist_t> lastdist(queries.size(),
+                                     std::numeric_limits<dist_t>::max());
+        std::vector<const char *> block_vectors;
+        std::vector<labeltype> block_labels;
+        block_vectors.reserve(kScanBlockSize);
+        block_labels.reserve(kScanBlockSize);
+        for (size_t start = 0; start < cur_element_count_; start += kScanBlockSize) {
+            if (isCancelled && isCancelled->isCancelled()) {
+                break;
+            }
+            block_vectors.clear();
+            block_labels.clear();
+            size_t end = std::min(start + kScanBlockSize, cur_element_count_);
+            for (size_t i = start; i < end; i++) {
+                labeltype label = labels_[i];
                 if ((!isIdAllowed) || (*isIdAllowed)(label)) {
-                    topResults.emplace(dist, label);
+                    block_vectors.push_back(getVectorByIndex(i));
+                    block_labels.push_back(label);
                 }
-                if (topResults.size() > k)
-                    topResults.pop();
-
-                if (!topResults.empty()) {
-                    lastdist = topResults.top().first;
+            }
+            for (size_t q = 0; q < queries.size(); q++) {
+                auto &results = topResults[q];
+                for (size_t i = 0; i < block_vectors.size(); i++) {
+                    dist_t dist = fstdistfunc_(queries[q], block_vectors[i], dist_func_param_);
+                    if (results.size() < k || dist <= lastdist[q]) {
+                        results.emplace(dist, block_labels[i]);
+                        if (results.size() > k)
+                            results.pop();
+                        lastdist[q] = results.top().first;
+                    }
                 }
             }
         }
         return topResults;
     }
 
+    // Returns all the stored vectors within `radius` of the query.
+    std::priority_queue<std::pair<dist_t, labeltype>>
+    searchRange(const void *query_data, dist_t radius,
+                BaseFilterFunctor *isIdAllowed = nullptr,
+                BaseCancellationFunctor *isCancelled = nullptr) const {
+        std::priority_queue<std::pair<dist_t, labeltype>> results;
+        dist_t distances[kScanBlockSize];
+        for (size_t start = 0; start < cur_element_count_; start += kScanBlockSize) {
+            if (isCancelled && isCancelled->isCancelled()) {
+                break;
+            }
+            size_t end = std::min(start + kScanBlockSize, cur_element_count_);
+            scoreBlock(query_data, start, end, distances);
+            for (size_t i = start; i < end; i++) {
+                if (distances[i - start] <= radius) {
+                    labeltype label = labels_[i];
+                    if ((!isIdAllowed) || (*isIdAllowed)(label)) {
+                        results.emplace(distances[i - start], label);
+                    }
+                }
+            }
+        }
+        return results;
+    }
+
     absl::Status SaveIndex(OutputStream &output) {
       data_model::BruteForceIndexHeader header;
       const size_t size_per_element = vector_size_ + sizeof(labeltype);
@@ -160,16 +288,14 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
       // TODO: write in chunks to improve throughput
       std::vector<char> buf(size_per_element);
       for (int i = 0; i < cur_element_count_; i++) {
-        memcpy(buf.data(), *(char **)(*data_)[i], vector_size_);
-        memcpy(buf.data() + vector_size_, (*data_)[i] + sizeof(char *),
-              sizeof(labeltype));
+        memcpy(buf.data(), getVectorByIndex(i), vector_size_);
+        memcpy(buf.data() + vector_size_, &labels_[i], sizeof(labeltype));
         VMSDK_RETURN_IF_ERROR(output.SaveChunk(buf.data(), size_per_element));
       }
       return absl::OkStatus();
     }
 
-    absl::Status LoadIndex(InputStream &input, SpaceInterface<dist_t> *s,
-                          VectorTracker *vector_tracker) {
+    absl::Status LoadIndex(InputStream &input, SpaceInterface<dist_t> *s) {
       if (data_ != nullptr) {
         data_->clear();
       }
@@ -189,17 +315,18 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
             "Persisted size_per_element does not match expectation.");
       }
 
-      data_ = std::make_unique<ChunkedArray>(data_ptr_size_ + sizeof(labeltype),
-                                            k_elements_per_chunk,
-                                            header->max_elements());
+      data_ = std::make_unique<ChunkedArray>(vector_size_,
+                                            getVectorsPerChunk(),
+                                            header->max_elements(),
+                                            kVectorAlignment);
+      labels_.assign(header->max_elements(), 0);
 
       for (int i = 0; i < cur_element_count_; i++) {
         VMSDK_ASSIGN_OR_RETURN(auto chunk, input.LoadChunk());
         labeltype id;
         memcpy((char *)&id, chunk->data() + vector_size_, sizeof(labeltype));
-        *(char **)(*data_)[i] =
-            vector_tracker->TrackVector(id, chunk->data(), vector_size_);
-        memcpy((*data_)[i] + data_ptr_size_, (char *)&id, sizeof(labeltype));
+        memcpy(getVectorByIndex(i), chunk->data(), vector_size_);
+        labels_[i] = id;
         dict_external_to_internal[id] = i;
       }
 
@@ -208,6 +335,7 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
 
     void resizeIndex(size_t new_max_elements) {
         data_->resize(new_max_elements);
+        labels_.resize(new_max_elements);
     }
 };
 }  // namespace hnswlib
@@ -3,15 +3,18 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <deque>
+#include <limits>
 #include <list>
 #include <memory>
 #include <optional>
 #include <random>
 #include <string>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 
@@ -40,6 +43,112 @@ namespace hnswlib {
 typedef unsigned int tableint;
 typedef unsigned int linklistsizeint;
 
+// VALKEYSEARCH START
+// Drives a range search: the beam keeps at least ef elements, like a KNN
+// search, but is never trimmed below the elements found within the radius, and
+// the search goes on for as long as the frontier reaches into the radius.
+template <typename dist_t>
+class RangeSearchStopCondition : public BaseSearchStopCondition<dist_t> {
+ public:
+  RangeSearchStopCondition(dist_t radius, size_t ef)
+      : radius_(radius), ef_(std::max<size_t>(ef, 1)) {}
+
+  void add_point_to_result(labeltype label, const void *datapoint,
+                           dist_t dist) override {
+    ++num_items_;
+    if (dist <= radius_) {
+      ++num_in_range_;
+    }
+  }
+
+  void remove_point_from_result(labeltype label, const void *datapoint,
+                                dist_t dist) override {
+    --num_items_;
+    if (dist <= radius_) {
+      --num_in_range_;
+    }
+  }
+
+  bool should_stop_search(dist_t candidate_dist, dist_t lowerBound) override {
+    return candidate_dist > radius_ && candidate_dist > lowerBound &&
+           num_items_ >= ef_;
+  }
+
+  bool should_consider_candidate(dist_t candidate_dist,
+                                 dist_t lowerBound) override {
+    return candidate_dist <= radius_ || num_items_ < ef_ ||
+           candidate_dist < lowerBound;
+  }
+
+  bool should_remove_extra() override {
+    return num_items_ > std::max(ef_, num_in_range_);
+  }
+
+  void filter_results(
+      std::vector<std::pair<dist_t, labeltype>> &candidates) override {
+    while (!candidates.empty() && candidates.back().first > radius_) {
+      candidates.pop_back();
+    }
+  }
+
+ private:
+  dist_t radius_;
+  size_t ef_;
+  size_t num_items_{0};
+  size_t num_in_range_{0};
+};
+
+// Lock of the link lists of an element at all levels, held in the spare last
+// byte of its level 0 link list header, after the neighbor count and the
+// delete mark. Unlike a mutex per element slot, it takes no memory of its own
+// and nothing to reallocate when the graph grows. Waiters spin briefly, then
+// yield, as the lock is only held for long while its element is inserted.
+class LinkListLock {
+ public:
+  explicit LinkListLock(linklistsizeint *ll0) : flag_(getFlag(ll0)) { lock(); }
+  LinkListLock(linklistsizeint *ll0, std::defer_lock_t)
+      : flag_(getFlag(ll0)) {}
+  LinkListLock(const LinkListLock &) = delete;
+  LinkListLock &operator=(const LinkListLock &) = delete;
+  ~LinkListLock() {
+    if (owns_) {
+      unlock();
+    }
+  }
+
+  void lock() {
+    for (int spins = 0; __atomic_test_and_set(flag_, __ATOMIC_ACQUIRE);
+         spins++) {
+      while (__atomic_load_n(flag_, __ATOMIC_RELAXED)) {
+        if (++spins > kSpinsBeforeYield) {
+          std::this_thread::yield();
+        }
+      }
+    }
+    owns_ = true;
+  }
+
+  void unlock() {
+    owns_ = false;
+    __atomic_clear(flag_, __ATOMIC_RELEASE);
+  }
+
+  // Clears the lock byte of a copied link list header.
+  static void clear(void *ll0) { *getFlag(ll0) = 0; }
+
+ private:
+  static_assert(sizeof(linklistsizeint) == 4);
+  static constexpr int kSpinsBeforeYield = 64;
+
+  static unsigned char *getFlag(void *ll0) {
+    return static_cast<unsigned char *>(ll0) + 3;
+  }
+
+  unsigned char *flag_;
+  bool owns_{false};
+};
+// VALKEYSEARCH END
+
 template <typename dist_t>
 class HierarchicalNSW : public AlgorithmInterface<dist_t> {
  public:
@@ -70,7 +179,6 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
   mutable std::vector<std::mutex> label_op_locks_;
 
   std::mutex global;
-  std::vector<std::mutex> link_list_locks_;
 
   tableint enterpoint_node_{0};
 
@@ -102,6 +210,25 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
   std::unordered_set<tableint>
       deleted_elements;  // contains internal ids of deleted elements
 
+  // VALKEYSEARCH START
+  // When a quantizer is set, every level-0 element also stores the code of its
+  // vector inline, right after the label, and the graph is built and searched
+  // over those codes. The full precision vector stays reachable through the
+  // vector pointer for serialization and re-ranking, unless the vectors were
+  // dropped, leaving only the codes and null vector pointers.
+  const VectorQuantizer *quantizer_{nullptr};
+  SpaceInterface<dist_t> *code_space_{nullptr};
+  size_t offsetCode_{0};
+  bool keep_vectors_{true};
+  // Elements changed while a reordered copy is built, for the copy to catch
+  // up with, see beginReorderedCopy. Moving or re-encoding all the elements
+  // invalidates the copy instead.
+  std::atomic<bool> reorder_tracking_{false};
+  std::mutex reorder_changes_lock_;
+  std::vector<tableint> reorder_changes_;
+  bool reorder_invalidated_{false};
+  // VALKEYSEARCH END
+
   HierarchicalNSW(SpaceInterface<dist_t> *s) {}
 
   HierarchicalNSW(SpaceInterface<dist_t> *s, const std::string &location,
@@ -115,7 +242,6 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                   size_t ef_construction = 200, size_t random_seed = 100,
                   bool allow_replace_deleted = false)
       : label_op_locks_(MAX_LABEL_OPERATION_LOCKS),
-        link_list_locks_(max_elements),
         element_levels_(max_elements),
         allow_replace_deleted_(allow_replace_deleted) {
     max_elements_ = max_elements;
@@ -228,11 +354,74 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     return ((*data_level0_memory_)[internal_id] + offsetData_);
   }
 
+  // Returns the data the distance function operates on: the inline code when
+  // the index is quantized, the full precision vector otherwise.
   inline char *getDataByInternalId(tableint internal_id) const {
+    if (quantizer_) {
+      return (*data_level0_memory_)[internal_id] + offsetCode_;
+    }
+    return getVectorByInternalId(internal_id);
+  }
+
+  inline char *getVectorByInternalId(tableint internal_id) const {
     auto data_ptr = (char **)(getDataPtrByInternalId(internal_id));
     return *data_ptr;
   }
 
+  // VALKEYSEARCH START
+  // Builds and searches the graph over codes produced by `quantizer`, using
+  // the distance function of `code_space`. Must be called before any element
+  // is added or loaded. Queries passed to searchKnn must then be encoded by
+  // the caller.
+  void setQuantizer(SpaceInterface<dist_t> *code_space,
+                    const VectorQuantizer *quantizer) {
+    if (cur_element_count_ != 0) {
+      throw std::runtime_error("Cannot set a quantizer on a non-empty index");
+    }
+    quantizer_ = quantizer;
+    code_space_ = code_space;
+    if (data_level0_memory_ != nullptr) {
+      applyQuantizedLayout();
+      data_level0_memory_ = std::make_unique<ChunkedArray>(
+          size_data_per_element_, k_elements_per_chunk, max_elements_);
+    }
+  }
+
+  // Re-encodes the code of every element from its full precision vector, e.g.
+  // after the quantizer's parameters changed. Requires exclusive access.
+  void requantize() {
+    if (!quantizer_ || !keep_vectors_) {
+      return;
+    }
+    invalidateReorderedCopy();
+    for (tableint i = 0; i < cur_element_count_; i++) {
+      quantizer_->encode(getVectorByInternalId(i), getDataByInternalId(i));
+    }
+  }
+
+  // Releases the full precision vectors of a quantized index, which from then
+  // on only keeps the codes, also of the elements added later and when saved.
+  // Requires exclusive access.
+  void dropVectors() {
+    if (!quantizer_) {
+      throw std::runtime_error(
+          "Cannot drop the vectors of a non-quantized index");
+    }
+    keep_vectors_ = false;
+    invalidateReorderedCopy();
+    for (tableint i = 0; i < cur_element_count_; i++) {
+      *reinterpret_cast<char **>(getDataPtrByInternalId(i)) = nullptr;
+    }
+  }
+
+  void applyQuantizedLayout() {
+    offsetCode_ = label_offset_ + sizeof(labeltype);
+    size_data_per_element_ = offsetCode_ + code_space_->get_data_size();
+    fstdistfunc_ = code_space_->get_dist_func();
+    dist_func_param_ = code_space_->get_dist_func_param();
+  }
+  // VALKEYSEARCH END
+
   int getRandomLevel(double reverse_size) {
     std::uniform_real_distribution<double> distribution(0.0, 1.0);
     double r = -log(distribution(level_generator_)) * reverse_size;
@@ -284,7 +473,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
       tableint curNodeNum = curr_el_pair.second;
 
-      std::unique_lock<std::mutex> lock(link_list_locks_[curNodeNum]);
+      LinkListLock lock(get_linklist0(curNodeNum));
 
       int *data;  // = (int *)(linkList0_ + curNodeNum *
                   // size_links_per_element0_);
@@ -587,8 +776,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     {
       // lock only during the update
       // because during the addition the lock for cur_c is already acquired
-      std::unique_lock<std::mutex> lock(link_list_locks_[cur_c],
-                                        std::defer_lock);
+      LinkListLock lock(get_linklist0(cur_c), std::defer_lock);
       if (isUpdate) {
         lock.lock();
       }
@@ -598,7 +786,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
       else
         ll_cur = get_linklist(cur_c, level);
 
-      if (*ll_cur && !isUpdate) {
+      if (getListCount(ll_cur) && !isUpdate) {
         throw std::runtime_error(
             "The newly inserted element should have blank link list");
       }
@@ -614,10 +802,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         data[idx] = selectedNeighbors[idx];
       }
     }
+    trackReorderChange(cur_c);
 
     for (size_t idx = 0; idx < selectedNeighbors.size(); idx++) {
-      std::unique_lock<std::mutex> lock(
-          link_list_locks_[selectedNeighbors[idx]]);
+      LinkListLock lock(get_linklist0(selectedNeighbors[idx]));
 
       linklistsizeint *ll_other;
       if (level == 0)
@@ -698,6 +886,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
           } */
         }
       }
+      trackReorderChange(selectedNeighbors[idx]);
     }
 
     return next_closest_entry_point;
@@ -713,8 +902,6 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     element_levels_.resize(new_max_elements);
 
-    std::vector<std::mutex>(new_max_elements).swap(link_list_locks_);
-
     // Reallocate base layer
     data_level0_memory_->resize(new_max_elements);
 
@@ -724,6 +911,448 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     max_elements_ = new_max_elements;
   }
 
+  // VALKEYSEARCH START
+  // Removes the elements marked deleted from the graph and frees their slots.
+  // Every live element linking to a deleted one is reconnected, through the
+  // neighbor selection heuristic, to its live neighbors and the live neighbors
+  // of the deleted ones. The live elements are then compacted to the front of
+  // the element slots, keeping their labels. Requires exclusive access.
+  // Returns the number of bytes of upper level link lists released.
+  size_t consolidateDeletes() {
+    if (num_deleted_ == 0) {
+      return 0;
+    }
+    repairDeletedLinks(0, cur_element_count_);
+    return compactDeleted();
+  }
+
+  // Reconnects the live elements in [begin, end) linking to deleted ones, and
+  // moves the entry point off a deleted element. The graph stays searchable,
+  // so large graphs can be repaired a range at a time, releasing exclusive
+  // access in between, before a final consolidateDeletes() finds little left
+  // to repair. Requires exclusive access.
+  void repairDeletedLinks(tableint begin, tableint end) {
+    const size_t element_count = cur_element_count_;
+    if (isMarkedDeleted(enterpoint_node_)) {
+      // The live element with the highest level becomes the entry point.
+      tableint new_enterpoint = element_count;
+      for (tableint i = 0; i < element_count; i++) {
+        if (!isMarkedDeleted(i) &&
+            (new_enterpoint == element_count ||
+             element_levels_[i] > element_levels_[new_enterpoint])) {
+          new_enterpoint = i;
+        }
+      }
+      if (new_enterpoint != element_count) {
+        repairEnterpoint(new_enterpoint);
+      }
+    }
+    end = std::min<tableint>(end, element_count);
+    for (tableint i = begin; i < end; i++) {
+      if (isMarkedDeleted(i)) {
+        continue;
+      }
+      for (int level = 0; level <= element_levels_[i]; level++) {
+        repairDeletedConnections(i, level);
+      }
+    }
+  }
+
+  // Makes `new_enterpoint` the entry point, at its own level.
+  void repairEnterpoint(tableint new_enterpoint) {
+    enterpoint_node_ = new_enterpoint;
+    maxlevel_ = element_levels_[new_enterpoint];
+  }
+
+  // Replaces the deleted neighbors of `internal_id` at `level`.
+  void repairDeletedConnections(tableint internal_id, int level) {
+    linklistsizeint *ll_cur = get_linklist_at_level(internal_id, level);
+    size_t size = getListCount(ll_cur);
+    tableint *data = (tableint *)(ll_cur + 1);
+    bool has_deleted = false;
+    for (size_t j = 0; j < size; j++) {
+      if (isMarkedDeleted(data[j])) {
+        has_deleted = true;
+        break;
+      }
+    }
+    if (!has_deleted) {
+      return;
+    }
+    std::unordered_set<tableint> candidate_ids;
+    for (size_t j = 0; j < size; j++) {
+      if (!isMarkedDeleted(data[j])) {
+        candidate_ids.insert(data[j]);
+        continue;
+      }
+      // Deleted elements keep their link lists untouched, so their neighbors
+      // are still valid two hop candidates.
+      linklistsizeint *ll_deleted = get_linklist_at_level(data[j], level);
+      size_t deleted_size = getListCount(ll_deleted);
+      tableint *deleted_data = (tableint *)(ll_deleted + 1);
+      for (size_t k = 0; k < deleted_size; k++) {
+        if (deleted_data[k] != internal_id &&
+            !isMarkedDeleted(deleted_data[k])) {
+          candidate_ids.insert(deleted_data[k]);
+        }
+      }
+    }
+    const void *data_point = getDataByInternalId(internal_id);
+    std::priority_queue<std::pair<dist_t, tableint>,
+                        std::vector<std::pair<dist_t, tableint>>,
+                        CompareByFirst>
+        candidates;
+    if (candidate_ids.empty() && internal_id != enterpoint_node_ &&
+        level <= maxlevel_) {
+      // All of the neighborhood is gone, search the graph for new neighbors.
+      auto found = searchBaseLayer(enterpoint_node_, data_point, level);
+      for (; !found.empty(); found.pop()) {
+        if (found.top().second != internal_id) {
+          candidate_ids.insert(found.top().second);
+        }
+      }
+    }
+    for (tableint candidate_id : candidate_ids) {
+      candidates.emplace(fstdistfunc_(data_point,
+                                      getDataByInternalId(candidate_id),
+                                      dist_func_param_),
+                         candidate_id);
+    }
+    getNeighborsByHeuristic2(candidates, level ? maxM_ : maxM0_);
+    size_t new_size = candidates.size();
+    for (size_t j = 0; j < new_size; j++) {
+      data[j] = candidates.top().second;
+      candidates.pop();
+    }
+    setListCount(ll_cur, new_size);
+    trackReorderChange(internal_id);
+  }
+
+  // Moves the live elements to the front of the element slots and remaps all
+  // the links accordingly. The link lists must not reference deleted elements.
+  size_t compactDeleted() {
+    invalidateReorderedCopy();
+    const size_t element_count = cur_element_count_;
+    const tableint kRemoved = std::numeric_limits<tableint>::max();
+    std::vector<tableint> new_ids(element_count, kRemoved);
+    size_t released_bytes = 0;
+    tableint live_count = 0;
+    for (tableint i = 0; i < element_count; i++) {
+      if (!isMarkedDeleted(i)) {
+        new_ids[i] = live_count++;
+        continue;
+      }
+      if (element_levels_[i] > 0) {
+        delete[] (*reinterpret_cast<char **>((*linkLists_)[i]));
+        released_bytes += size_links_per_element_ * element_levels_[i] + 1;
+      }
+    }
+    label_lookup_.clear();
+    for (tableint i = 0; i < element_count; i++) {
+      tableint new_id = new_ids[i];
+      if (new_id == kRemoved) {
+        continue;
+      }
+      if (new_id != i) {
+        memcpy((*data_level0_memory_)[new_id], (*data_level0_memory_)[i],
+               size_data_per_element_);
+        *reinterpret_cast<char **>((*linkLists_)[new_id]) =
+            *reinterpret_cast<char **>((*linkLists_)[i]);
+        element_levels_[new_id] = element_levels_[i];
+      }
+      label_lookup_[getExternalLabel(new_id)] = new_id;
+    }
+    for (tableint i = live_count; i < element_count; i++) {
+      element_levels_[i] = 0;
+    }
+    for (tableint i = 0; i < live_count; i++) {
+      for (int level = 0; level <= element_levels_[i]; level++) {
+        linklistsizeint *ll_cur = get_linklist_at_level(i, level);
+        size_t size = getListCount(ll_cur);
+        tableint *data = (tableint *)(ll_cur + 1);
+        size_t new_size = 0;
+        for (size_t j = 0; j < size; j++) {
+          if (new_ids[data[j]] != kRemoved) {
+            data[new_size++] = new_ids[data[j]];
+          }
+        }
+        setListCount(ll_cur, new_size);
+      }
+    }
+    if (live_count == 0) {
+      enterpoint_node_ = -1;
+      maxlevel_ = -1;
+    } else {
+      enterpoint_node_ = new_ids[enterpoint_node_];
+    }
+    valkey_search::Metrics::GetStats().reclaimable_memory -=
+        num_deleted_ * vector_size_;
+    num_deleted_ = 0;
+    {
+      std::unique_lock<std::mutex> lock_deleted_elements(deleted_elements_lock);
+      deleted_elements.clear();
+    }
+    cur_element_count_ = live_count;
+    return released_bytes;
+  }
+
+  // A renumbered copy of the graph, started by beginReorderedCopy, built by
+  // buildReorderedCopy and swapped in by swapReorderedCopy. Once swapped, it
+  // holds the previous graph, whose upper level link lists it releases.
+  struct ReorderedCopy {
+    // Number of elements renumbered, those added later keep their ids.
+    size_t element_count{0};
+    std::vector<tableint> new_ids;
+    // Breadth-first traversal, released once it visited every element.
+    std::vector<tableint> order;
+    size_t traversed{0};
+    tableint next_root{0};
+    size_t copied{0};
+    std::unique_ptr<ChunkedArray> data_level0_memory;
+    std::unique_ptr<ChunkedArray> linkLists;
+    std::vector<int> element_levels;
+    std::unordered_map<labeltype, tableint> label_lookup;
+
+    ReorderedCopy() = default;
+    ReorderedCopy(const ReorderedCopy &) = delete;
+    ReorderedCopy &operator=(const ReorderedCopy &) = delete;
+    ~ReorderedCopy() {
+      for (size_t i = 0; i < element_count; i++) {
+        if (element_levels[i] > 0) {
+          delete[] (*reinterpret_cast<char **>((*linkLists)[i]));
+        }
+      }
+    }
+
+    tableint remap(tableint id) const {
+      return id < element_count ? new_ids[id] : id;
+    }
+  };
+
+  // Starts a copy of the graph with the elements renumbered in the
+  // breadth-first order of the level 0 graph from the entry point, so that
+  // the neighbors of an element mostly sit in nearby slots and a search
+  // touches fewer cache lines and pages. The elements the traversal does not
+  // reach follow in their previous order. Labels are unchanged.
+  // From here on, the elements changed are recorded for the copy to catch up
+  // with, until it is swapped in or cancelled. Requires exclusive access.
+  // Returns null if the graph is too small to reorder.
+  std::unique_ptr<ReorderedCopy> beginReorderedCopy() {
+    const size_t element_count = cur_element_count_;
+    if (element_count < 2) {
+      return nullptr;
+    }
+    auto copy = std::make_unique<ReorderedCopy>();
+    copy->element_count = element_count;
+    copy->new_ids.assign(element_count,
+                         std::numeric_limits<tableint>::max());
+    copy->order.reserve(element_count);
+    copy->new_ids[enterpoint_node_] = 0;
+    copy->order.push_back(enterpoint_node_);
+    copy->data_level0_memory = std::make_unique<ChunkedArray>(
+        size_data_per_element_, k_elements_per_chunk, max_elements_);
+    copy->linkLists = std::make_unique<ChunkedArray>(
+        sizeof(void *), k_elements_per_chunk, max_elements_);
+    copy->element_levels.assign(max_elements_, 0);
+    copy->label_lookup.reserve(element_count);
+    std::unique_lock<std::mutex> lock(reorder_changes_lock_);
+    reorder_changes_.clear();
+    reorder_invalidated_ = false;
+    reorder_tracking_ = true;
+    return copy;
+  }
+
+  // Traverses or copies up to `max_elements` more elements of `copy`. The
+  // graph is only read, each element under its link list lock, so this runs
+  // alongside searches and mutations, but not resizes. Returns true once all
+  // the elements are copied.
+  bool buildReorderedCopy(ReorderedCopy &copy, size_t max_elements) {
+    const tableint kUnvisited = std::numeric_limits<tableint>::max();
+    const size_t element_count = copy.element_count;
+    std::vector<tableint> neighbors;
+    for (; copy.traversed < element_count && max_elements > 0;
+         copy.traversed++, max_elements--) {
+      if (copy.traversed == copy.order.size()) {
+        while (copy.new_ids[copy.next_root] != kUnvisited) {
+          copy.next_root++;
+        }
+        copy.new_ids[copy.next_root] = copy.order.size();
+        copy.order.push_back(copy.next_root);
+      }
+      {
+        linklistsizeint *ll_cur = get_linklist0(copy.order[copy.traversed]);
+        LinkListLock lock(ll_cur);
+        tableint *data = (tableint *)(ll_cur + 1);
+        neighbors.assign(data, data + getListCount(ll_cur));
+      }
+      for (tableint neighbor : neighbors) {
+        // Elements added since the copy started are left out.
+        if (neighbor < element_count && copy.new_ids[neighbor] == kUnvisited) {
+          copy.new_ids[neighbor] = copy.order.size();
+          copy.order.push_back(neighbor);
+        }
+      }
+    }
+    if (copy.traversed < element_count) {
+      return false;
+    }
+    copy.order = std::vector<tableint>();
+    for (; copy.copied < element_count && max_elements > 0;
+         copy.copied++, max_elements--) {
+      copyReorderedElement(copy, copy.copied, false);
+    }
+    return copy.copied == element_count;
+  }
+
+  // Copies again the elements of a built copy that changed since they were
+  // copied. Runs alongside searches and mutations, but not resizes, so that
+  // swapReorderedCopy is left with fewer changes. Returns the number of
+  // elements copied.
+  size_t catchUpReorderedCopy(ReorderedCopy &copy) {
+    std::vector<tableint> changes;
+    {
+      std::unique_lock<std::mutex> lock(reorder_changes_lock_);
+      changes.swap(reorder_changes_);
+    }
+    std::sort(changes.begin(), changes.end());
+    changes.erase(std::unique(changes.begin(), changes.end()), changes.end());
+    size_t copied = 0;
+    for (tableint id : changes) {
+      // Elements added since the copy started are copied when swapped in.
+      if (id < copy.element_count) {
+        copyReorderedElement(copy, id, true);
+        copied++;
+      }
+    }
+    return copied;
+  }
+
+  // Swaps in a built copy, once caught up with the changed and added
+  // elements. The copy then holds the previous graph. Requires exclusive
+  // access. Returns false, leaving the graph as it is, if the elements were
+  // moved or re-encoded since the copy started.
+  bool swapReorderedCopy(ReorderedCopy &copy) {
+    if (!endReorderTracking()) {
+      return false;
+    }
+    const size_t element_count = cur_element_count_;
+    if (copy.data_level0_memory->getCapacity() < max_elements_) {
+      copy.data_level0_memory->resize(max_elements_);
+      copy.linkLists->resize(max_elements_);
+      copy.element_levels.resize(max_elements_, 0);
+    }
+    catchUpReorderedCopy(copy);
+    for (tableint i = copy.element_count; i < element_count; i++) {
+      copyReorderedElement(copy, i, false);
+    }
+    std::swap(data_level0_memory_, copy.data_level0_memory);
+    std::swap(linkLists_, copy.linkLists);
+    std::swap(element_levels_, copy.element_levels);
+    enterpoint_node_ = copy.remap(enterpoint_node_);
+    {
+      std::unique_lock<std::mutex> lock_label(label_lookup_lock);
+      std::swap(label_lookup_, copy.label_lookup);
+    }
+    {
+      std::unique_lock<std::mutex> lock_deleted_elements(deleted_elements_lock);
+      std::unordered_set<tableint> new_deleted_elements;
+      for (tableint id : deleted_elements) {
+        new_deleted_elements.insert(copy.remap(id));
+      }
+      deleted_elements.swap(new_deleted_elements);
+    }
+    // The copy releases the upper level link lists of the previous graph.
+    copy.element_count = element_count;
+    return true;
+  }
+
+  // Stops recording the changes for a copy which is not swapped in.
+  void cancelReorderedCopy() { endReorderTracking(); }
+
+  // Renumbers the elements for locality, see beginReorderedCopy. Requires
+  // exclusive access.
+  void reorderForLocality() {
+    auto copy = beginReorderedCopy();
+    if (copy == nullptr) {
+      return;
+    }
+    buildReorderedCopy(*copy, copy->element_count * 2);
+    swapReorderedCopy(*copy);
+  }
+
+  // Records that `internal_id` changed while a reordered copy is built.
+  void trackReorderChange(tableint internal_id) {
+    if (!reorder_tracking_) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(reorder_changes_lock_);
+    reorder_changes_.push_back(internal_id);
+  }
+
+  // Records that the elements were moved or re-encoded while a reordered copy
+  // is built, which it cannot catch up with.
+  void invalidateReorderedCopy() {
+    if (!reorder_tracking_) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(reorder_changes_lock_);
+    reorder_invalidated_ = true;
+  }
+
+  // Stops recording the changes. Returns false if the copy was invalidated.
+  bool endReorderTracking() {
+    std::unique_lock<std::mutex> lock(reorder_changes_lock_);
+    reorder_tracking_ = false;
+    return !reorder_invalidated_;
+  }
+
+  // Copies element `id` to its slot in `copy`, remapping its links. With
+  // `replace`, the slot holds an earlier copy of the element to overwrite.
+  void copyReorderedElement(ReorderedCopy &copy, tableint id, bool replace) {
+    tableint new_id = copy.remap(id);
+    char *element = (*copy.data_level0_memory)[new_id];
+    char **links = reinterpret_cast<char **>((*copy.linkLists)[new_id]);
+    if (replace) {
+      labeltype label;
+      memcpy(&label, element + label_offset_, sizeof(labeltype));
+      auto it = copy.label_lookup.find(label);
+      if (it != copy.label_lookup.end() && it->second == new_id) {
+        copy.label_lookup.erase(it);
+      }
+      if (copy.element_levels[new_id] > 0) {
+        delete[] *links;
+      }
+    }
+    linklistsizeint *ll_cur = get_linklist0(id);
+    LinkListLock lock(ll_cur);
+    memcpy(element, (*data_level0_memory_)[id], size_data_per_element_);
+    LinkListLock::clear(element + offsetLevel0_);
+    int level = element_levels_[id];
+    copy.element_levels[new_id] = level;
+    *links = nullptr;
+    if (level > 0) {
+      size_t links_size = size_links_per_element_ * level + 1;
+      *links = new char[links_size];
+      memcpy(*links, *reinterpret_cast<char **>((*linkLists_)[id]),
+             links_size);
+    }
+    for (int l = 0; l <= level; l++) {
+      linklistsizeint *ll_new =
+          l == 0 ? (linklistsizeint *)(element + offsetLevel0_)
+                 : (linklistsizeint *)(*links +
+                                       (l - 1) * size_links_per_element_);
+      size_t size = getListCount(ll_new);
+      tableint *data = (tableint *)(ll_new + 1);
+      for (size_t j = 0; j < size; j++) {
+        data[j] = copy.remap(data[j]);
+      }
+    }
+    labeltype label;
+    memcpy(&label, element + label_offset_, sizeof(labeltype));
+    copy.label_lookup[label] = new_id;
+  }
+  // VALKEYSEARCH END
+
   size_t indexFileSize() const {
     size_t size = 0;
     size += sizeof(offsetLevel0_);
@@ -754,12 +1383,16 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
   }
 
   absl::Status SaveIndex(OutputStream &output) {
+    // Without the vectors, the codes are saved in their place.
+    const size_t saved_vector_size =
+        keep_vectors_ ? vector_size_ : code_space_->get_data_size();
+    const size_t serialize_size_data_per_element =
+        size_links_level0_ + saved_vector_size + sizeof(labeltype);
     data_model::HNSWIndexHeader header;
     header.set_offset_level_0(offsetLevel0_);
     header.set_max_elements(max_elements_);
     header.set_curr_element_count(cur_element_count_);
-    header.set_serialize_size_data_per_element(
-        serialize_size_data_per_element_);
+    header.set_serialize_size_data_per_element(serialize_size_data_per_element);
     header.set_label_offset(label_offset_);
     header.set_offset_data(offsetData_);
     header.set_max_level(maxlevel_);
@@ -769,6 +1402,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     header.set_m(M_);
     header.set_mult(mult_);
     header.set_ef_construction(ef_construction_);
+    header.set_codes_only(!keep_vectors_);
     std::string serialized;
     if (!header.SerializeToString(&serialized)) {
       return absl::InternalError("Could not serialize HNSW header");
@@ -785,15 +1419,17 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     data_level0_memory_->resize(max_elements_);
     linkLists_->resize(max_elements_);
 
-    std::vector<char> buf(serialize_size_data_per_element_);
+    std::vector<char> buf(serialize_size_data_per_element);
     for (int i = 0; i < cur_element_count_; i++) {
       memcpy(buf.data(), (*data_level0_memory_)[i], size_links_level0_);
+      LinkListLock::clear(buf.data());
       memcpy(buf.data() + size_links_level0_,
-             *(char **)((*data_level0_memory_)[i] + offsetData_), vector_size_);
-      memcpy(buf.data() + size_links_level0_ + vector_size_,
+             keep_vectors_ ? getVectorByInternalId(i) : getDataByInternalId(i),
+             saved_vector_size);
+      memcpy(buf.data() + size_links_level0_ + saved_vector_size,
              (*data_level0_memory_)[i] + label_offset_, sizeof(labeltype));
       VMSDK_RETURN_IF_ERROR(
-          output.SaveChunk(buf.data(), serialize_size_data_per_element_));
+          output.SaveChunk(buf.data(), serialize_size_data_per_element));
     };
 
     for (size_t i = 0; i < cur_element_count_; i++) {
@@ -851,6 +1487,15 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     fstdistfunc_ = s->get_dist_func();
     dist_func_param_ = s->get_dist_func_param();
+    if (quantizer_) {
+      applyQuantizedLayout();
+    }
+    keep_vectors_ = !header->codes_only();
+    if (!keep_vectors_ && !quantizer_) {
+      return absl::InternalError("Could not load HNSW codes without quantizer");
+    }
+    const size_t saved_vector_size =
+        keep_vectors_ ? vector_size_ : code_space_->get_data_size();
 
     data_level0_memory_ = std::make_unique<ChunkedArray>(
         size_data_per_element_, k_elements_per_chunk, max_elements);
@@ -859,19 +1504,27 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
       VMSDK_ASSIGN_OR_RETURN(auto chunk, input.LoadChunk());
       memcpy((*data_level0_memory_)[i], chunk->data(), size_links_level0_);
       labeltype id;
-      memcpy((char *)&id, chunk->data() + offsetData_ + vector_size_,
+      memcpy((char *)&id, chunk->data() + offsetData_ + saved_vector_size,
              sizeof(labeltype));
+      memcpy((*data_level0_memory_)[i] + label_offset_, (char *)&id,
+             sizeof(labeltype));
+      if (!keep_vectors_) {
+        *(char **)((*data_level0_memory_)[i] + offsetData_) = nullptr;
+        memcpy(getDataByInternalId(i), chunk->data() + offsetData_,
+               saved_vector_size);
+        continue;
+      }
       *(char **)((*data_level0_memory_)[i] + offsetData_) =
           vector_tracker->TrackVector(id, chunk->data() + offsetData_,
                                       vector_size_);
-      memcpy((*data_level0_memory_)[i] + label_offset_, (char *)&id,
-             sizeof(labeltype));
+      if (quantizer_) {
+        quantizer_->encode(getVectorByInternalId(i), getDataByInternalId(i));
+      }
     }
 
     size_links_per_element_ =
         maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
 
-    std::vector<std::mutex>(max_elements).swap(link_list_locks_);
     std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
 
     visited_list_pool_ = std::make_unique<VisitedListPool>(1, max_elements);
@@ -918,7 +1571,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     if (search == label_lookup_.end() || isMarkedDeleted(search->second)) {
       return nullptr;
     }
-    return getDataByInternalId(search->second);
+    return getVectorByInternalId(search->second);
   }
 
   template <typename data_t>
@@ -934,8 +1587,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     tableint internalId = search->second;
     lock_table.unlock();
 
-    char *data_ptrv = getDataByInternalId(internalId);
-    size_t dim = *((size_t *)dist_func_param_);
+    char *data_ptrv = getVectorByInternalId(internalId);
+    size_t dim = vector_size_ / sizeof(data_t);
     std::vector<data_t> data(dim);
     memcpy(data.data(), data_ptrv, dim * sizeof(data_t));
     return data;
@@ -970,6 +1623,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     if (!isMarkedDeleted(internalId)) {
       unsigned char *ll_cur = ((unsigned char *)get_linklist0(internalId)) + 2;
       *ll_cur |= DELETE_MARK;
+      trackReorderChange(internalId);
       num_deleted_ += 1;
       valkey_search::Metrics::GetStats().reclaimable_memory += vector_size_;
       if (allow_replace_deleted_) {
@@ -1014,6 +1668,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     if (isMarkedDeleted(internalId)) {
       unsigned char *ll_cur = ((unsigned char *)get_linklist0(internalId)) + 2;
       *ll_cur &= ~DELETE_MARK;
+      trackReorderChange(internalId);
       num_deleted_ -= 1;
       valkey_search::Metrics::GetStats().reclaimable_memory -= vector_size_;
       if (allow_replace_deleted_) {
@@ -1095,7 +1750,12 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                    float updateNeighborProbability) {
     // update the feature vector associated with existing point with new vector
     auto data_ptr = (const char **)(getDataPtrByInternalId(internalId));
-    *data_ptr = static_cast<const char *>(dataPoint);
+    *data_ptr = keep_vectors_ ? static_cast<const char *>(dataPoint) : nullptr;
+    if (quantizer_) {
+      quantizer_->encode(dataPoint, getDataByInternalId(internalId));
+      dataPoint = getDataByInternalId(internalId);
+    }
+    trackReorderChange(internalId);
 
     int maxLevelCopy = maxlevel_;
     tableint entryPointCopy = enterpoint_node_;
@@ -1163,7 +1823,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         getNeighborsByHeuristic2(candidates, layer == 0 ? maxM0_ : maxM_);
 
         {
-          std::unique_lock<std::mutex> lock(link_list_locks_[neigh]);
+          LinkListLock lock(get_linklist0(neigh));
           linklistsizeint *ll_cur;
           ll_cur = get_linklist_at_level(neigh, layer);
           size_t candSize = candidates.size();
@@ -1174,6 +1834,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             candidates.pop();
           }
         }
+        trackReorderChange(neigh);
       }
     }
 
@@ -1194,7 +1855,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         while (changed) {
           changed = false;
           unsigned int *data;
-          std::unique_lock<std::mutex> lock(link_list_locks_[currObj]);
+          LinkListLock lock(get_linklist0(currObj));
           data = get_linklist_at_level(currObj, level);
           int size = getListCount(data);
           tableint *datal = (tableint *)(data + 1);
@@ -1263,7 +1924,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
   }
 
   std::vector<tableint> getConnectionsWithLock(tableint internalId, int level) {
-    std::unique_lock<std::mutex> lock(link_list_locks_[internalId]);
+    LinkListLock lock(get_linklist0(internalId));
     unsigned int *data = get_linklist_at_level(internalId, level);
     int size = getListCount(data);
     std::vector<tableint> result(size);
@@ -1308,9 +1969,15 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
       label_lookup_[label] = cur_c;
     }
 
+    // VALKEYSEARCH START
+    // The level 0 link list header holds the element lock, cleared first.
+    memset((*data_level0_memory_)[cur_c] + offsetLevel0_, 0,
+           size_data_per_element_);
+    // VALKEYSEARCH END
+
     std::unique_lock<std::mutex> templock(global);
     int maxlevelcopy = maxlevel_;
-    std::unique_lock<std::mutex> lock_el(link_list_locks_[cur_c]);
+    LinkListLock lock_el(get_linklist0(cur_c));
     int curlevel = getRandomLevel(mult_);
     if (level > 0) curlevel = level;
     if (curlevel <= maxlevelcopy) {
@@ -1320,13 +1987,14 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     tableint currObj = enterpoint_node_;
     tableint enterpoint_copy = enterpoint_node_;
 
-    memset((*data_level0_memory_)[cur_c] + offsetLevel0_, 0,
-           size_data_per_element_);
-
     // Initialisation of the data and label
     memcpy(getExternalLabeLp(cur_c), &label, sizeof(labeltype));
     auto data_ptr = (const char **)(getDataPtrByInternalId(cur_c));
-    *data_ptr = static_cast<const char *>(data_point);
+    *data_ptr = keep_vectors_ ? static_cast<const char *>(data_point) : nullptr;
+    if (quantizer_) {
+      quantizer_->encode(data_point, getDataByInternalId(cur_c));
+      data_point = getDataByInternalId(cur_c);
+    }
 
     if (curlevel) {
       *reinterpret_cast<char **>((*linkLists_)[cur_c]) =
@@ -1347,7 +2015,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
           while (changed) {
             changed = false;
             unsigned int *data;
-            std::unique_lock<std::mutex> lock(link_list_locks_[currObj]);
+            LinkListLock lock(get_linklist0(currObj));
             data = get_linklist(currObj, level);
             int size = getListCount(data);
 
@@ -1477,7 +2145,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
   std::vector<std::pair<dist_t, labeltype>> searchStopConditionClosest(
       const void *query_data, BaseSearchStopCondition<dist_t> &stop_condition,
-      BaseFilterFunctor *isIdAllowed = nullptr) const {
+      BaseFilterFunctor *isIdAllowed = nullptr,
+      BaseCancellationFunctor *isCancelled = nullptr  // VALKEYSEARCH
+    ) const {
     std::vector<std::pair<dist_t, labeltype>> result;
     if (cur_element_count_ == 0) return result;
 
@@ -1518,12 +2188,16 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                         CompareByFirst>
         top_candidates;
     top_candidates = searchBaseLayerST<false>(currObj, query_data, 0,
-                                              isIdAllowed, nullptr, &stop_condition);
+                                              isIdAllowed, isCancelled,
+                                              &stop_condition);  // VALKEYSEARCH
 
     size_t sz = top_candidates.size();
     result.resize(sz);
     while (!top_candidates.empty()) {
-      result[--sz] = top_candidates.top();
+      // VALKEYSEARCH START
+      result[--sz] = {top_candidates.top().first,
+                      getExternalLabel(top_candidates.top().second)};
+      // VALKEYSEARCH END
       top_candidates.pop();
     }
 
@@ -1532,6 +2206,205 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     return result;
   }
 
+  // VALKEYSEARCH START
+  // Returns the elements within `radius` of the query, closest first. The
+  // search is approximate: ef bounds how far it strays outside of the radius
+  // looking for further elements within it.
+  std::vector<std::pair<dist_t, labeltype>> searchRange(
+      const void *query_data, dist_t radius, size_t ef,
+      BaseFilterFunctor *isIdAllowed = nullptr,
+      BaseCancellationFunctor *isCancelled = nullptr) const {
+    RangeSearchStopCondition<dist_t> stop_condition(radius, ef);
+    return searchStopConditionClosest(query_data, stop_condition, isIdAllowed,
+                                      isCancelled);
+  }
+
+  // Base layer search for restrictive filters. Only the elements that pass
+  // the filter enter the candidate and result sets, and the neighbors of a
+  // rejected element are explored in its place, so that the search keeps
+  // moving through the filtered subgraph even when few direct neighbors of an
+  // element pass the filter. Up to maxM0_ passing elements of the one and two
+  // hop neighborhood of each expanded element are scored. `exhausted` is set
+  // when the search ran out of candidates before it had ef results, in which
+  // case a larger ef would visit the same elements.
+  std::priority_queue<std::pair<dist_t, tableint>,
+                      std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
+  searchBaseLayerFiltered(tableint ep_id, const void *data_point, size_t ef,
+                          BaseFilterFunctor *isIdAllowed,
+                          BaseCancellationFunctor *isCancelled,
+                          bool *exhausted = nullptr) const {
+    VisitedList *vl = visited_list_pool_->getFreeVisitedList();
+    vl_type *visited_array = vl->mass;
+    vl_type visited_array_tag = vl->curV;
+
+    std::priority_queue<std::pair<dist_t, tableint>,
+                        std::vector<std::pair<dist_t, tableint>>,
+                        CompareByFirst>
+        top_candidates;
+    std::priority_queue<std::pair<dist_t, tableint>,
+                        std::vector<std::pair<dist_t, tableint>>,
+                        CompareByFirst>
+        candidate_set;
+    auto is_allowed = [&](tableint id) {
+      return !isMarkedDeleted(id) && (*isIdAllowed)(getExternalLabel(id));
+    };
+
+    dist_t lowerBound = std::numeric_limits<dist_t>::max();
+    dist_t ep_dist =
+        fstdistfunc_(data_point, getDataByInternalId(ep_id), dist_func_param_);
+    if (is_allowed(ep_id)) {
+      lowerBound = ep_dist;
+      top_candidates.emplace(ep_dist, ep_id);
+    }
+    // The entry point is expanded even if it is rejected, it is where the
+    // search enters the filtered subgraph.
+    candidate_set.emplace(-ep_dist, ep_id);
+    visited_array[ep_id] = visited_array_tag;
+
+    std::vector<tableint> matching;
+    std::vector<tableint> rejected;
+    matching.reserve(maxM0_);
+    rejected.reserve(maxM0_);
+    bool stopped = false;
+    while (!candidate_set.empty()) {
+      std::pair<dist_t, tableint> current_node_pair = candidate_set.top();
+      if ((-current_node_pair.first > lowerBound &&
+           top_candidates.size() == ef) ||
+          (isCancelled && isCancelled->isCancelled())) {
+        stopped = true;
+        break;
+      }
+      candidate_set.pop();
+
+      matching.clear();
+      rejected.clear();
+      linklistsizeint *ll = get_linklist0(current_node_pair.second);
+      size_t size = getListCount(ll);
+      tableint *data = (tableint *)(ll + 1);
+      for (size_t j = 0; j < size; j++) {
+        tableint candidate_id = data[j];
+        if (visited_array[candidate_id] == visited_array_tag) continue;
+        visited_array[candidate_id] = visited_array_tag;
+        if (is_allowed(candidate_id)) {
+          matching.push_back(candidate_id);
+        } else {
+          rejected.push_back(candidate_id);
+        }
+      }
+      for (size_t r = 0; r < rejected.size() && matching.size() < maxM0_;
+           r++) {
+        linklistsizeint *ll_rejected = get_linklist0(rejected[r]);
+        size_t size_rejected = getListCount(ll_rejected);
+        tableint *data_rejected = (tableint *)(ll_rejected + 1);
+        for (size_t j = 0; j < size_rejected && matching.size() < maxM0_;
+             j++) {
+          tableint candidate_id = data_rejected[j];
+          if (visited_array[candidate_id] == visited_array_tag) continue;
+          visited_array[candidate_id] = visited_array_tag;
+          if (is_allowed(candidate_id)) {
+            matching.push_back(candidate_id);
+          }
+        }
+      }
+
+      for (tableint candidate_id : matching) {
+        dist_t dist = fstdistfunc_(data_point,
+                                   getDataByInternalId(candidate_id),
+                                   dist_func_param_);
+        if (top_candidates.size() < ef || dist < lowerBound) {
+          candidate_set.emplace(-dist, candidate_id);
+          top_candidates.emplace(dist, candidate_id);
+          if (top_candidates.size() > ef) {
+            top_candidates.pop();
+          }
+          lowerBound = top_candidates.top().first;
+        }
+      }
+    }
+
+    visited_list_pool_->releaseVisitedList(vl);
+    if (exhausted) {
+      // Short of ef results, every passing element reached was kept, so the
+      // traversal did not depend on ef.
+      *exhausted = !stopped && top_candidates.size() < ef;
+    }
+    return top_candidates;
+  }
+
+  // Returns the k elements closest to the query among the ones that pass the
+  // filter, using searchBaseLayerFiltered. When fewer than k elements pass in
+  // the explored part of the graph, the search is repeated with twice the ef,
+  // up to the size of the graph, unless it already reached all the passing
+  // elements it can.
+  std::priority_queue<std::pair<dist_t, labeltype>> searchKnnFiltered(
+      const void *query_data, size_t k, std::optional<size_t> ef_runtime,
+      BaseFilterFunctor *isIdAllowed,
+      BaseCancellationFunctor *isCancelled = nullptr) const {
+    std::priority_queue<std::pair<dist_t, labeltype>> result;
+    if (cur_element_count_ == 0) return result;
+
+    tableint currObj = enterpoint_node_;
+    dist_t curdist = fstdistfunc_(
+        query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+
+    for (int level = maxlevel_; level > 0; level--) {
+      bool changed = true;
+      while (changed) {
+        changed = false;
+        unsigned int *data;
+
+        data = (unsigned int *)get_linklist(currObj, level);
+        int size = getListCount(data);
+        metric_hops++;
+        metric_distance_computations += size;
+
+        tableint *datal = (tableint *)(data + 1);
+        for (int i = 0; i < size; i++) {
+          tableint cand = datal[i];
+          if (cand < 0 || cand >= max_elements_)
+            throw std::runtime_error("cand error");
+          dist_t d = fstdistfunc_(query_data, getDataByInternalId(cand),
+                                  dist_func_param_);
+
+          if (d < curdist) {
+            curdist = d;
+            currObj = cand;
+            changed = true;
+          }
+        }
+      }
+    }
+
+    size_t ef = std::max(ef_runtime.value_or(ef_), k);
+    std::priority_queue<std::pair<dist_t, tableint>,
+                        std::vector<std::pair<dist_t, tableint>>,
+                        CompareByFirst>
+        top_candidates;
+    while (true) {
+      bool exhausted = false;
+      top_candidates = searchBaseLayerFiltered(
+          currObj, query_data, ef, isIdAllowed, isCancelled, &exhausted);
+      if (top_candidates.size() >= k || exhausted ||
+          ef >= cur_element_count_ ||
+          (isCancelled && isCancelled->isCancelled())) {
+        break;
+      }
+      ef = std::min<size_t>(ef * 2, cur_element_count_);
+    }
+
+    while (top_candidates.size() > k) {
+      top_candidates.pop();
+    }
+    while (!top_candidates.empty()) {
+      std::pair<dist_t, tableint> rez = top_candidates.top();
+      result.push(std::pair<dist_t, labeltype>(rez.first,
+                                               getExternalLabel(rez.second)));
+      top_candidates.pop();
+    }
+    return result;
+  }
+  // VALKEYSEARCH END
+
   void checkIntegrity() {
     int connections_checked = 0;
     std::vector<int> inbound_connections_num(cur_element_count_, 0);
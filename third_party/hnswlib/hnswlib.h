@@ -129,6 +129,7 @@ static bool AVX512Capable() {
 #include <string.h>
 
 #include <iostream>
+#include <new>
 #include <queue>
 #include <vector>
 
@@ -207,6 +208,17 @@ class SpaceInterface {
   virtual ~SpaceInterface() {}
 };
 
+// VALKEYSEARCH START
+// Encodes full precision vectors into the compact codes a quantized graph is
+// built and traversed over.
+class VectorQuantizer {
+ public:
+  virtual void encode(const void *vector, void *code) const = 0;
+
+  virtual ~VectorQuantizer() {}
+};
+// VALKEYSEARCH END
+
 template <typename dist_t>
 class AlgorithmInterface {
  public:
@@ -253,11 +265,13 @@ AlgorithmInterface<dist_t>::searchKnnCloserFirst(
 
 class ChunkedArray {
  public:
+  // A non-zero `alignment` aligns the start of every chunk to it.
   ChunkedArray(size_t element_byte_size, size_t elements_per_chunk,
-               size_t element_count)
+               size_t element_count, size_t alignment = 0)
       : element_byte_size_(element_byte_size),
         elements_per_chunk_(elements_per_chunk),
-        element_count_(0) {
+        element_count_(0),
+        alignment_(alignment) {
     resize(element_count);
   }
 
@@ -284,7 +298,11 @@ class ChunkedArray {
 
   void clear() {
     for (auto chunk : chunks_) {
-      delete[] chunk;
+      if (alignment_) {
+        operator delete[](chunk, std::align_val_t(alignment_));
+      } else {
+        delete[] chunk;
+      }
     }
     chunks_.clear();
     element_count_ = 0;
@@ -296,7 +314,10 @@ class ChunkedArray {
 
     chunks_.resize(new_chunk_count);
     for (size_t i = chunk_count; i < new_chunk_count; i++) {
-      chunks_[i] = new char[elements_per_chunk_ * element_byte_size_];
+      size_t chunk_byte_size = elements_per_chunk_ * element_byte_size_;
+      chunks_[i] = alignment_ ? new (std::align_val_t(alignment_))
+                                    char[chunk_byte_size]
+                              : new char[chunk_byte_size];
       // Note that we don't initialize the memory on purpose. The caller
       // is expected to track the initialization state.
     }
@@ -311,6 +332,7 @@ class ChunkedArray {
   size_t element_byte_size_;
   size_t elements_per_chunk_;
   size_t element_count_;
+  size_t alignment_;
   std::deque<char *> chunks_;
 };
 
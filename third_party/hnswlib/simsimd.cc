@@ -0,0 +1,140 @@
+// Compile the kernels of every instruction set the compiler supports, like
+// simsimd's own dispatch library does. Each kernel is compiled with its own
+// target attributes, so the build flags only bound the kernels used by the
+// other translation units.
+#if defined(__linux__)
+#ifndef SIMSIMD_TARGET_NEON
+#define SIMSIMD_TARGET_NEON 1
+#endif
+#ifndef SIMSIMD_TARGET_SVE
+#define SIMSIMD_TARGET_SVE 1
+#endif
+#ifndef SIMSIMD_TARGET_HASWELL
+#define SIMSIMD_TARGET_HASWELL 1
+#endif
+#ifndef SIMSIMD_TARGET_SKYLAKE
+#define SIMSIMD_TARGET_SKYLAKE 1
+#endif
+#ifndef SIMSIMD_TARGET_ICE
+#define SIMSIMD_TARGET_ICE 1
+#endif
+#ifndef SIMSIMD_TARGET_GENOA
+#define SIMSIMD_TARGET_GENOA 1
+#endif
+#ifndef SIMSIMD_TARGET_SAPPHIRE
+#define SIMSIMD_TARGET_SAPPHIRE 1
+#endif
+#elif defined(__APPLE__)
+#ifndef SIMSIMD_TARGET_NEON
+#define SIMSIMD_TARGET_NEON 1
+#endif
+#ifndef SIMSIMD_TARGET_HASWELL
+#define SIMSIMD_TARGET_HASWELL 1
+#endif
+#endif
+
+#include "third_party/hnswlib/simsimd.h"
+
+namespace hnswlib {
+
+namespace {
+
+// From the fastest to the slowest, when a kernel exists for several.
+constexpr simsimd_capability_t kPreferredCapabilities[] = {
+    simsimd_cap_sapphire_k, simsimd_cap_genoa_k,     simsimd_cap_ice_k,
+    simsimd_cap_skylake_k,  simsimd_cap_haswell_k,   simsimd_cap_sve_i8_k,
+    simsimd_cap_sve_bf16_k, simsimd_cap_sve_f16_k,   simsimd_cap_sve_k,
+    simsimd_cap_neon_i8_k,  simsimd_cap_neon_bf16_k, simsimd_cap_neon_f16_k,
+    simsimd_cap_neon_k,     simsimd_cap_serial_k,
+};
+
+// The AVX-512 FP16 kernels of float16 vectors accumulate in float16, which
+// overflows past 65504 and loses the small terms of long sums. The AVX-512
+// kernels below them convert to float32 first, at a small cost.
+constexpr simsimd_capability_t kFloat16Allowed =
+    static_cast<simsimd_capability_t>(simsimd_cap_any_k &
+                                      ~simsimd_cap_sapphire_k);
+
+DistanceKernels FindDistanceKernels() {
+  return DistanceKernels{
+      .l2sq_f32 = FindDistanceKernel(simsimd_metric_l2sq_k,
+                                     simsimd_datatype_f32_k, simsimd_cap_any_k),
+      .dot_f32 = FindDistanceKernel(simsimd_metric_dot_k,
+                                    simsimd_datatype_f32_k, simsimd_cap_any_k),
+      .l2sq_f16 = FindDistanceKernel(simsimd_metric_l2sq_k,
+                                     simsimd_datatype_f16_k, kFloat16Allowed),
+      .dot_f16 = FindDistanceKernel(simsimd_metric_dot_k,
+                                    simsimd_datatype_f16_k, kFloat16Allowed),
+      .l2sq_bf16 = FindDistanceKernel(
+          simsimd_metric_l2sq_k, simsimd_datatype_bf16_k, simsimd_cap_any_k),
+      .dot_bf16 = FindDistanceKernel(
+          simsimd_metric_dot_k, simsimd_datatype_bf16_k, simsimd_cap_any_k),
+      .hamming_b8 = FindDistanceKernel(
+          simsimd_metric_hamming_k, simsimd_datatype_b8_k, simsimd_cap_any_k),
+  };
+}
+
+}  // namespace
+
+const DistanceKernels distance_kernels = FindDistanceKernels();
+
+DistanceKernel FindDistanceKernel(simsimd_metric_kind_t kind,
+                                  simsimd_datatype_t datatype,
+                                  simsimd_capability_t allowed) {
+  // simsimd_find_metric_punned does not always try the newest instruction
+  // set first, e.g. it prefers AVX2 over AVX-512 BF16 for bfloat16, so ask it
+  // for one instruction set at a time.
+  for (auto capability : kPreferredCapabilities) {
+    DistanceKernel kernel;
+    simsimd_find_metric_punned(
+        kind, datatype, GetCpuCapabilities(),
+        static_cast<simsimd_capability_t>(allowed & capability),
+        &kernel.metric, &kernel.capability);
+    if (kernel.metric != nullptr) {
+      return kernel;
+    }
+  }
+  return DistanceKernel{};
+}
+
+simsimd_capability_t GetCpuCapabilities() {
+  static const simsimd_capability_t capabilities = simsimd_capabilities();
+  return capabilities;
+}
+
+const char *GetCapabilityName(simsimd_capability_t capability) {
+  switch (capability) {
+    case simsimd_cap_serial_k:
+      return "serial";
+    case simsimd_cap_haswell_k:
+      return "avx2";
+    case simsimd_cap_skylake_k:
+      return "avx512";
+    case simsimd_cap_ice_k:
+      return "avx512_vnni";
+    case simsimd_cap_genoa_k:
+      return "avx512_bf16";
+    case simsimd_cap_sapphire_k:
+      return "avx512_fp16";
+    case simsimd_cap_neon_k:
+      return "neon";
+    case simsimd_cap_neon_f16_k:
+      return "neon_f16";
+    case simsimd_cap_neon_bf16_k:
+      return "neon_bf16";
+    case simsimd_cap_neon_i8_k:
+      return "neon_i8";
+    case simsimd_cap_sve_k:
+      return "sve";
+    case simsimd_cap_sve_f16_k:
+      return "sve_f16";
+    case simsimd_cap_sve_bf16_k:
+      return "sve_bf16";
+    case simsimd_cap_sve_i8_k:
+      return "sve_i8";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace hnswlib
@@ -3,29 +3,76 @@
 
 #include <cstddef>
 
-#include "third_party/simsimd/c/lib.c"
+// The kernels of every instruction set are compiled into simsimd.cc, which
+// picks the fastest ones the CPU supports when the module is loaded. Other
+// translation units only need the types, so they use the header-only build.
+// Native half types are disabled to keep simsimd_f16_t/simsimd_bf16_t as raw
+// 16-bit storage.
+#ifndef SIMSIMD_DYNAMIC_DISPATCH
+#define SIMSIMD_DYNAMIC_DISPATCH 0
+#endif
+#ifndef SIMSIMD_NATIVE_F16
+#define SIMSIMD_NATIVE_F16 0
+#endif
+#ifndef SIMSIMD_NATIVE_BF16
+#define SIMSIMD_NATIVE_BF16 0
+#endif
 
 #include "third_party/simsimd/include/simsimd/simsimd.h"
 #include "third_party/simsimd/include/simsimd/types.h"
 
+namespace hnswlib {
+
+// A distance kernel and the instruction set it was compiled for.
+struct DistanceKernel {
+  simsimd_metric_punned_t metric{nullptr};
+  simsimd_capability_t capability{simsimd_cap_serial_k};
+};
+
+// The kernels of every metric and element type the indexes support.
+struct DistanceKernels {
+  DistanceKernel l2sq_f32;
+  DistanceKernel dot_f32;
+  DistanceKernel l2sq_f16;
+  DistanceKernel dot_f16;
+  DistanceKernel l2sq_bf16;
+  DistanceKernel dot_bf16;
+  DistanceKernel hamming_b8;
+};
+
+// Kernels picked from the CPUID of the host when the module is loaded. They
+// are set by a static initializer, so distances must not be computed during
+// static initialization.
+extern const DistanceKernels distance_kernels;
+
+// Returns the fastest kernel of the metric and element type among the
+// instruction sets which are both supported by the CPU and in `allowed`. The
+// metric is null if none of them has such a kernel.
+DistanceKernel FindDistanceKernel(simsimd_metric_kind_t kind,
+                                  simsimd_datatype_t datatype,
+                                  simsimd_capability_t allowed);
+
+// Returns the instruction sets supported by the CPU.
+simsimd_capability_t GetCpuCapabilities();
+
+// Returns the name of an instruction set, e.g. "avx2" or "avx512_fp16".
+const char *GetCapabilityName(simsimd_capability_t capability);
+
+}  // namespace hnswlib
 
 inline float InnerProductDistanceSimsimd(const void *pVect1, const void *pVect2,
                                          const void *qty_ptr) {
-  simsimd_size_t dim = *static_cast<const size_t *>(qty_ptr);
-  const simsimd_f32_t *vec1 = static_cast<const simsimd_f32_t *>(pVect1);
-  const simsimd_f32_t *vec2 = static_cast<const simsimd_f32_t *>(pVect2);
   simsimd_distance_t distance;
-  simsimd_dot_f32(vec1, vec2, dim, &distance);
-  return 1.0f -  distance;
+  hnswlib::distance_kernels.dot_f32.metric(
+      pVect1, pVect2, *static_cast<const size_t *>(qty_ptr), &distance);
+  return 1.0f - distance;
 }
 
 inline float L2SqrSimsimd(const void *pVect1, const void *pVect2,
                           const void *qty_ptr) {
-  simsimd_size_t dim = *static_cast<const size_t *>(qty_ptr);
-  const simsimd_f32_t *vec1 = static_cast<const simsimd_f32_t *>(pVect1);
-  const simsimd_f32_t *vec2 = static_cast<const simsimd_f32_t *>(pVect2);
   simsimd_distance_t distance;
-  simsimd_l2sq_f32(vec1, vec2, dim, &distance);
+  hnswlib::distance_kernels.l2sq_f32.metric(
+      pVect1, pVect2, *static_cast<const size_t *>(qty_ptr), &distance);
   return distance;
 }
 
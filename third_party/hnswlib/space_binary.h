@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+
+#include "hnswlib.h"
+
+#ifdef VMSDK_ENABLE_MEMORY_ALLOCATION_OVERRIDES
+  #include "vmsdk/src/memory_allocation_overrides.h" // IWYU pragma: keep
+#endif
+
+// The popcount kernels come from simsimd, picked for the CPU at module load.
+#include "third_party/hnswlib/simsimd.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+namespace hnswlib {
+
+// Storage element of binary vectors: eight dimensions packed into a byte,
+// the first dimension in the most significant bit.
+struct bit8 {
+    uint8_t bits;
+};
+
+static_assert(sizeof(bit8) == 1, "bit8 must be 1 byte");
+
+constexpr size_t kBitsPerBit8 = 8;
+
+// Number of differing bits. qty_ptr points to the vector size in bytes.
+static float
+HammingDistance(const void *pVect1, const void *pVect2, const void *qty_ptr) {
+    simsimd_distance_t distance;
+    distance_kernels.hamming_b8.metric(pVect1, pVect2,
+                                       *static_cast<const size_t *>(qty_ptr),
+                                       &distance);
+    return static_cast<float>(distance);
+}
+
+// Hamming distance space over `dim` bits, stored as dim / 8 bytes.
+class HammingSpace : public SpaceInterface<float> {
+    size_t data_size_;
+
+ public:
+    explicit HammingSpace(size_t dim) : data_size_(dim / kBitsPerBit8) {}
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return HammingDistance;
+    }
+
+    void *get_dist_func_param() {
+        return &data_size_;
+    }
+
+    ~HammingSpace() {}
+};
+
+}  // namespace hnswlib
+#pragma GCC diagnostic pop
@@ -0,0 +1,202 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#include "hnswlib.h"
+
+#ifdef VMSDK_ENABLE_MEMORY_ALLOCATION_OVERRIDES
+  #include "vmsdk/src/memory_allocation_overrides.h" // IWYU pragma: keep
+#endif
+
+// Half-precision kernels come from simsimd, picked for the CPU at module load.
+#include "third_party/hnswlib/simsimd.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+namespace hnswlib {
+
+// IEEE-754 binary16 storage element.
+struct float16 {
+    uint16_t bits;
+};
+
+// bfloat16 storage element: the upper 16 bits of an IEEE-754 binary32.
+struct bfloat16 {
+    uint16_t bits;
+};
+
+static_assert(sizeof(float16) == 2, "float16 must be 2 bytes");
+static_assert(sizeof(bfloat16) == 2, "bfloat16 must be 2 bytes");
+
+namespace half_internal {
+
+inline uint32_t FloatToBits(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+inline float BitsToFloat(uint32_t bits) {
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+}  // namespace half_internal
+
+inline float ToFloat(float value) { return value; }
+
+// Exact widening conversion, including subnormals, infinities and NaNs.
+inline float ToFloat(float16 value) {
+    using half_internal::BitsToFloat;
+    using half_internal::FloatToBits;
+    const uint32_t w = static_cast<uint32_t>(value.bits) << 16;
+    const uint32_t sign = w & 0x80000000u;
+    const uint32_t two_w = w + w;
+    const uint32_t exp_offset = 0xE0u << 23;
+    const float exp_scale = 0x1.0p-112f;
+    const float normalized = BitsToFloat((two_w >> 4) + exp_offset) * exp_scale;
+    const uint32_t magic_mask = 126u << 23;
+    const float magic_bias = 0.5f;
+    const float denormalized =
+        BitsToFloat((two_w >> 17) | magic_mask) - magic_bias;
+    const uint32_t denormalized_cutoff = 1u << 27;
+    return BitsToFloat(sign | (two_w < denormalized_cutoff
+                                   ? FloatToBits(denormalized)
+                                   : FloatToBits(normalized)));
+}
+
+inline float ToFloat(bfloat16 value) {
+    return half_internal::BitsToFloat(static_cast<uint32_t>(value.bits) << 16);
+}
+
+template <typename T>
+T FromFloat(float value);
+
+template <>
+inline float FromFloat<float>(float value) {
+    return value;
+}
+
+// Round-to-nearest-even narrowing conversion. Values beyond the binary16
+// range become infinities.
+template <>
+inline float16 FromFloat<float16>(float value) {
+    using half_internal::BitsToFloat;
+    using half_internal::FloatToBits;
+    const float scale_to_inf = 0x1.0p+112f;
+    const float scale_to_zero = 0x1.0p-110f;
+    float base = ((value < 0 ? -value : value) * scale_to_inf) * scale_to_zero;
+    const uint32_t w = FloatToBits(value);
+    const uint32_t shl1_w = w + w;
+    const uint32_t sign = w & 0x80000000u;
+    uint32_t bias = shl1_w & 0xFF000000u;
+    if (bias < 0x71000000u) {
+        bias = 0x71000000u;
+    }
+    base = BitsToFloat((bias >> 1) + 0x07800000u) + base;
+    const uint32_t bits = FloatToBits(base);
+    const uint32_t exp_bits = (bits >> 13) & 0x00007C00u;
+    const uint32_t mantissa_bits = bits & 0x00000FFFu;
+    const uint32_t nonsign = exp_bits + mantissa_bits;
+    return float16{static_cast<uint16_t>(
+        (sign >> 16) | (shl1_w > 0xFF000000u ? 0x7E00u : nonsign))};
+}
+
+// Round-to-nearest-even narrowing conversion; NaNs stay quiet NaNs.
+template <>
+inline bfloat16 FromFloat<bfloat16>(float value) {
+    const uint32_t bits = half_internal::FloatToBits(value);
+    if ((bits & 0x7FFFFFFFu) > 0x7F800000u) {
+        return bfloat16{static_cast<uint16_t>((bits >> 16) | 0x0040u)};
+    }
+    const uint32_t rounding_bias = 0x7FFFu + ((bits >> 16) & 1u);
+    return bfloat16{static_cast<uint16_t>((bits + rounding_bias) >> 16)};
+}
+
+static float
+L2SqrF16(const void *pVect1, const void *pVect2, const void *qty_ptr) {
+    simsimd_distance_t distance;
+    distance_kernels.l2sq_f16.metric(pVect1, pVect2,
+                                     *static_cast<const size_t *>(qty_ptr),
+                                     &distance);
+    return static_cast<float>(distance);
+}
+
+static float
+InnerProductDistanceF16(const void *pVect1, const void *pVect2, const void *qty_ptr) {
+    simsimd_distance_t distance;
+    distance_kernels.dot_f16.metric(pVect1, pVect2,
+                                    *static_cast<const size_t *>(qty_ptr),
+                                    &distance);
+    return 1.0f - static_cast<float>(distance);
+}
+
+static float
+L2SqrBF16(const void *pVect1, const void *pVect2, const void *qty_ptr) {
+    simsimd_distance_t distance;
+    distance_kernels.l2sq_bf16.metric(pVect1, pVect2,
+                                      *static_cast<const size_t *>(qty_ptr),
+                                      &distance);
+    return static_cast<float>(distance);
+}
+
+static float
+InnerProductDistanceBF16(const void *pVect1, const void *pVect2, const void *qty_ptr) {
+    simsimd_distance_t distance;
+    distance_kernels.dot_bf16.metric(pVect1, pVect2,
+                                     *static_cast<const size_t *>(qty_ptr),
+                                     &distance);
+    return 1.0f - static_cast<float>(distance);
+}
+
+// Distance space over 16-bit elements. Distances are always reported as
+// float so that half-precision indexes share the float graph/search code.
+class HalfSpace : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    HalfSpace(size_t dim, DISTFUNC<float> dist_func)
+        : fstdistfunc_(dist_func), data_size_(dim * sizeof(uint16_t)), dim_(dim) {}
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~HalfSpace() {}
+};
+
+class L2SpaceF16 : public HalfSpace {
+ public:
+    explicit L2SpaceF16(size_t dim) : HalfSpace(dim, L2SqrF16) {}
+};
+
+class InnerProductSpaceF16 : public HalfSpace {
+ public:
+    explicit InnerProductSpaceF16(size_t dim)
+        : HalfSpace(dim, InnerProductDistanceF16) {}
+};
+
+class L2SpaceBF16 : public HalfSpace {
+ public:
+    explicit L2SpaceBF16(size_t dim) : HalfSpace(dim, L2SqrBF16) {}
+};
+
+class InnerProductSpaceBF16 : public HalfSpace {
+ public:
+    explicit InnerProductSpaceBF16(size_t dim)
+        : HalfSpace(dim, InnerProductDistanceBF16) {}
+};
+
+}  // namespace hnswlib
+#pragma GCC diagnostic pop
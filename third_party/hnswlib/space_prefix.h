@@ -0,0 +1,70 @@
+#pragma once
+#include <cmath>
+#include <memory>
+
+#include "hnswlib.h"
+#include "space_half.h"
+#include "space_ip.h"
+#include "space_l2.h"
+
+namespace hnswlib {
+
+// Distance space over the leading dimensions of vectors of element type T,
+// which also encodes the vectors into those prefixes. Matryoshka-trained
+// embeddings concentrate their information in the leading dimensions, so the
+// distances between prefixes approximate the full distances at a fraction of
+// the bytes. Prefixes are stored as float, and re-normalized when the metric
+// compares directions, as a normalized vector's prefix no longer is.
+template <typename T>
+class PrefixSpace : public SpaceInterface<float>, public VectorQuantizer {
+    size_t dim_;
+    bool normalize_;
+    std::unique_ptr<SpaceInterface<float>> space_;
+
+ public:
+    PrefixSpace(size_t dim, bool inner_product, bool normalize)
+        : dim_(dim), normalize_(normalize) {
+        if (inner_product) {
+            space_ = std::make_unique<InnerProductSpace>(dim);
+        } else {
+            space_ = std::make_unique<L2Space>(dim);
+        }
+    }
+
+    size_t get_dim() const {
+        return dim_;
+    }
+
+    size_t get_data_size() {
+        return space_->get_data_size();
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return space_->get_dist_func();
+    }
+
+    void *get_dist_func_param() {
+        return space_->get_dist_func_param();
+    }
+
+    void encode(const void *vector, void *code) const override {
+        const T *src = static_cast<const T *>(vector);
+        float *dst = static_cast<float *>(code);
+        float norm = 0;
+        for (size_t i = 0; i < dim_; i++) {
+            dst[i] = ToFloat(src[i]);
+            norm += dst[i] * dst[i];
+        }
+        if (!normalize_ || norm == 0) {
+            return;
+        }
+        float inverse_norm = 1.0f / std::sqrt(norm);
+        for (size_t i = 0; i < dim_; i++) {
+            dst[i] *= inverse_norm;
+        }
+    }
+
+    ~PrefixSpace() {}
+};
+
+}  // namespace hnswlib
@@ -0,0 +1,179 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "hnswlib.h"
+#include "space_half.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+namespace hnswlib {
+
+// Per-dimension scalar quantization: element i is stored as the int8 code
+// round((x - center[i]) / step[i]), clamped to [-127, 127].
+struct SQ8Param {
+    size_t dim;
+    std::vector<float> center;
+    std::vector<float> step;
+};
+
+static float
+SQ8L2Sqr(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const SQ8Param *param = static_cast<const SQ8Param *>(param_ptr);
+    const int8_t *pVect1 = static_cast<const int8_t *>(pVect1v);
+    const int8_t *pVect2 = static_cast<const int8_t *>(pVect2v);
+    const float *step = param->step.data();
+
+    float res = 0;
+    for (size_t i = 0; i < param->dim; i++) {
+        float t = step[i] * static_cast<float>(pVect1[i] - pVect2[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+static float
+SQ8InnerProductDistance(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const SQ8Param *param = static_cast<const SQ8Param *>(param_ptr);
+    const int8_t *pVect1 = static_cast<const int8_t *>(pVect1v);
+    const int8_t *pVect2 = static_cast<const int8_t *>(pVect2v);
+    const float *center = param->center.data();
+    const float *step = param->step.data();
+
+    float res = 0;
+    for (size_t i = 0; i < param->dim; i++) {
+        float a = center[i] + step[i] * static_cast<float>(pVect1[i]);
+        float b = center[i] + step[i] * static_cast<float>(pVect2[i]);
+        res += a * b;
+    }
+    return 1.0f - res;
+}
+
+// Distance space over int8 codes, which also encodes vectors of element type
+// T into those codes. The quantization range of each dimension is learned
+// from the vectors passed to fit(), padded so that small drifts of the data
+// do not require re-encoding. Elements outside of the ranges are clamped.
+template <typename T>
+class SQ8Space : public SpaceInterface<float>, public VectorQuantizer {
+    static constexpr float kMaxCode = 127.0f;
+    static constexpr float kRangePadding = 0.125f;
+
+    DISTFUNC<float> fstdistfunc_;
+    SQ8Param param_;
+    std::vector<float> min_;
+    std::vector<float> max_;
+    size_t fit_count_{0};
+
+    void updateParams() {
+        for (size_t i = 0; i < param_.dim; i++) {
+            float width = std::max(max_[i] - min_[i], 1e-6f);
+            float lower = min_[i] - width * kRangePadding;
+            float upper = max_[i] + width * kRangePadding;
+            param_.center[i] = lower + (upper - lower) / 2;
+            param_.step[i] = (upper - lower) / (2 * kMaxCode);
+        }
+    }
+
+ public:
+    SQ8Space(size_t dim, bool inner_product)
+        : fstdistfunc_(inner_product ? SQ8InnerProductDistance : SQ8L2Sqr),
+          min_(dim, std::numeric_limits<float>::max()),
+          max_(dim, std::numeric_limits<float>::lowest()) {
+        param_.dim = dim;
+        param_.center.assign(dim, 0.0f);
+        param_.step.assign(dim, 1.0f);
+    }
+
+    size_t get_data_size() {
+        return param_.dim * sizeof(int8_t);
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &param_;
+    }
+
+    void encode(const void *vector, void *code) const override {
+        const T *src = static_cast<const T *>(vector);
+        int8_t *dst = static_cast<int8_t *>(code);
+        for (size_t i = 0; i < param_.dim; i++) {
+            float q = std::round((ToFloat(src[i]) - param_.center[i]) /
+                                 param_.step[i]);
+            dst[i] = static_cast<int8_t>(std::clamp(q, -kMaxCode, kMaxCode));
+        }
+    }
+
+    // Returns true if every element of the vector can be encoded without
+    // clamping.
+    bool covers(const void *vector) const {
+        if (fit_count_ == 0) {
+            return false;
+        }
+        const T *src = static_cast<const T *>(vector);
+        for (size_t i = 0; i < param_.dim; i++) {
+            float value = ToFloat(src[i]);
+            if (std::abs(value - param_.center[i]) >
+                kMaxCode * param_.step[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Accounts for the vector in the quantization ranges, widening them if it
+    // falls outside. Returns true if they were widened, in which case the
+    // codes encoded before the call must be re-encoded.
+    bool fit(const void *vector) {
+        bool widen = !covers(vector);
+        const T *src = static_cast<const T *>(vector);
+        for (size_t i = 0; i < param_.dim; i++) {
+            float value = ToFloat(src[i]);
+            min_[i] = std::min(min_[i], value);
+            max_[i] = std::max(max_[i], value);
+        }
+        fit_count_++;
+        if (widen) {
+            updateParams();
+        }
+        return widen;
+    }
+
+    size_t getFitCount() const {
+        return fit_count_;
+    }
+
+    const std::vector<float> &getRangeMin() const {
+        return min_;
+    }
+
+    const std::vector<float> &getRangeMax() const {
+        return max_;
+    }
+
+    // Restores the ranges saved from getRangeMin() and getRangeMax().
+    bool restore(std::vector<float> min, std::vector<float> max,
+                 size_t fit_count) {
+        if (min.size() != param_.dim || max.size() != param_.dim) {
+            return false;
+        }
+        min_ = std::move(min);
+        max_ = std::move(max);
+        fit_count_ = fit_count;
+        if (fit_count_ != 0) {
+            updateParams();
+        }
+        return true;
+    }
+
+    ~SQ8Space() {}
+};
+
+}  // namespace hnswlib
+#pragma GCC diagnostic pop
@@ -8,6 +8,7 @@
 #include "vmsdk/src/thread_pool.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstddef>
 #include <memory>
@@ -18,6 +19,7 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/functional/any_invocable.h"
+#include "absl/functional/function_ref.h"
 #include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/synchronization/blocking_counter.h"
@@ -434,4 +436,55 @@ std::optional<absl::AnyInvocable<void()>> ThreadPool::TryGetNextTask() {
   return std::move(task_with_time.task);
 }
 
+namespace {
+
+// The tasks of a RunInParallel call, claimed one at a time by the calling
+// thread and by the helpers scheduled on the pool.
+struct ParallelTasks {
+  ParallelTasks(size_t num_tasks, absl::FunctionRef<void(size_t)> task)
+      : num_tasks(num_tasks), task(task) {}
+
+  void Run() {
+    for (size_t i = next.fetch_add(1); i < num_tasks; i = next.fetch_add(1)) {
+      task(i);
+      absl::MutexLock lock(&mutex);
+      ++done;
+    }
+  }
+
+  bool AllDone() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+    return done == num_tasks;
+  }
+
+  const size_t num_tasks;
+  // Only invoked for a claimed task, which RunInParallel waits for, so it
+  // never outlives the caller's callable.
+  absl::FunctionRef<void(size_t)> task;
+  std::atomic<size_t> next{0};
+  absl::Mutex mutex;
+  size_t done ABSL_GUARDED_BY(mutex){0};
+};
+
+}  // namespace
+
+void RunInParallel(ThreadPool *pool, size_t num_tasks,
+                   absl::FunctionRef<void(size_t)> task,
+                   ThreadPool::Priority priority) {
+  if (num_tasks == 0) {
+    return;
+  }
+  // Helpers may run after all the tasks completed, so they share ownership of
+  // the tasks state.
+  auto tasks = std::make_shared<ParallelTasks>(num_tasks, task);
+  if (pool) {
+    size_t num_helpers = std::min(num_tasks - 1, pool->Size());
+    for (size_t i = 0; i < num_helpers; ++i) {
+      pool->Schedule([tasks]() { tasks->Run(); }, priority);
+    }
+  }
+  tasks->Run();
+  absl::MutexLock lock(&tasks->mutex);
+  tasks->mutex.Await(absl::Condition(tasks.get(), &ParallelTasks::AllDone));
+}
+
 }  // namespace vmsdk
@@ -21,6 +21,7 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/functional/any_invocable.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/synchronization/blocking_counter.h"
 #include "absl/synchronization/mutex.h"
@@ -188,5 +189,14 @@ class ThreadPool {
   FRIEND_TEST(ThreadPoolTest, DynamicSizing);
 };
 
+/// Runs `task(i)` for every i in [0, num_tasks) and returns once all of them
+/// completed. The calling thread runs tasks too, while helpers scheduled on
+/// `pool` claim the others. A task is never left waiting in the queue of the
+/// pool, so this can be called from a worker of `pool` itself, and runs every
+/// task on the calling thread if `pool` is null or busy.
+void RunInParallel(ThreadPool* pool, size_t num_tasks,
+                   absl::FunctionRef<void(size_t)> task,
+                   ThreadPool::Priority priority = ThreadPool::Priority::kHigh);
+
 }  // namespace vmsdk
 #endif  // VMSDK_SRC_THREAD_POOL_H_
@@ -797,4 +797,37 @@ TEST_F(ThreadPoolTest, QueueWaitTimeWithDifferentPriorities) {
   pool.JoinWorkers();
 }
 
+TEST_F(ThreadPoolTest, RunInParallel) {
+  ThreadPool thread_pool("test-pool", 4);
+  thread_pool.StartWorkers();
+  for (ThreadPool* pool : {&thread_pool, static_cast<ThreadPool*>(nullptr)}) {
+    std::vector<std::atomic<int>> runs(100);
+    RunInParallel(pool, runs.size(), [&runs](size_t i) { ++runs[i]; });
+    for (const auto& run : runs) {
+      EXPECT_EQ(run, 1);
+    }
+  }
+  thread_pool.JoinWorkers();
+}
+
+TEST_F(ThreadPoolTest, RunInParallelFromWorkers) {
+  // Every worker runs a split task, so none is left to help the others. The
+  // callers run their own sub-tasks rather than waiting for the queue.
+  ThreadPool thread_pool("test-pool", 2);
+  thread_pool.StartWorkers();
+  absl::BlockingCounter blocking_refcount(thread_pool.Size());
+  std::atomic<size_t> runs{0};
+  for (size_t i = 0; i < thread_pool.Size(); ++i) {
+    EXPECT_TRUE(thread_pool.Schedule(
+        [&thread_pool, &runs, &blocking_refcount] {
+          RunInParallel(&thread_pool, 10, [&runs](size_t) { ++runs; });
+          blocking_refcount.DecrementCount();
+        },
+        ThreadPool::Priority::kHigh));
+  }
+  blocking_refcount.Wait();
+  EXPECT_EQ(runs, 10 * thread_pool.Size());
+  thread_pool.JoinWorkers();
+}
+
 }  // namespace vmsdk